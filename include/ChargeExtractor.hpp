@@ -0,0 +1,93 @@
+#ifndef __CHARGEEXTRACTOR_H
+#define __CHARGEEXTRACTOR_H
+
+#include "Config.hpp"
+#include "EventFormat.hpp"
+#include "EventProcessor.hpp"
+
+/** @def DL1_WINDOW
+ * @brief Default width of the integration window [samples]
+ */
+#define DL1_WINDOW 7
+
+/** @def DL1_MODULESIZE
+ * @brief Size of the DL1 record of one module with nGain gains [bytes]
+ */
+#define DL1_MODULESIZE(nGain) ((nGain)*NCHANNEL*(4+2))
+
+namespace LSTDAQ{
+
+  /**
+   * Extraction of charge and peak time of each channel (EVFMT_DL1).
+   *
+   * For each channel and stored gain, the window of the given width with the largest sum of samples is
+   * searched by sliding it over the READDEPTH samples, and its sum minus the baseline is the charge.
+   * The baseline is PEDESTAL_OFFSET per sample if the pedestals are subtracted (EVFMT_PEDSUB), 0 otherwise.
+   * The peak time is the index of the largest sample. Both are computed for the 8 channels of a line
+   * at once with SSSE3 (32 bit window sums, 16 bit maxima and indices) when available.
+   *
+   * DL1 payload (EVFMT_DL1, plus EVFMT_GAINSEL/EVFMT_PEDSUB of the input):
+   * - prefix of the input format (gain bitmap with EVFMT_GAINSEL)
+   * - for each module, DL1_MODULESIZE(nGain) bytes : for each stored gain,
+   *   int charge[NCHANNEL] then unsigned short peak[NCHANNEL], in host byte order like EventHeader.
+   *
+   * The records are written either to the side output of WorkerPool (a separate DL1 stream next to the
+   * events) or, with replace, instead of the waveforms in the event itself. Dense layouts only :
+   * the stage runs after pedestal subtraction and gain selection and before zero suppression.
+   */
+  class ChargeExtractor : public EventProcessor
+  {
+  public:
+    /**
+     * @param window  width of the integration window [samples] (1 - READDEPTH)
+     * @param replace true to replace the payload by the DL1 record, false to make side records
+     */
+    ChargeExtractor(int window, bool replace) throw();
+    virtual ~ChargeExtractor() throw();
+
+    virtual const char *getName();
+    virtual unsigned int getSideSize(unsigned int inSize);
+    virtual bool makeSide(const EventHeader *header, const unsigned char *data,
+                          EventHeader *sideHeader, unsigned char *side, int worker);
+    virtual bool process(EventHeader *header, unsigned char **data, unsigned char **spare, int worker);
+    virtual void printSummary();
+
+    /**
+     * Extracts charge and peak time of one gain of one module.
+     * @param module   module in the dense layout
+     * @param nGain    number of stored gains
+     * @param gain     gain to extract (0 - nGain-1)
+     * @param baseline baseline per sample [counts]
+     * @param charge   NCHANNEL charges are stored here.
+     * @param peak     NCHANNEL peak times are stored here.
+     */
+    static void extractGain(const unsigned char *module, int nGain, int gain, int window, int baseline,
+                            int *charge, unsigned short *peak);
+    /**
+     * Makes the DL1 record of one module.
+     * @param module   module in the dense layout
+     * @param nGain    number of stored gains
+     * @param baseline baseline per sample [counts]
+     * @param out      DL1_MODULESIZE(nGain) bytes are stored here.
+     */
+    static void extractModule(const unsigned char *module, int nGain, int window, int baseline, unsigned char *out);
+
+    /**
+     * Makes the DL1 payload of an event.
+     * @return flags of the DL1 payload, or 0 if the payload is not a dense layout.
+     */
+    unsigned short extract(const EventHeader *header, const unsigned char *data, unsigned char *out, unsigned int *size);
+
+  private:
+    int m_window;
+    bool m_replace;
+    //counter of each worker on its own cache line
+    struct Count
+    {
+      unsigned long long nRecord;
+    } __attribute__((aligned(CACHELINE_SIZE)));
+    Count m_count[MAX_WORKER];
+  };
+}
+
+#endif
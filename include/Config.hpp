@@ -24,6 +24,44 @@
 #define EVENTSIZE (READDEPTH*2 + 2 +1 +1)*16
 
 
+/*--- Layout of the fragment of one module ---*/
+/** @def LINESIZE
+ * @brief Size of one line of the fragment [bytes]
+ */
+#define LINESIZE 16
+
+/** @def NCHANNEL
+ * @brief Number of channels in one line (16 bit big endian samples)
+ */
+#define NCHANNEL 8
+
+/** @def NGAIN
+ * @brief Number of gains (0: high gain, 1: low gain)
+ */
+#define NGAIN 2
+
+/** @def LINE_FLAG
+ * @brief Line of the flags
+ */
+#define LINE_FLAG 2
+
+/** @def LINE_STOPCELL
+ * @brief Line of the DRS4 stop cells (one per channel)
+ */
+#define LINE_STOPCELL 3
+
+/** @def LINE_WAVEFORM
+ * @brief First line of the waveforms.
+
+ * High and low gain lines are interleaved : sample s of gain g is at line LINE_WAVEFORM + 2*s + g.
+ */
+#define LINE_WAVEFORM 4
+
+/** @def DRS4_NCELL
+ * @brief Number of cells of a DRS4 channel
+ */
+#define DRS4_NCELL 4096
+
 /*FakeFEB sends data begins with header 2 bytes and followed by ipaddress 4 bytes */
 #define HEADERLEN 2   //for FakeFEB only
 #define IPADDRLEN 4   //for FakeFEB only
@@ -93,15 +131,40 @@ POSTRGNO+TRGNOLEN = (12+4) = 16
  */
 #define POSCLK    POSTRGNO+TRGNOLEN
 
+/** @def FRAGMENT_MISSING_MARK
+ * @brief Written over the AAAA header and the PPS counter of the fragment the builder node puts in the Ring Buffer
+ * of a module flagged missing in a sub-event. Only the TriggerCounter of such a fragment is valid.
+ */
+#define FRAGMENT_MISSING_MARK "MISS"
+
 /** @def MAX_CONNECTION
  * @brief max number of connections
  */
 #define MAX_CONNECTION 48
+//EventHeader::missing has one bit per module of a partition, over all the nodes under -N
+#if MAX_CONNECTION>64
+#error "MAX_CONNECTION must be at most 64"
+#endif
+
+/** @def MAX_PARTITION
+ * @brief max number of partitions (independent cameras) in Connection.conf
+ */
+#define MAX_PARTITION 8
+
+/** @def MAX_PARTITION_CPU
+ * @brief max number of CPUs in the CPU set of a partition
+ */
+#define MAX_PARTITION_CPU 256
+
+/** @def MAX_CPU
+ * @brief max number of CPUs of the machine considered for the placement of the threads
+ */
+#define MAX_CPU 1024
 
 /** @def MAX_RINGBUF
- * @brief max number of ring buffer
+ * @brief max number of ring buffer (one more per partition to terminate its list)
  */
-#define MAX_RINGBUF 49
+#define MAX_RINGBUF (MAX_CONNECTION+MAX_PARTITION)
 
 //error exit threshold 
 #define ERR_NDROPPED 100000
@@ -111,12 +174,221 @@ POSTRGNO+TRGNOLEN = (12+4) = 16
 #define THRUPUTMES_INTERVALSEC 0
 #define THRUPUTMES_INTERVALNSEC 1000000 
 //1000000 for 1msec
-#define MAX_NWMES 10000
 
 //outputfile by DAQtimer
 #define MESFILE "LSTDAQmeasure.dat"
 #define ERRMESFILE "LSTDAQerrmeasure.dat"
+/** @def HISTO_SUBBITS
+ * @brief log2 of the linear sub-buckets in each power of 2 of LatencyHistogram. The relative error of a value is below 2^-HISTO_SUBBITS.
+ */
+#define HISTO_SUBBITS 6
+/** @def HISTO_NBUCKET
+ * @brief Number of buckets of LatencyHistogram, covering 0 ... 2^64-1 [nsec]
+ */
+#define HISTO_NBUCKET ((65-HISTO_SUBBITS)<<HISTO_SUBBITS)
 
 #define LOGPATH "./log"
 
+/*--- Output writer (EventWriter) ---*/
+/** @def WRITER_BLOCKSIZE_MB
+ * @brief Default size of one output block [MB]
+ */
+#define WRITER_BLOCKSIZE_MB 16
+
+/** @def WRITER_NBLOCK
+ * @brief Default number of output blocks (2 = double buffering)
+ */
+#define WRITER_NBLOCK 2
+
+/** @def WRITER_MAX_NBLOCK
+ * @brief max number of output blocks
+ */
+#define WRITER_MAX_NBLOCK 64
+
+/** @def WRITER_ALIGN
+ * @brief Alignment of output blocks [bytes]
+ */
+#define WRITER_ALIGN 4096
+
+/** @def WRITER_IDLE_MSEC
+ * @brief Interval at which an idle writer thread checks the rotation of the output files by time [msec]
+ */
+#define WRITER_IDLE_MSEC 200
+
+/** @def OUTPUT_ENGINE_BUFFERED
+ * @brief Output engine writing through the page cache
+ */
+#define OUTPUT_ENGINE_BUFFERED 0
+
+/** @def OUTPUT_ENGINE_DIRECT
+ * @brief Output engine writing with O_DIRECT and native AIO
+ */
+#define OUTPUT_ENGINE_DIRECT 1
+
+/** @def OUTPUT_QDEPTH
+ * @brief Default number of writes in flight of the direct output engine
+ */
+#define OUTPUT_QDEPTH 4
+
+/** @def MAX_STRIPE
+ * @brief max number of output directories to stripe events over
+ */
+#define MAX_STRIPE 16
+
+/** @def INDEX_BLOCKSIZE
+ * @brief Size of one block of index files [bytes]
+ */
+#define INDEX_BLOCKSIZE (1024*1024)
+
+/*--- Event processing (WorkerPool) ---*/
+/** @def MAX_WORKER
+ * @brief max number of worker threads processing built events
+ */
+#define MAX_WORKER 32
+
+/** @def WORKER_NSLOT
+ * @brief Number of event slots per worker thread
+ */
+#define WORKER_NSLOT 8
+
+/** @def CACHELINE_SIZE
+ * @brief Alignment of the counters updated by each worker thread, so that workers do not share cache lines [bytes]
+ */
+#define CACHELINE_SIZE 64
+
+/** @def MAX_PROCESSOR
+ * @brief max number of processing stages applied to each event
+ */
+#define MAX_PROCESSOR 8
+
+/** @def EVENTPOOL_NSPARE
+ * @brief Number of event buffers in addition to the slots of WorkerPool (the one being built and the one being written)
+ */
+#define EVENTPOOL_NSPARE 2
+
+/** @def EVENTPOOL_POLL_MSEC
+ * @brief Interval to check the stop request while the builder waits for a free event buffer [msec]
+ */
+#define EVENTPOOL_POLL_MSEC 100
+
+/*--- Event distribution (EventDispatcher) ---*/
+/** @def MAX_CONSUMER
+ * @brief max number of consumers of the built event stream
+ */
+#define MAX_CONSUMER 8
+
+/** @def DISPATCH_QDEPTH
+ * @brief Default number of events queued for each consumer
+ */
+#define DISPATCH_QDEPTH 16
+
+/** @def DISPATCH_POLL_USEC
+ * @brief Interval to check an empty (consumer) or full (publisher) queue again [usec]
+ */
+#define DISPATCH_POLL_USEC 100
+
+/** @def DISPATCH_BLOCK
+ * @brief Consumer policy : lossless, the publisher waits for the consumer
+ */
+#define DISPATCH_BLOCK 0
+
+/** @def DISPATCH_DROP
+ * @brief Consumer policy : events are dropped for the consumer while its queue is full
+ */
+#define DISPATCH_DROP 1
+
+/** @def SHM_RINGSIZE_MB
+ * @brief Default size of the shared memory ring of events [MB]
+ */
+#define SHM_RINGSIZE_MB 64
+
+/** @def MAX_STREAM_CLIENT
+ * @brief max number of clients of the event stream server
+ */
+#define MAX_STREAM_CLIENT 8
+
+/** @def STREAM_QUEUE_MB
+ * @brief Size of the queue of events for each stream client [MB]
+ */
+#define STREAM_QUEUE_MB 8
+
+/** @def STREAM_MAX_PRESCALE
+ * @brief max prescale the stream server applies to a slow client
+ */
+#define STREAM_MAX_PRESCALE 1024
+
+/** @def STREAM_POLL_MSEC
+ * @brief Interval of the stream server to check new connections and disconnected clients [msec]
+ */
+#define STREAM_POLL_MSEC 200
+
+/** @def STREAM_REQUEST_MSEC
+ * @brief Time to wait for the request line of a new stream client [msec]
+ */
+#define STREAM_REQUEST_MSEC 200
+
+/** @def STREAM_SENDTIMEOUT_SEC
+ * @brief Timeout of a send to a stream client. A client stalled longer is dropped at the end of the run [sec]
+ */
+#define STREAM_SENDTIMEOUT_SEC 1
+
+/** @def MAX_NODE
+ * @brief max number of collector nodes sending sub-events to a builder node
+ */
+#define MAX_NODE 16
+
+/** @def NODE_CONNECT_SEC
+ * @brief Time a collector node retries to connect to the builder node [sec]
+ */
+#define NODE_CONNECT_SEC 10
+
+/** @def NODE_POLL_MSEC
+ * @brief Interval of the builder node to check the stop request while waiting for sub-events [msec]
+ */
+#define NODE_POLL_MSEC 200
+
+/** @def NODE_SOCKBUF_MB
+ * @brief Socket buffer of the links between collector nodes and the builder node [MB]
+ */
+#define NODE_SOCKBUF_MB 4
+
+/** @def RC_POLL_MSEC
+ * @brief Interval of the run control loop to check the end of the run and SIGINT/SIGTERM while waiting for commands [msec]
+ */
+#define RC_POLL_MSEC 200
+/** @def RC_CONFIGURE_SEC
+ * @brief Time for configure to connect all the FEBs before it fails [sec]
+ */
+#define RC_CONFIGURE_SEC 30
+/** @def FEB_CONNECT_SEC
+ * @brief Time for the TCP connection to a FEB before it fails [sec]
+ */
+#define FEB_CONNECT_SEC 5
+
+/** @def RT_PRIO_COLLECTOR
+ * @brief SCHED_FIFO priority of Collector_thread and Node_thread in real-time mode (-t)
+ */
+#define RT_PRIO_COLLECTOR 50
+/** @def RT_PRIO_BUILDER
+ * @brief SCHED_FIFO priority of Builder_thread while it builds a run in real-time mode (0: SCHED_OTHER)
+ */
+#define RT_PRIO_BUILDER 40
+/** @def RT_IDLE_USEC
+ * @brief sleep of Builder_thread in real-time mode when a Ring Buffer is empty, to let the threads sharing its CPU run [usec]
+ */
+#define RT_IDLE_USEC 50
+
+/** @def METRICS_INTERVAL_MSEC
+ * @brief Interval of the rates served by the metrics server (-H), measured by ThruPutMes_thread [msec]
+ */
+#define METRICS_INTERVAL_MSEC 1000
+/** @def METRICS_POLL_MSEC
+ * @brief Interval of the metrics server to check new connections and its end [msec]
+ */
+#define METRICS_POLL_MSEC 200
+/** @def METRICS_REQUEST_MSEC
+ * @brief Time to wait for the HTTP request of a metrics client [msec]
+ */
+#define METRICS_REQUEST_MSEC 200
+
 #endif
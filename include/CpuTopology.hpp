@@ -0,0 +1,79 @@
+#ifndef __CPUTOPOLOGY_H
+#define __CPUTOPOLOGY_H
+
+#include <string>
+#include "Config.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * CPU and NUMA topology of the machine, read from /sys, used to place the threads (see \ref CPU_ID).
+   *
+   * - /sys/devices/system/node/nodeN/cpulist : NUMA node of each CPU.
+   * - /sys/devices/system/cpu/cpuN/topology/{physical_package_id,core_id} : physical core of each CPU.
+   *   CPUs on the same physical core are SMT siblings.
+   * - /sys/class/net/IF/device/numa_node : NUMA node of the NIC IF.
+   * - /sys/devices/system/cpu/{isolated,nohz_full} : CPUs kept free of other tasks (isolcpus=) and of the
+   *   scheduler tick (nohz_full=) by the kernel command line.
+   * Without these files (e.g. in a container), all CPUs are on node 0 and have their own core.
+   *
+   * @param m_node[] int : NUMA node of each CPU.
+   * @param m_core[] int : physical core of each CPU, unique over the packages.
+   * @param m_isolated[] bool : CPU in isolcpus or nohz_full.
+   */
+  class CpuTopology
+  {
+  public:
+    /**
+     * Constructor
+     */
+    CpuTopology() throw();
+    /**
+     * Destructor
+     */
+    virtual ~CpuTopology() throw();
+
+    /**
+     * Reads the topology of CPU 0 ... nCpu-1.
+     */
+    void load(int nCpu);
+    /**
+     * @return true if the CPUs are on the same physical core
+     */
+    bool isSibling(int cpu1, int cpu2) throw();
+    /**
+     * @return true if the CPU is in isolcpus or nohz_full
+     */
+    bool isIsolated(int cpu) throw();
+    /**
+     * NUMA node of the NIC which the packets to addr go out through.
+     * @param addr IPv4 address of a FEB
+     * @param ifName set to the name of the NIC (empty if unknown)
+     * @return -1 if unknown (loopback, virtual NIC or no NUMA)
+     */
+    static int nicNode(const char *addr, std::string &ifName);
+    /**
+     * Parses a CPU list like "0-3,8".
+     * @return number of CPUs set to cpu[], -1 on syntax error
+     */
+    static int parseCpuList(const char *list, int *cpu, int max);
+
+    //getter methods
+    int getNnode() throw();
+    int getNode(int cpu) throw();
+    int getCore(int cpu) throw();
+    const char *getIsolatedList() throw();
+    const char *getNohzList() throw();
+
+  private:
+    int m_nCpu;
+    int m_nNode;
+    int m_node[MAX_CPU];
+    int m_core[MAX_CPU];
+    bool m_isolated[MAX_CPU];
+    std::string m_isolatedList; //!< as in /sys/devices/system/cpu/isolated
+    std::string m_nohzList;     //!< as in /sys/devices/system/cpu/nohz_full
+  };
+}
+
+#endif
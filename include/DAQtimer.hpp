@@ -6,10 +6,20 @@
 #include <fstream> //FILE discriptor
 
 #include "Config.hpp"
+#include "LatencyHistogram.hpp"
 //#include <time.h>     //for measuring time
 //#include <sys/time.h> //for making filename
 
 namespace LSTDAQ{
+  /**
+   * Timer of the DAQ performance, used by Builder_thread.
+   *
+   * The times are taken with a monotonic clock. Over the whole run, it fills two LatencyHistogram :
+   * - build interval : time between two events built (readend()), from the 2nd event.
+   * - event latency  : time from the first fragment of an event read from the Ring Buffers (readbegin())
+   *   to the event built (readend()), including the resynchronization of the trigger numbers.
+   * Their p50/p99/p99.9/max are reported by DAQsummary() and served by the metrics server (see \ref METRICS).
+   */
   class DAQtimer
   {
   public:
@@ -18,6 +28,13 @@ namespace LSTDAQ{
     
     unsigned long long GetRealTimeInterval(const  struct timespec *pFrom, const struct timespec *pTo);
     void DAQstart();
+    /**
+     * Called when the first fragment of an event is read.
+     */
+    void readbegin();
+    /**
+     * Called when an event is built.
+     */
     void readend();
     void DAQend();
     void DAQsummary(int infreq, 
@@ -42,16 +59,22 @@ namespace LSTDAQ{
 		   unsigned long Ntrg[MAX_CONNECTION], 
 		   unsigned long Nevt[MAX_CONNECTION]);
     void fclose();
+
+    //getter methods
+    LatencyHistogram *getInterval() throw(){return &m_interval;}
+    LatencyHistogram *getLatency() throw(){return &m_latency;}
   private:
+    void printHisto(const char *title, LatencyHistogram *histo);
 
     char   m_foutName[128];
     int m_nServ;
     struct timeval tv;
     struct timespec tsStart,tsEnd,tsRStart;
-    struct timespec tsctime1,tsctime2;
-    int readcount;
-    unsigned long long llstartdiffusec;
-    unsigned long long lltime_diff[1000];
+    struct timespec tsctime1,tsctime2,tsBegin;
+    unsigned long long readcount;
+    unsigned long long llstartdiffusec; //!< from DAQstart() to the 1st event [usec]
+    LatencyHistogram m_interval;        //!< build interval [nsec]
+    LatencyHistogram m_latency;         //!< event latency [nsec]
 
   };
     
@@ -0,0 +1,116 @@
+#ifndef __EVENTBUFFERPOOL_H
+#define __EVENTBUFFERPOOL_H
+
+#include <pthread.h>
+#include "Config.hpp"
+#include "EventFormat.hpp"
+
+namespace LSTDAQ{
+
+  class EventBufferPool;
+
+  /**
+   * One built event owned by EventBufferPool.
+   *
+   * Builder_thread assembles the fragments directly into data. The buffer is then passed by pointer
+   * to the consumers (WorkerPool, EventOutput, ...), each of which holds one reference.
+   * The buffer returns to the pool when the last reference is released.
+   * spare is the second buffer of the same size used by the processing stages (see EventProcessor).
+   */
+  struct EventBuffer
+  {
+    EventHeader header;
+    unsigned char *data;
+    unsigned char *spare;
+    unsigned long long timeNs; //!< build time of the event
+    EventBufferPool *pool;     //!< owner
+    int index;                 //!< position in the pool
+    volatile int refCount;
+  };
+
+  /**
+   * The class to hold a fixed number of event buffers reused for all the events.
+   *
+   * All the buffers are allocated at the beginning (aligned to WRITER_ALIGN), so that no memory is
+   * allocated nor copied per event between Builder_thread and the consumers.
+   * When all the buffers are in use, acquire() waits until one is released (stall), which throttles
+   * Builder_thread and lets the Ring Buffers absorb the backlog.
+   *
+   * @param *****Buffers*****
+     @param m_buffer[]  EventBuffer : the buffers.
+     @param m_free[]    int         : stack of the indices of free buffers.
+     @param m_nFree     int         : number of free buffers.
+
+   * @param *****Metrics*****
+     @param m_nAcquire  unsigned long long : number of buffers acquired.
+     @param m_minFree   int                : lowest number of free buffers seen at acquire().
+     @param m_nStall    unsigned long      : number of times acquire() waited for a free buffer.
+     @param m_stallUsec unsigned long long : total time acquire() waited [usec].
+   */
+  class EventBufferPool
+  {
+  public:
+    /**
+     * Constructor
+     * @param nBuffer number of buffers. At least 1.
+     * @param size    size of data and spare of each buffer [bytes]. Rounded up to WRITER_ALIGN.
+     */
+    EventBufferPool(int nBuffer, unsigned int size) throw();
+    /**
+     * Destructor. All the buffers have to be released.
+     */
+    virtual ~EventBufferPool() throw();
+
+    /**
+     * Takes a free buffer with one reference. Waits if all the buffers are in use.
+     * @param stopped if given, checked every EVENTPOOL_POLL_MSEC while waiting
+     * @return NULL if stopped() became true before a buffer was released
+     */
+    EventBuffer *acquire(bool (*stopped)()=NULL);
+    /**
+     * Takes a free buffer with one reference.
+     * @return NULL if all the buffers are in use
+     */
+    EventBuffer *tryAcquire();
+    /**
+     * Adds a reference to the buffer, e.g. before passing it to one more consumer.
+     */
+    static void addRef(EventBuffer *buf);
+    /**
+     * Drops a reference. The buffer returns to its pool when no reference is left.
+     */
+    static void release(EventBuffer *buf);
+
+    //getter methods
+    int getNbuffer() throw();
+    int getNfree() throw();
+    unsigned int getBufferSize() throw();
+    unsigned long getNstall() throw();
+    unsigned long long getStallUsec() throw();
+
+    /**
+     * Prints the metrics of the pool to stdout.
+     */
+    void printSummary();
+
+  private:
+    void put(EventBuffer *buf);
+    EventBuffer *take();
+
+    pthread_mutex_t m_mutex;
+    pthread_cond_t m_condFree;   //signaled when a buffer is released
+
+    int m_nBuffer;
+    unsigned int m_size;
+    EventBuffer *m_buffer;
+    int *m_free;
+    int m_nFree;
+
+    unsigned long long m_nAcquire;
+    int m_minFree;
+    unsigned long m_nStall;
+    unsigned long long m_stallUsec;
+  };
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef __EVENTCONSUMER_H
+#define __EVENTCONSUMER_H
+
+#include "Config.hpp"
+#include "EventFormat.hpp"
+#include "EventBufferPool.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * The base class of consumers of the built event stream (online monitor, display, ...).
+   *
+   * Consumers are attached to EventDispatcher, which runs each of them on its own thread and
+   * hands the events over in the order of building. The event must be treated as read only,
+   * since the same buffer is seen by the other consumers at the same time.
+   * The buffer is released by the dispatcher after consume() returns.
+   */
+  class EventConsumer
+  {
+  public:
+    /**
+     * Constructor
+     */
+    EventConsumer() throw();
+    /**
+     * Destructor
+     */
+    virtual ~EventConsumer() throw();
+
+    /**
+     * @return name of the consumer shown in the summary
+     */
+    virtual const char *getName()=0;
+    /**
+     * Called once on the consumer thread before the first event.
+     */
+    virtual void init();
+    /**
+     * Handles one event.
+     */
+    virtual void consume(const EventBuffer *buf)=0;
+    /**
+     * Called once on the consumer thread after the last event.
+     */
+    virtual void finish();
+    /**
+     * Prints the metrics of the consumer to stdout (called by EventDispatcher::printSummary()).
+     */
+    virtual void printSummary();
+  };
+}
+
+#endif
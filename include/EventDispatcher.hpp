@@ -0,0 +1,118 @@
+#ifndef __EVENTDISPATCHER_H
+#define __EVENTDISPATCHER_H
+
+#include <pthread.h>
+#include "Config.hpp"
+#include "EventBufferPool.hpp"
+#include "EventConsumer.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * The class to broadcast the built events to several independent consumers.
+   *
+   * Each consumer has its own queue of EventBuffer pointers and its own thread, so every consumer
+   * reads the stream at its own pace. publish() adds one reference to the buffer per queue it enters,
+   * and the consumer thread releases it after EventConsumer::consume(). The payload is never copied.
+   *
+   * The queues are single producer / single consumer rings without locks: only the publishing thread
+   * moves the head and only the consumer thread moves the tail. The waiting sides poll every
+   * DISPATCH_POLL_USEC.
+   *
+   * Each consumer has a policy:
+   * - DISPATCH_BLOCK : lossless. publish() waits while the queue is full.
+   * - DISPATCH_DROP  : the event is dropped for this consumer while its queue is full,
+   *   so a slow consumer never slows down the publisher nor the other consumers.
+   * In addition, a consumer with prescale n sees only 1 of n events.
+   *
+   * The queues hold buffers of EventBufferPool. The pool has to have getNbufferHeld() buffers
+   * in addition, so that the consumers cannot exhaust it.
+   *
+   * @param *****Queues*****
+     @param m_queue[]   Queue : one queue per consumer.
+     @param m_nQueue    int   : number of consumers.
+
+   * @param *****Metrics (per queue)*****
+     @param nOffer      unsigned long long : events published while the consumer was attached.
+     @param nPush       unsigned long long : events put into the queue.
+     @param nDrop       unsigned long long : events dropped because the queue was full.
+     @param nStall      unsigned long      : number of times publish() waited for a blocking consumer.
+     @param stallUsec   unsigned long long : total time publish() waited [usec].
+   */
+  class EventDispatcher
+  {
+  public:
+    /**
+     * Constructor
+     */
+    EventDispatcher() throw();
+    /**
+     * Destructor. The consumers are deleted as well.
+     */
+    virtual ~EventDispatcher() throw();
+
+    /**
+     * Attaches a consumer. Must be called before start().
+     * @param policy   DISPATCH_BLOCK or DISPATCH_DROP
+     * @param prescale the consumer sees 1 of prescale events (1 for all)
+     * @param depth    number of events the queue holds
+     */
+    void addConsumer(EventConsumer *consumer, int policy, int prescale, int depth);
+    /**
+     * @return number of consumers
+     */
+    int getNconsumer() throw();
+    /**
+     * @return max number of buffers held by the queues and the consumers at the same time
+     */
+    int getNbufferHeld() throw();
+
+    /**
+     * Starts the consumer threads.
+     */
+    bool start();
+    /**
+     * Passes one event to the consumers. The reference of the caller is kept by the caller.
+     */
+    void publish(EventBuffer *buf);
+    /**
+     * Lets the consumers finish the queued events, then stops the threads.
+     */
+    void close();
+
+    /**
+     * Prints the metrics of the queues and the consumers to stdout.
+     */
+    void printSummary();
+
+  private:
+    struct Queue
+    {
+      EventDispatcher *owner;
+      EventConsumer *consumer;
+      pthread_t thread;
+      int policy;
+      int prescale;
+      unsigned int depth;
+      EventBuffer **ring;
+      volatile unsigned long long head; //!< written by the publisher
+      volatile unsigned long long tail; //!< written by the consumer thread
+
+      unsigned long long nOffer;
+      unsigned long long nPush;
+      unsigned long long nDrop;
+      unsigned long nStall;
+      unsigned long long stallUsec;
+    };
+
+    static void *consumer_thread(void *arg);
+    void runConsumer(Queue *q);
+
+    Queue m_queue[MAX_CONSUMER];
+    int m_nQueue;
+    bool m_running;
+    volatile bool m_closing;
+  };
+}
+
+#endif
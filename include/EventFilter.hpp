@@ -0,0 +1,73 @@
+#ifndef __EVENTFILTER_H
+#define __EVENTFILTER_H
+
+#include "Config.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * The base class of tests applied by SoftwareTrigger to the pixel charges of an event.
+   *
+   * accept() is called from several worker threads at the same time, so filters must not change
+   * their state in it.
+   */
+  class EventFilter
+  {
+  public:
+    EventFilter() throw();
+    virtual ~EventFilter() throw();
+
+    /**
+     * @return short description of the filter and its parameters shown in the summary
+     */
+    virtual const char *getName()=0;
+    /**
+     * @param charge  charge of each pixel, NCHANNEL per module [counts]
+     * @param nModule number of modules
+     * @param missing modules without data in the event (EventHeader::missing). Their charges are not valid and must be skipped.
+     * @return true if the event is interesting
+     */
+    virtual bool accept(const int *charge, int nModule, unsigned long long missing)=0;
+
+    /**
+     * Makes a filter from its description, "mult:<threshold>:<n>" or "topo:<threshold>:<n>".
+     * @return NULL if the description is not understood
+     */
+    static EventFilter *create(const char *spec);
+  };
+
+  /**
+   * Multiplicity : at least n pixels with charge >= threshold in the camera.
+   */
+  class MultiplicityFilter : public EventFilter
+  {
+  public:
+    MultiplicityFilter(int threshold, int n) throw();
+    virtual ~MultiplicityFilter() throw();
+    virtual const char *getName();
+    virtual bool accept(const int *charge, int nModule, unsigned long long missing);
+  private:
+    int m_threshold;
+    int m_n;
+    char m_name[64];
+  };
+
+  /**
+   * Topology : at least n neighbouring pixels with charge >= threshold, i.e. n consecutive channels
+   * of one module (Connection.conf gives no camera geometry beyond the modules).
+   */
+  class TopologyFilter : public EventFilter
+  {
+  public:
+    TopologyFilter(int threshold, int n) throw();
+    virtual ~TopologyFilter() throw();
+    virtual const char *getName();
+    virtual bool accept(const int *charge, int nModule, unsigned long long missing);
+  private:
+    int m_threshold;
+    int m_n;
+    char m_name[64];
+  };
+}
+
+#endif
@@ -0,0 +1,192 @@
+//
+//! \file  EventFormat.hpp
+//  Format of the built events written by LSTDAQ.
+//
+
+#ifndef __EVENTFORMAT_H
+#define __EVENTFORMAT_H
+
+#include <string.h> //memcpy
+#include "Config.hpp"
+
+/** @def EVENT_MAGIC
+ * @brief First 4 bytes of every built event
+ */
+#define EVENT_MAGIC "EHDR"
+
+/** @def EVENT_HEADER_VERSION
+ * @brief Version of EventHeader.
+ *
+ * Files written before version 2 have a 16 byte header "EHDR99999999" + lower 32 bits of the trigger number,
+ * so the version field reads 0x3939 ("99") for them.
+ */
+#define EVENT_HEADER_VERSION 2
+
+/** @def EVENT_INDEX_MAGIC
+ * @brief First 4 bytes of the event index file (*.idx)
+ */
+#define EVENT_INDEX_MAGIC "EIDX"
+
+/** @def EVENT_INDEX_VERSION
+ * @brief Version of the event index file
+ */
+#define EVENT_INDEX_VERSION 1
+
+/** @def EVFMT_DELTA
+ * @brief Format flag : waveforms are compressed by WaveformCodec
+ */
+#define EVFMT_DELTA 0x0001
+
+/** @def EVFMT_PACK12
+ * @brief Format flag : waveform samples are packed to 12 bits by Pack12
+ */
+#define EVFMT_PACK12 0x0002
+
+/** @def EVFMT_GAINSEL
+ * @brief Format flag : one gain per channel is kept by GainSelector
+ */
+#define EVFMT_GAINSEL 0x0004
+
+/** @def EVFMT_PEDSUB
+ * @brief Format flag : DRS4 pedestals are subtracted by PedestalSubtractor (samples offset by PEDESTAL_OFFSET)
+ */
+#define EVFMT_PEDSUB 0x0008
+
+/** @def EVFMT_ZS
+ * @brief Format flag : channels without signal are removed by ZeroSuppressor (sparse layout)
+ */
+#define EVFMT_ZS 0x0010
+
+/** @def EVFMT_DL1
+ * @brief Format flag : charge and peak time per channel made by ChargeExtractor instead of waveforms
+ */
+#define EVFMT_DL1 0x0020
+
+/** @def EVFMT_SOA
+ * @brief Format flag : samples are stored as [gain][pixel][sample] arrays by SoaTransposer
+ */
+#define EVFMT_SOA 0x0040
+
+/** @def EVFMT_ENCODED
+ * @brief Format flags of lossless encodings, which EventReader::readEvent() undoes
+ */
+#define EVFMT_ENCODED (EVFMT_DELTA|EVFMT_PACK12)
+
+/** @def TRIGTYPE_FILTER
+ * @brief Trigger type bit : accepted by the i-th filter of SoftwareTrigger
+ */
+#define TRIGTYPE_FILTER(i) (1<<(i))
+
+/** @def TRIGTYPE_PRESCALED
+ * @brief Trigger type bit : rejected by the filters of SoftwareTrigger but kept as background sample
+ */
+#define TRIGTYPE_PRESCALED 0x8000
+
+/** @def GAINSEL_BITMAPSIZE
+ * @brief Size of the gain bitmap at the head of a payload with EVFMT_GAINSEL [bytes]
+ */
+#define GAINSEL_BITMAPSIZE(nModule) (((nModule)+LINESIZE-1)/LINESIZE*LINESIZE)
+
+/** @def ZS_BITMAPSIZE
+ * @brief Size of the channel bitmap in a payload with EVFMT_ZS [bytes]
+ */
+#define ZS_BITMAPSIZE(nModule) (((nModule)+LINESIZE-1)/LINESIZE*LINESIZE)
+
+namespace LSTDAQ{
+
+  /**
+   * Header of one built event in the output file.
+   *
+   * Output files are a stream of events, each of which is this header followed by `size` bytes of payload.
+   * The payload is the fragments of the modules (EVENTSIZE bytes each) concatenated in the order of Ring Buffers,
+   * unless some of the format flags (EVFMT_*) say otherwise.
+   */
+  struct EventHeader
+  {
+    char magic[4];              //!< EVENT_MAGIC
+    unsigned short version;     //!< EVENT_HEADER_VERSION
+    unsigned short flags;       //!< format flags of the payload (EVFMT_*). 0 for raw fragments.
+    unsigned int size;          //!< size of the payload following this header [bytes]
+    unsigned short nModule;     //!< number of module fragments in the event
+    unsigned short trigType;    //!< trigger type bits (TRIGTYPE_*). 0 if the event is not classified.
+    unsigned long long trigger; //!< trigger number, unwrapped to 64 bits
+    unsigned long long missing; //!< bit i is set if module i did not contribute to this event
+  };
+
+  /**
+   * Header of the event index file.
+   *
+   * Each output file <name>.dat has an index <name>.idx written alongside. It is this header followed by
+   * one EventIndexEntry per event, in the order of the events in the .dat file.
+   */
+  struct EventIndexHeader
+  {
+    char magic[4];              //!< EVENT_INDEX_MAGIC
+    unsigned short version;     //!< EVENT_INDEX_VERSION
+    unsigned short entrySize;   //!< sizeof(EventIndexEntry)
+    unsigned long long reserved;
+  };
+
+  /**
+   * One record of the event index file.
+   */
+  struct EventIndexEntry
+  {
+    unsigned long long trigger; //!< trigger number of the event
+    unsigned long long offset;  //!< offset of the EventHeader in the .dat file [bytes]
+    unsigned long long timeNs;  //!< time the event was built (CLOCK_REALTIME) [nsec]
+    unsigned long long missing; //!< EventHeader::missing
+  };
+
+  /**
+   * @return number of gains stored for each sample in a payload of the format
+   */
+  inline int getNgainStored(unsigned short flags)
+  {
+    return (flags&EVFMT_GAINSEL) ? 1 : NGAIN;
+  }
+  /**
+   * @return size of the part before the first module in a payload of the format [bytes]
+   */
+  inline unsigned int getPrefixSize(unsigned short flags, unsigned int nModule)
+  {
+    return ((flags&EVFMT_GAINSEL) ? GAINSEL_BITMAPSIZE(nModule) : 0)
+      + ((flags&EVFMT_ZS) ? ZS_BITMAPSIZE(nModule) : 0);
+  }
+  /**
+   * @return size of one module in a payload of the format, without lossless encodings [bytes].
+   *   With EVFMT_ZS, this is the size before suppression (see ZeroSuppressor).
+   */
+  inline unsigned int getModuleSize(unsigned short flags)
+  {
+    return (LINE_WAVEFORM+READDEPTH*getNgainStored(flags))*LINESIZE;
+  }
+
+  /**
+   * Fills the constant part of an EventHeader.
+   */
+  inline void initEventHeader(EventHeader *h)
+  {
+    memcpy(h->magic,EVENT_MAGIC,4);
+    h->version=EVENT_HEADER_VERSION;
+    h->flags=0;
+    h->size=0;
+    h->nModule=0;
+    h->trigType=0;
+    h->trigger=0;
+    h->missing=0;
+  }
+
+  /**
+   * Fills an EventIndexHeader.
+   */
+  inline void initEventIndexHeader(EventIndexHeader *h)
+  {
+    memcpy(h->magic,EVENT_INDEX_MAGIC,4);
+    h->version=EVENT_INDEX_VERSION;
+    h->entrySize=sizeof(EventIndexEntry);
+    h->reserved=0;
+  }
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef __EVENTMONITOR_H
+#define __EVENTMONITOR_H
+
+#include <time.h>
+#include "Config.hpp"
+#include "EventFormat.hpp"
+#include "EventConsumer.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * Online monitor of the built event stream.
+   *
+   * For each module, counts the events the module was missing from and, for payloads with samples
+   * of every channel (raw layout, pedestals may be subtracted, one gain may be selected), averages the
+   * samples of the first stored gain. A drift of this mean shows a wrong pedestal or a noisy module
+   * long before the file is analyzed. The event rate and size seen by the monitor are recorded too.
+   * Other layouts are counted only.
+   */
+  class EventMonitor : public EventConsumer
+  {
+  public:
+    EventMonitor() throw();
+    virtual ~EventMonitor() throw();
+
+    virtual const char *getName();
+    virtual void init();
+    virtual void consume(const EventBuffer *buf);
+    virtual void printSummary();
+
+    /**
+     * Adds the samples of the first stored gain of one module to *sum.
+     * @param nGain number of gains stored for each sample
+     * @return number of samples added
+     */
+    static unsigned int sumModule(const unsigned char *module, int nGain, unsigned long long *sum);
+
+  private:
+    unsigned long long m_nEvent;
+    unsigned long long m_nSampled;
+    unsigned long long m_bytes;
+    unsigned long long m_firstTrigger;
+    unsigned long long m_lastTrigger;
+    int m_nModule;
+    unsigned long long m_nMissing[MAX_CONNECTION];
+    unsigned long long m_sum[MAX_CONNECTION];
+    unsigned long long m_nSample[MAX_CONNECTION];
+    struct timespec m_tsFirst;
+    struct timespec m_tsLast;
+  };
+}
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef __EVENTOUTPUT_H
+#define __EVENTOUTPUT_H
+
+#include <string>
+#include <time.h>
+#include <pthread.h>
+#include "Config.hpp"
+#include "EventWriter.hpp"
+#include "EventFormat.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * One record of the stripe index file (*.sidx).
+   *
+   * The stripe index is written when events are striped over several output directories.
+   * It has one record per event in the order of building, and tells in which stripe file
+   * and at which offset the event (EHDR header included) is stored.
+   */
+  struct StripeIndexEntry
+  {
+    unsigned long long trigger;  //!< trigger number of the event
+    unsigned int stripe;         //!< stripe number (= position of the directory in -d option)
+    unsigned int size;           //!< size of the event including the EHDR header [bytes]
+    unsigned long long offset;   //!< offset of the event in the stripe file [bytes]
+  };
+
+  /**
+   * The class to distribute built events to the output files.
+   *
+   * Without -d option, all events go to one file <prefix>_infreqXX_nCollXX_nRBXX.dat by one EventWriter.
+   *
+   * With -d dir1,dir2,... events are striped over the directories, one EventWriter (hence one writer thread)
+   * per directory, so that the bandwidth scales with the number of independent volumes.
+   * The stripe files are named <dir>/<prefix>_infreqXX_nCollXX_nRBXX_sNN.dat.
+   * Events are distributed in round robin (-S 0), or the stripe is switched each time
+   * the given amount of data [MB] has been written to it (-S MB).
+   * A stripe index <dir1>/<prefix>_infreqXX_nCollXX_nRBXX.sidx (records of StripeIndexEntry) is written
+   * as well, so that an event can be located from its trigger number.
+   *
+   * With setRotation(), all the files are switched together to new ones every given time or size,
+   * at an event boundary. The files of the k-th period get the suffix _fNNNN (k) after <prefix>_infreqXX_nCollXX_nRBXX,
+   * e.g. <prefix>_..._nRBXX_f0003.dat or <prefix>_..._nRBXX_f0003_s01.dat, and each stripe index covers its own period.
+   * Files are preallocated with fallocate() to the rotation size (divided by the number of stripes).
+   * The rotation by time is checked by write(), and by the writer thread of the first stripe while no event comes.
+   *
+   * Every .dat file gets an event index <name>.idx (EventIndexHeader + EventIndexEntry per event),
+   * so that EventReader can jump to any event without scanning the file.
+   *
+   * @param m_writer[]    EventWriter* : writer of each stripe
+   * @param m_nStripe     int          : number of stripes
+   * @param m_chunk       unsigned long long : bytes written to a stripe before switching. 0 for round robin.
+   * @param m_cur         int          : current stripe
+   * @param m_curBytes    unsigned long long : bytes written to the current stripe since the last switch
+   * @param m_index       EventWriter* : writer of the stripe index (NULL if not striped)
+   * @param m_fileIndex[] EventWriter* : writer of the event index of each stripe file
+   * @param m_rotateSec   double       : period of rotation [sec]. 0 for no rotation by time.
+   * @param m_rotateBytes unsigned long long : size of rotation [bytes]. 0 for no rotation by size.
+   * @param m_nFile       int          : number of the current file period (NNNN of _fNNNN)
+   * @param m_fileBytes   unsigned long long : bytes written in the current period (all stripes)
+   * @param m_tsFile      struct timespec : time the current period started (CLOCK_MONOTONIC)
+   * @param m_mutex       pthread_mutex_t : excludes write()/close() and the rotation from the writer thread
+   */
+  class EventOutput
+  {
+  public:
+    /**
+     * Constructor. Arguments are passed to EventWriter.
+     */
+    EventOutput(unsigned long blockSize, int nBlock, int engine, int qdepth) throw();
+    /**
+     * Destructor
+     */
+    virtual ~EventOutput() throw();
+
+    /**
+     * Sets the output directories. Must be called before open().
+     * @param dirList comma separated list of directories.
+     * @param chunkMB size of the chunk to switch stripes [MB]. 0 for round robin.
+     * @return number of directories
+     */
+    int setDirectories(const char *dirList, unsigned long chunkMB);
+
+    /**
+     * Enables rotation of the output files. Must be called before open().
+     * @param sec switch files every sec seconds. 0 for no rotation by time.
+     * @param gb  switch files every gb GB (2^30 bytes). 0 for no rotation by size.
+     */
+    void setRotation(double sec, double gb);
+
+    /**
+     * Opens the output file(s).
+     * @param baseName file name without extension (<prefix>_infreqXX_nCollXX_nRBXX)
+     */
+    bool open(const char *baseName);
+
+    /**
+     * Writes one event (header + header->size bytes of data) to one of the stripes.
+     * @param timeNs build time of the event recorded in the event index [nsec]
+     */
+    int write(const EventHeader *header, const void *data, unsigned long long timeNs);
+
+    /**
+     * Flushes and closes all the files.
+     */
+    void close();
+
+    //getter methods (sum of all stripes)
+    unsigned long long getLagBytes() throw();
+    unsigned long long getStallUsec() throw();
+    int getNstripe() throw();
+    int getNfile() throw();
+
+    /**
+     * Prints the metrics of all the writers to stdout.
+     */
+    void printSummary();
+
+  private:
+    unsigned long m_blockSize;
+    int m_nBlock;
+    int m_engine;
+    int m_qdepth;
+
+    std::string m_dir[MAX_STRIPE];
+    int m_nDir;
+    EventWriter *m_writer[MAX_STRIPE];
+    int m_nStripe;
+    unsigned long long m_chunk;
+    int m_cur;
+    unsigned long long m_curBytes;
+    EventWriter *m_index;
+    EventWriter *m_fileIndex[MAX_STRIPE];
+
+    std::string m_baseName;
+    double m_rotateSec;
+    unsigned long long m_rotateBytes;
+    int m_nFile;
+    unsigned long long m_fileBytes;
+    struct timespec m_tsFile;
+
+    pthread_mutex_t m_mutex;
+
+    void makeName(char *buf, int stripe, const char *ext);
+    void rotate();
+    bool rotationDue();
+    static void idle(void *arg);
+    void startIndex(int stripe);
+  };
+}
+
+#endif
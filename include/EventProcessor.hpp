@@ -0,0 +1,77 @@
+#ifndef __EVENTPROCESSOR_H
+#define __EVENTPROCESSOR_H
+
+#include "Config.hpp"
+#include "EventFormat.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * The base class of processing stages applied to built events before they are written.
+   *
+   * Stages are chained in WorkerPool and called from its worker threads, several events at a time.
+   * A stage reads the payload in *data (header->size bytes) and either modifies it in place,
+   * or writes the result to *spare and swaps the two pointers. It updates header->size and header->flags.
+   * Both buffers are as large as getMaxSize() of all the stages allows.
+   *
+   * A stage may also make a side record of each event (e.g. DL1 parameters), which WorkerPool writes
+   * to its side output in the order of building, whether the event itself is kept or not.
+   *
+   * State changed by process() has to be kept per worker (the worker argument), since the same
+   * stage runs in all the workers at the same time.
+   */
+  class EventProcessor
+  {
+  public:
+    /**
+     * Constructor
+     */
+    EventProcessor() throw();
+    /**
+     * Destructor
+     */
+    virtual ~EventProcessor() throw();
+
+    /**
+     * @return name of the stage shown in the summary
+     */
+    virtual const char *getName()=0;
+    /**
+     * @return max size of the payload made by this stage from a payload of inSize bytes
+     */
+    virtual unsigned int getMaxSize(unsigned int inSize);
+    /**
+     * @return max size of the side record made by this stage from a payload of inSize bytes.
+     *   0 (default) if the stage makes no side record.
+     */
+    virtual unsigned int getSideSize(unsigned int inSize);
+    /**
+     * Makes the side record of one event. Called just before process() for stages with getSideSize()>0,
+     * as long as no earlier stage has made the record of the event.
+     * @param sideHeader header of the side record. Filled by the stage.
+     * @param side       the side record is stored here.
+     * @return false if no record is made for the event
+     */
+    virtual bool makeSide(const EventHeader *header, const unsigned char *data,
+                          EventHeader *sideHeader, unsigned char *side, int worker);
+    /**
+     * Prepares per worker state. Called once before the workers start.
+     */
+    virtual void init(int nWorker);
+    /**
+     * Processes one event.
+     * @return false to drop the event
+     */
+    virtual bool process(EventHeader *header, unsigned char **data, unsigned char **spare, int worker)=0;
+    /**
+     * Called once after all the workers have stopped.
+     */
+    virtual void finish();
+    /**
+     * Prints the metrics of the stage to stdout (called by WorkerPool::printSummary()).
+     */
+    virtual void printSummary();
+  };
+}
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef __EVENTREADER_H
+#define __EVENTREADER_H
+
+#include <stddef.h> //size_t
+#include "EventFormat.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * The class to read events from an output file with random access.
+   *
+   * The .dat file and its event index (.idx) are mapped with mmap(), so an event is reached
+   * by one lookup in the index instead of scanning the file from the start.
+   * Trigger numbers in one file are increasing. findTrigger() first tries the position expected when
+   * no trigger is skipped, which hits in O(1) for a file without gaps, and falls back to binary search.
+   *
+   * If the index is longer than the data (the run was killed before the last blocks were flushed),
+   * only the events contained in the .dat file are visible.
+   *
+   * getEvent() returns the event as stored. readEvent() also undoes the lossless encodings recorded in
+   * EventHeader::flags (EVFMT_ENCODED, e.g. EVFMT_DELTA). Reductions like EVFMT_GAINSEL are kept
+   * and stay in the flags of the header returned. Sparse payloads (EVFMT_ZS) are returned as they are,
+   * ZeroSuppressor::expand() converts them to the dense layout.
+   *
+   * @param m_data    const unsigned char* : mapped .dat file
+   * @param m_idx     const unsigned char* : mapped .idx file
+   * @param m_entry   const EventIndexEntry* : first record in m_idx
+   * @param m_nEvent  unsigned long long : number of events available
+   */
+  class EventReader
+  {
+  public:
+    /**
+     * Constructor
+     */
+    EventReader() throw();
+    /**
+     * Destructor
+     */
+    virtual ~EventReader() throw();
+
+    /**
+     * Maps a file and its index.
+     * @param fileName path to the .dat file. The index is the same path with .idx instead of .dat.
+     * @return false if either of the files is missing or the index is broken.
+     */
+    bool open(const char *fileName);
+    /**
+     * Unmaps the files.
+     */
+    void close();
+
+    /**
+     * @return number of events in the file
+     */
+    unsigned long long getNevent() throw();
+    /**
+     * @return index record of the n-th event in the file, NULL if out of range.
+     */
+    const EventIndexEntry *getEntry(unsigned long long n) throw();
+    /**
+     * @return header of the n-th event, followed by header->size bytes of payload. NULL if out of range.
+     */
+    const EventHeader *getEvent(unsigned long long n) throw();
+    /**
+     * Copies the n-th event undoing the lossless encodings.
+     * @param header the header of the event is stored here, with EVFMT_ENCODED flags cleared and size of the decoded payload.
+     * @param buf    decoded payload is stored here. Must have room for EVENTSIZE*nModule bytes.
+     * @return size of the decoded payload, or -1 on error.
+     */
+    int readEvent(unsigned long long n, EventHeader *header, unsigned char *buf);
+    /**
+     * Undoes the lossless encodings of a payload.
+     * @return size of the decoded payload, or -1 if the payload is broken or the format is unknown.
+     */
+    static int decodePayload(const EventHeader *header, const unsigned char *payload, unsigned char *buf);
+    /**
+     * Looks up a trigger number.
+     * @return position of the event in the file, or -1 if the trigger is not in this file.
+     */
+    long long findTrigger(unsigned long long trigger) throw();
+
+  private:
+    const unsigned char *m_data;
+    size_t m_dataSize;
+    const unsigned char *m_idx;
+    size_t m_idxSize;
+    const EventIndexEntry *m_entry;
+    unsigned long long m_nEvent;
+
+    static const unsigned char *mapFile(const char *fileName, size_t *size);
+  };
+}
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef __EVENTWRITER_H
+#define __EVENTWRITER_H
+
+#include <pthread.h>
+#include <time.h>     //timespec
+#include <string>
+#include "Config.hpp"
+#include "OutputFile.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * The class to write built events to the output file from a dedicated thread.
+   *
+   * Builder_thread used to call fwrite() for every event by itself, so any stall of the disk
+   * directly stopped event building and Ring Buffers started to overflow.
+   * EventWriter decouples them. Builder_thread only copies events into large aligned memory blocks,
+   * and the writer thread flushes the filled blocks to the file.
+   *
+   * The blocks are used in round robin. While the writer thread flushes one block,
+   * Builder_thread fills the next one (double buffering when nBlock=2).
+   * Events are stored as a plain byte stream, so one event can continue over the boundary of blocks.
+   * Only when all the blocks are waiting to be flushed, Builder_thread has to wait (stall).
+   *
+   * The blocks are written by an output engine (see OutputFile). With the direct engine,
+   * up to qdepth blocks are in flight at the same time, so nBlock should be larger than qdepth.
+   * If the file cannot be opened with the direct engine (e.g. tmpfs), the buffered engine is used instead.
+   *
+   * The output can be switched to a new file at an event boundary by rotate(). The current block is sealed,
+   * even if it is empty, and the writer thread opens the new file as soon as all the writes to the old file
+   * have completed. So every file is created, even one that gets no event before the next rotate().
+   *
+   * @param *****Blocks*****
+     @param m_block[]      Block        : memory blocks of m_blockSize bytes, aligned to WRITER_ALIGN.
+     @param m_nBlock       int          : number of blocks.
+     @param m_fill         int          : index of the block being filled by Builder_thread.
+     @param m_submit       int          : index of the next block to be submitted to the engine by the writer thread.
+     @param m_flush        int          : index of the oldest block not yet flushed.
+     @param m_nFull        int          : number of blocks sealed and not yet flushed.
+     @param m_nSealed      int          : number of blocks sealed and not yet submitted to the engine.
+
+   * @param *****Metrics*****
+     @param m_nIn          unsigned long long : bytes handed over by Builder_thread. Updated atomically, the other metrics under m_mutex.
+     @param m_fileIn       unsigned long long : bytes handed over for the current file (offset of the next event).
+     @param m_nOut         unsigned long long : bytes flushed to the file.
+     @param m_nStall       unsigned long      : number of times Builder_thread waited for a free block.
+     @param m_stallUsec    unsigned long long : total time Builder_thread waited [usec].
+     @param m_maxStallUsec unsigned long long : longest wait of Builder_thread [usec].
+     @param m_maxLagUsec   unsigned long long : longest time from sealing a block to the end of its flush [usec].
+   */
+  class EventWriter
+  {
+  public:
+    /**
+     * Constructor
+     * @param blockSize size of one block [bytes]. Rounded up to WRITER_ALIGN.
+     * @param nBlock    number of blocks. At least 2.
+     * @param engine    output engine. OUTPUT_ENGINE_BUFFERED or OUTPUT_ENGINE_DIRECT.
+     * @param qdepth    max number of blocks in flight. Limited to nBlock-1.
+     */
+    EventWriter(unsigned long blockSize, int nBlock, int engine, int qdepth) throw();
+    /**
+     * Destructor
+     */
+    virtual ~EventWriter() throw();
+
+    /**
+     * Opens the output file and starts the writer thread.
+     */
+    bool open(const char *fileName);
+
+    /**
+     * Sets the size to reserve with fallocate() for each file. Must be called before open().
+     */
+    void setPreallocate(unsigned long long bytes);
+
+    /**
+     * Sets a function the writer thread calls every WRITER_IDLE_MSEC while it has nothing to write
+     * (EventOutput checks the rotation by time with it). Must be called before open().
+     */
+    void setIdleHandler(void (*handler)(void *), void *arg);
+
+    /**
+     * Switches to a new file. Events written after this call go to the new file.
+     */
+    void rotate(const char *fileName);
+
+    /**
+     * Hands one event (header + data) over to the writer thread.
+     *
+     * The event is copied into the current block. When the block becomes full, it is passed to
+     * the writer thread and the next block is taken. If no block is free, this function waits.
+     * @return 0 on success
+     */
+    int write(const void *header, unsigned int hlen, const void *data, unsigned int dlen);
+
+    /**
+     * Flushes the remaining data, stops the writer thread and closes the file.
+     */
+    void close();
+
+    //getter methods
+    unsigned long long getNin() throw();
+    unsigned long long getNout() throw();
+    unsigned long long getFileOffset() throw();
+    unsigned long long getLagBytes() throw();
+    unsigned long getNstall() throw();
+    unsigned long long getStallUsec() throw();
+    unsigned long long getMaxStallUsec() throw();
+    unsigned long long getMaxLagUsec() throw();
+
+    /**
+     * Prints the metrics of the writer to stdout.
+     */
+    void printSummary();
+
+  private:
+    struct Block
+    {
+      unsigned char *buf;
+      unsigned long used;
+      struct timespec tsSeal;
+      std::string nextPath; //!< not empty if this block is the last one of its file
+    };
+
+    static void *writer_thread(void *arg);
+    void run();
+    void put(const void *buf, unsigned long len);
+    void seal();
+    void release(int tag);
+    void reopen(const char *fileName);
+
+    pthread_mutex_t m_mutex;
+    pthread_cond_t m_condFull;   //signaled when a block is sealed
+    pthread_cond_t m_condFree;   //signaled when a block is flushed
+    pthread_t m_thread;
+    bool m_running;
+    bool m_closing;
+
+    OutputFile *m_file;
+    unsigned long long m_prealloc;
+    void (*m_idle)(void *);
+    void *m_idleArg;
+    int m_engine;
+    int m_qdepth;
+    unsigned long m_blockSize;
+    int m_nBlock;
+    Block m_block[WRITER_MAX_NBLOCK];
+    bool m_done[WRITER_MAX_NBLOCK];
+    int m_fill;
+    int m_submit;
+    int m_flush;
+    int m_nFull;
+    int m_nSealed;
+
+    unsigned long long m_nIn;
+    unsigned long long m_fileIn;
+    unsigned long long m_nOut;
+    unsigned long m_nStall;
+    unsigned long long m_stallUsec;
+    unsigned long long m_maxStallUsec;
+    unsigned long long m_maxLagUsec;
+  };
+}
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef __GAINSELECTOR_H
+#define __GAINSELECTOR_H
+
+#include "Config.hpp"
+#include "EventFormat.hpp"
+#include "EventProcessor.hpp"
+
+/** @def GAINSEL_THRESHOLD
+ * @brief Default high gain sample above which the low gain is kept [counts]
+ */
+#define GAINSEL_THRESHOLD 3500
+
+namespace LSTDAQ{
+
+  /**
+   * Selection of one gain per channel (EVFMT_GAINSEL).
+   *
+   * For each channel of each module, the high gain waveform is kept unless one of its samples
+   * exceeds the threshold (saturation), in which case the low gain waveform is kept instead.
+   * This halves the waveform part of the payload.
+   *
+   * Payload with EVFMT_GAINSEL:
+   * - gain bitmap : GAINSEL_BITMAPSIZE(nModule) bytes. Byte m is the bitmap of module m,
+   *   bit c set if the low gain is kept for channel c. Padded with 0 to a multiple of LINESIZE.
+   * - for each module : lines 0 to LINE_WAVEFORM-1 (header, flag, stopcell) as they are,
+   *   then READDEPTH lines of the selected samples (line LINE_WAVEFORM + s is sample s), LINESIZE bytes each.
+   *
+   * The stage takes the raw layout only (pedestals may be subtracted) and runs before the lossless encodings (Pack12, WaveformCodec),
+   * which apply to this layout as well. The scan of the high gain and the selection are done with
+   * SSSE3 (saturating subtract against the threshold and masks) when available.
+   */
+  class GainSelector : public EventProcessor
+  {
+  public:
+    /**
+     * @param threshold high gain sample above which the low gain is kept [counts]
+     */
+    GainSelector(unsigned short threshold) throw();
+    virtual ~GainSelector() throw();
+
+    virtual const char *getName();
+    virtual bool process(EventHeader *header, unsigned char **data, unsigned char **spare, int worker);
+    virtual void printSummary();
+
+    /**
+     * Selects the gains of one module.
+     * @param frag raw fragment (EVENTSIZE bytes)
+     * @param out  (LINE_WAVEFORM+READDEPTH)*LINESIZE bytes of the selected layout are stored here.
+     * @return gain bitmap of the module
+     */
+    static unsigned char selectModule(const unsigned char *frag, unsigned char *out, unsigned short threshold);
+
+    /**
+     * @return number of channels for which the low gain was kept, summed over the workers.
+     */
+    unsigned long long getNlowGain();
+
+  private:
+    unsigned short m_threshold;
+    //counter of each worker on its own cache line
+    struct Count
+    {
+      unsigned long long nLowGain;
+    } __attribute__((aligned(CACHELINE_SIZE)));
+    Count m_count[MAX_WORKER];
+  };
+}
+
+#endif
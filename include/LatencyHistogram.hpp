@@ -0,0 +1,76 @@
+#ifndef __LATENCYHISTOGRAM_H
+#define __LATENCYHISTOGRAM_H
+
+#include "Config.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * Log-linear (HDR) histogram of time intervals [nsec] with constant memory, used by DAQtimer.
+   *
+   * Each power of 2 is cut into 2^HISTO_SUBBITS linear buckets, so that any value from 1 nsec to hours is kept
+   * with a relative error below 2^-HISTO_SUBBITS in HISTO_NBUCKET counters. Values below 2^(HISTO_SUBBITS+1) are exact.
+   * record() is a few instructions and never allocates memory, so the whole run is measured.
+   *
+   * It is written by one thread. Another thread may read it while it is written (e.g. ThruPutMes_thread
+   * for the metrics server), so every field is stored and loaded as a relaxed atomic (plain moves on x86-64).
+   * Each value read is then one that was written, but the fields are not read at the same moment :
+   * the percentiles are computed from counts which may already include a few more values than getTotal().
+   *
+   * @param m_count[] unsigned long long : number of values in each bucket.
+   * @param m_total   unsigned long long : number of values.
+   * @param m_sum     unsigned long long : sum of the values [nsec].
+   * @param m_max     unsigned long long : largest value [nsec].
+   */
+  class LatencyHistogram
+  {
+  public:
+    /**
+     * Constructor
+     */
+    LatencyHistogram() throw();
+    /**
+     * Destructor
+     */
+    virtual ~LatencyHistogram() throw();
+
+    void reset();
+    void record(unsigned long long ns)
+    {
+      //****** single writer : load + store, no locked instruction ******
+      int b=bucket(ns);
+      store(&m_count[b],load(&m_count[b])+1);
+      store(&m_total,load(&m_total)+1);
+      store(&m_sum,load(&m_sum)+ns);
+      if(ns>load(&m_max))store(&m_max,ns);
+    }
+    /**
+     * @param q quantile, 0 ... 1 (e.g. 0.999 for p99.9)
+     * @return the largest value equivalent to the bucket of the quantile, at most getMax() [nsec]. 0 if empty.
+     */
+    unsigned long long getPercentile(double q);
+
+    //getter methods
+    unsigned long long getTotal() throw(){return load(&m_total);}
+    unsigned long long getSum() throw(){return load(&m_sum);}
+    unsigned long long getMax() throw(){return load(&m_max);}
+
+  private:
+    static int bucket(unsigned long long ns)
+    {
+      int msb=63-__builtin_clzll(ns|1);
+      int shift=(msb>HISTO_SUBBITS ? msb-HISTO_SUBBITS : 0);
+      return (shift<<HISTO_SUBBITS)+(int)(ns>>shift);
+    }
+    static unsigned long long highest(int index);
+    static unsigned long long load(const unsigned long long *p){return __atomic_load_n(p,__ATOMIC_RELAXED);}
+    static void store(unsigned long long *p, unsigned long long v){__atomic_store_n(p,v,__ATOMIC_RELAXED);}
+
+    unsigned long long m_count[HISTO_NBUCKET];
+    unsigned long long m_total;
+    unsigned long long m_sum;
+    unsigned long long m_max;
+  };
+}
+
+#endif
@@ -15,6 +15,7 @@
 
 void usage(char **argv);
 void inverseByteOrder(char *buf,int bufsize);
+unsigned long unwrapCounter(unsigned int raw,unsigned long prev);
 
 
 #endif
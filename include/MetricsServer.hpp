@@ -0,0 +1,61 @@
+#ifndef __METRICSSERVER_H
+#define __METRICSSERVER_H
+
+#include <pthread.h>
+#include <string>
+#include "Config.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * HTTP server of the metrics of LSTDAQ in the Prometheus text format on a TCP port of localhost (-H).
+   *
+   * \code
+   * curl http://localhost:<port>/metrics
+   * \endcode
+   * The text is made by the writer function given to the constructor at each request, in the thread of the server,
+   * from the latest measurement of ThruPutMes_thread. Requests are served one at a time and the connection is closed
+   * after the reply (HTTP/1.0), so the memory used does not grow with the length of the run or the number of scrapes.
+   *
+   * @param m_writer   Writer : appends the metrics to the text of the reply.
+   * @param m_listenFd int    : listening socket.
+   */
+  class MetricsServer
+  {
+  public:
+    typedef void (*Writer)(std::string &text);
+
+    /**
+     * @param port TCP port of localhost
+     * @param writer function making the metrics text
+     */
+    MetricsServer(int port, Writer writer) throw();
+    virtual ~MetricsServer() throw();
+
+    /**
+     * Opens the listening socket and starts serving.
+     * @return false on error
+     */
+    bool open();
+    /**
+     * Stops serving and closes the socket.
+     */
+    void close();
+    void printSummary();
+
+  private:
+    static void *server_thread(void *arg);
+    void run();
+    void serve(int fd);
+
+    int m_port;
+    Writer m_writer;
+    int m_listenFd;
+    pthread_t m_thread;
+    volatile bool m_closing;
+    bool m_running;
+    unsigned long long m_nRequest;
+  };
+}
+
+#endif
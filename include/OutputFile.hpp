@@ -0,0 +1,128 @@
+#ifndef __OUTPUTFILE_H
+#define __OUTPUTFILE_H
+
+#include <linux/aio_abi.h> //aio_context_t, iocb
+#include "Config.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * The base class of output engines used by EventWriter.
+   *
+   * An output engine writes memory blocks to one file asynchronously.
+   * EventWriter submits a block with submit() and gets it back with reap() once the data is on its way to disk.
+   * The block must not be touched between submit() and reap().
+   *
+   * All the blocks except the last one have to be multiples of WRITER_ALIGN, which EventWriter ensures.
+   *
+   * Engines (selected with -e option):
+   * Engine                 | Class              | Description
+   * -----------------------|--------------------|--------------------------------------------------
+   * OUTPUT_ENGINE_BUFFERED | BufferedOutputFile | write() through the page cache. One block at a time.
+   * OUTPUT_ENGINE_DIRECT   | DirectOutputFile   | O_DIRECT with up to qdepth writes in flight by Linux native AIO.
+   */
+  class OutputFile
+  {
+  public:
+    /**
+     * Constructor
+     */
+    OutputFile() throw();
+    /**
+     * Destructor
+     */
+    virtual ~OutputFile() throw();
+
+    /**
+     * Creates the file.
+     * @param prealloc bytes to reserve on disk with fallocate(). 0 for none.
+     * @return false if the file cannot be opened with this engine.
+     */
+    virtual bool open(const char *fileName, unsigned long long prealloc)=0;
+    /**
+     * Starts to write len bytes of buf at the end of the file.
+     * @param tag returned by reap() when the write completes.
+     * @return 0 on success
+     */
+    virtual int submit(const void *buf, unsigned long len, int tag)=0;
+    /**
+     * Collects completed writes.
+     * @param tags       tags of completed writes are stored here.
+     * @param maxtag     size of tags.
+     * @param timeoutUsec time to wait for at least one completion. 0 does not wait.
+     * @return number of completed writes, or -1 on error.
+     */
+    virtual int reap(int *tags, int maxtag, int timeoutUsec)=0;
+    /**
+     * Closes the file. All the writes must have been reaped.
+     * Space reserved by fallocate() beyond the written data is released.
+     */
+    virtual bool close()=0;
+    /**
+     * @return name of the engine
+     */
+    virtual const char *getName()=0;
+
+    /**
+     * Creates an engine.
+     * @param engine OUTPUT_ENGINE_BUFFERED or OUTPUT_ENGINE_DIRECT
+     * @param qdepth max number of writes in flight.
+     */
+    static OutputFile *create(int engine, int qdepth);
+  };
+
+  /**
+   * Output engine writing through the page cache (the behaviour of former fopen()/fwrite()).
+   */
+  class BufferedOutputFile : public OutputFile
+  {
+  public:
+    BufferedOutputFile() throw();
+    virtual ~BufferedOutputFile() throw();
+    virtual bool open(const char *fileName, unsigned long long prealloc);
+    virtual int submit(const void *buf, unsigned long len, int tag);
+    virtual int reap(int *tags, int maxtag, int timeoutUsec);
+    virtual bool close();
+    virtual const char *getName();
+  private:
+    int m_fd;
+    int m_tag[WRITER_MAX_NBLOCK];
+    int m_nDone;
+    unsigned long long m_size;
+    bool m_prealloc;
+  };
+
+  /**
+   * Output engine writing with O_DIRECT, keeping up to qdepth writes in flight by Linux native AIO.
+   *
+   * The page cache is bypassed, so writing at multi-Gbps neither thrashes memory nor causes writeback stalls.
+   * The last block is padded up to WRITER_ALIGN and the file is truncated to the real size in close().
+   *
+   * @param m_fd      int           : file descriptor opened with O_DIRECT
+   * @param m_ctx     aio_context_t : AIO context with m_qdepth slots
+   * @param m_iocb[]  struct iocb   : control blocks, one per tag
+   * @param m_offset  unsigned long long : file offset of the next write
+   * @param m_size    unsigned long long : real size of the file
+   */
+  class DirectOutputFile : public OutputFile
+  {
+  public:
+    DirectOutputFile(int qdepth) throw();
+    virtual ~DirectOutputFile() throw();
+    virtual bool open(const char *fileName, unsigned long long prealloc);
+    virtual int submit(const void *buf, unsigned long len, int tag);
+    virtual int reap(int *tags, int maxtag, int timeoutUsec);
+    virtual bool close();
+    virtual const char *getName();
+  private:
+    int m_fd;
+    int m_qdepth;
+    aio_context_t m_ctx;
+    struct iocb m_iocb[WRITER_MAX_NBLOCK];
+    int m_nInflight;
+    unsigned long long m_offset;
+    unsigned long long m_size;
+  };
+}
+
+#endif
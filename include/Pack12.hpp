@@ -0,0 +1,65 @@
+#ifndef __PACK12_H
+#define __PACK12_H
+
+#include "Config.hpp"
+#include "EventFormat.hpp"
+#include "EventProcessor.hpp"
+
+/** @def PACK12_LINESIZE
+ * @brief Size of one waveform line packed to 12 bit samples [bytes]
+ */
+#define PACK12_LINESIZE (NCHANNEL*12/8)
+
+/** @def PACK12_MODULESIZE
+ * @brief Size of the fragment of one module with packed waveforms of nGain gains [bytes]
+ */
+#define PACK12_MODULESIZE(nGain) (LINE_WAVEFORM*LINESIZE + READDEPTH*(nGain)*PACK12_LINESIZE)
+
+namespace LSTDAQ{
+
+  /**
+   * Packing of the waveforms to 12 bit samples (EVFMT_PACK12).
+   *
+   * DRS4 samples have 12 bits but take 16 bits in the waveform lines. This stage leaves the prefix of the
+   * format (e.g. gain bitmap of EVFMT_GAINSEL) and lines 0 to LINE_WAVEFORM-1 (header, flag, stopcell)
+   * as they are and packs every waveform line of NCHANNEL samples into PACK12_LINESIZE bytes,
+   * so each module takes PACK12_MODULESIZE(nGain) bytes.
+   * Two neighbouring samples a, b of a line become 3 bytes, big endian like the raw data:
+   * a[11:4], a[3:0]<<4|b[11:8], b[7:0].
+   * The upper 4 bits of the raw samples are not kept (they are always 0 for DRS4 data).
+   * Sparse payloads (EVFMT_ZS), DL1 records (EVFMT_DL1) and EVFMT_SOA are left as they are.
+   *
+   * The kernels are selected at run time (see Simd.hpp) : pshufb/pmaddwd with SSSE3 or AVX2, or scalar.
+   */
+  class Pack12 : public EventProcessor
+  {
+  public:
+    Pack12() throw();
+    virtual ~Pack12() throw();
+
+    virtual const char *getName();
+    virtual bool process(EventHeader *header, unsigned char **data, unsigned char **spare, int worker);
+
+    /**
+     * Packs nLine waveform lines (LINESIZE bytes each) into nLine*PACK12_LINESIZE bytes.
+     */
+    static void pack(const unsigned char *in, unsigned char *out, int nLine);
+    /**
+     * Unpacks nLine packed lines into raw waveform lines.
+     */
+    static void unpack(const unsigned char *in, unsigned char *out, int nLine);
+
+    /**
+     * Packs nModule fragments with nGain gains per sample (prefix not included).
+     * @return size of the packed modules
+     */
+    static unsigned int encode(const unsigned char *in, unsigned int nModule, int nGain, unsigned char *out);
+    /**
+     * Unpacks size bytes of packed modules into nModule fragments with nGain gains per sample.
+     * @return size of the unpacked fragments, or -1 if the size does not match.
+     */
+    static int decode(const unsigned char *in, unsigned int size, unsigned int nModule, int nGain, unsigned char *out);
+  };
+}
+
+#endif
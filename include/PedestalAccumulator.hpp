@@ -0,0 +1,65 @@
+#ifndef __PEDESTALACCUMULATOR_H
+#define __PEDESTALACCUMULATOR_H
+
+#include <string>
+#include "Config.hpp"
+#include "EventFormat.hpp"
+#include "EventProcessor.hpp"
+#include "PedestalTable.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * Pedestal run : running statistics of every DRS4 cell, written as a PedestalTable at the end.
+   *
+   * Each raw event updates the running mean and variance (Welford) of the cells read out,
+   * cell (stopcell[c]+s)%DRS4_NCELL for sample s of channel c, and is dropped afterwards.
+   * Only the pedestal file (PedestalTable::save()) is written, which is what PedestalSubtractor loads.
+   *
+   * Each worker has its own shard of accumulators, so the workers never share a cell.
+   * The shards are arrays of count, mean and M2 per module, gain, channel and cell, so the cells of
+   * one channel in one event are contiguous and updated 4 at a time with SSE.
+   * In finish(), the shards are merged (Chan et al.) and the table is saved.
+   */
+  class PedestalAccumulator : public EventProcessor
+  {
+  public:
+    /**
+     * @param nModule  number of modules in the events
+     * @param fileName pedestal file to write at the end
+     */
+    PedestalAccumulator(int nModule, const char *fileName) throw();
+    virtual ~PedestalAccumulator() throw();
+
+    virtual const char *getName();
+    virtual void init(int nWorker);
+    virtual bool process(EventHeader *header, unsigned char **data, unsigned char **spare, int worker);
+    virtual void finish();
+    virtual void printSummary();
+
+    /**
+     * @return merged table. NULL before finish().
+     */
+    PedestalTable *getTable();
+
+  private:
+    //shard of each worker, on its own cache line
+    struct Shard
+    {
+      float *n;
+      float *mean;
+      float *m2;
+      unsigned long long nEvent;
+    } __attribute__((aligned(CACHELINE_SIZE)));
+    void accumulateModule(Shard *shard, const unsigned char *frag, int module);
+
+    int m_nModule;
+    std::string m_fileName;
+    int m_nWorker;
+    Shard m_shard[MAX_WORKER];
+    PedestalTable *m_table;
+    bool m_saved;
+  };
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef __PEDESTALSUBTRACTOR_H
+#define __PEDESTALSUBTRACTOR_H
+
+#include "Config.hpp"
+#include "EventFormat.hpp"
+#include "EventProcessor.hpp"
+#include "PedestalTable.hpp"
+
+/** @def PEDESTAL_OFFSET
+ * @brief Added to the samples after subtraction so that the noise around 0 stays positive [counts]
+ */
+#define PEDESTAL_OFFSET 400
+
+namespace LSTDAQ{
+
+  /**
+   * Online subtraction of the DRS4 pedestals (EVFMT_PEDSUB).
+   *
+   * Each DRS4 cell has its own pedestal. Sample s of channel c was read from cell
+   * (stopcell[c]+s)%DRS4_NCELL, where stopcell[c] is taken from line LINE_STOPCELL of the fragment.
+   * Each sample becomes sample-pedestal+PEDESTAL_OFFSET, clipped to 0..4095, so that the payload
+   * keeps the raw layout and 12 bit range (Pack12 and WaveformCodec still apply).
+   *
+   * The rows of PedestalTable are padded with the head of the row, so the pedestals of READDEPTH samples
+   * from any stop cell are contiguous. With SSSE3, 8 samples of the 8 channels are loaded from the rows,
+   * transposed to the line layout (8x8 of 16 bits) and subtracted from 8 lines at once.
+   *
+   * The stage takes raw fragments and runs first, before GainSelector.
+   */
+  class PedestalSubtractor : public EventProcessor
+  {
+  public:
+    /**
+     * @param table pedestals. Not owned.
+     */
+    PedestalSubtractor(PedestalTable *table) throw();
+    virtual ~PedestalSubtractor() throw();
+
+    virtual const char *getName();
+    virtual bool process(EventHeader *header, unsigned char **data, unsigned char **spare, int worker);
+    virtual void printSummary();
+
+    /**
+     * Subtracts the pedestals of one module in place.
+     * @param frag raw fragment (EVENTSIZE bytes)
+     */
+    static void subtractModule(unsigned char *frag, PedestalTable *table, int module);
+
+  private:
+    PedestalTable *m_table;
+    //counter of each worker on its own cache line
+    struct Count
+    {
+      unsigned long long nModule;
+    } __attribute__((aligned(CACHELINE_SIZE)));
+    Count m_count[MAX_WORKER];
+  };
+}
+
+#endif
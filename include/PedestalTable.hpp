@@ -0,0 +1,103 @@
+#ifndef __PEDESTALTABLE_H
+#define __PEDESTALTABLE_H
+
+#include "Config.hpp"
+
+/** @def PEDESTAL_MAGIC
+ * @brief First 4 bytes of a pedestal file
+ */
+#define PEDESTAL_MAGIC "PEDT"
+
+/** @def PEDESTAL_VERSION
+ * @brief Version of the pedestal file
+ */
+#define PEDESTAL_VERSION 1
+
+/** @def PEDESTAL_PAD
+ * @brief Cells appended to each row of the subtraction table, copied from its head,
+ * so that READDEPTH samples from any stop cell (rounded up to 8) are read without wraparound.
+ */
+#define PEDESTAL_PAD ((READDEPTH+7)/8*8)
+
+namespace LSTDAQ{
+
+  /**
+   * Header of a pedestal file.
+   *
+   * The header is followed by float mean[nModule][nGain][nChannel][nCell] and
+   * float rms[nModule][nGain][nChannel][nCell], in ADC counts. Modules are in the order of the
+   * Ring Buffers (i.e. of Connection.conf), as in the built events.
+   */
+  struct PedestalFileHeader
+  {
+    char magic[4];              //!< PEDESTAL_MAGIC
+    unsigned short version;     //!< PEDESTAL_VERSION
+    unsigned short nModule;
+    unsigned short nGain;       //!< NGAIN
+    unsigned short nChannel;    //!< NCHANNEL
+    unsigned short nCell;       //!< DRS4_NCELL
+    unsigned short reserved;
+    unsigned long long nEvent;  //!< number of events the pedestals were computed from
+  };
+
+  /**
+   * Pedestals of all the DRS4 cells of all the modules.
+   *
+   * For subtraction, the means are kept rounded to integers in rows of DRS4_NCELL+PEDESTAL_PAD cells,
+   * one row per module, gain and channel (getRow()).
+   */
+  class PedestalTable
+  {
+  public:
+    /**
+     * Constructor. All pedestals are 0.
+     */
+    PedestalTable(int nModule) throw();
+    /**
+     * Destructor
+     */
+    virtual ~PedestalTable() throw();
+
+    /**
+     * Reads a pedestal file.
+     * @return NULL if the file cannot be read or does not match NGAIN/NCHANNEL/DRS4_NCELL.
+     */
+    static PedestalTable *load(const char *fileName);
+    /**
+     * Writes the table to a pedestal file.
+     */
+    bool save(const char *fileName);
+
+    /**
+     * Sets the pedestal of one cell.
+     */
+    void set(int module, int gain, int channel, int cell, float mean, float rms);
+    float getMean(int module, int gain, int channel, int cell);
+    float getRms(int module, int gain, int channel, int cell);
+    int getNmodule() throw();
+    void setNevent(unsigned long long nEvent);
+    unsigned long long getNevent() throw();
+
+    /**
+     * @return rounded means of one channel, DRS4_NCELL+PEDESTAL_PAD cells.
+     */
+    const unsigned short *getRow(int module, int gain, int channel)
+    {
+      return m_row+(((unsigned long)module*NGAIN+gain)*NCHANNEL+channel)*(DRS4_NCELL+PEDESTAL_PAD);
+    }
+
+  private:
+    int m_nModule;
+    unsigned long long m_nEvent;
+    float *m_mean;
+    float *m_rms;
+    unsigned short *m_row;
+
+    unsigned long index(int module, int gain, int channel, int cell)
+    {
+      return (((unsigned long)module*NGAIN+gain)*NCHANNEL+channel)*DRS4_NCELL+cell;
+    }
+  };
+}
+
+#endif
@@ -124,6 +124,16 @@ namespace LSTDAQ{
      */
     int read(char *buf);
 
+    /**
+     * Places the buffer memory on a NUMA node.
+     *
+     * The pages not yet written are allocated on the node when they are first written (mbind(), MPOL_PREFERRED).
+     * Pages already allocated, e.g. locked by mlockall() in real-time mode, are moved to the node (MPOL_MF_MOVE).
+     * Called by the Collector_thread before it writes, so that the ring is local to the CPU and NIC of the collector.
+     * @return false if the memory policy is not supported
+     */
+    bool setNode(int node);
+
     //getter methods
     unsigned long getNw() throw();
     unsigned long getNr() throw();
@@ -0,0 +1,132 @@
+#ifndef __RUNCONTROL_H
+#define __RUNCONTROL_H
+
+#include <string>
+#include "Config.hpp"
+
+/** @def RC_CMD_NONE
+ * @brief no command came within the timeout
+ */
+#define RC_CMD_NONE 0
+/** @def RC_CMD_CONFIGURE
+ * @brief reads the configuration, connects the FEBs and starts the threads
+ */
+#define RC_CMD_CONFIGURE 1
+/** @def RC_CMD_START
+ * @brief starts a run
+ */
+#define RC_CMD_START 2
+/** @def RC_CMD_STOP
+ * @brief stops the run and reports its statistics
+ */
+#define RC_CMD_STOP 3
+/** @def RC_CMD_RESET
+ * @brief stops the threads and closes the connections
+ */
+#define RC_CMD_RESET 4
+/** @def RC_CMD_STATUS
+ * @brief reports the state and the progress of the run
+ */
+#define RC_CMD_STATUS 5
+/** @def RC_CMD_QUIT
+ * @brief resets and ends LSTDAQ
+ */
+#define RC_CMD_QUIT 6
+/** @def RC_CMD_UNKNOWN
+ * @brief line which is not a command
+ */
+#define RC_CMD_UNKNOWN 7
+
+/** @def RC_STATE_IDLE
+ * @brief nothing is configured
+ */
+#define RC_STATE_IDLE 0
+/** @def RC_STATE_CONFIGURED
+ * @brief FEBs are connected and their data is discarded
+ */
+#define RC_STATE_CONFIGURED 1
+/** @def RC_STATE_RUNNING
+ * @brief events are built
+ */
+#define RC_STATE_RUNNING 2
+
+namespace LSTDAQ{
+
+  /**
+   * Control socket of LSTDAQ driven by a run control (-Q).
+   *
+   * The socket is a Unix socket ("unix:<path>") or a TCP port of localhost ("tcp:<port>") as in StreamServer.
+   * One client at a time sends command lines and gets for each command zero or more information lines
+   * followed by "OK <state>" or "ERROR <reason>".
+   * \code
+   * configure      IDLE       -> CONFIGURED : connections, Ring Buffers and threads are made
+   * start [N]      CONFIGURED -> RUNNING    : run of N events (default -n, or until stop with -C)
+   * stop           RUNNING    -> CONFIGURED : statistics of the run are reported
+   * reset          any        -> IDLE       : threads are stopped and connections closed
+   * status         any                      : state, run number and events built
+   * quit           any                      : reset and end of LSTDAQ
+   * \endcode
+   * A run which ends by itself after N events goes back to CONFIGURED, and "stop" then reports it.
+   * RunControl only parses the commands and keeps the state. The actions are taken by main().
+   *
+   * @param m_state    int : RC_STATE_*.
+   * @param m_clientFd int : socket of the client (-1 if none).
+   */
+  class RunControl
+  {
+  public:
+    /**
+     * @param address "unix:<path>" or "tcp:<port>"
+     */
+    RunControl(const char *address) throw();
+    virtual ~RunControl() throw();
+
+    /**
+     * Opens the listening socket.
+     * @return false on error
+     */
+    bool open();
+    /**
+     * Waits for the next command, accepting a client if none is connected.
+     * @param arg argument of the command (empty if none)
+     * @param timeoutMsec max time to wait [msec]
+     * @return RC_CMD_*
+     */
+    int next(std::string &arg, int timeoutMsec);
+    /**
+     * Sends one line to the client.
+     */
+    void reply(const char *line);
+    /**
+     * Sends "OK <state>", ending the reply.
+     */
+    void ok();
+    /**
+     * Sends "ERROR <reason>", ending the reply.
+     */
+    void error(const char *reason);
+    /**
+     * @return true if the command is accepted in the current state
+     */
+    bool isAllowed(int cmd) throw();
+    void close();
+
+    static const char *stateName(int state);
+
+    //getter and setter methods
+    int getState() throw();
+    void setState(int state) throw();
+
+  private:
+    int parse(const char *line, std::string &arg);
+
+    std::string m_address;
+    std::string m_unixPath;
+    int m_listenFd;
+    int m_clientFd;
+    int m_state;
+    std::string m_line;   //received bytes of the next command
+  };
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef __SHMPUBLISHER_H
+#define __SHMPUBLISHER_H
+
+#include <string>
+#include "Config.hpp"
+#include "EventConsumer.hpp"
+#include "ShmRing.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * Consumer publishing the built events to a POSIX shared memory ring for local analysis programs.
+   *
+   * The segment is created with shm_open() and the events are copied into the ring of records
+   * described in ShmRing.hpp. Old records are overwritten without waiting for the readers,
+   * so readers (ShmReader) that fall behind skip ahead instead of slowing down LSTDAQ.
+   * Attached to EventDispatcher with DISPATCH_DROP, the copy itself runs on the consumer thread
+   * and never stalls the pipeline either.
+   *
+   * The segment is removed with shm_unlink() at the end of the run after its state is set to
+   * SHM_STATE_CLOSED. Readers already attached keep their mapping and see the state.
+   */
+  class ShmPublisher : public EventConsumer
+  {
+  public:
+    /**
+     * @param name     name of the segment (e.g. "/lstdaq"). A leading '/' is added if missing.
+     * @param dataSize size of the data area [bytes]. Rounded up to SHM_ALIGN.
+     */
+    ShmPublisher(const char *name, unsigned long long dataSize) throw();
+    virtual ~ShmPublisher() throw();
+
+    /**
+     * Creates and maps the segment.
+     * @return false on error
+     */
+    bool open();
+
+    virtual const char *getName();
+    virtual void consume(const EventBuffer *buf);
+    virtual void finish();
+    virtual void printSummary();
+
+  private:
+    void put(const ShmRecordHeader *record, const EventHeader *header, const unsigned char *data);
+    void makeRoom(unsigned int len);
+
+    std::string m_name;
+    unsigned long long m_dataSize;
+    int m_fd;
+    unsigned char *m_map;
+    unsigned long m_mapSize;
+    ShmRingHeader *m_header;
+    unsigned char *m_data;
+
+    unsigned long long m_nEvent;
+    unsigned long long m_nTooLarge;
+    unsigned long long m_bytes;
+  };
+}
+
+#endif
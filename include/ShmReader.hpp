@@ -0,0 +1,103 @@
+#ifndef __SHMREADER_H
+#define __SHMREADER_H
+
+#include <stddef.h> //size_t
+#include "EventFormat.hpp"
+#include "ShmRing.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * Client of the shared memory ring published by LSTDAQ (ShmPublisher).
+   *
+   * The segment is mapped read only, and the events are returned as pointers into the ring,
+   * without copy. Since LSTDAQ never waits for readers, an event can be overwritten while it is used:
+   * check isValid() after using it (or use copy(), which checks by itself), following the protocol
+   * described in ShmRing.hpp. A reader which falls behind jumps to the oldest event in the ring,
+   * and the events in between are counted by getNskipped().
+   *
+   * Typical loop :
+   * \code
+   * LSTDAQ::ShmReader reader;
+   * reader.open("/lstdaq");
+   * const LSTDAQ::EventHeader *h; const unsigned char *data;
+   * while(reader.next(&h,&data,100000)>=0)
+   * {
+   *   ... use h and data ...
+   *   if(!reader.isValid()) ... discard the result ...
+   * }
+   * \endcode
+   *
+   * @param m_pos     unsigned long long : position of the next record (see ShmRing.hpp).
+   * @param m_cur     unsigned long long : position of the record returned by the last next().
+   * @param m_seq     unsigned long long : sequence number expected for the next event.
+   */
+  class ShmReader
+  {
+  public:
+    /**
+     * Constructor
+     */
+    ShmReader() throw();
+    /**
+     * Destructor
+     */
+    virtual ~ShmReader() throw();
+
+    /**
+     * Maps the segment. Reading starts from the next event published.
+     * @param name name of the segment given to LSTDAQ. A leading '/' is added if missing.
+     * @return false if the segment does not exist or is not a ring of this version.
+     */
+    bool open(const char *name);
+    /**
+     * Unmaps the segment.
+     */
+    void close();
+
+    /**
+     * Waits for the next event.
+     * @param header  header of the event in the ring is returned here.
+     * @param data    payload of the event in the ring is returned here.
+     * @param timeoutUsec max time to wait [usec].
+     * @return 1 if an event is returned, 0 on timeout, -1 if the run has ended and all events were read.
+     */
+    int next(const EventHeader **header, const unsigned char **data, int timeoutUsec);
+    /**
+     * @return true if the event returned by the last next() has not been overwritten yet.
+     */
+    bool isValid();
+    /**
+     * Copies the event returned by the last next().
+     * @param buf must have room for header->size bytes.
+     * @return false if the event was overwritten during the copy.
+     */
+    bool copy(EventHeader *header, unsigned char *buf);
+
+    //getter methods
+    unsigned long long getSeq() throw();     //!< sequence number of the last event returned
+    unsigned long long getTimeNs() throw();  //!< build time of the last event returned
+    unsigned long long getNread() throw();
+    unsigned long long getNskipped() throw();
+    unsigned long long getNtorn() throw();
+
+  private:
+    unsigned char *m_map;
+    size_t m_mapSize;
+    const ShmRingHeader *m_header;
+    const unsigned char *m_data;
+    unsigned long long m_dataSize;
+
+    unsigned long long m_pos;
+    unsigned long long m_cur;
+    unsigned long long m_seq;
+    const ShmRecordHeader *m_record;
+    unsigned long long m_timeNs;
+
+    unsigned long long m_nRead;
+    unsigned long long m_nSkipped;
+    unsigned long long m_nTorn;
+  };
+}
+
+#endif
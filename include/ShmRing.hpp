@@ -0,0 +1,105 @@
+#ifndef __SHMRING_H
+#define __SHMRING_H
+
+#include "EventFormat.hpp"
+
+/** @def SHM_MAGIC
+ * @brief Identifier at the top of the shared memory ring
+ */
+#define SHM_MAGIC "SHMR"
+
+/** @def SHM_VERSION
+ * @brief Version of the shared memory ring layout
+ */
+#define SHM_VERSION 1
+
+/** @def SHM_ALIGN
+ * @brief Alignment of the records in the shared memory ring [bytes]
+ */
+#define SHM_ALIGN 64
+
+/** @def SHM_RECORD_PAD
+ * @brief ShmRecordHeader::flags of a record filling the end of the ring, to be skipped
+ */
+#define SHM_RECORD_PAD 0x1
+
+/** @def SHM_STATE_RUNNING
+ * @brief ShmRingHeader::state while events are published
+ */
+#define SHM_STATE_RUNNING 1
+
+/** @def SHM_STATE_CLOSED
+ * @brief ShmRingHeader::state after the last event
+ */
+#define SHM_STATE_CLOSED 2
+
+namespace LSTDAQ{
+
+  /**
+   * Header of the shared memory ring (see ShmPublisher, ShmReader).
+   *
+   * Layout of the segment /dev/shm/<name> :
+   * - ShmRingHeader, padded to SHM_ALIGN bytes.
+   * - data area of dataSize bytes (multiple of SHM_ALIGN), used as a ring of records.
+   *
+   * Each record is a ShmRecordHeader, then EventHeader and EventHeader::size bytes of payload,
+   * padded to a multiple of SHM_ALIGN. A record is never split at the end of the data area:
+   * if it does not fit, the rest of the area is filled with a record flagged SHM_RECORD_PAD.
+   *
+   * Positions are byte offsets counted from the start of the run (never wrapped); the address of
+   * position p is data area + p%dataSize. The only writer (LSTDAQ) keeps
+   *   oldest <= (position of any valid record) < writeOffset, writeOffset-oldest <= dataSize.
+   * To add a record of len bytes at writeOffset, the writer
+   *   1. moves oldest over the records to be overwritten, so that writeOffset+len-oldest <= dataSize,
+   *   2. writes the record,
+   *   3. increments writeSeq and moves writeOffset behind the record,
+   * with memory barriers between the steps. A reader keeps its own position r and
+   * - reads the record at r if oldest <= r < writeOffset,
+   * - jumps to oldest if r < oldest (it fell behind : the events in between are lost for it),
+   * - after using the record in place, checks oldest <= r again. Otherwise the record may have been
+   *   overwritten while it was read and has to be discarded.
+   * Readers never write to the segment, so any number of them can follow the ring without slowing the DAQ.
+   * ShmRecordHeader::seq counts the events, so a reader knows how many events it skipped.
+   */
+  struct ShmRingHeader
+  {
+    char magic[4];                         //!< SHM_MAGIC
+    unsigned int version;                  //!< SHM_VERSION
+    unsigned long long dataSize;           //!< size of the data area [bytes]
+    volatile unsigned int state;           //!< SHM_STATE_RUNNING or SHM_STATE_CLOSED
+    unsigned int reserved;
+    volatile unsigned long long oldest;    //!< position of the oldest valid record
+    volatile unsigned long long writeOffset; //!< position of the next record
+    volatile unsigned long long writeSeq;  //!< number of events published
+    unsigned long long reserved2[2];
+  };
+
+  /**
+   * Header of one record in the shared memory ring.
+   */
+  struct ShmRecordHeader
+  {
+    unsigned long long seq;    //!< sequence number of the event (0 for the first event of the run)
+    unsigned long long timeNs; //!< time the event was built (CLOCK_REALTIME) [nsec]
+    unsigned int size;         //!< size of the record including this header and the padding [bytes]
+    unsigned int flags;        //!< SHM_RECORD_PAD or 0
+    unsigned long long reserved;
+  };
+
+  /**
+   * @return size of the ring header including padding [bytes]
+   */
+  inline unsigned long getShmHeaderSize()
+  {
+    return (sizeof(ShmRingHeader)+SHM_ALIGN-1)/SHM_ALIGN*SHM_ALIGN;
+  }
+  /**
+   * @return size of the record of an event with a payload of size bytes
+   */
+  inline unsigned int getShmRecordSize(unsigned int size)
+  {
+    return (sizeof(ShmRecordHeader)+sizeof(EventHeader)+size+SHM_ALIGN-1)/SHM_ALIGN*SHM_ALIGN;
+  }
+}
+
+#endif
@@ -0,0 +1,40 @@
+//
+//! \file  Simd.hpp
+//  Selection of the SIMD instruction set used by the processing kernels.
+//
+
+#ifndef __SIMD_H
+#define __SIMD_H
+
+/** @def SIMD_SCALAR
+ * @brief Plain C++ kernels
+ */
+#define SIMD_SCALAR 0
+
+/** @def SIMD_SSSE3
+ * @brief 128 bit kernels (SSSE3)
+ */
+#define SIMD_SSSE3 1
+
+/** @def SIMD_AVX2
+ * @brief 256 bit kernels (AVX2)
+ */
+#define SIMD_AVX2 2
+
+namespace LSTDAQ{
+  /**
+   * @return the best instruction set supported by the CPU (detected once), unless set by setSimdLevel().
+   */
+  int getSimdLevel();
+  /**
+   * Forces the instruction set, e.g. to compare kernels in benchmarks.
+   * A level higher than the CPU supports is lowered.
+   */
+  void setSimdLevel(int level);
+  /**
+   * @return name of the level ("scalar", "ssse3", "avx2")
+   */
+  const char *getSimdName(int level);
+}
+
+#endif
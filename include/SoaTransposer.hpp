@@ -0,0 +1,60 @@
+#ifndef __SOATRANSPOSER_H
+#define __SOATRANSPOSER_H
+
+#include "Config.hpp"
+#include "EventFormat.hpp"
+#include "EventProcessor.hpp"
+
+/** @def SOA_HEADERSIZE
+ * @brief Size of the entry of one module in the module table of EVFMT_SOA [bytes]
+ */
+#define SOA_HEADERSIZE (LINE_WAVEFORM*LINESIZE)
+
+namespace LSTDAQ{
+
+  /**
+   * Pixel-major layout of the samples (EVFMT_SOA).
+   *
+   * In the built event, the samples of one pixel are spread over READDEPTH lines of its module,
+   * interleaved with the other channels and gains. This stage stores them as contiguous arrays instead,
+   * so analysis can read the waveform of a pixel, or all pixels of a gain, directly.
+   *
+   * Payload with EVFMT_SOA (the input must be a dense layout, raw or EVFMT_GAINSEL, may be EVFMT_PEDSUB):
+   * - prefix of the input format (gain bitmap with EVFMT_GAINSEL)
+   * - module table : for each module, lines 0 to LINE_WAVEFORM-1 (header, flag, stopcell) as they are,
+   *   SOA_HEADERSIZE bytes each
+   * - samples : unsigned short [nGain][nModule*NCHANNEL][READDEPTH] in host byte order,
+   *   pixel m*NCHANNEL+c being channel c of module m
+   *
+   * The payload size is the same as the dense layout. Blocks of 8 samples x 8 channels are transposed
+   * in registers with SSSE3 (byte swap with pshufb, then 8x8 of 16 bits with unpack), so each line is
+   * read once and each output row is written 16 bytes at a time.
+   * The lossless encodings and zero suppression do not apply to this layout.
+   */
+  class SoaTransposer : public EventProcessor
+  {
+  public:
+    SoaTransposer() throw();
+    virtual ~SoaTransposer() throw();
+
+    virtual const char *getName();
+    virtual bool process(EventHeader *header, unsigned char **data, unsigned char **spare, int worker);
+
+    /**
+     * Transposes the samples of one gain of one module.
+     * @param module module in the dense layout
+     * @param nGain  number of stored gains
+     * @param gain   gain to transpose
+     * @param out    NCHANNEL rows of READDEPTH samples, rows stride samples apart
+     */
+    static void transposeModule(const unsigned char *module, int nGain, int gain, unsigned short *out, int stride);
+
+    /**
+     * Converts a payload with EVFMT_SOA back to the dense layout of header->flags without EVFMT_SOA.
+     * @return size of the dense payload
+     */
+    static int restore(const EventHeader *header, const unsigned char *payload, unsigned char *out);
+  };
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef __SOFTWARETRIGGER_H
+#define __SOFTWARETRIGGER_H
+
+#include "Config.hpp"
+#include "EventFormat.hpp"
+#include "EventProcessor.hpp"
+#include "EventFilter.hpp"
+
+/** @def MAX_FILTER
+ * @brief Max number of filters of SoftwareTrigger
+ */
+#define MAX_FILTER 8
+
+namespace LSTDAQ{
+
+  /**
+   * Event filter before writing.
+   *
+   * The charge of each pixel is taken from the DL1 record (EVFMT_DL1) or extracted from the first
+   * stored gain of the waveforms with the same window as the DL1 record (ChargeExtractor::extractGain()).
+   * Every filter (EventFilter) is applied, and the event is kept if any of them accepts it.
+   * Of the rejected events, those with trigger%prescale==0 are kept as a background sample
+   * (prescale 0 : all rejected events are dropped). Using the trigger number keeps the sample
+   * independent of the worker that processed the event.
+   * The filters which accepted the event (TRIGTYPE_FILTER(i)) or TRIGTYPE_PRESCALED are set to EventHeader::trigType.
+   * Modules flagged in EventHeader::missing are skipped, since their buffer holds an older event.
+   *
+   * Accept counts and CPU time are recorded per filter and worker and shown by printSummary().
+   * Sparse and encoded payloads are kept without test.
+   */
+  class SoftwareTrigger : public EventProcessor
+  {
+  public:
+    /**
+     * @param prescale 1 of prescale rejected events is kept. 0 to drop all rejected events.
+     * @param window   samples integrated when the charges are extracted from the waveforms (-D, DL1_WINDOW by default)
+     */
+    SoftwareTrigger(unsigned int prescale, int window) throw();
+    /**
+     * Destructor. The filters are deleted as well.
+     */
+    virtual ~SoftwareTrigger() throw();
+
+    /**
+     * Adds a filter. Must be called before the pool starts.
+     */
+    void addFilter(EventFilter *filter);
+    int getNfilter() throw();
+
+    virtual const char *getName();
+    virtual bool process(EventHeader *header, unsigned char **data, unsigned char **spare, int worker);
+    virtual void printSummary();
+
+  private:
+    bool getCharge(const EventHeader *header, const unsigned char *data, int *charge);
+
+    unsigned int m_prescale;
+    int m_window;
+    EventFilter *m_filter[MAX_FILTER];
+    int m_nFilter;
+    //counters of each worker on their own cache lines
+    struct Count
+    {
+      unsigned long long nTest;
+      unsigned long long nKeep;
+      unsigned long long nPrescaled;
+      unsigned long long nAccept[MAX_FILTER];
+      unsigned long long filterNsec[MAX_FILTER];
+    } __attribute__((aligned(CACHELINE_SIZE)));
+    Count m_count[MAX_WORKER];
+  };
+}
+
+#endif
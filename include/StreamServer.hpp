@@ -0,0 +1,101 @@
+#ifndef __STREAMSERVER_H
+#define __STREAMSERVER_H
+
+#include <pthread.h>
+#include <string>
+#include "Config.hpp"
+#include "EventConsumer.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * Consumer streaming a fraction of the built events to clients (e.g. event display) over a socket.
+   *
+   * The server listens on a Unix socket ("unix:<path>") or on a TCP port of localhost ("tcp:<port>").
+   * A client may send one request line just after connecting (within STREAM_REQUEST_MSEC), e.g.
+   * \code
+   * prescale=10 types=0x8001
+   * \endcode
+   * - prescale=N : the client gets 1 of N events (default 1).
+   * - types=MASK : only events with EventHeader::trigType&MASK (see TRIGTYPE_*) are sent. 0 (default) for all.
+   * The server then sends the events as in the output file : EventHeader followed by the payload.
+   *
+   * Each client has a queue of STREAM_QUEUE_MB bytes and a thread sending it to the socket, so a slow or
+   * stalled client delays nobody else. An event which does not fit in the queue is dropped for the client.
+   * To follow the bandwidth the client can take, the prescale of the client is doubled (up to STREAM_MAX_PRESCALE)
+   * when the queue is more than half full, at most once per 1/8 of the queue sent. While the queue is less than
+   * 1/4 full, the prescale goes down by one after each send towards the requested one.
+   *
+   * @param m_client[]  Client* : connected clients (NULL for free entries).
+   * @param m_listenFd  int     : listening socket.
+   */
+  class StreamServer : public EventConsumer
+  {
+  public:
+    /**
+     * @param address "unix:<path>" or "tcp:<port>"
+     */
+    StreamServer(const char *address) throw();
+    virtual ~StreamServer() throw();
+
+    /**
+     * Opens the listening socket and starts accepting clients.
+     * @return false on error
+     */
+    bool open();
+
+    virtual const char *getName();
+    virtual void consume(const EventBuffer *buf);
+    virtual void finish();
+    virtual void printSummary();
+
+  private:
+    struct Client
+    {
+      StreamServer *owner;
+      int fd;
+      std::string name;
+      pthread_t thread;
+      pthread_mutex_t mutex;
+      pthread_cond_t cond;   //signaled when an event is queued
+      unsigned char *ring;
+      unsigned long size;
+      unsigned long long head; //bytes queued since connection
+      unsigned long long tail; //bytes sent since connection
+      unsigned long long holdUntil; //prescale is not changed again before this is sent
+      bool closing;
+      volatile bool dead;
+
+      unsigned int prescale;
+      unsigned int curPrescale;
+      unsigned int typeMask;
+      unsigned long long nOffer;
+      unsigned long long nQueued;
+      unsigned long long nDrop;
+    };
+
+    static void *accept_thread(void *arg);
+    static void *sender_thread(void *arg);
+    void runAccept();
+    void runSender(Client *c);
+    void addClient(int fd, const char *name);
+    void removeClient(int i);
+    void put(Client *c, const void *p, unsigned long len);
+
+    std::string m_address;
+    std::string m_unixPath;
+    int m_listenFd;
+    pthread_t m_acceptThread;
+    volatile bool m_closing;
+    bool m_running;
+    pthread_mutex_t m_mutex;   //protects m_client[]
+    Client *m_client[MAX_STREAM_CLIENT];
+
+    unsigned long long m_nClient;
+    unsigned long long m_nQueued;
+    unsigned long long m_nDrop;
+    unsigned long long m_bytesSent;
+  };
+}
+
+#endif
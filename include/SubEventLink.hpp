@@ -0,0 +1,45 @@
+#ifndef __SUBEVENTLINK_H
+#define __SUBEVENTLINK_H
+
+#include "EventFormat.hpp"
+
+/** @def SUBEVENT_MAGIC
+ * @brief Identifier at the top of a link from a collector node
+ */
+#define SUBEVENT_MAGIC "SUBE"
+
+/** @def SUBEVENT_VERSION
+ * @brief Version of the sub-event link protocol
+ */
+#define SUBEVENT_VERSION 1
+
+namespace LSTDAQ{
+
+  /**
+   * First message of a link from a collector node to the builder node (see SubEventSender, SubEventReceiver).
+   *
+   * In the two-tier event building, each collector node builds sub-events from its own FEBs
+   * (the modules in its Connection.conf) and sends them over one TCP connection to the builder node:
+   * - SubEventHello once after connecting.
+   * - then for each sub-event, EventHeader followed by EventHeader::size bytes of payload, as in the output file.
+   *   EventHeader::trigger is the trigger number the sub-event is tagged with, EventHeader::nModule is the
+   *   number of modules of the node, and bit i of EventHeader::missing is set if module i of the node has no data.
+   *   The payload is the raw fragments of the modules (EventHeader::flags is 0) in the order of the node's
+   *   Connection.conf.
+   * The link is closed after the last sub-event.
+   *
+   * The builder node orders the modules by nodeId, then by their order in the node, and merges the sub-events
+   * with the same trigger number into events of the whole camera.
+   */
+  struct SubEventHello
+  {
+    char magic[4];             //!< SUBEVENT_MAGIC
+    unsigned int version;      //!< SUBEVENT_VERSION
+    unsigned int nodeId;       //!< index of the collector node (0 ... number of nodes-1)
+    unsigned int nModule;      //!< number of modules of the node
+    unsigned int fragmentSize; //!< EVENTSIZE of the node [bytes]
+    unsigned int reserved[3];
+  };
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef __SUBEVENTRECEIVER_H
+#define __SUBEVENTRECEIVER_H
+
+#include <signal.h> //sig_atomic_t
+#include "Config.hpp"
+#include "EventFormat.hpp"
+#include "SubEventLink.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * Receives the sub-events of the collector nodes on the builder node (see SubEventLink.hpp).
+   *
+   * acceptNodes() waits until all the nodes are connected, so that the number of modules of each node
+   * is known before the Ring Buffers are made. Then each node is read by its own thread with read().
+   *
+   * @param m_fd[]      int : socket of each node, indexed by node id.
+   * @param m_nModule[] int : number of modules of each node.
+   */
+  class SubEventReceiver
+  {
+  public:
+    /**
+     * Constructor
+     */
+    SubEventReceiver() throw();
+    /**
+     * Destructor
+     */
+    virtual ~SubEventReceiver() throw();
+
+    /**
+     * Opens the listening socket on all interfaces.
+     * @return false on error
+     */
+    bool listen(int port);
+    /**
+     * Waits for nNode collector nodes to connect and to introduce themselves.
+     * @param stop the wait is given up when this is set
+     * @return false on error or stop
+     */
+    bool acceptNodes(int nNode, const volatile sig_atomic_t *stop);
+    /**
+     * Waits for the next sub-event of a node.
+     * @param buf must have room for getNmodule(node)*EVENTSIZE bytes.
+     * @param timeoutMsec max time to wait for the start of the sub-event [msec].
+     * @return 1 if a sub-event is read, 0 on timeout, -1 if the node has closed the link or sent a bad sub-event.
+     */
+    int read(int node, EventHeader *header, unsigned char *buf, int timeoutMsec);
+    /**
+     * Closes all the sockets.
+     */
+    void close();
+    void printSummary();
+
+    //getter methods
+    int getNnode() throw();
+    int getNmodule(int node) throw();
+
+  private:
+    int m_listenFd;
+    int m_nNode;
+    int m_fd[MAX_NODE];
+    int m_nModule[MAX_NODE];
+    unsigned long long m_nEvent[MAX_NODE];
+    unsigned long long m_bytes[MAX_NODE];
+  };
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef __SUBEVENTSENDER_H
+#define __SUBEVENTSENDER_H
+
+#include <string>
+#include "Config.hpp"
+#include "EventFormat.hpp"
+#include "SubEventLink.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * Sends the sub-events built on a collector node to the builder node (see SubEventLink.hpp).
+   *
+   * send() blocks until the sub-event is in the socket buffer, so a builder node which cannot keep up
+   * slows down event building on the collector node, and the Ring Buffers absorb the backlog meanwhile.
+   * The time spent waiting is reported by printSummary().
+   *
+   * @param m_fd        int : socket connected to the builder node (-1 when closed).
+   * @param m_stallUsec unsigned long long : total time send() waited for the socket [usec].
+   */
+  class SubEventSender
+  {
+  public:
+    /**
+     * Constructor
+     */
+    SubEventSender() throw();
+    /**
+     * Destructor
+     */
+    virtual ~SubEventSender() throw();
+
+    /**
+     * Connects to the builder node and introduces the node, retrying for NODE_CONNECT_SEC.
+     * @param address "<host>:<port>" of the builder node
+     * @param nodeId  index of this node
+     * @param nModule number of modules in the sub-events
+     * @return false on error
+     */
+    bool connect(const char *address, int nodeId, int nModule);
+    /**
+     * Sends one sub-event.
+     * @return false if the link is broken
+     */
+    bool send(const EventHeader *header, const unsigned char *data);
+    /**
+     * Closes the link. The builder node sees it as the end of the node's data.
+     */
+    void close();
+    void printSummary();
+
+  private:
+    bool sendAll(const void *p, unsigned long len, int flags);
+
+    std::string m_address;
+    int m_fd;
+    unsigned long long m_nEvent;
+    unsigned long long m_bytes;
+    unsigned long long m_stallUsec;
+  };
+}
+
+#endif
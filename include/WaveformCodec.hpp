@@ -0,0 +1,58 @@
+#ifndef __WAVEFORMCODEC_H
+#define __WAVEFORMCODEC_H
+
+#include "Config.hpp"
+#include "EventFormat.hpp"
+#include "EventProcessor.hpp"
+
+/** @def CODEC_BLOCK
+ * @brief Number of samples packed with one bit width
+ */
+#define CODEC_BLOCK 16
+
+namespace LSTDAQ{
+
+  /**
+   * Lossless compression of the waveforms (EVFMT_DELTA).
+   *
+   * DRS4 samples of a channel change little from one sample to the next, so the waveform of each
+   * channel and gain is stored as differences to the previous sample. The difference (modulo 2^16)
+   * is mapped to an unsigned number by zigzag coding (0,-1,1,-2,... -> 0,1,2,3,...) and
+   * each block of CODEC_BLOCK values is bit-packed with the width of its largest value.
+   *
+   * Encoded payload : the prefix of the format (e.g. gain bitmap of EVFMT_GAINSEL) as it is, then
+   * for each module in the order of the raw payload:
+   * - lines 0 to LINE_WAVEFORM-1 (header, flag, stopcell) as they are, LINE_WAVEFORM*LINESIZE bytes
+   * - for each stored gain (NGAIN, or 1 with EVFMT_GAINSEL), for channel 0..NCHANNEL-1 :
+   *   READDEPTH samples in blocks of CODEC_BLOCK
+   *   (the last block is shorter), each block being
+   *   - 1 byte : bit width b (0 to 16)
+   *   - ceil(n*b/8) bytes : the n values, b bits each, least significant bit first
+   *
+   * Raw fragments of missing modules are encoded as well, so decoding restores the payload exactly.
+   * Sparse payloads (EVFMT_ZS), DL1 records (EVFMT_DL1) and EVFMT_SOA are left as they are.
+   */
+  class WaveformCodec : public EventProcessor
+  {
+  public:
+    WaveformCodec() throw();
+    virtual ~WaveformCodec() throw();
+
+    virtual const char *getName();
+    virtual unsigned int getMaxSize(unsigned int inSize);
+    virtual bool process(EventHeader *header, unsigned char **data, unsigned char **spare, int worker);
+
+    /**
+     * Encodes nModule fragments with nGain gains per sample (prefix not included).
+     * @return size of the encoded payload
+     */
+    static unsigned int encode(const unsigned char *in, unsigned int nModule, int nGain, unsigned char *out);
+    /**
+     * Decodes size bytes of encoded modules into nModule fragments with nGain gains per sample.
+     * @return size of the decoded fragments, or -1 if the payload is broken.
+     */
+    static int decode(const unsigned char *in, unsigned int size, unsigned int nModule, int nGain, unsigned char *out);
+  };
+}
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef __WORKERPOOL_H
+#define __WORKERPOOL_H
+
+#include <pthread.h>
+#include "Config.hpp"
+#include "EventFormat.hpp"
+#include "EventProcessor.hpp"
+#include "EventOutput.hpp"
+#include "EventBufferPool.hpp"
+#include "EventDispatcher.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * The class to process built events on several threads between Builder_thread and EventOutput.
+   *
+   * Builder_thread passes each event in an EventBuffer to a free slot with submit() and goes on building.
+   * The pool takes over the reference of the buffer, and releases it after the event is written,
+   * so the payload is not copied on the way.
+   * The worker threads take the slots in order and apply the chain of EventProcessor stages,
+   * several events in parallel. The drain thread hands the processed events to EventOutput
+   * in the order of building, so the output files look the same as without the pool.
+   * Only when all the slots are in use, Builder_thread has to wait (stall).
+   * Side records made by the stages (EventProcessor::makeSide()) go to the side output, also in order.
+   * The kept events are published to the dispatcher (if any) after they are written.
+   *
+   * @param *****Slots*****
+     @param m_slot[]    Slot : event slots used in round robin. Slot of sequence number n is m_slot[n%m_nSlot].
+     @param m_nSubmit   unsigned long long : number of events submitted by Builder_thread.
+     @param m_nTaken    unsigned long long : number of events taken by the workers.
+     @param m_nDrained  unsigned long long : number of events handed to EventOutput (or dropped).
+
+   * @param *****Metrics*****
+     @param m_bytesIn   unsigned long long : payload bytes submitted.
+     @param m_bytesOut  unsigned long long : payload bytes after processing.
+     @param m_nDrop     unsigned long long : events dropped by the stages.
+     @param m_sideBytes unsigned long long : bytes of side records.
+     @param m_procStat[] ProcStat : time spent in each stage [nsec] and number of events, per worker.
+   */
+  class WorkerPool
+  {
+  public:
+    /**
+     * Constructor
+     * @param nWorker  number of worker threads (1 - MAX_WORKER).
+     * @param nSlot    number of event slots. At least nWorker+1.
+     * @param maxSize  max payload size of the submitted events [bytes].
+     */
+    WorkerPool(int nWorker, int nSlot, unsigned int maxSize) throw();
+    /**
+     * Destructor. The stages are deleted as well.
+     */
+    virtual ~WorkerPool() throw();
+
+    /**
+     * Appends a stage to the chain. Must be called before start().
+     */
+    void addProcessor(EventProcessor *proc);
+    /**
+     * @return number of stages in the chain
+     */
+    int getNprocessor() throw();
+
+    /**
+     * @return size of the EventBuffer needed for the output of every stage [bytes].
+     *   Valid after all the stages are added.
+     */
+    unsigned int getBufferSize();
+    /**
+     * @return number of event slots
+     */
+    int getNslot() throw();
+
+    /**
+     * Starts the worker threads and the drain thread writing to output.
+     * With output NULL, the events are processed only (e.g. pedestal run).
+     */
+    bool start(EventOutput *output);
+    /**
+     * Sets the output of the side records. Must be called before start().
+     */
+    void setSideOutput(EventOutput *side);
+    /**
+     * Sets the dispatcher to publish the processed events to. Must be called before start().
+     */
+    void setDispatcher(EventDispatcher *dispatcher);
+    /**
+     * Puts one event into a free slot. Waits if all the slots are in use.
+     * The reference of the caller to buf is taken over by the pool.
+     * buf->timeNs is passed to EventOutput as the build time.
+     */
+    int submit(EventBuffer *buf);
+    /**
+     * Processes and writes the remaining events, then stops the threads.
+     */
+    void close();
+
+    //getter methods
+    unsigned long long getBytesIn() throw();
+    unsigned long long getBytesOut() throw();
+    unsigned long getNstall() throw();
+    unsigned long long getStallUsec() throw();
+
+    /**
+     * Prints the metrics of the pool and the stages to stdout.
+     */
+    void printSummary();
+
+  private:
+    struct Slot
+    {
+      EventBuffer *buf;
+      bool done;
+      bool keep;
+      EventHeader sideHeader;
+      unsigned char *side;
+      bool hasSide;
+    };
+
+    static void *worker_thread(void *arg);
+    static void *drain_thread(void *arg);
+    void runWorker(int worker);
+    void runDrain();
+
+    pthread_mutex_t m_mutex;
+    pthread_cond_t m_condWork;   //signaled when an event is submitted
+    pthread_cond_t m_condDone;   //signaled when an event is processed
+    pthread_cond_t m_condFree;   //signaled when a slot is released
+    pthread_t m_worker[MAX_WORKER];
+    pthread_t m_drain;
+    int m_nextWorker;
+    bool m_running;
+    bool m_closing;
+
+    EventOutput *m_output;
+    EventOutput *m_sideOutput;
+    EventDispatcher *m_dispatcher;
+    bool m_makeSide[MAX_PROCESSOR];
+    EventProcessor *m_proc[MAX_PROCESSOR];
+    int m_nProc;
+    int m_nWorker;
+    int m_nSlot;
+    unsigned int m_maxSize;
+    unsigned int m_bufSize;
+    Slot *m_slot;
+    unsigned long long m_nSubmit;
+    unsigned long long m_nTaken;
+    unsigned long long m_nDrained;
+
+    unsigned long long m_bytesIn;
+    unsigned long long m_bytesOut;
+    unsigned long long m_nDrop;
+    unsigned long long m_sideBytes;
+    unsigned long m_nStall;
+    unsigned long long m_stallUsec;
+    struct ProcStat
+    {
+      unsigned long long nsec[MAX_PROCESSOR];
+      unsigned long long count[MAX_PROCESSOR];
+    } __attribute__((aligned(CACHELINE_SIZE)));
+    ProcStat m_procStat[MAX_WORKER];
+  };
+}
+
+#endif
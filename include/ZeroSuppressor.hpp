@@ -0,0 +1,80 @@
+#ifndef __ZEROSUPPRESSOR_H
+#define __ZEROSUPPRESSOR_H
+
+#include "Config.hpp"
+#include "EventFormat.hpp"
+#include "EventProcessor.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * Zero suppression of channels without signal (EVFMT_ZS).
+   *
+   * Works on pedestal subtracted payloads (EVFMT_PEDSUB), with or without EVFMT_GAINSEL.
+   * A channel passes if, in its first stored gain (high gain, or the selected gain),
+   * the peak above PEDESTAL_OFFSET reaches peakThreshold or the sum of the READDEPTH samples
+   * above PEDESTAL_OFFSET reaches chargeThreshold (0 disables either test).
+   * The neighbours of a passing channel (channel +-1 in the module) are kept as well,
+   * since Connection.conf knows nothing about the pixel geometry of the camera.
+   * The scan of the samples is done with SSSE3 (max and 32 bit sums of 8 channels per line) when available.
+   *
+   * Sparse payload with EVFMT_ZS:
+   * - prefix of the input format (gain bitmap with EVFMT_GAINSEL)
+   * - channel bitmap : ZS_BITMAPSIZE(nModule) bytes. Byte m is the bitmap of module m,
+   *   bit c set if channel c is kept. Padded with 0 to a multiple of LINESIZE.
+   * - for each module : lines 0 to LINE_WAVEFORM-1 (header, flag, stopcell) as they are,
+   *   then for each kept channel in increasing order and each stored gain,
+   *   READDEPTH big endian 16 bit samples (READDEPTH*2 bytes).
+   *   A module without kept channels takes LINE_WAVEFORM*LINESIZE bytes.
+   *
+   * expand() turns a sparse payload back into the dense layout of the input format, with the samples of
+   * the suppressed channels at PEDESTAL_OFFSET. The lossless encodings are not applied to sparse payloads.
+   */
+  class ZeroSuppressor : public EventProcessor
+  {
+  public:
+    /**
+     * @param peakThreshold   peak above pedestal to keep a channel [counts]. 0 for no peak test.
+     * @param chargeThreshold sum of samples above pedestal to keep a channel [counts]. 0 for no charge test.
+     */
+    ZeroSuppressor(int peakThreshold, int chargeThreshold) throw();
+    virtual ~ZeroSuppressor() throw();
+
+    virtual const char *getName();
+    virtual unsigned int getMaxSize(unsigned int inSize);
+    virtual bool process(EventHeader *header, unsigned char **data, unsigned char **spare, int worker);
+    virtual void printSummary();
+
+    /**
+     * Finds the channels passing the thresholds in one module (without neighbours).
+     * @param module module in the dense layout
+     * @param nGain  number of stored gains
+     * @return channel bitmap
+     */
+    static unsigned char scanModule(const unsigned char *module, int nGain, int peakThreshold, int chargeThreshold);
+
+    /**
+     * @return channel bitmap of module m of a sparse payload
+     */
+    static unsigned char getChannelMask(const EventHeader *header, const unsigned char *payload, int m);
+    /**
+     * Converts a sparse payload to the dense layout of header->flags without EVFMT_ZS.
+     * @param out must have room for getPrefixSize()+nModule*getModuleSize() bytes.
+     * @return size of the dense payload, or -1 if the payload is broken.
+     */
+    static int expand(const EventHeader *header, const unsigned char *payload, unsigned char *out);
+
+  private:
+    int m_peakThreshold;
+    int m_chargeThreshold;
+    //counters of each worker on their own cache line
+    struct Count
+    {
+      unsigned long long nChannel;
+      unsigned long long nKept;
+    } __attribute__((aligned(CACHELINE_SIZE)));
+    Count m_count[MAX_WORKER];
+  };
+}
+
+#endif
@@ -0,0 +1,189 @@
+#include "ChargeExtractor.hpp"
+#include "PedestalSubtractor.hpp"
+#include "Simd.hpp"
+#include <string.h>//memcpy
+#include <stdio.h> //printf
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DL1_X86
+#endif
+
+//****************************************************
+// scalar kernel
+//****************************************************
+static void extract_scalar(const unsigned char *module, int nGain, int g, int window, int baseline,
+                           int *charge, unsigned short *peak)
+{
+  for(int c=0;c<NCHANNEL;c++)
+  {
+    const unsigned char *p=module+(LINE_WAVEFORM+g)*LINESIZE+2*c;
+    int x[READDEPTH];
+    for(int s=0;s<READDEPTH;s++)
+    {
+      x[s]=p[0]<<8|p[1];
+      p+=nGain*LINESIZE;
+    }
+    int sum=0,best=0,max=-1;
+    for(int s=0;s<READDEPTH;s++)
+    {
+      if(x[s]>max)
+      {
+        max=x[s];
+        peak[c]=s;
+      }
+      sum+=x[s];
+      if(s>=window)sum-=x[s-window];
+      if(s==window-1 || (s>=window && sum>best))best=sum;
+    }
+    charge[c]=best-window*baseline;
+  }
+}
+
+#ifdef DL1_X86
+//****************************************************
+// SSSE3 kernel : 8 channels of a line at once
+//****************************************************
+__attribute__((target("ssse3")))
+static void extract_ssse3(const unsigned char *module, int nGain, int g, int window, int baseline,
+                          int *charge, unsigned short *peak)
+{
+  const __m128i swap=_mm_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+  const __m128i zero=_mm_setzero_si128();
+  const unsigned char *line=module+(LINE_WAVEFORM+g)*LINESIZE;
+  const int stride=nGain*LINESIZE;
+  __m128i sumlo=zero,sumhi=zero,bestlo=zero,besthi=zero;
+  __m128i max=_mm_set1_epi16(-1),idx=zero;
+  for(int s=0;s<READDEPTH;s++)
+  {
+    __m128i x=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(line+s*stride)),swap);
+    //****** peak : first index of the largest sample ******
+    __m128i gt=_mm_cmpgt_epi16(x,max);
+    max=_mm_max_epi16(max,x);
+    idx=_mm_or_si128(_mm_and_si128(gt,_mm_set1_epi16((short)s)),_mm_andnot_si128(gt,idx));
+    //****** sliding window ******
+    sumlo=_mm_add_epi32(sumlo,_mm_unpacklo_epi16(x,zero));
+    sumhi=_mm_add_epi32(sumhi,_mm_unpackhi_epi16(x,zero));
+    if(s>=window)
+    {
+      __m128i y=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(line+(s-window)*stride)),swap);
+      sumlo=_mm_sub_epi32(sumlo,_mm_unpacklo_epi16(y,zero));
+      sumhi=_mm_sub_epi32(sumhi,_mm_unpackhi_epi16(y,zero));
+    }
+    if(s==window-1)
+    {
+      bestlo=sumlo;
+      besthi=sumhi;
+    }
+    else if(s>=window)
+    {
+      __m128i glo=_mm_cmpgt_epi32(sumlo,bestlo);
+      __m128i ghi=_mm_cmpgt_epi32(sumhi,besthi);
+      bestlo=_mm_or_si128(_mm_and_si128(glo,sumlo),_mm_andnot_si128(glo,bestlo));
+      besthi=_mm_or_si128(_mm_and_si128(ghi,sumhi),_mm_andnot_si128(ghi,besthi));
+    }
+  }
+  const __m128i base=_mm_set1_epi32(window*baseline);
+  _mm_storeu_si128((__m128i *)charge,_mm_sub_epi32(bestlo,base));
+  _mm_storeu_si128((__m128i *)(charge+4),_mm_sub_epi32(besthi,base));
+  _mm_storeu_si128((__m128i *)peak,idx);
+}
+#endif
+
+namespace LSTDAQ{
+  ChargeExtractor::ChargeExtractor(int window, bool replace) throw():m_replace(replace)
+  {
+    if(window<1)window=1;
+    if(window>READDEPTH)window=READDEPTH;
+    m_window=window;
+    for(int i=0;i<MAX_WORKER;i++)m_count[i].nRecord=0;
+  }
+  ChargeExtractor::~ChargeExtractor() throw()
+  {
+  }
+  const char *ChargeExtractor::getName()
+  {
+    return "dl1";
+  }
+
+  void ChargeExtractor::extractGain(const unsigned char *module, int nGain, int gain, int window, int baseline,
+                                    int *charge, unsigned short *peak)
+  {
+#ifdef DL1_X86
+    if(getSimdLevel()>=SIMD_SSSE3)
+    {
+      extract_ssse3(module,nGain,gain,window,baseline,charge,peak);
+      return;
+    }
+#endif
+    extract_scalar(module,nGain,gain,window,baseline,charge,peak);
+  }
+
+  void ChargeExtractor::extractModule(const unsigned char *module, int nGain, int window, int baseline, unsigned char *out)
+  {
+    for(int g=0;g<nGain;g++)
+    {
+      int charge[NCHANNEL];
+      unsigned short peak[NCHANNEL];
+      extractGain(module,nGain,g,window,baseline,charge,peak);
+      memcpy(out,charge,sizeof(charge));
+      memcpy(out+sizeof(charge),peak,sizeof(peak));
+      out+=DL1_MODULESIZE(1);
+    }
+  }
+
+  unsigned short ChargeExtractor::extract(const EventHeader *header, const unsigned char *data, unsigned char *out, unsigned int *size)
+  {
+    if(header->flags&(EVFMT_ENCODED|EVFMT_ZS|EVFMT_DL1|EVFMT_SOA))return 0;
+    int nGain=getNgainStored(header->flags);
+    int baseline=(header->flags&EVFMT_PEDSUB) ? PEDESTAL_OFFSET : 0;
+    unsigned int prefix=getPrefixSize(header->flags,header->nModule);
+    unsigned int moduleSize=getModuleSize(header->flags);
+    memcpy(out,data,prefix);
+    for(unsigned int m=0;m<header->nModule;m++)
+      extractModule(data+prefix+(unsigned long)m*moduleSize,nGain,m_window,baseline,
+                    out+prefix+m*DL1_MODULESIZE(nGain));
+    *size=prefix+header->nModule*DL1_MODULESIZE(nGain);
+    return header->flags|EVFMT_DL1;
+  }
+
+  unsigned int ChargeExtractor::getSideSize(unsigned int inSize)
+  {
+    if(m_replace)return 0;
+    return GAINSEL_BITMAPSIZE(MAX_CONNECTION)+MAX_CONNECTION*DL1_MODULESIZE(NGAIN);
+  }
+
+  bool ChargeExtractor::makeSide(const EventHeader *header, const unsigned char *data,
+                                 EventHeader *sideHeader, unsigned char *side, int worker)
+  {
+    unsigned int size;
+    unsigned short flags=extract(header,data,side,&size);
+    if(flags==0)return false;
+    memcpy(sideHeader,header,sizeof(EventHeader));
+    sideHeader->flags=flags;
+    sideHeader->size=size;
+    m_count[worker].nRecord++;
+    return true;
+  }
+
+  bool ChargeExtractor::process(EventHeader *header, unsigned char **data, unsigned char **spare, int worker)
+  {
+    if(!m_replace)return true;
+    unsigned int size;
+    unsigned short flags=extract(header,*data,*spare,&size);
+    if(flags==0)return true;
+    header->flags=flags;
+    header->size=size;
+    m_count[worker].nRecord++;
+    unsigned char *p=*data;
+    *data=*spare;
+    *spare=p;
+    return true;
+  }
+
+  void ChargeExtractor::printSummary()
+  {
+    unsigned long long n=0;
+    for(int i=0;i<MAX_WORKER;i++)n+=m_count[i].nRecord;
+    printf("  window %d samples, %llu DL1 records %s\n",m_window,n,m_replace ? "instead of waveforms" : "to the side stream");
+  }
+}
@@ -0,0 +1,195 @@
+#include "CpuTopology.hpp"
+#include <stdio.h>     //fopen
+#include <stdlib.h>    //strtol
+#include <string.h>    //memset
+#include <unistd.h>    //close
+#include <dirent.h>    //opendir
+#include <ifaddrs.h>   //getifaddrs
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h> //inet_aton
+
+//****************************************************
+// reads the first line of a /sys file
+//****************************************************
+static bool readLine(const char *path, char *buf, int len)
+{
+  FILE *fp=fopen(path,"r");
+  if(fp==NULL)return false;
+  bool ok=(fgets(buf,len,fp)!=NULL);
+  fclose(fp);
+  return ok;
+}
+
+namespace LSTDAQ{
+  CpuTopology::CpuTopology() throw()
+  {
+    m_nCpu=0;
+    m_nNode=1;
+  }
+  CpuTopology::~CpuTopology() throw()
+  {
+  }
+
+  void CpuTopology::load(int nCpu)
+  {
+    char path[320];   //room for a d_name of NAME_MAX bytes
+    char buf[4096];
+    m_nCpu=(nCpu<MAX_CPU ? nCpu : MAX_CPU);
+    m_nNode=1;
+    for(int i=0;i<m_nCpu;i++)
+    {
+      m_node[i]=0;
+      m_core[i]=i;
+      m_isolated[i]=false;
+    }
+
+    //****** NUMA nodes ******
+    DIR *dir=opendir("/sys/devices/system/node");
+    if(dir!=NULL)
+    {
+      struct dirent *ent;
+      int cpu[MAX_CPU];
+      while((ent=readdir(dir))!=NULL)
+      {
+        int node;
+        if(sscanf(ent->d_name,"node%d",&node)!=1)continue;
+        snprintf(path,sizeof(path),"/sys/devices/system/node/%s/cpulist",ent->d_name);
+        if(!readLine(path,buf,sizeof(buf)))continue;
+        buf[strcspn(buf,"\n")]='\0';
+        int n=parseCpuList(buf,cpu,MAX_CPU);
+        for(int i=0;i<n;i++)
+          if(cpu[i]<m_nCpu)m_node[cpu[i]]=node;
+        if(node+1>m_nNode)m_nNode=node+1;
+      }
+      closedir(dir);
+    }
+
+    //****** physical cores ******
+    for(int i=0;i<m_nCpu;i++)
+    {
+      int package=0;
+      int core=0;
+      sprintf(path,"/sys/devices/system/cpu/cpu%d/topology/physical_package_id",i);
+      if(!readLine(path,buf,sizeof(buf)))continue;
+      package=atoi(buf);
+      sprintf(path,"/sys/devices/system/cpu/cpu%d/topology/core_id",i);
+      if(!readLine(path,buf,sizeof(buf)))continue;
+      core=atoi(buf);
+      m_core[i]=package*MAX_CPU+core;
+    }
+
+    //****** CPUs isolated by the kernel command line ******
+    m_isolatedList="";
+    m_nohzList="";
+    const char *file[2]={"/sys/devices/system/cpu/isolated","/sys/devices/system/cpu/nohz_full"};
+    for(int f=0;f<2;f++)
+    {
+      if(!readLine(file[f],buf,sizeof(buf)))continue;
+      buf[strcspn(buf,"\n")]='\0';
+      (f==0 ? m_isolatedList : m_nohzList)=buf;
+      int cpu[MAX_CPU];
+      int n=parseCpuList(buf,cpu,MAX_CPU);
+      for(int i=0;i<n;i++)
+        if(cpu[i]<m_nCpu)m_isolated[cpu[i]]=true;
+    }
+  }
+
+  bool CpuTopology::isSibling(int cpu1, int cpu2) throw()
+  {
+    return getCore(cpu1)==getCore(cpu2);
+  }
+
+  bool CpuTopology::isIsolated(int cpu) throw()
+  {
+    if(cpu<0 || cpu>=m_nCpu)return false;
+    return m_isolated[cpu];
+  }
+
+  int CpuTopology::nicNode(const char *addr, std::string &ifName)
+  {
+    ifName="";
+    //****** the kernel picks the source address of the route to addr ******
+    struct sockaddr_in to;
+    memset(&to,0,sizeof(to));
+    to.sin_family=AF_INET;
+    to.sin_port=htons(9);
+    if(inet_aton(addr,&to.sin_addr)==0)return -1;
+    int fd=socket(AF_INET,SOCK_DGRAM,0);
+    if(fd<0)return -1;
+    struct sockaddr_in local;
+    socklen_t len=sizeof(local);
+    bool ok=(connect(fd,(struct sockaddr *)&to,sizeof(to))==0
+             && getsockname(fd,(struct sockaddr *)&local,&len)==0);
+    close(fd);
+    if(!ok)return -1;
+
+    //****** NIC of the source address ******
+    struct ifaddrs *ifa;
+    if(getifaddrs(&ifa)!=0)return -1;
+    for(struct ifaddrs *p=ifa;p!=NULL;p=p->ifa_next)
+    {
+      if(p->ifa_addr==NULL || p->ifa_addr->sa_family!=AF_INET)continue;
+      if(((struct sockaddr_in *)p->ifa_addr)->sin_addr.s_addr==local.sin_addr.s_addr)
+      {
+        ifName=p->ifa_name;
+        break;
+      }
+    }
+    freeifaddrs(ifa);
+    if(ifName.length()==0)return -1;
+    char path[128];
+    char buf[32];
+    snprintf(path,sizeof(path),"/sys/class/net/%s/device/numa_node",ifName.c_str());
+    if(!readLine(path,buf,sizeof(buf)))return -1;
+    return atoi(buf);
+  }
+
+  int CpuTopology::parseCpuList(const char *list, int *cpu, int max)
+  {
+    int n=0;
+    const char *p=list;
+    while(*p!='\0')
+    {
+      char *end;
+      int from=strtol(p,&end,10);
+      int to=from;
+      if(end==p)return -1;
+      if(*end=='-')
+      {
+        p=end+1;
+        to=strtol(p,&end,10);
+        if(end==p)return -1;
+      }
+      if(from<0 || to<from)return -1;
+      for(int i=from;i<=to && n<max;i++)cpu[n++]=i;
+      p=end;
+      if(*p==',')p++;
+      else if(*p!='\0')return -1;
+    }
+    return n;
+  }
+
+  int CpuTopology::getNnode() throw()
+  {
+    return m_nNode;
+  }
+  int CpuTopology::getNode(int cpu) throw()
+  {
+    if(cpu<0 || cpu>=m_nCpu)return 0;
+    return m_node[cpu];
+  }
+  int CpuTopology::getCore(int cpu) throw()
+  {
+    if(cpu<0 || cpu>=m_nCpu)return cpu;
+    return m_core[cpu];
+  }
+  const char *CpuTopology::getIsolatedList() throw()
+  {
+    return m_isolatedList.c_str();
+  }
+  const char *CpuTopology::getNohzList() throw()
+  {
+    return m_nohzList.c_str();
+  }
+}
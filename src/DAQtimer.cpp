@@ -15,8 +15,9 @@
 #include <fstream>
 #include <sstream>
 ///////////////////////////////////////////////////////////////////////////////////////////
-// clock_gettime(CLOCK_REALTIME) is not available on Mac OSX.
+// clock_gettime(CLOCK_MONOTONIC) is not available on Mac OSX.
 // instead, this is imported from https://gist.github.com/jbenet/1087739
+// The monotonic clock is not moved by NTP nor by the date set by hand during the run.
 ///////////////////////////////////////////////////////////////////////////////////////////
 //****************************************************
 #ifdef __MACH__
@@ -24,18 +25,18 @@
 #include <mach/mach.h>
 #endif
 
-void current_utc_time(struct timespec *ts) {
+void current_monotonic_time(struct timespec *ts) {
   
 #ifdef __MACH__ // OS X does not have clock_gettime, use clock_get_time
   clock_serv_t cclock;
   mach_timespec_t mts;
-  host_get_clock_service(mach_host_self(), CALENDAR_CLOCK, &cclock);
+  host_get_clock_service(mach_host_self(), SYSTEM_CLOCK, &cclock);
   clock_get_time(cclock, &mts);
   mach_port_deallocate(mach_task_self(), cclock);
   ts->tv_sec = mts.tv_sec;
   ts->tv_nsec = mts.tv_nsec;
 #else
-  clock_gettime(CLOCK_REALTIME, ts);
+  clock_gettime(CLOCK_MONOTONIC, ts);
 #endif
 }
 //****************************************************
@@ -45,8 +46,8 @@ namespace LSTDAQ{
     m_nServ = nServ;
     tv.tv_sec = 0;
     tv.tv_usec = 10000;
-    for(int i=0;i<1000;i++)
-      lltime_diff[i]=0;
+    readcount = 0;
+    llstartdiffusec = 0;
   }
   DAQtimer::~DAQtimer() throw()
   {
@@ -62,30 +63,47 @@ namespace LSTDAQ{
     return( (llEnd - llStart)/1000 );
   }
   ///////////////////////////////////////////////////////////////////////////////////////////
-  // clock_gettime(CLOCK_REALTIME) is not available on Mac OSX.
+  // clock_gettime(CLOCK_MONOTONIC) is not available on Mac OSX.
   ///////////////////////////////////////////////////////////////////////////////////////////
   void DAQtimer::DAQstart()
   {
-    //clock_gettime(CLOCK_REALTIME,&tsStart);
-    current_utc_time(&tsStart);
+    current_monotonic_time(&tsStart);
     tsctime1=tsStart;
+    tsBegin=tsStart;
     readcount =0;
+    llstartdiffusec =0;
+    m_interval.reset();
+    m_latency.reset();
+  }
+  void DAQtimer::readbegin()
+  {
+    current_monotonic_time(&tsBegin);
   }
   void DAQtimer::readend()
   {
-    //clock_gettime(CLOCK_REALTIME,&tsctime2);
-    current_utc_time(&tsctime2);
-    if(readcount<1000)
-    {
-      lltime_diff[readcount] = GetRealTimeInterval(&tsctime1,&tsctime2);
-      tsctime1=tsctime2;
-    }
+    current_monotonic_time(&tsctime2);
+    unsigned long long interval=(tsctime2.tv_sec-tsctime1.tv_sec)*1000000000LL+(tsctime2.tv_nsec-tsctime1.tv_nsec);
+    //the 1st event includes the start of the FEBs
+    if(readcount==0)
+      llstartdiffusec=interval/1000;
+    else
+      m_interval.record(interval);
+    m_latency.record((tsctime2.tv_sec-tsBegin.tv_sec)*1000000000LL+(tsctime2.tv_nsec-tsBegin.tv_nsec));
+    tsctime1=tsctime2;
     readcount++;
   }
   void DAQtimer::DAQend()
   {
-    //clock_gettime(CLOCK_REALTIME,&tsEnd);
-    current_utc_time(&tsEnd);
+    current_monotonic_time(&tsEnd);
+  }
+  void DAQtimer::printHisto(const char *title, LatencyHistogram *histo)
+  {
+    std::cout<<title
+	     <<" p50="<<histo->getPercentile(0.5)/1000.
+	     <<" p99="<<histo->getPercentile(0.99)/1000.
+	     <<" p99.9="<<histo->getPercentile(0.999)/1000.
+	     <<" max="<<histo->getMax()/1000.
+	     <<" [usec]"<<std::endl;
   }
   void DAQtimer::DAQsummary(int infreq, 
 			    unsigned long long NreadAll,
@@ -98,7 +116,7 @@ namespace LSTDAQ{
     //requisition time
     unsigned long long llreq_usec = GetRealTimeInterval(&tsStart,&tsEnd);
     //daq time (from 2nd to DAQ_NEVENTth events)
-    unsigned long long lldaq_usec = llreq_usec - lltime_diff[0];
+    unsigned long long lldaq_usec = llreq_usec - llstartdiffusec;
     std::cout<<"readcount:"<<readcount<<std::endl;
     std::cout<<"NreadAll :"<<NreadAll<<std::endl;
     std::cout<<"readcount*nRB="<<readcount*nRB<<std::endl;
@@ -112,6 +130,8 @@ namespace LSTDAQ{
     std::cout<<"Read Freq :"<<readfreq<<"[Hz]"<<std::endl;
     std::cout<<"Read Rate :"<<readrate<<"[Mbps]"<<std::endl;
     std::cout<<"Throughput:"<<thruput<<"[Gbps]"<<std::endl;
+    printHisto("Build interval:",&m_interval);
+    printHisto("Event latency :",&m_latency);
     
     
     //**** file create
@@ -131,6 +151,8 @@ namespace LSTDAQ{
         m_fout<<" Ntrg["<< std::setw(2)<< std::setfill(' ')<< std::fixed<< std::setprecision(0)<<i<<"]";
       }
       m_fout<<" readcount";
+      m_fout<<" Int50[us] Int99[us] Int999[us] IntMax[us]";
+      m_fout<<" Lat50[us] Lat99[us] Lat999[us] LatMax[us]";
       m_fout<<std::endl;
       std::cout<<"New measurement file is created. "<<std::endl;
     }
@@ -157,7 +179,21 @@ namespace LSTDAQ{
     }
     m_fout
     << std::setw(8)  << std::setfill(' ')<< std::fixed<< std::setprecision(0)
-    << readcount      <<"\n";
+    << readcount      <<" ";
+    LatencyHistogram *histo[2]={&m_interval,&m_latency};
+    for(int h=0;h<2;h++)
+    {
+      m_fout
+      << std::setw(9)  << std::setfill(' ')<< std::fixed<< std::setprecision(1)
+      << histo[h]->getPercentile(0.5)/1000.   << " "
+      << std::setw(9)  << std::setfill(' ')<< std::fixed<< std::setprecision(1)
+      << histo[h]->getPercentile(0.99)/1000.  << " "
+      << std::setw(10) << std::setfill(' ')<< std::fixed<< std::setprecision(1)
+      << histo[h]->getPercentile(0.999)/1000. << " "
+      << std::setw(10) << std::setfill(' ')<< std::fixed<< std::setprecision(1)
+      << histo[h]->getMax()/1000.             << " ";
+    }
+    m_fout<<"\n";
     m_fout.close();
   }
   
@@ -231,7 +267,7 @@ namespace LSTDAQ{
     //requisition time
     unsigned long long llreq_usec = GetRealTimeInterval(&tsStart,&tsEnd);
     //daq time (from 2nd to DAQ_NEVENTth events)
-    unsigned long long lldaq_usec = llreq_usec - lltime_diff[0];
+    unsigned long long lldaq_usec = llreq_usec - llstartdiffusec;
     
     // std::cout<<nEvent<<"events read."<<std::endl;
     // std::cout<<"duration for requisition :"<<llreq_usec<<"usec"<<std::endl;
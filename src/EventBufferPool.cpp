@@ -0,0 +1,172 @@
+#include "EventBufferPool.hpp"
+#include <iostream>
+#include <stdlib.h>//posix_memalign, exit(1)
+#include <time.h>
+
+//****************************************************
+// time calc
+//****************************************************
+static unsigned long long usecSince(const struct timespec *pFrom)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC,&now);
+  return ((unsigned long long)(now.tv_sec - pFrom->tv_sec)*1000000ULL
+          + (unsigned long long)now.tv_nsec/1000ULL) - (unsigned long long)pFrom->tv_nsec/1000ULL;
+}
+
+namespace LSTDAQ{
+  EventBufferPool::EventBufferPool(int nBuffer, unsigned int size) throw()
+  {
+    pthread_mutex_init(&m_mutex,NULL);
+    pthread_cond_init(&m_condFree,NULL);
+    if(nBuffer<1)nBuffer=1;
+    m_nBuffer=nBuffer;
+    m_size=(size+WRITER_ALIGN-1)/WRITER_ALIGN*WRITER_ALIGN;
+    m_buffer=new EventBuffer[m_nBuffer];
+    m_free=new int[m_nBuffer];
+    for(int i=0;i<m_nBuffer;i++)
+    {
+      void *p,*q;
+      if(posix_memalign(&p,WRITER_ALIGN,m_size)!=0 || posix_memalign(&q,WRITER_ALIGN,m_size)!=0)
+      {
+        std::cout<<"EventBufferPool: buffer allocation error!!"<<std::endl;
+        exit(1);
+      }
+      EventBuffer &b=m_buffer[i];
+      initEventHeader(&b.header);
+      b.data=(unsigned char *)p;
+      b.spare=(unsigned char *)q;
+      b.timeNs=0;
+      b.pool=this;
+      b.index=i;
+      b.refCount=0;
+      //****** the first buffer is taken first ******
+      m_free[i]=m_nBuffer-1-i;
+    }
+    m_nFree=m_nBuffer;
+
+    m_nAcquire=0;
+    m_minFree=m_nBuffer;
+    m_nStall=0;
+    m_stallUsec=0;
+  }
+  EventBufferPool::~EventBufferPool() throw()
+  {
+    if(m_nFree!=m_nBuffer)
+      std::cout<<"EventBufferPool: "<<m_nBuffer-m_nFree<<" buffers are not released"<<std::endl;
+    for(int i=0;i<m_nBuffer;i++)
+    {
+      free(m_buffer[i].data);
+      free(m_buffer[i].spare);
+    }
+    delete[] m_free;
+    delete[] m_buffer;
+    pthread_cond_destroy(&m_condFree);
+    pthread_mutex_destroy(&m_mutex);
+  }
+
+  //****** called with m_mutex locked ******
+  EventBuffer *EventBufferPool::take()
+  {
+    EventBuffer *buf=&m_buffer[m_free[--m_nFree]];
+    if(m_nFree<m_minFree)m_minFree=m_nFree;
+    m_nAcquire++;
+    buf->refCount=1;
+    return buf;
+  }
+
+  EventBuffer *EventBufferPool::acquire(bool (*stopped)())
+  {
+    pthread_mutex_lock(&m_mutex);
+    if(m_nFree==0)
+    {
+      //****** all buffers in flight : builder stalls ******
+      struct timespec tsWait;
+      clock_gettime(CLOCK_MONOTONIC,&tsWait);
+      while(m_nFree==0)
+      {
+        if(stopped==NULL)
+        {
+          pthread_cond_wait(&m_condFree,&m_mutex);
+          continue;
+        }
+        //****** a consumer may never release : give up on stop ******
+        if(stopped())break;
+        struct timespec tsLimit;
+        clock_gettime(CLOCK_REALTIME,&tsLimit);
+        tsLimit.tv_nsec+=EVENTPOOL_POLL_MSEC*1000000L;
+        tsLimit.tv_sec+=tsLimit.tv_nsec/1000000000L;
+        tsLimit.tv_nsec%=1000000000L;
+        pthread_cond_timedwait(&m_condFree,&m_mutex,&tsLimit);
+      }
+      m_nStall++;
+      m_stallUsec+=usecSince(&tsWait);
+      if(m_nFree==0)
+      {
+        pthread_mutex_unlock(&m_mutex);
+        return NULL;
+      }
+    }
+    EventBuffer *buf=take();
+    pthread_mutex_unlock(&m_mutex);
+    return buf;
+  }
+
+  EventBuffer *EventBufferPool::tryAcquire()
+  {
+    EventBuffer *buf=NULL;
+    pthread_mutex_lock(&m_mutex);
+    if(m_nFree>0)buf=take();
+    pthread_mutex_unlock(&m_mutex);
+    return buf;
+  }
+
+  void EventBufferPool::addRef(EventBuffer *buf)
+  {
+    __sync_add_and_fetch(&buf->refCount,1);
+  }
+
+  void EventBufferPool::release(EventBuffer *buf)
+  {
+    if(__sync_sub_and_fetch(&buf->refCount,1)==0)
+      buf->pool->put(buf);
+  }
+
+  void EventBufferPool::put(EventBuffer *buf)
+  {
+    pthread_mutex_lock(&m_mutex);
+    m_free[m_nFree++]=buf->index;
+    pthread_cond_signal(&m_condFree);
+    pthread_mutex_unlock(&m_mutex);
+  }
+
+  int EventBufferPool::getNbuffer() throw()
+  {
+    return m_nBuffer;
+  }
+  int EventBufferPool::getNfree() throw()
+  {
+    return m_nFree;
+  }
+  unsigned int EventBufferPool::getBufferSize() throw()
+  {
+    return m_size;
+  }
+  unsigned long EventBufferPool::getNstall() throw()
+  {
+    return m_nStall;
+  }
+  unsigned long long EventBufferPool::getStallUsec() throw()
+  {
+    return m_stallUsec;
+  }
+
+  void EventBufferPool::printSummary()
+  {
+    std::cout<<" Event Buffer Pool Summary "<<std::endl;
+    std::cout<<"buffers             :"<<m_nBuffer<<" x "<<m_size/1024<<"kB x 2"<<std::endl;
+    std::cout<<"events              :"<<m_nAcquire<<std::endl;
+    std::cout<<"max in use          :"<<m_nBuffer-m_minFree<<std::endl;
+    std::cout<<"builder stall       :"<<m_nStall<<" times, "<<m_stallUsec<<"usec"<<std::endl;
+  }
+}
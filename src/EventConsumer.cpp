@@ -0,0 +1,19 @@
+#include "EventConsumer.hpp"
+
+namespace LSTDAQ{
+  EventConsumer::EventConsumer() throw()
+  {
+  }
+  EventConsumer::~EventConsumer() throw()
+  {
+  }
+  void EventConsumer::init()
+  {
+  }
+  void EventConsumer::finish()
+  {
+  }
+  void EventConsumer::printSummary()
+  {
+  }
+}
@@ -0,0 +1,159 @@
+#include "EventDispatcher.hpp"
+#include <iostream>
+#include <stdio.h> //printf
+#include <stdlib.h>//exit(1)
+#include <unistd.h>//usleep
+#include <time.h>
+
+//****************************************************
+// time calc
+//****************************************************
+static unsigned long long usecSince(const struct timespec *pFrom)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC,&now);
+  return ((unsigned long long)(now.tv_sec - pFrom->tv_sec)*1000000ULL
+          + (unsigned long long)now.tv_nsec/1000ULL) - (unsigned long long)pFrom->tv_nsec/1000ULL;
+}
+
+namespace LSTDAQ{
+  EventDispatcher::EventDispatcher() throw()
+  {
+    m_nQueue=0;
+    m_running=false;
+    m_closing=false;
+  }
+  EventDispatcher::~EventDispatcher() throw()
+  {
+    close();
+    for(int i=0;i<m_nQueue;i++)
+    {
+      delete[] m_queue[i].ring;
+      delete m_queue[i].consumer;
+    }
+  }
+
+  void EventDispatcher::addConsumer(EventConsumer *consumer, int policy, int prescale, int depth)
+  {
+    if(m_nQueue==MAX_CONSUMER)
+    {
+      std::cout<<"The number of event consumers excessed limit."<<std::endl;
+      exit(1);
+    }
+    if(prescale<1)prescale=1;
+    if(depth<1)depth=1;
+    Queue &q=m_queue[m_nQueue++];
+    q.owner=this;
+    q.consumer=consumer;
+    q.policy=policy;
+    q.prescale=prescale;
+    q.depth=depth;
+    q.ring=new EventBuffer*[depth];
+    q.head=0;
+    q.tail=0;
+    q.nOffer=0;
+    q.nPush=0;
+    q.nDrop=0;
+    q.nStall=0;
+    q.stallUsec=0;
+  }
+  int EventDispatcher::getNconsumer() throw()
+  {
+    return m_nQueue;
+  }
+  int EventDispatcher::getNbufferHeld() throw()
+  {
+    //****** the queued events plus the one being consumed ******
+    int n=0;
+    for(int i=0;i<m_nQueue;i++)n+=m_queue[i].depth+1;
+    return n;
+  }
+
+  bool EventDispatcher::start()
+  {
+    m_closing=false;
+    m_running=true;
+    for(int i=0;i<m_nQueue;i++)
+      pthread_create(&m_queue[i].thread,NULL,&EventDispatcher::consumer_thread,&m_queue[i]);
+    return true;
+  }
+
+  void EventDispatcher::publish(EventBuffer *buf)
+  {
+    for(int i=0;i<m_nQueue;i++)
+    {
+      Queue &q=m_queue[i];
+      if(q.nOffer++%q.prescale!=0)continue;
+      if(q.head-q.tail==q.depth)
+      {
+        if(q.policy==DISPATCH_DROP)
+        {
+          q.nDrop++;
+          continue;
+        }
+        //****** lossless consumer is behind : publisher stalls ******
+        struct timespec tsWait;
+        clock_gettime(CLOCK_MONOTONIC,&tsWait);
+        while(q.head-q.tail==q.depth)usleep(DISPATCH_POLL_USEC);
+        q.nStall++;
+        q.stallUsec+=usecSince(&tsWait);
+      }
+      EventBufferPool::addRef(buf);
+      q.ring[q.head%q.depth]=buf;
+      __sync_synchronize();
+      q.head++;
+      q.nPush++;
+    }
+  }
+
+  void EventDispatcher::close()
+  {
+    if(!m_running)return;
+    m_closing=true;
+    for(int i=0;i<m_nQueue;i++)pthread_join(m_queue[i].thread,NULL);
+    m_running=false;
+  }
+
+  void *EventDispatcher::consumer_thread(void *arg)
+  {
+    Queue *q=(Queue *)arg;
+    q->owner->runConsumer(q);
+    return NULL;
+  }
+
+  void EventDispatcher::runConsumer(Queue *q)
+  {
+    q->consumer->init();
+    while(1)
+    {
+      if(q->tail==q->head)
+      {
+        if(m_closing && q->tail==q->head)break;
+        usleep(DISPATCH_POLL_USEC);
+        continue;
+      }
+      __sync_synchronize();
+      EventBuffer *buf=q->ring[q->tail%q->depth];
+      q->consumer->consume(buf);
+      EventBufferPool::release(buf);
+      __sync_synchronize();
+      q->tail++;
+    }
+    q->consumer->finish();
+  }
+
+  void EventDispatcher::printSummary()
+  {
+    std::cout<<" Event Dispatcher Summary "<<std::endl;
+    for(int i=0;i<m_nQueue;i++)
+    {
+      Queue &q=m_queue[i];
+      printf("consumer %-11s:%llu events (1/%d of %llu, %llu dropped), %s, depth %u\n",
+             q.consumer->getName(),q.nPush,q.prescale,q.nOffer,q.nDrop,
+             q.policy==DISPATCH_BLOCK ? "lossless" : "drop when full",q.depth);
+      if(q.nStall>0)
+        std::cout<<"publisher stall     :"<<q.nStall<<" times, "<<q.stallUsec<<"usec"<<std::endl;
+      q.consumer->printSummary();
+    }
+  }
+}
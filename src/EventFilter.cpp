@@ -0,0 +1,81 @@
+#include "EventFilter.hpp"
+#include <stdio.h> //sprintf, sscanf
+#include <string>
+
+namespace LSTDAQ{
+  //****************************************************
+  // EventFilter
+  //****************************************************
+  EventFilter::EventFilter() throw()
+  {
+  }
+  EventFilter::~EventFilter() throw()
+  {
+  }
+  EventFilter *EventFilter::create(const char *spec)
+  {
+    char type[8];
+    int threshold,n;
+    if(sscanf(spec,"%4[a-z]:%d:%d",type,&threshold,&n)!=3 || n<1)return NULL;
+    std::string t(type);
+    if(t=="mult")return new MultiplicityFilter(threshold,n);
+    if(t=="topo")return new TopologyFilter(threshold,n);
+    return NULL;
+  }
+
+  //****************************************************
+  // MultiplicityFilter
+  //****************************************************
+  MultiplicityFilter::MultiplicityFilter(int threshold, int n) throw():m_threshold(threshold),m_n(n)
+  {
+    sprintf(m_name,"mult(%d,%d)",threshold,n);
+  }
+  MultiplicityFilter::~MultiplicityFilter() throw()
+  {
+  }
+  const char *MultiplicityFilter::getName()
+  {
+    return m_name;
+  }
+  bool MultiplicityFilter::accept(const int *charge, int nModule, unsigned long long missing)
+  {
+    int n=0;
+    for(int m=0;m<nModule;m++)
+    {
+      if(m<64 && (missing>>m&1))continue;
+      for(int c=0;c<NCHANNEL;c++)
+        n+=(charge[m*NCHANNEL+c]>=m_threshold);
+    }
+    return n>=m_n;
+  }
+
+  //****************************************************
+  // TopologyFilter
+  //****************************************************
+  TopologyFilter::TopologyFilter(int threshold, int n) throw():m_threshold(threshold),m_n(n)
+  {
+    sprintf(m_name,"topo(%d,%d)",threshold,n);
+  }
+  TopologyFilter::~TopologyFilter() throw()
+  {
+  }
+  const char *TopologyFilter::getName()
+  {
+    return m_name;
+  }
+  bool TopologyFilter::accept(const int *charge, int nModule, unsigned long long missing)
+  {
+    for(int m=0;m<nModule;m++)
+    {
+      if(m<64 && (missing>>m&1))continue;
+      unsigned int mask=0;
+      for(int c=0;c<NCHANNEL;c++)
+        if(charge[m*NCHANNEL+c]>=m_threshold)mask|=1<<c;
+      //****** a run of n set bits survives n-1 shifted ANDs ******
+      unsigned int run=mask;
+      for(int i=1;i<m_n && run!=0;i++)run&=mask>>i;
+      if(run!=0)return true;
+    }
+    return false;
+  }
+}
@@ -0,0 +1,91 @@
+#include "EventMonitor.hpp"
+#include <iostream>
+#include <stdio.h> //printf
+#include <string.h>//memset
+
+namespace LSTDAQ{
+  EventMonitor::EventMonitor() throw()
+  {
+    init();
+  }
+  EventMonitor::~EventMonitor() throw()
+  {
+  }
+
+  const char *EventMonitor::getName()
+  {
+    return "monitor";
+  }
+
+  void EventMonitor::init()
+  {
+    m_nEvent=0;
+    m_nSampled=0;
+    m_bytes=0;
+    m_firstTrigger=0;
+    m_lastTrigger=0;
+    m_nModule=0;
+    memset(m_nMissing,0,sizeof(m_nMissing));
+    memset(m_sum,0,sizeof(m_sum));
+    memset(m_nSample,0,sizeof(m_nSample));
+  }
+
+  unsigned int EventMonitor::sumModule(const unsigned char *module, int nGain, unsigned long long *sum)
+  {
+    //****** first stored gain of sample s is at line LINE_WAVEFORM+nGain*s ******
+    //the samples are big endian
+    unsigned long long s=0;
+    for(int i=0;i<READDEPTH;i++)
+    {
+      const unsigned char *line=module+(LINE_WAVEFORM+nGain*i)*LINESIZE;
+      for(int c=0;c<NCHANNEL;c++)
+        s+=(line[2*c]<<8)|line[2*c+1];
+    }
+    *sum+=s;
+    return READDEPTH*NCHANNEL;
+  }
+
+  void EventMonitor::consume(const EventBuffer *buf)
+  {
+    const EventHeader *h=&buf->header;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    if(m_nEvent==0)
+    {
+      m_tsFirst=now;
+      m_firstTrigger=h->trigger;
+    }
+    m_tsLast=now;
+    m_lastTrigger=h->trigger;
+    m_nEvent++;
+    m_bytes+=sizeof(EventHeader)+h->size;
+    int nModule=h->nModule<MAX_CONNECTION ? h->nModule : MAX_CONNECTION;
+    if(nModule>m_nModule)m_nModule=nModule;
+    for(int m=0;m<nModule;m++)
+      if(m<64 && (h->missing>>m)&1)m_nMissing[m]++;
+
+    if(h->flags&(EVFMT_ENCODED|EVFMT_ZS|EVFMT_DL1|EVFMT_SOA))return;
+    int nGain=getNgainStored(h->flags);
+    unsigned int prefix=getPrefixSize(h->flags,h->nModule);
+    unsigned int moduleSize=getModuleSize(h->flags);
+    for(int m=0;m<nModule;m++)
+    {
+      if(m<64 && (h->missing>>m)&1)continue;
+      const unsigned char *module=buf->data+prefix+(unsigned long)m*moduleSize;
+      m_nSample[m]+=sumModule(module,nGain,&m_sum[m]);
+    }
+    m_nSampled++;
+  }
+
+  void EventMonitor::printSummary()
+  {
+    double sec=(m_tsLast.tv_sec-m_tsFirst.tv_sec)+(m_tsLast.tv_nsec-m_tsFirst.tv_nsec)*1e-9;
+    std::cout<<"monitored events    :"<<m_nEvent<<" (trigger "<<m_firstTrigger<<" - "<<m_lastTrigger<<")"<<std::endl;
+    if(m_nEvent>1 && sec>0)
+      printf("monitored rate      :%.1f events/s, %.2f MB/s\n",(m_nEvent-1)/sec,m_bytes/sec/1e6);
+    if(m_nSampled==0)return;
+    std::cout<<"module  missing  mean"<<std::endl;
+    for(int m=0;m<m_nModule;m++)
+      printf("%6d %8llu %7.1f\n",m,m_nMissing[m],m_nSample[m]>0 ? (double)m_sum[m]/m_nSample[m] : 0.);
+  }
+}
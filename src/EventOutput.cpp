@@ -0,0 +1,272 @@
+#include "EventOutput.hpp"
+#include <iostream>
+#include <sstream>
+#include <stdio.h>  //sprintf
+#include <stdlib.h> //exit(1)
+
+namespace LSTDAQ{
+  EventOutput::EventOutput(unsigned long blockSize, int nBlock, int engine, int qdepth) throw()
+  {
+    m_blockSize=blockSize;
+    m_nBlock=nBlock;
+    m_engine=engine;
+    m_qdepth=qdepth;
+    m_nDir=0;
+    m_nStripe=0;
+    m_chunk=0;
+    m_cur=0;
+    m_curBytes=0;
+    m_index=NULL;
+    m_rotateSec=0;
+    m_rotateBytes=0;
+    m_nFile=0;
+    m_fileBytes=0;
+    pthread_mutex_init(&m_mutex,NULL);
+    for(int i=0;i<MAX_STRIPE;i++)
+    {
+      m_writer[i]=NULL;
+      m_fileIndex[i]=NULL;
+    }
+  }
+  EventOutput::~EventOutput() throw()
+  {
+    close();
+    for(int i=0;i<m_nStripe;i++)
+    {
+      delete m_writer[i];
+      delete m_fileIndex[i];
+    }
+    delete m_index;
+    pthread_mutex_destroy(&m_mutex);
+  }
+
+  int EventOutput::setDirectories(const char *dirList, unsigned long chunkMB)
+  {
+    std::istringstream iss(dirList);
+    std::string dir;
+    m_nDir=0;
+    while(std::getline(iss,dir,','))
+    {
+      if(dir.length()==0)continue;
+      if(m_nDir==MAX_STRIPE)
+      {
+        std::cout<<"The number of output directories excessed limit."<<std::endl;
+        exit(1);
+      }
+      m_dir[m_nDir++]=dir;
+    }
+    m_chunk=(unsigned long long)chunkMB*1024*1024;
+    return m_nDir;
+  }
+
+  void EventOutput::setRotation(double sec, double gb)
+  {
+    m_rotateSec=sec;
+    m_rotateBytes=(unsigned long long)(gb*1024.*1024.*1024.);
+  }
+
+  //****************************************************
+  // name of the file of stripe (or -1 for the stripe index) in the current period
+  //****************************************************
+  void EventOutput::makeName(char *buf, int stripe, const char *ext)
+  {
+    char base[512];
+    if(m_rotateSec>0 || m_rotateBytes>0)
+      sprintf(base,"%s_f%04d",m_baseName.c_str(),m_nFile);
+    else
+      sprintf(base,"%s",m_baseName.c_str());
+
+    if(m_nDir==0)
+      sprintf(buf,"%s.%s",base,ext);
+    else if(m_nDir==1 || stripe<0)
+      sprintf(buf,"%s/%s.%s",m_dir[0].c_str(),base,ext);
+    else
+      sprintf(buf,"%s/%s_s%02d.%s",m_dir[stripe].c_str(),base,stripe,ext);
+  }
+
+  bool EventOutput::open(const char *baseName)
+  {
+    char buf[512];
+    m_baseName=baseName;
+    m_nFile=0;
+    m_nStripe = m_nDir>1 ? m_nDir : 1;
+    for(int i=0;i<m_nStripe;i++)
+    {
+      makeName(buf,i,"dat");
+      m_writer[i]=new EventWriter(m_blockSize,m_nBlock,m_engine,m_qdepth);
+      if(m_rotateBytes>0)m_writer[i]->setPreallocate(m_rotateBytes/m_nStripe);
+      if(i==0 && m_rotateSec>0)m_writer[i]->setIdleHandler(&EventOutput::idle,this);
+      if(!m_writer[i]->open(buf))
+      {
+        std::cout<<"output file open error!! : "<<buf<<std::endl;
+        return false;
+      }
+      makeName(buf,i,"idx");
+      m_fileIndex[i]=new EventWriter(INDEX_BLOCKSIZE,2,OUTPUT_ENGINE_BUFFERED,1);
+      if(!m_fileIndex[i]->open(buf))
+      {
+        std::cout<<"index file open error!! : "<<buf<<std::endl;
+        return false;
+      }
+      startIndex(i);
+    }
+    if(m_nStripe>1)
+    {
+      //****** stripe index : small, always buffered ******
+      makeName(buf,-1,"sidx");
+      m_index=new EventWriter(INDEX_BLOCKSIZE,2,OUTPUT_ENGINE_BUFFERED,1);
+      if(!m_index->open(buf))
+      {
+        std::cout<<"index file open error!! : "<<buf<<std::endl;
+        return false;
+      }
+    }
+    m_cur=0;
+    m_curBytes=0;
+    m_fileBytes=0;
+    clock_gettime(CLOCK_MONOTONIC,&m_tsFile);
+    return true;
+  }
+
+  //****************************************************
+  // switch all the files to the next period
+  //****************************************************
+  void EventOutput::rotate()
+  {
+    char buf[512];
+    m_nFile++;
+    for(int i=0;i<m_nStripe;i++)
+    {
+      makeName(buf,i,"dat");
+      m_writer[i]->rotate(buf);
+      makeName(buf,i,"idx");
+      m_fileIndex[i]->rotate(buf);
+      startIndex(i);
+    }
+    if(m_index!=NULL)
+    {
+      makeName(buf,-1,"sidx");
+      m_index->rotate(buf);
+    }
+    m_cur=0;
+    m_curBytes=0;
+    m_fileBytes=0;
+    clock_gettime(CLOCK_MONOTONIC,&m_tsFile);
+  }
+
+  bool EventOutput::rotationDue()
+  {
+    if(m_rotateSec<=0)return false;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ((ts.tv_sec-m_tsFile.tv_sec)+(ts.tv_nsec-m_tsFile.tv_nsec)*1e-9>=m_rotateSec);
+  }
+
+  //****************************************************
+  // called by the writer thread of stripe 0 while it is idle
+  //****************************************************
+  void EventOutput::idle(void *arg)
+  {
+    EventOutput *out=(EventOutput *)arg;
+    //****** events are being written : write() rotates by itself ******
+    if(pthread_mutex_trylock(&out->m_mutex)!=0)return;
+    if(out->m_fileBytes>0 && out->rotationDue())out->rotate();
+    pthread_mutex_unlock(&out->m_mutex);
+  }
+
+  //****************************************************
+  // header of the event index of a new file
+  //****************************************************
+  void EventOutput::startIndex(int stripe)
+  {
+    EventIndexHeader ih;
+    initEventIndexHeader(&ih);
+    m_fileIndex[stripe]->write(&ih,sizeof(ih),NULL,0);
+  }
+
+  int EventOutput::write(const EventHeader *header, const void *data, unsigned long long timeNs)
+  {
+    unsigned int hlen=sizeof(EventHeader);
+    unsigned int dlen=header->size;
+    pthread_mutex_lock(&m_mutex);
+    //****** rotation at the event boundary ******
+    if(m_fileBytes>0)
+    {
+      if(m_rotateBytes>0 && m_fileBytes+hlen+dlen>m_rotateBytes)
+        rotate();
+      else if(rotationDue())
+        rotate();
+    }
+    m_fileBytes+=hlen+dlen;
+
+    //****** choose the stripe ******
+    if(m_nStripe>1 && (m_chunk==0 || m_curBytes>=m_chunk))
+    {
+      if(m_curBytes>0)m_cur=(m_cur+1)%m_nStripe;
+      m_curBytes=0;
+    }
+    EventIndexEntry ent;
+    ent.trigger=header->trigger;
+    ent.offset=m_writer[m_cur]->getFileOffset();
+    ent.timeNs=timeNs;
+    ent.missing=header->missing;
+    if(m_index!=NULL)
+    {
+      StripeIndexEntry sent;
+      sent.trigger=header->trigger;
+      sent.stripe=m_cur;
+      sent.size=hlen+dlen;
+      sent.offset=ent.offset;
+      m_index->write(&sent,sizeof(sent),NULL,0);
+    }
+    int ret=m_writer[m_cur]->write(header,hlen,data,dlen);
+    m_curBytes+=hlen+dlen;
+    m_fileIndex[m_cur]->write(&ent,sizeof(ent),NULL,0);
+    pthread_mutex_unlock(&m_mutex);
+    return ret;
+  }
+
+  void EventOutput::close()
+  {
+    pthread_mutex_lock(&m_mutex);
+    for(int i=0;i<m_nStripe;i++)
+    {
+      m_writer[i]->close();
+      m_fileIndex[i]->close();
+    }
+    if(m_index!=NULL)m_index->close();
+    pthread_mutex_unlock(&m_mutex);
+  }
+
+  unsigned long long EventOutput::getLagBytes() throw()
+  {
+    unsigned long long n=0;
+    for(int i=0;i<m_nStripe;i++)n+=m_writer[i]->getLagBytes();
+    return n;
+  }
+  unsigned long long EventOutput::getStallUsec() throw()
+  {
+    unsigned long long n=0;
+    for(int i=0;i<m_nStripe;i++)n+=m_writer[i]->getStallUsec();
+    return n;
+  }
+  int EventOutput::getNstripe() throw()
+  {
+    return m_nStripe;
+  }
+  int EventOutput::getNfile() throw()
+  {
+    return m_nFile+1;
+  }
+
+  void EventOutput::printSummary()
+  {
+    if(m_rotateSec>0 || m_rotateBytes>0)
+      std::cout<<" Output files : "<<m_nFile+1<<" periods"<<std::endl;
+    for(int i=0;i<m_nStripe;i++)
+    {
+      if(m_nStripe>1)std::cout<<" Stripe "<<i<<" ("<<m_dir[i]<<")"<<std::endl;
+      m_writer[i]->printSummary();
+    }
+  }
+}
@@ -0,0 +1,32 @@
+#include "EventProcessor.hpp"
+
+namespace LSTDAQ{
+  EventProcessor::EventProcessor() throw()
+  {
+  }
+  EventProcessor::~EventProcessor() throw()
+  {
+  }
+  unsigned int EventProcessor::getMaxSize(unsigned int inSize)
+  {
+    return inSize;
+  }
+  unsigned int EventProcessor::getSideSize(unsigned int inSize)
+  {
+    return 0;
+  }
+  bool EventProcessor::makeSide(const EventHeader *header, const unsigned char *data,
+                                EventHeader *sideHeader, unsigned char *side, int worker)
+  {
+    return false;
+  }
+  void EventProcessor::init(int nWorker)
+  {
+  }
+  void EventProcessor::finish()
+  {
+  }
+  void EventProcessor::printSummary()
+  {
+  }
+}
@@ -0,0 +1,164 @@
+#include "EventReader.hpp"
+#include "WaveformCodec.hpp"
+#include "Pack12.hpp"
+#include <iostream>
+#include <string>
+#include <fcntl.h>    //open
+#include <unistd.h>   //close
+#include <sys/mman.h> //mmap
+#include <sys/stat.h> //fstat
+
+namespace LSTDAQ{
+  EventReader::EventReader() throw():m_data(NULL),m_dataSize(0),m_idx(NULL),m_idxSize(0),m_entry(NULL),m_nEvent(0)
+  {
+  }
+  EventReader::~EventReader() throw()
+  {
+    close();
+  }
+
+  //****************************************************
+  // map the whole file read only
+  //****************************************************
+  const unsigned char *EventReader::mapFile(const char *fileName, size_t *size)
+  {
+    int fd=::open(fileName,O_RDONLY);
+    if(fd<0)return NULL;
+    struct stat st;
+    if(fstat(fd,&st)!=0 || st.st_size==0)
+    {
+      ::close(fd);
+      return NULL;
+    }
+    void *p=mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+    ::close(fd);
+    if(p==MAP_FAILED)return NULL;
+    *size=st.st_size;
+    return (const unsigned char *)p;
+  }
+
+  bool EventReader::open(const char *fileName)
+  {
+    close();
+    std::string idxName(fileName);
+    if(idxName.size()>4 && idxName.compare(idxName.size()-4,4,".dat")==0)
+      idxName.replace(idxName.size()-4,4,".idx");
+    else
+      idxName+=".idx";
+
+    m_data=mapFile(fileName,&m_dataSize);
+    m_idx=mapFile(idxName.c_str(),&m_idxSize);
+    if(m_data==NULL || m_idx==NULL)
+    {
+      std::cout<<"EventReader: cannot map "<<fileName<<" or "<<idxName<<std::endl;
+      close();
+      return false;
+    }
+    const EventIndexHeader *ih=(const EventIndexHeader *)m_idx;
+    if(m_idxSize<sizeof(EventIndexHeader) || memcmp(ih->magic,EVENT_INDEX_MAGIC,4)!=0
+       || ih->entrySize!=sizeof(EventIndexEntry))
+    {
+      std::cout<<"EventReader: broken index "<<idxName<<std::endl;
+      close();
+      return false;
+    }
+    m_entry=(const EventIndexEntry *)(m_idx+sizeof(EventIndexHeader));
+    m_nEvent=(m_idxSize-sizeof(EventIndexHeader))/sizeof(EventIndexEntry);
+
+    //****** drop the records of events not flushed to the .dat file ******
+    while(m_nEvent>0)
+    {
+      unsigned long long off=m_entry[m_nEvent-1].offset;
+      if(off+sizeof(EventHeader)<=m_dataSize
+         && off+sizeof(EventHeader)+((const EventHeader *)(m_data+off))->size<=m_dataSize)
+        break;
+      m_nEvent--;
+    }
+    return true;
+  }
+
+  void EventReader::close()
+  {
+    if(m_data!=NULL)munmap((void *)m_data,m_dataSize);
+    if(m_idx!=NULL)munmap((void *)m_idx,m_idxSize);
+    m_data=NULL;
+    m_idx=NULL;
+    m_entry=NULL;
+    m_dataSize=0;
+    m_idxSize=0;
+    m_nEvent=0;
+  }
+
+  unsigned long long EventReader::getNevent() throw()
+  {
+    return m_nEvent;
+  }
+
+  const EventIndexEntry *EventReader::getEntry(unsigned long long n) throw()
+  {
+    if(n>=m_nEvent)return NULL;
+    return &m_entry[n];
+  }
+
+  const EventHeader *EventReader::getEvent(unsigned long long n) throw()
+  {
+    if(n>=m_nEvent)return NULL;
+    return (const EventHeader *)(m_data+m_entry[n].offset);
+  }
+
+  int EventReader::readEvent(unsigned long long n, EventHeader *header, unsigned char *buf)
+  {
+    const EventHeader *h=getEvent(n);
+    if(h==NULL)return -1;
+    int size=decodePayload(h,(const unsigned char *)(h+1),buf);
+    if(size<0)return -1;
+    memcpy(header,h,sizeof(EventHeader));
+    header->flags&=~EVFMT_ENCODED;
+    header->size=size;
+    return size;
+  }
+
+  int EventReader::decodePayload(const EventHeader *header, const unsigned char *payload, unsigned char *buf)
+  {
+    unsigned int prefix=getPrefixSize(header->flags,header->nModule);
+    int nGain=getNgainStored(header->flags);
+    if(header->size<prefix)return -1;
+    memcpy(buf,payload,prefix);
+    int n;
+    switch(header->flags&EVFMT_ENCODED)
+    {
+    case 0:
+      memcpy(buf+prefix,payload+prefix,header->size-prefix);
+      n=header->size-prefix;
+      break;
+    case EVFMT_DELTA:
+      n=WaveformCodec::decode(payload+prefix,header->size-prefix,header->nModule,nGain,buf+prefix);
+      break;
+    case EVFMT_PACK12:
+      n=Pack12::decode(payload+prefix,header->size-prefix,header->nModule,nGain,buf+prefix);
+      break;
+    default:
+      return -1;
+    }
+    return n<0 ? -1 : (int)prefix+n;
+  }
+
+  long long EventReader::findTrigger(unsigned long long trigger) throw()
+  {
+    if(m_nEvent==0 || trigger<m_entry[0].trigger)return -1;
+    //****** no trigger skipped : direct hit ******
+    unsigned long long guess=trigger-m_entry[0].trigger;
+    if(guess<m_nEvent && m_entry[guess].trigger==trigger)return (long long)guess;
+
+    //****** binary search ******
+    unsigned long long lo=0,hi=m_nEvent;
+    while(lo<hi)
+    {
+      unsigned long long mid=(lo+hi)/2;
+      if(m_entry[mid].trigger<trigger)lo=mid+1;
+      else hi=mid;
+    }
+    if(lo<m_nEvent && m_entry[lo].trigger==trigger)return (long long)lo;
+    return -1;
+  }
+}
@@ -0,0 +1,367 @@
+#include "EventWriter.hpp"
+#include <iostream>
+#include <string.h>//memcpy
+#include <stdlib.h>//posix_memalign, exit(1)
+#include <errno.h> //ETIMEDOUT
+
+//****************************************************
+// time calc
+//****************************************************
+static unsigned long long usecSince(const struct timespec *pFrom)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC,&now);
+  return ((unsigned long long)(now.tv_sec - pFrom->tv_sec)*1000000ULL
+          + (unsigned long long)now.tv_nsec/1000ULL) - (unsigned long long)pFrom->tv_nsec/1000ULL;
+}
+
+namespace LSTDAQ{
+  EventWriter::EventWriter(unsigned long blockSize, int nBlock, int engine, int qdepth) throw()
+  {
+    pthread_mutex_init(&m_mutex,NULL);
+    pthread_cond_init(&m_condFull,NULL);
+    pthread_cond_init(&m_condFree,NULL);
+    m_running=false;
+    m_closing=false;
+    m_file=NULL;
+    m_prealloc=0;
+    m_idle=NULL;
+    m_idleArg=NULL;
+
+    if(nBlock<2)nBlock=2;
+    if(nBlock>WRITER_MAX_NBLOCK)nBlock=WRITER_MAX_NBLOCK;
+    m_nBlock=nBlock;
+    m_engine=engine;
+    if(qdepth<1)qdepth=1;
+    if(qdepth>m_nBlock-1)qdepth=m_nBlock-1;
+    m_qdepth=qdepth;
+    m_blockSize=(blockSize+WRITER_ALIGN-1)/WRITER_ALIGN*WRITER_ALIGN;
+    for(int i=0;i<m_nBlock;i++)
+    {
+      void *p;
+      if(posix_memalign(&p,WRITER_ALIGN,m_blockSize)!=0)
+      {
+        std::cout<<"EventWriter: block allocation error!!"<<std::endl;
+        exit(1);
+      }
+      m_block[i].buf=(unsigned char *)p;
+      m_block[i].used=0;
+    }
+    m_fill=0;
+    m_submit=0;
+    m_flush=0;
+    m_nFull=0;
+    m_nSealed=0;
+
+    m_nIn=0;
+    m_fileIn=0;
+    m_nOut=0;
+    m_nStall=0;
+    m_stallUsec=0;
+    m_maxStallUsec=0;
+    m_maxLagUsec=0;
+  }
+  EventWriter::~EventWriter() throw()
+  {
+    close();
+    delete m_file;
+    for(int i=0;i<m_nBlock;i++)
+      free(m_block[i].buf);
+    pthread_cond_destroy(&m_condFree);
+    pthread_cond_destroy(&m_condFull);
+    pthread_mutex_destroy(&m_mutex);
+  }
+
+  bool EventWriter::open(const char *fileName)
+  {
+    delete m_file;
+    m_file=OutputFile::create(m_engine,m_qdepth);
+    if(!m_file->open(fileName,m_prealloc))
+    {
+      if(m_engine==OUTPUT_ENGINE_BUFFERED)
+        return false;
+      //****** fallback to buffered writes ******
+      std::cout<<"EventWriter: "<<m_file->getName()<<" engine is not available for "<<fileName
+               <<". Fallback to buffered writes."<<std::endl;
+      delete m_file;
+      m_file=OutputFile::create(OUTPUT_ENGINE_BUFFERED,m_qdepth);
+      if(!m_file->open(fileName,m_prealloc))
+        return false;
+    }
+    for(int i=0;i<m_nBlock;i++)m_done[i]=false;
+    m_fileIn=0;
+    m_closing=false;
+    m_running=true;
+    pthread_create(&m_thread,NULL,&EventWriter::writer_thread,this);
+    return true;
+  }
+
+  int EventWriter::write(const void *header, unsigned int hlen, const void *data, unsigned int dlen)
+  {
+    put(header,hlen);
+    put(data,dlen);
+    //read by other threads through getNin()/getLagBytes()
+    __sync_add_and_fetch(&m_nIn,(unsigned long long)(hlen+dlen));
+    m_fileIn+=hlen+dlen;
+    return 0;
+  }
+
+  void EventWriter::setPreallocate(unsigned long long bytes)
+  {
+    m_prealloc=bytes;
+  }
+
+  void EventWriter::setIdleHandler(void (*handler)(void *), void *arg)
+  {
+    m_idle=handler;
+    m_idleArg=arg;
+  }
+
+  void EventWriter::rotate(const char *fileName)
+  {
+    //****** the current block, even empty, is the last one of the old file ******
+    m_block[m_fill].nextPath=fileName;
+    seal();
+    m_fileIn=0;
+  }
+
+  //****** called by the writer thread when all the writes to the old file have completed ******
+  void EventWriter::reopen(const char *fileName)
+  {
+    if(!m_file->close())
+      std::cout<<"EventWriter: output file close error!!"<<std::endl;
+    if(!m_file->open(fileName,m_prealloc))
+    {
+      std::cout<<"EventWriter: output file open error!! : "<<fileName<<std::endl;
+      exit(1);
+    }
+  }
+
+  void EventWriter::put(const void *buf, unsigned long len)
+  {
+    const unsigned char *p=(const unsigned char *)buf;
+    while(len>0)
+    {
+      Block &b=m_block[m_fill];
+      unsigned long n=m_blockSize-b.used;
+      if(n>len)n=len;
+      memcpy(b.buf+b.used,p,n);
+      b.used+=n;
+      p+=n;
+      len-=n;
+      if(b.used==m_blockSize)seal();
+    }
+  }
+
+  //****** pass the current block to the writer thread and take the next one ******
+  void EventWriter::seal()
+  {
+    pthread_mutex_lock(&m_mutex);
+    clock_gettime(CLOCK_MONOTONIC,&m_block[m_fill].tsSeal);
+    m_nFull++;
+    m_nSealed++;
+    pthread_cond_signal(&m_condFull);
+    if(m_nFull==m_nBlock)
+    {
+      //****** all blocks are waiting for disk : builder stalls ******
+      struct timespec tsWait;
+      clock_gettime(CLOCK_MONOTONIC,&tsWait);
+      while(m_nFull==m_nBlock)
+        pthread_cond_wait(&m_condFree,&m_mutex);
+      unsigned long long usec=usecSince(&tsWait);
+      m_nStall++;
+      m_stallUsec+=usec;
+      if(usec>m_maxStallUsec)m_maxStallUsec=usec;
+    }
+    pthread_mutex_unlock(&m_mutex);
+    m_fill=(m_fill+1)%m_nBlock;
+    m_block[m_fill].used=0;
+  }
+
+  void *EventWriter::writer_thread(void *arg)
+  {
+    ((EventWriter *)arg)->run();
+    return NULL;
+  }
+
+  void EventWriter::run()
+  {
+    int tags[WRITER_MAX_NBLOCK];
+    int nInflight=0;
+    std::string next; //file to switch to when the writes to the current one have completed
+    while(1)
+    {
+      if(next.length()>0 && nInflight==0)
+      {
+        reopen(next.c_str());
+        next.clear();
+      }
+      pthread_mutex_lock(&m_mutex);
+      while(m_nSealed==0 && nInflight==0 && !m_closing)
+      {
+        if(m_idle==NULL)
+        {
+          pthread_cond_wait(&m_condFull,&m_mutex);
+          continue;
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME,&ts);
+        ts.tv_nsec+=WRITER_IDLE_MSEC*1000000L;
+        ts.tv_sec+=ts.tv_nsec/1000000000L;
+        ts.tv_nsec%=1000000000L;
+        if(pthread_cond_timedwait(&m_condFull,&m_mutex,&ts)==ETIMEDOUT)
+        {
+          //****** all blocks are flushed, so the handler can seal one block of this writer without waiting ******
+          pthread_mutex_unlock(&m_mutex);
+          m_idle(m_idleArg);
+          pthread_mutex_lock(&m_mutex);
+        }
+      }
+      if(m_nSealed==0 && nInflight==0 && m_closing)
+      {
+        pthread_mutex_unlock(&m_mutex);
+        break;
+      }
+      int nSubmit=m_nSealed;
+      pthread_mutex_unlock(&m_mutex);
+
+      //****** keep up to m_qdepth blocks in flight, and no block of the new file before the switch ******
+      while(nSubmit>0 && nInflight<m_qdepth && next.length()==0)
+      {
+        Block &b=m_block[m_submit];
+        int tag=m_submit;
+        if(b.used>0 && m_file->submit(b.buf,b.used,tag)!=0)
+        {
+          std::cout<<"EventWriter: output file write error!!"<<std::endl;
+          exit(1);
+        }
+        if(b.nextPath.length()>0)
+        {
+          next=b.nextPath;
+          b.nextPath.clear();
+        }
+        m_submit=(m_submit+1)%m_nBlock;
+        nSubmit--;
+        pthread_mutex_lock(&m_mutex);
+        m_nSealed--;
+        pthread_mutex_unlock(&m_mutex);
+        if(b.used>0)
+          nInflight++;
+        else
+          release(tag);//an empty block sealed by rotate() or close()
+      }
+
+      //****** collect completed blocks ******
+      //wait only when nothing more can be submitted, including the blocks sealed meanwhile
+      pthread_mutex_lock(&m_mutex);
+      bool more=(nInflight==0 || (m_nSealed>0 && nInflight<m_qdepth && next.length()==0));
+      pthread_mutex_unlock(&m_mutex);
+      int n=m_file->reap(tags,WRITER_MAX_NBLOCK,more ? 0 : 1000);
+      if(n<0)
+      {
+        std::cout<<"EventWriter: output file write error!!"<<std::endl;
+        exit(1);
+      }
+      nInflight-=n;
+      for(int i=0;i<n;i++)release(tags[i]);
+    }
+  }
+
+  //****** return a flushed block. blocks are freed in the order of sealing ******
+  void EventWriter::release(int tag)
+  {
+    pthread_mutex_lock(&m_mutex);
+    m_done[tag]=true;
+    while(m_nFull>0 && m_done[m_flush])
+    {
+      Block &b=m_block[m_flush];
+      unsigned long long usec=usecSince(&b.tsSeal);
+      if(usec>m_maxLagUsec)m_maxLagUsec=usec;
+      m_nOut+=b.used;
+      m_done[m_flush]=false;
+      m_flush=(m_flush+1)%m_nBlock;
+      m_nFull--;
+      pthread_cond_signal(&m_condFree);
+    }
+    pthread_mutex_unlock(&m_mutex);
+  }
+
+  void EventWriter::close()
+  {
+    if(!m_running)return;
+    //****** seal the partially filled block ******
+    if(m_block[m_fill].used>0)seal();
+    pthread_mutex_lock(&m_mutex);
+    m_closing=true;
+    pthread_cond_signal(&m_condFull);
+    pthread_mutex_unlock(&m_mutex);
+    pthread_join(m_thread,NULL);
+    m_running=false;
+    if(!m_file->close())
+      std::cout<<"EventWriter: output file close error!!"<<std::endl;
+  }
+
+  //****** the getters may be called from other threads (e.g. ThruPutMes_thread) ******
+  unsigned long long EventWriter::getNin() throw()
+  {
+    return __sync_fetch_and_add(&m_nIn,0);
+  }
+  unsigned long long EventWriter::getNout() throw()
+  {
+    pthread_mutex_lock(&m_mutex);
+    unsigned long long n=m_nOut;
+    pthread_mutex_unlock(&m_mutex);
+    return n;
+  }
+  //only for the thread calling write()
+  unsigned long long EventWriter::getFileOffset() throw()
+  {
+    return m_fileIn;
+  }
+  unsigned long long EventWriter::getLagBytes() throw()
+  {
+    //m_nOut first : m_nIn read after it is never smaller
+    unsigned long long nOut=getNout();
+    unsigned long long nIn=getNin();
+    return (nIn>nOut ? nIn-nOut : 0);
+  }
+  unsigned long EventWriter::getNstall() throw()
+  {
+    pthread_mutex_lock(&m_mutex);
+    unsigned long n=m_nStall;
+    pthread_mutex_unlock(&m_mutex);
+    return n;
+  }
+  unsigned long long EventWriter::getStallUsec() throw()
+  {
+    pthread_mutex_lock(&m_mutex);
+    unsigned long long usec=m_stallUsec;
+    pthread_mutex_unlock(&m_mutex);
+    return usec;
+  }
+  unsigned long long EventWriter::getMaxStallUsec() throw()
+  {
+    pthread_mutex_lock(&m_mutex);
+    unsigned long long usec=m_maxStallUsec;
+    pthread_mutex_unlock(&m_mutex);
+    return usec;
+  }
+  unsigned long long EventWriter::getMaxLagUsec() throw()
+  {
+    pthread_mutex_lock(&m_mutex);
+    unsigned long long usec=m_maxLagUsec;
+    pthread_mutex_unlock(&m_mutex);
+    return usec;
+  }
+
+  void EventWriter::printSummary()
+  {
+    std::cout<<" Writer Summary "<<std::endl;
+    std::cout<<"block size          :"<<m_blockSize/1024/1024<<"MB x "<<m_nBlock<<std::endl;
+    if(m_file!=NULL)
+      std::cout<<"output engine       :"<<m_file->getName()<<" (qdepth "<<m_qdepth<<")"<<std::endl;
+    std::cout<<"bytes written       :"<<m_nOut<<std::endl;
+    std::cout<<"builder stall       :"<<m_nStall<<" times, "<<m_stallUsec<<"usec (max "<<m_maxStallUsec<<"usec)"<<std::endl;
+    std::cout<<"writer lag (max)    :"<<m_maxLagUsec<<"usec"<<std::endl;
+  }
+}
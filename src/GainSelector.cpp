@@ -0,0 +1,144 @@
+#include "GainSelector.hpp"
+#include "Simd.hpp"
+#include <string.h>//memcpy
+#include <stdio.h> //printf
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GAINSEL_X86
+#endif
+
+//****************************************************
+// scalar kernel
+//****************************************************
+static unsigned char select_scalar(const unsigned char *frag, unsigned char *out, unsigned short threshold)
+{
+  const unsigned char *hg=frag+LINE_WAVEFORM*LINESIZE;
+  unsigned char mask=0;
+  for(int s=0;s<READDEPTH;s++)
+  {
+    for(int c=0;c<NCHANNEL;c++)
+      if((hg[2*c]<<8|hg[2*c+1])>threshold)mask|=1<<c;
+    hg+=NGAIN*LINESIZE;
+  }
+  memcpy(out,frag,LINE_WAVEFORM*LINESIZE);
+  const unsigned char *in=frag+LINE_WAVEFORM*LINESIZE;
+  out+=LINE_WAVEFORM*LINESIZE;
+  for(int s=0;s<READDEPTH;s++)
+  {
+    for(int c=0;c<NCHANNEL;c++)
+    {
+      const unsigned char *p= (mask>>c&1) ? in+LINESIZE : in;
+      out[2*c]=p[2*c];
+      out[2*c+1]=p[2*c+1];
+    }
+    in+=NGAIN*LINESIZE;
+    out+=LINESIZE;
+  }
+  return mask;
+}
+
+#ifdef GAINSEL_X86
+//****************************************************
+// SSSE3 kernel
+//   sample > threshold <=> saturating (sample - threshold) != 0,
+//   then each output line is (lg & mask) | (hg & ~mask) with a 16 bit mask per channel.
+//****************************************************
+__attribute__((target("ssse3")))
+static unsigned char select_ssse3(const unsigned char *frag, unsigned char *out, unsigned short threshold)
+{
+  const __m128i swap=_mm_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+  const __m128i thr=_mm_set1_epi16((short)threshold);
+  const __m128i zero=_mm_setzero_si128();
+  const unsigned char *hg=frag+LINE_WAVEFORM*LINESIZE;
+  __m128i acc=zero;
+  for(int s=0;s<READDEPTH;s++)
+  {
+    __m128i x=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)hg),swap);
+    acc=_mm_or_si128(acc,_mm_subs_epu16(x,thr));
+    hg+=NGAIN*LINESIZE;
+  }
+  __m128i low=_mm_andnot_si128(_mm_cmpeq_epi16(acc,zero),_mm_set1_epi16(-1));
+  unsigned char mask=(unsigned char)_mm_movemask_epi8(_mm_packs_epi16(low,zero));
+
+  memcpy(out,frag,LINE_WAVEFORM*LINESIZE);
+  const unsigned char *in=frag+LINE_WAVEFORM*LINESIZE;
+  out+=LINE_WAVEFORM*LINESIZE;
+  if(mask==0)
+  {
+    //****** usual case : all high gain ******
+    for(int s=0;s<READDEPTH;s++)
+    {
+      _mm_storeu_si128((__m128i *)out,_mm_loadu_si128((const __m128i *)in));
+      in+=NGAIN*LINESIZE;
+      out+=LINESIZE;
+    }
+    return 0;
+  }
+  for(int s=0;s<READDEPTH;s++)
+  {
+    __m128i h=_mm_loadu_si128((const __m128i *)in);
+    __m128i l=_mm_loadu_si128((const __m128i *)(in+LINESIZE));
+    _mm_storeu_si128((__m128i *)out,_mm_or_si128(_mm_and_si128(low,l),_mm_andnot_si128(low,h)));
+    in+=NGAIN*LINESIZE;
+    out+=LINESIZE;
+  }
+  return mask;
+}
+#endif
+
+namespace LSTDAQ{
+  GainSelector::GainSelector(unsigned short threshold) throw():m_threshold(threshold)
+  {
+    for(int i=0;i<MAX_WORKER;i++)m_count[i].nLowGain=0;
+  }
+  GainSelector::~GainSelector() throw()
+  {
+  }
+  const char *GainSelector::getName()
+  {
+    return "gainsel";
+  }
+
+  bool GainSelector::process(EventHeader *header, unsigned char **data, unsigned char **spare, int worker)
+  {
+    if(header->flags&~EVFMT_PEDSUB)return true;  //raw layout only
+    unsigned int prefix=GAINSEL_BITMAPSIZE(header->nModule);
+    unsigned int moduleSize=getModuleSize(EVFMT_GAINSEL);
+    unsigned char *bitmap=*spare;
+    memset(bitmap,0,prefix);
+    for(unsigned int m=0;m<header->nModule;m++)
+    {
+      //****** a missing module holds an older event : keep its high gain, not counted ******
+      bool missing=(m<64 && (header->missing>>m&1));
+      bitmap[m]=selectModule(*data+(unsigned long)m*EVENTSIZE,*spare+prefix+m*moduleSize,missing ? 0xffff : m_threshold);
+      if(!missing)m_count[worker].nLowGain+=__builtin_popcount(bitmap[m]);
+    }
+    header->size=prefix+header->nModule*moduleSize;
+    header->flags|=EVFMT_GAINSEL;
+    unsigned char *p=*data;
+    *data=*spare;
+    *spare=p;
+    return true;
+  }
+
+  unsigned char GainSelector::selectModule(const unsigned char *frag, unsigned char *out, unsigned short threshold)
+  {
+#ifdef GAINSEL_X86
+    if(getSimdLevel()>=SIMD_SSSE3)
+      return select_ssse3(frag,out,threshold);
+#endif
+    return select_scalar(frag,out,threshold);
+  }
+
+  unsigned long long GainSelector::getNlowGain()
+  {
+    unsigned long long n=0;
+    for(int i=0;i<MAX_WORKER;i++)n+=m_count[i].nLowGain;
+    return n;
+  }
+
+  void GainSelector::printSummary()
+  {
+    printf("  threshold %d, low gain kept for %llu channels\n",m_threshold,getNlowGain());
+  }
+}
@@ -0,0 +1,49 @@
+#include "LatencyHistogram.hpp"
+#include <math.h>      //ceil
+
+namespace LSTDAQ{
+  LatencyHistogram::LatencyHistogram() throw()
+  {
+    reset();
+  }
+  LatencyHistogram::~LatencyHistogram() throw()
+  {
+  }
+
+  void LatencyHistogram::reset()
+  {
+    for(int i=0;i<HISTO_NBUCKET;i++)
+      store(&m_count[i],0);
+    store(&m_total,0);
+    store(&m_sum,0);
+    store(&m_max,0);
+  }
+
+  unsigned long long LatencyHistogram::highest(int index)
+  {
+    int shift=(index<(2<<HISTO_SUBBITS) ? 0 : (index>>HISTO_SUBBITS)-1);
+    unsigned long long mantissa=index-(shift<<HISTO_SUBBITS);
+    return ((mantissa+1)<<shift)-1;
+  }
+
+  unsigned long long LatencyHistogram::getPercentile(double q)
+  {
+    unsigned long long total=load(&m_total);
+    unsigned long long max=load(&m_max);
+    if(total==0)return 0;
+    unsigned long long rank=(unsigned long long)ceil(q*total);
+    if(rank<1)rank=1;
+    unsigned long long n=0;
+    for(int i=0;i<HISTO_NBUCKET;i++)
+    {
+      n+=load(&m_count[i]);
+      if(n>=rank)
+      {
+	unsigned long long value=highest(i);
+	return (value<max ? value : max);
+      }
+    }
+    //the buckets were filled while they were summed
+    return max;
+  }
+}
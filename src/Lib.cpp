@@ -1,4 +1,5 @@
 #include "Lib.hpp"
+#include "Config.hpp"
 
 
 /*!
@@ -19,8 +20,37 @@ void usage(char **argv)
 	printf("-n|--Ndaq <#of data to acquire>      : Default is 1000.\n");
 	//	printf("-v|--version   <Dragon Version>      : Default is 5.\n");
 	//	printf("-c|--closeinspect                    : Default is false.\n");
-	//	printf("-f|--configfile                      : .\n");
+	printf("-f|--configfile <file>               : Connection configuration. Default is Connection.conf.\n");
 	printf("-l|--logringbuffer                   : .\n");
+	printf("-b|--blocksize <MB>                  : Size of one output block. Default is %d.\n",WRITER_BLOCKSIZE_MB);
+	printf("-B|--nblock <#of blocks>             : Output blocks in flight. Default is %d.\n",WRITER_NBLOCK);
+	printf("-e|--engine <buffered|direct>        : Output engine. Default is buffered.\n");
+	printf("-q|--qdepth <#of writes>             : Writes in flight of direct engine. Default is %d.\n",OUTPUT_QDEPTH);
+	printf("-d|--outdir <dir1,dir2,...>          : Output directories to stripe data over.\n");
+	printf("-S|--stripe <MB>                     : Data written to a stripe before switching. Default is 0 (every event).\n");
+	printf("-C|--continuous                      : Run until SIGINT/SIGTERM instead of -n events.\n");
+	printf("-R|--rotate-sec <sec>                : Switch to a new output file every <sec> seconds.\n");
+	printf("-G|--rotate-gb <GB>                  : Switch to a new output file every <GB> GB. Files are preallocated.\n");
+	printf("-w|--workers <#of threads>           : Threads processing events before writing. Default is 1 if needed.\n");
+	printf("-z|--compress                        : Compress waveforms losslessly (delta + bit packing).\n");
+	printf("-p|--pack12                          : Pack waveform samples to 12 bits.\n");
+	printf("-g|--gainsel <threshold>             : Keep low gain only for channels with high gain above threshold.\n");
+	printf("-P|--pedestal <file>                 : Subtract DRS4 pedestals of the file (<file>_<name> per partition) by stop cell.\n");
+	printf("-Z|--zs <peak>[,<charge>]            : Keep only channels above thresholds after pedestal subtraction.\n");
+	printf("-D|--dl1 <window>                    : Write charge and peak time per channel to <file>_dl1.\n");
+	printf("-X|--dl1-only                        : Write charge and peak time instead of waveforms.\n");
+	printf("-F|--filter <type:thr:n>             : Write only events with n pixels (mult) or n neighbours (topo) >= thr.\n");
+	printf("-K|--prescale <N>                    : Keep 1 of N events rejected by -F. Default is 0 (none).\n");
+	printf("-A|--soa                             : Store samples as [gain][pixel][sample] arrays.\n");
+	printf("-M|--monitor <N>                     : Monitor 1 of N built events online. Events are skipped when it is behind.\n");
+	printf("-m|--shm <name>[,<MB>]               : Publish built events to a shared memory ring. Default size is 64MB.\n");
+	printf("-E|--stream unix:<path>|tcp:<port>   : Stream built events to clients on localhost (see LSTDAQ::StreamServer).\n");
+	printf("-U|--uplink <host>:<port>[,<node>]   : Collector node : send sub-events to the builder node. Default node is 0.\n");
+	printf("-N|--nodes <port>,<#of nodes>        : Builder node : merge sub-events of collector nodes instead of reading FEBs.\n");
+	printf("-Q|--control unix:<path>|tcp:<port>  : Wait for configure/start/stop/reset commands of a run control (see LSTDAQ::RunControl).\n");
+	printf("-t|--realtime                        : Real-time mode : lock memory, SCHED_FIFO collectors and builder, isolated CPUs first.\n");
+	printf("-H|--metrics <port>                  : Serve rates, ring occupancy, drops and CPU use at http://localhost:<port>/metrics.\n");
+	printf("-T|--pedestal-run <file>             : Pedestal run. Write only the pedestals of all DRS4 cells to the file.\n");
 	// printf("********* CAUTION ********\n");
 	// printf("Make sure to specify readdepth to Dragon through rpcp command.\n");
 	// printf("If RD=1024,limit is 3kHz at 1Gbps. so 10000events will take 10s. \n");
@@ -62,3 +92,24 @@ void inverseByteOrder(char *buf,int bufsize)
   }
   memcpy(buf,tempbuf,bufsize);
 }
+
+/****************************/
+// unwrap counter
+/****************************/
+
+/*!
+ * \fn unsigned long unwrapCounter(unsigned int raw,unsigned long prev)
+ * \brief Extends a 32 bit counter from Dragon to 64 bits
+ *
+ * trigNo and evtNo in the data are 32 bits and wrap around in long runs.<br>
+ * The difference from the previous value is taken as a signed 32 bit number, so that both the wrap
+ * and small steps back (as in the builder's resynchronization) are followed.<br>
+ * \param raw  counter read from the data (byte order already flipped)
+ * \param prev previous unwrapped value
+ */
+unsigned long unwrapCounter(unsigned int raw,unsigned long prev)
+{
+  int delta=(int)(raw-(unsigned int)prev);
+  if(delta<0 && (unsigned long)(-(long)delta)>prev)return raw;
+  return prev+delta;
+}
@@ -28,6 +28,9 @@
    - TCP/IP connection to FEBs (configurable without compilation)
    - Multi threaded data acquisition through TCP/IP (configurable without compilation)
    - Event building identifying trigger number
+   - Two-tier event building : collector nodes send sub-events to a builder node (-U / -N)
+   - Several independent partitions (cameras) in one process, each with its own threads, outputs and CPU set
+   - Run control over a local socket (-Q) : connections, Ring Buffers and threads are kept over runs
    - data pooling in ring buffers, to absorb inequality of sending data between FEBs.
    
    
@@ -85,17 +88,36 @@
    
   \subsubsection CPU_ID_PROC Procedues
   There are `nColl + 2` threads to be assigned, which consist of one `Builder_thread`, one `ThruPutMes_thread`, and  `nColl` threads of `Collector_thread`. 
-  Using residual number, CPUs are assigned to the threads evenly. Here is the relation between thread and `CPU_ID`.
+  The CPUs are planned by planPlacement() from the topology of the machine (LSTDAQ::CpuTopology) and printed at start.
 
   Thread name     | Number of threads |  CPU ID  
  -----------------|-------------------|--------------
- Collector_thread | `nColl`           |  `Cid` \% `Ncpu` (where `Cid` = 0,1,2...`nColl`-1)
- Builder_thread   | 1                 |  `nColl` \% `Ncpu`
- ThruPutMes_thread| 1                 |  `nColl`+1 \% `Ncpu`
+ Collector_thread | `nColl`           |  free CPU on the NUMA node of the NIC to its FEBs, on a core of its own if possible
+ Builder_thread   | 1                 |  free CPU which is not an SMT sibling of a collector
+ ThruPutMes_thread| 1                 |  `cpu[nCpu-1]`
+ writer, worker, dispatcher | any     |  the CPUs left by the collectors and the builder
+
+  When no CPU is free, a thread gets `cpu[k` \% `nCpu]` (k = `Cid` for a collector, `nColl` for the builder).
+  On a machine without NUMA and SMT, this is `cpu[Cid]` for the collectors and `cpu[nColl]` for the builder.
+  Each Collector_thread places its Ring Buffers on the NUMA node of its CPU (LSTDAQ::RingBuffer::setNode()).
+  The writer, worker and dispatcher threads started by Builder_thread share the CPUs left by the collectors and the
+  builder (and the SMT siblings of the builder), so that -w N runs the workers in parallel. Without such CPUs, they
+  also use the CPU of the builder, and then all the CPUs of the partition. The builder binds itself to them while it
+  makes those threads, and to its own CPU afterwards.
+
+  `cpu[]` is the CPU set of the partition (sPartition) and `nCpu` the number of CPUs in it.
+  Without a CPU set in Connection.conf, it is all the CPUs 0...`Ncpu`-1.
+  A thread can be pinned to a CPU in Connection.conf, in the lines of its partition :
+  \code
+  pin collector <Cid> <cpu>
+  pin builder <cpu>
+  pin thruput <cpu>
+  \endcode
 
 
   The number of CPUs is inspected using `sysconf()` function in `main()` function, and stored as `Ncpu` value. 
   When a thread starts, which CPU to use is set, specifying `CPU_ID` in `__CPU_SET()` function.
+  With several partitions, the threads of each partition are assigned in the same way within its own CPU set.
 
 
    ************************************************
@@ -104,6 +126,8 @@
    When DAQ starts, all the Collector_thread and Builder_thread synchronize, not to waste Ring Buffer memory in a way that Collector_thread starts filling data in Ring Buffer before Builder_thread gets prepared to extract it.
    
 
+   Each partition (sPartition) is synchronized on its own, with its own `initEnd`, `mutex_initLock` and `cond_allend`.
+
    \subsubsection START_SYNC_DETAILS Procedures
    - When Builder_thread gets prepared, it waits all the other threads untill they are also prepared, checking if `initEnd` become nColl (\ref BLD_START_SYNC process).
 
@@ -118,10 +142,13 @@
 
    - Collector_thread\n
    When a Collector_thread gets prepared for DAQ, it locks `mutex_initLock` ticket by `pthread_mutex_lock()` and immediately it releases it by `pthread_cond_wait()`. But this function makes it stopped until `pthread_cond_broadcast()` is issued to `cond_allend`. After receiving the signal, it again tries to lock `mutex_initLock` which enables it to leave `pthread_cond_wait()`  function. As the last step, now having the `mutex_initLock` ticket, it unlocks it by `pthread_mutex_unlock()` so that the other Collector_threads can do the same step.
+   `initEnd` is counted up under `mutex_initLock`, and the Collector_thread waits only while `started` is not set, so that
+   a Collector_thread which comes after the broadcast does not wait forever (waitStart()).
 
    - Builder_thread\n
    When `initEnd` = `nColl`, Builder_thread announces the allowance of starting DAQ as follows.
    First, it locks `mutex_initLock` which is already free from any other threads, with pthread_mutex_lock() method. Second, it sends signal to all the threads which have issued `pthread_cond_wait()` function with `cond_allend` variable. This procedure means that it announces the start of DAQ to all the Collector_threads. At last, it unlocks `mutex_initLock` with `pthread_mutex_unlock()` function for the Collector_threads to be able to leave `pthread_cond_wait()` function.
+   `started` is set before the broadcast (allowStart()).
 
    - ThruPutMes_thread\n
    When preparation for the measurement is completed, it does the same steps as Builder_thread. But the steps neither do nor suffer from any harm. Here is the inspection of two possible case:
@@ -135,6 +162,62 @@
       - Monitor thread 
 
 
+   ************************************************
+   \subsection RUN_CONTROL Run control
+   ************************************************
+   With -Q unix:<path> or -Q tcp:<port>, main() does not configure anything by itself but waits for the commands
+   of a run control on the socket (LSTDAQ::RunControl) :
+   - configure : configure() reads the configuration, makes the Ring Buffers and creates the threads as for a
+     single run. The reply comes when all the FEBs are connected. Collector_threads then read the sockets
+     all the time, but discard the data while no run is going on (`running` of sPartition is false).
+     If a FEB cannot be connected (FEB_CONNECT_SEC each) or not all are within RC_CONFIGURE_SEC, its Collector_thread
+     sets `failed` of sPartition instead of exiting, teardown() ends the threads and the reply is ERROR in IDLE.
+   - start [N] : the run number is counted up and each Builder_thread is woken up by requestRun(). It drains the
+     Ring Buffers, sets `running` and builds N events (-n by default) in Builder_run(), with new output files
+     (suffix _runNNNNN) and a new LSTDAQ::WorkerPool. The event buffers and the consumers of the events stay.
+   - stop : sets `runStopRequested`, which makes Builder_run() return, waits for all the partitions with isRunDone()
+     and reports the statistics of the run of each partition (sRunStats). A run which ended by itself is
+     reported in the same way.
+   - reset : teardown() sets `closing` of the partitions, joins the threads and deletes the Ring Buffers.
+   - status, quit.
+
+   So a new run starts in milliseconds, without connecting the FEBs and making the threads and buffers again.
+   SIGINT/SIGTERM acts as quit.
+
+   ************************************************
+   \subsection REALTIME Real-time mode
+   ************************************************
+   With -t, the jitter of the data path is cut down at the cost of memory and CPUs :
+   - The memory is faulted in and locked by mlockall(MCL_CURRENT) after configure() has made the Ring Buffers and
+     threads, and again after Builder_thread has made the event buffers and write blocks of each run (lockMemory()).
+     MCL_FUTURE is not used : beyond RLIMIT_MEMLOCK, it would make the next allocation fail instead of mlockall().
+     The Ring Buffers are moved to the NUMA node of their collector by LSTDAQ::RingBuffer::setNode().
+   - Collector_thread and Node_thread run SCHED_FIFO at RT_PRIO_COLLECTOR. Builder_thread runs SCHED_FIFO at
+     RT_PRIO_BUILDER while it builds a run (setRealtime()), after its writer and worker threads are started,
+     so that these stay SCHED_OTHER. It sleeps RT_IDLE_USEC when a Ring Buffer is empty to let them run.
+     On a CPU shared with a collector, the writer/worker threads or ThruPutMes_thread, it stays SCHED_OTHER :
+     a polling SCHED_FIFO thread would take the CPU from everything else on it.
+   - planPlacement() puts the collectors and the builder on the CPUs in /sys/devices/system/cpu/isolated and
+     nohz_full first, and ThruPutMes_thread off them.
+
+   What was granted is printed at start : mlockall() needs RLIMIT_MEMLOCK (or CAP_IPC_LOCK) for all the Ring Buffers,
+   and SCHED_FIFO needs RLIMIT_RTPRIO (or CAP_SYS_NICE). DAQ goes on without what was refused.
+
+   ************************************************
+   \subsection METRICS Metrics
+   ************************************************
+   With -H <port>, LSTDAQ::MetricsServer serves the metrics in the Prometheus text format at http://localhost:<port>/metrics
+   while DAQ runs, also between runs under run control :
+   - per FEB (labels partition, rb, feb) : bytes and fragments received (total and per second), occupancy of its
+     Ring Buffer, fragments lost on a full Ring Buffer, fragments thrown away by the builder to catch up the trigger
+     number, and events built without the FEB.
+   - per partition : events built (total and per second), writer lag and stall, run number, and the p50/p99/p99.9/max
+     of the build interval and of the event latency in the current run (see LSTDAQ::DAQtimer).
+   - per thread (collectors, builder, ThruPutMes) : CPU time from /proc/self/task/<tid>/stat.
+
+   ThruPutMes_thread of each partition samples the Ring Buffers every THRUPUTMES_INTERVAL as for -l, and every
+   METRICS_INTERVAL_MSEC puts the counters and rates into sMetrics. The server makes the text from sMetrics at each
+   request, so nothing grows with the length of the run. With -l, the samples are written to the log file as they come.
 
  */
 
@@ -194,12 +277,41 @@
 #include "RingBuffer.hpp"
 #include "TCPClientSocket.hpp"
 #include "DAQtimer.hpp"
+#include "EventOutput.hpp"
+#include "EventFormat.hpp"
+#include "WorkerPool.hpp"
+#include "EventBufferPool.hpp"
+#include "EventDispatcher.hpp"
+#include "EventMonitor.hpp"
+#include "ShmPublisher.hpp"
+#include "StreamServer.hpp"
+#include "SubEventSender.hpp"
+#include "SubEventReceiver.hpp"
+#include "RunControl.hpp"
+#include "MetricsServer.hpp"
+#include "CpuTopology.hpp"
+#include "WaveformCodec.hpp"
+#include "Pack12.hpp"
+#include "GainSelector.hpp"
+#include "PedestalSubtractor.hpp"
+#include "PedestalAccumulator.hpp"
+#include "ZeroSuppressor.hpp"
+#include "ChargeExtractor.hpp"
+#include "SoftwareTrigger.hpp"
+#include "SoaTransposer.hpp"
 #include "Config.hpp"
 
 /* for measurement  */
 #include <time.h>//itimespec
 #include <sys/timerfd.h>//timer in ThruPutMes_thread
 #include <assert.h>
+#include <signal.h>//stop by SIGINT/SIGTERM
+#include <errno.h>//EINTR
+#include <limits.h>//ULONG_MAX
+#include <sched.h>//SCHED_FIFO
+#include <sys/mman.h>//mlockall
+#include <sys/resource.h>//RLIMIT_MEMLOCK
+#include <sys/syscall.h>//gettid
 
 #include "termcolor.h"
 #include <getopt.h>
@@ -217,6 +329,35 @@ struct option options[] =
     {"closeinspect" ,no_argument   ,NULL ,'c'},
     {"configfile" ,required_argument   ,NULL ,'f'},
     {"logringbuffer" ,no_argument   ,NULL ,'l'},
+    {"blocksize" ,required_argument ,NULL ,'b'},
+    {"nblock"    ,required_argument ,NULL ,'B'},
+    {"engine"    ,required_argument ,NULL ,'e'},
+    {"qdepth"    ,required_argument ,NULL ,'q'},
+    {"outdir"    ,required_argument ,NULL ,'d'},
+    {"stripe"    ,required_argument ,NULL ,'S'},
+    {"continuous",no_argument       ,NULL ,'C'},
+    {"rotate-sec",required_argument ,NULL ,'R'},
+    {"rotate-gb" ,required_argument ,NULL ,'G'},
+    {"workers"   ,required_argument ,NULL ,'w'},
+    {"compress"  ,no_argument       ,NULL ,'z'},
+    {"pack12"    ,no_argument       ,NULL ,'p'},
+    {"gainsel"   ,required_argument ,NULL ,'g'},
+    {"pedestal"  ,required_argument ,NULL ,'P'},
+    {"pedestal-run",required_argument ,NULL ,'T'},
+    {"zs"        ,required_argument ,NULL ,'Z'},
+    {"dl1"       ,required_argument ,NULL ,'D'},
+    {"dl1-only"  ,no_argument       ,NULL ,'X'},
+    {"filter"    ,required_argument ,NULL ,'F'},
+    {"prescale"  ,required_argument ,NULL ,'K'},
+    {"soa"       ,no_argument       ,NULL ,'A'},
+    {"monitor"   ,required_argument ,NULL ,'M'},
+    {"shm"       ,required_argument ,NULL ,'m'},
+    {"stream"    ,required_argument ,NULL ,'E'},
+    {"uplink"    ,required_argument ,NULL ,'U'},
+    {"nodes"     ,required_argument ,NULL ,'N'},
+    {"control"   ,required_argument ,NULL ,'Q'},
+    {"realtime"  ,no_argument       ,NULL ,'t'},
+    {"metrics"   ,required_argument ,NULL ,'H'},
     {0,0,0,0}
   };
 
@@ -230,21 +371,419 @@ bool datacreate;
 std::string fileNameHeader;
 //! to save log file or not
 bool logcreate;
+//! size of one output block of EventWriter [MB]
+unsigned long writeBlockSizeMB;
+//! number of output blocks of EventWriter
+int writeNblock;
+//! output engine (OUTPUT_ENGINE_BUFFERED or OUTPUT_ENGINE_DIRECT)
+int outputEngine;
+//! number of writes in flight of the output engine
+int outputQdepth;
+//! comma separated output directories to stripe data over (empty: single file)
+std::string outputDirs;
+//! size of the chunk to switch stripes [MB] (0: round robin by event)
+unsigned long stripeChunkMB;
+//! to run until stopped by signal, ignoring Ndaq
+bool continuous;
+//! interval to switch output files [sec] (0: no rotation by time)
+double rotateSec;
+//! size to switch output files [GB] (0: no rotation by size)
+double rotateGB;
+//! number of worker threads processing built events (0: no processing)
+int nWorker;
+//! to compress waveforms (EVFMT_DELTA)
+bool compress;
+//! to pack waveform samples to 12 bits (EVFMT_PACK12)
+bool pack12;
+//! threshold of gain selection (EVFMT_GAINSEL). 0 for no selection.
+int gainselThreshold;
+//! pedestal file to subtract (EVFMT_PEDSUB). Empty for no subtraction. Each partition loads <file>_<name>.
+std::string pedestalFile;
+//! pedestal file made by the pedestal run. Empty for a normal run.
+std::string pedestalRunFile;
+//! peak threshold of zero suppression (EVFMT_ZS) [counts]. 0 for no peak test.
+int zsPeak;
+//! charge threshold of zero suppression [counts]. 0 for no charge test.
+int zsCharge;
+//! integration window of DL1 extraction [samples]. 0 for no extraction.
+int dl1Window;
+//! to write DL1 records instead of waveforms (otherwise to a separate <file>_dl1 stream)
+bool dl1Only;
+//! filters of the software trigger ("mult:<thr>:<n>", "topo:<thr>:<n>")
+std::string filterSpec[MAX_FILTER];
+int nFilter;
+//! 1 of prescale events rejected by the filters is kept (0: all dropped)
+unsigned int prescale;
+//! to store the samples as [gain][pixel][sample] arrays (EVFMT_SOA)
+bool soa;
+//! the online monitor sees 1 of monitorPrescale events (0: no monitor)
+int monitorPrescale;
+//! name of the shared memory ring of events. Empty for none.
+std::string shmName;
+//! size of the shared memory ring [MB]
+int shmSizeMB;
+//! address of the event stream server ("unix:<path>" or "tcp:<port>"). Empty for none.
+std::string streamAddress;
+//! connection configuration file
+std::string configFile;
+//! "<host>:<port>" of the builder node to send sub-events to. Empty for a standalone run.
+std::string uplinkAddress;
+//! index of this collector node for the builder node
+int nodeId;
+//! port to receive sub-events from the collector nodes on (0: FEBs are read from configFile)
+int nodePort;
+//! number of collector nodes sending sub-events
+int nNode;
+//! links from the collector nodes (NULL when FEBs are read directly)
+LSTDAQ::SubEventReceiver *nodeReceiver=NULL;
+//! address of the run control socket ("unix:<path>" or "tcp:<port>"). Empty for a single run.
+std::string controlAddress;
+//! run control socket (NULL for a single run)
+LSTDAQ::RunControl *runControl=NULL;
+//! real-time mode : memory locked, SCHED_FIFO and isolated CPUs (see \ref REALTIME)
+bool realtime;
+//! port of localhost to serve the metrics on (0: none). See \ref METRICS.
+int metricsPort;
+//! metrics server (NULL if none)
+LSTDAQ::MetricsServer *metricsServer=NULL;
+//! number of the current run under run control
+unsigned int runNumber=0;
+//! set by SIGINT/SIGTERM to stop DAQ
+volatile sig_atomic_t stopRequested=0;
+//! set by the run control to end the current run. The threads keep running for the next run.
+volatile sig_atomic_t runStopRequested=0;
 
-//variables for start synchronizer
-pthread_mutex_t mutex_initLock  =PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t cond_allend      =PTHREAD_COND_INITIALIZER;
-
-int initEnd;
 //! variable of the number of CPU in the system on which this runs
 int Ncpu;
+//! NUMA nodes and physical cores of the CPUs
+LSTDAQ::CpuTopology topology;
+//! serializes the end of run summaries of the partitions
+pthread_mutex_t mutex_summary   =PTHREAD_MUTEX_INITIALIZER;
+//! threads created by configure()
+pthread_t threadHandle[MAX_CONNECTION+2*MAX_PARTITION];
+int nThread=0;
 
 using namespace std;
 
+/*!
+ * \fn void requestStop(int sig)
+ * \brief signal handler to stop DAQ gracefully
+ *
+ * All the threads check stopRequested and leave their loops, so that the output files are closed properly.
+ */
+void requestStop(int sig)
+{
+  stopRequested=1;
+}
+
+/*!
+ * \fn bool isStopRequested()
+ * \brief true if DAQ or the current run is being stopped (passed to the blocking waits)
+ */
+bool isStopRequested()
+{
+  return stopRequested || runStopRequested;
+}
+
+/*!
+ * \fn void setRealtime(int prio, const char *role)
+ * \brief in real-time mode, switches the calling thread to SCHED_FIFO at prio (back to SCHED_OTHER if prio is 0)
+ *
+ * Whether the priority was granted is printed, since it needs CAP_SYS_NICE or RLIMIT_RTPRIO.
+ */
+void setRealtime(int prio, const char *role)
+{
+  if(!realtime)return;
+  struct sched_param param;
+  param.sched_priority=prio;
+  int err=pthread_setschedparam(pthread_self(),prio>0 ? SCHED_FIFO : SCHED_OTHER,&param);
+  if(prio==0)return;
+  if(err==0)
+    printf("%s : SCHED_FIFO priority %d granted\n",role,prio);
+  else
+    printf("WARNING: %s : SCHED_FIFO priority %d not granted (%s)\n",role,prio,strerror(err));
+}
+
 
 /****************************/
 // struct definition
 /****************************/
+/**
+ Statistics of one run of a partition, reported to the run control on stop.
+ */
+struct sRunStats{
+  unsigned int run;          //!< run number
+  unsigned long nEvent;      //!< events built
+  double sec;                //!< duration of the run
+  unsigned long long bytesIn;  //!< bytes of the built events
+  unsigned long long bytesOut; //!< bytes after processing (as built without processing)
+  std::string file;          //!< output file name (empty if data is not saved)
+};
+
+/**
+ A partition is an independent camera (e.g. one telescope or test bench) declared in Connection.conf
+ by a line
+ \code
+ partition <name> [<cpus>]
+ \endcode
+ followed by the connections of its FEBs. Lines before the first partition line form partition "0".
+ Each partition has its own Collector_threads, Builder_thread, output files (suffix _<name> when there are
+ several partitions) and statistics, and its threads run only on its CPU set <cpus> (e.g. 0-3,8; all CPUs if omitted).
+ The Collector IDs start from 0 in each partition.
+
+ Its sRingBuffer structs are contiguous in sRB[] and followed by one unused struct (sRBid=-1, next=0),
+ so that the threads of a partition see only its own Ring Buffers.
+ */
+struct sPartition{
+  std::string name;     //!< name of the partition
+  std::string cpuSpec;  //!< CPU set as given in Connection.conf
+  int cpu[MAX_PARTITION_CPU]; //!< CPUs of the CPU set
+  int nCpu;
+  int first;            //!< sRBid of the first Ring Buffer of the partition
+  int nRB;              //!< number of connections
+  int nColl;            //!< number of Collector_threads
+  //placement of the threads. See \ref CPU_ID.
+  int collCpu[MAX_CONNECTION]; //!< CPU of each Collector_thread (-1 : planned by planPlacement())
+  int builderCpu;       //!< CPU of Builder_thread (-1 : planned)
+  int thruPutCpu;       //!< CPU of ThruPutMes_thread (-1 : planned)
+  int helperCpu[MAX_PARTITION_CPU]; //!< CPUs of the writer, worker and dispatcher threads, planned by planPlacement()
+  int nHelperCpu;
+  bool collPinned[MAX_CONNECTION]; //!< set by a "pin" line of Connection.conf
+  bool builderPinned;
+  bool thruPutPinned;
+  //variables for start synchronizer
+  pthread_mutex_t mutex_initLock;
+  pthread_cond_t cond_allend;
+  volatile int initEnd; //!< number of Collector_threads ready
+  bool started;         //!< set with cond_allend, so that a late Collector_thread does not wait forever
+  LSTDAQ::EventOutput *evOutput; //!< output files (NULL when data is not saved). Guarded by mutex_metrics.
+  LSTDAQ::PedestalTable *pedestal; //!< pedestals of the modules of the partition (NULL without -P)
+  //variables for the run control. See \ref RUN_CONTROL.
+  pthread_mutex_t mutex_run;
+  pthread_cond_t cond_run;
+  unsigned int runRequested; //!< last run started by the run control
+  unsigned int runDone;      //!< last run finished by Builder_thread
+  volatile bool closing;     //!< set by reset : the threads of the partition end
+  volatile bool running;     //!< set while Builder_thread builds events. Collector_threads discard data otherwise.
+  volatile unsigned long nBuilt; //!< events built in the current run
+  volatile unsigned long nBuiltAll; //!< events built in all the runs (never reset, for the rates)
+  volatile bool ended;       //!< set when Builder_thread ends
+  volatile bool failed;      //!< set when a Collector_thread cannot connect its FEBs. Guarded by mutex_initLock.
+  LSTDAQ::DAQtimer *timer;   //!< timer of the run being built, NULL otherwise. Guarded by mutex_metrics.
+  sRunStats stats;           //!< statistics of the last run
+};
+sPartition partition[MAX_PARTITION];
+int nPartition=0;
+
+/*!
+ * \fn std::string partitionSuffix(sPartition *part)
+ * \brief "_<name>" to make file names of the partition unique, empty if there is only one partition
+ */
+std::string partitionSuffix(sPartition *part)
+{
+  if(nPartition<=1)return "";
+  return "_"+part->name;
+}
+
+/*!
+ * \fn int partitionCpu(sPartition *part, int k)
+ * \brief k-th CPU of the CPU set of the partition, wrapping around
+ */
+int partitionCpu(sPartition *part, int k)
+{
+  return part->cpu[k%part->nCpu];
+}
+
+/*!
+ * \fn void lockMemory(bool report)
+ * \brief in real-time mode, faults in and locks all the memory mapped so far (mlockall(MCL_CURRENT)). See \ref REALTIME.
+ *
+ * Memory mapped later is not locked, so that an allocation beyond RLIMIT_MEMLOCK does not fail as with MCL_FUTURE.
+ * A refusal is printed once.
+ */
+void lockMemory(bool report)
+{
+  static bool warned=false;
+  if(!realtime)return;
+  if(mlockall(MCL_CURRENT)==0)
+  {
+    if(report)printf("real-time mode : memory locked\n");
+  }
+  else if(!warned)
+  {
+    struct rlimit rl;
+    getrlimit(RLIMIT_MEMLOCK,&rl);
+    if(rl.rlim_cur==RLIM_INFINITY)
+      printf("WARNING: real-time mode : memory not locked (%s)\n",strerror(errno));
+    else
+      printf("WARNING: real-time mode : memory not locked (%s, RLIMIT_MEMLOCK %lu kB)\n",strerror(errno),
+             (unsigned long)(rl.rlim_cur/1024));
+    warned=true;
+  }
+}
+
+/*!
+ * \fn bool hasHelperThreads()
+ * \brief true if Builder_thread starts writer, worker or dispatcher threads (placed on sPartition::helperCpu)
+ */
+bool hasHelperThreads()
+{
+  return datacreate || nWorker>0 || monitorPrescale>0 || shmName.length()>0 || streamAddress.length()>0;
+}
+
+/*!
+ * \fn void setAffinity(const int *cpu, int n, const char *role)
+ * \brief binds the calling thread to cpu[0] ... cpu[n-1]. The threads it creates afterwards inherit them.
+ */
+void setAffinity(const int *cpu, int n, const char *role)
+{
+#ifdef __CPU_ZERO
+  cpu_set_t mask;
+  __CPU_ZERO(&mask);
+  for(int i=0;i<n;i++)__CPU_SET(cpu[i],&mask);
+  if(sched_setaffinity(0,sizeof(mask), &mask) == -1)
+    printf("WARNING: %s : failed to set CPU affinity... (cpuid=%d, %d CPUs)\n",role,cpu[0],n);
+#endif
+}
+
+/*!
+ * \fn bool waitStart(sPartition *part)
+ * \brief called by a Collector_thread when it is ready : waits for the start of DAQ. See \ref START_SYNC.
+ * \return false if the partition is not started because another Collector_thread failed or it is reset
+ */
+bool waitStart(sPartition *part)
+{
+  pthread_mutex_lock(&part->mutex_initLock);
+  part->initEnd++;
+  pthread_cond_broadcast(&part->cond_allend);
+  while(!part->started && !part->failed && !part->closing)pthread_cond_wait(&part->cond_allend,&part->mutex_initLock);
+  bool started=part->started;
+  pthread_mutex_unlock(&part->mutex_initLock);
+  return started;
+}
+
+/*!
+ * \fn void failStart(sPartition *part)
+ * \brief called by a Collector_thread which cannot connect its FEBs : the partition is not started
+ */
+void failStart(sPartition *part)
+{
+  pthread_mutex_lock(&part->mutex_initLock);
+  part->failed=true;
+  pthread_cond_broadcast(&part->cond_allend);
+  pthread_mutex_unlock(&part->mutex_initLock);
+}
+
+/*!
+ * \fn bool allowStart(sPartition *part)
+ * \brief waits until all the Collector_threads of the partition are ready, and starts DAQ. See \ref START_SYNC.
+ * \return false if a Collector_thread failed or the partition is reset
+ */
+bool allowStart(sPartition *part)
+{
+  pthread_mutex_lock(&part->mutex_initLock);
+  while(part->initEnd<part->nColl && !part->failed && !part->closing)
+    pthread_cond_wait(&part->cond_allend,&part->mutex_initLock);
+  if(!part->failed && !part->closing)part->started=true;
+  pthread_cond_broadcast(&part->cond_allend);
+  bool started=part->started;
+  pthread_mutex_unlock(&part->mutex_initLock);
+  return started;
+}
+
+/*!
+ * \fn bool waitConfigured(sPartition *part, const struct timespec *tsLimit)
+ * \brief called by the run control after configure() : waits until the partition is started (all the FEBs connected)
+ * \param tsLimit CLOCK_MONOTONIC time to give up
+ * \return false if a Collector_thread failed, the time is over or SIGINT/SIGTERM came
+ */
+bool waitConfigured(sPartition *part, const struct timespec *tsLimit)
+{
+  pthread_mutex_lock(&part->mutex_initLock);
+  while(!part->started && !part->failed && !stopRequested)
+  {
+    struct timespec now,ts;
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    if(now.tv_sec>tsLimit->tv_sec || (now.tv_sec==tsLimit->tv_sec && now.tv_nsec>=tsLimit->tv_nsec))break;
+    //cond_allend runs on CLOCK_REALTIME
+    clock_gettime(CLOCK_REALTIME,&ts);
+    ts.tv_nsec+=RC_POLL_MSEC*1000000L;
+    ts.tv_sec+=ts.tv_nsec/1000000000L;
+    ts.tv_nsec%=1000000000L;
+    pthread_cond_timedwait(&part->cond_allend,&part->mutex_initLock,&ts);
+  }
+  bool started=part->started;
+  pthread_mutex_unlock(&part->mutex_initLock);
+  return started;
+}
+
+/*!
+ * \fn void requestRun(sPartition *part, unsigned int run)
+ * \brief called by the run control : lets Builder_thread start the run. See \ref RUN_CONTROL.
+ */
+void requestRun(sPartition *part, unsigned int run)
+{
+  pthread_mutex_lock(&part->mutex_run);
+  part->stats.run=run;
+  part->runRequested=run;
+  pthread_cond_broadcast(&part->cond_run);
+  pthread_mutex_unlock(&part->mutex_run);
+}
+
+/*!
+ * \fn bool waitRun(sPartition *part)
+ * \brief called by Builder_thread between runs : waits for the next run
+ * \return false if the partition is reset instead
+ */
+bool waitRun(sPartition *part)
+{
+  pthread_mutex_lock(&part->mutex_run);
+  while(part->runDone==part->runRequested && !part->closing)
+    pthread_cond_wait(&part->cond_run,&part->mutex_run);
+  bool run=(part->runDone!=part->runRequested);
+  pthread_mutex_unlock(&part->mutex_run);
+  return run;
+}
+
+/*!
+ * \fn void endRun(sPartition *part)
+ * \brief called by Builder_thread when the run is over and its statistics are set
+ */
+void endRun(sPartition *part)
+{
+  pthread_mutex_lock(&part->mutex_run);
+  part->runDone=part->runRequested;
+  pthread_cond_broadcast(&part->cond_run);
+  pthread_mutex_unlock(&part->mutex_run);
+}
+
+/*!
+ * \fn bool isRunDone(sPartition *part, bool wait)
+ * \brief called by the run control : whether Builder_thread has finished the last run
+ * \param wait to wait until it is finished
+ */
+bool isRunDone(sPartition *part, bool wait)
+{
+  pthread_mutex_lock(&part->mutex_run);
+  while(wait && part->runDone!=part->runRequested)
+    pthread_cond_wait(&part->cond_run,&part->mutex_run);
+  bool done=(part->runDone==part->runRequested);
+  pthread_mutex_unlock(&part->mutex_run);
+  return done;
+}
+
+/*!
+ * \fn std::string runSuffix()
+ * \brief "_runNNNNN" to make file names of each run unique under run control, empty otherwise
+ */
+std::string runSuffix()
+{
+  if(runControl==NULL)return "";
+  char buf[16];
+  sprintf(buf,"_run%05u",runNumber);
+  return buf;
+}
+
 /**
 \param sRBid 
 RingBufferID.
@@ -299,6 +838,11 @@ struct sRingBuffer{
                         //!< The value in Connection.conf will be read and set.
   LSTDAQ::RingBuffer* rb ;
   sRingBuffer* next;
+  volatile bool closed; //!< set when no more data comes to rb (link of a collector node closed)
+  sPartition* part;     //!< partition of the connection
+  volatile unsigned long nDrop;    //!< fragments lost on a full rb
+  volatile unsigned long nSkip;    //!< fragments thrown away by Builder_thread to catch up the trigger number
+  volatile unsigned long nMissing; //!< events built without the fragment of rb
 };
 sRingBuffer sRB[MAX_RINGBUF];
 
@@ -316,20 +860,30 @@ void sRBinit()
     sRB[i].Cid = -1;
     sRB[i].sRBid = -1;
     sRB[i].next = 0;
+    sRB[i].closed = false;
+    sRB[i].part = 0;
+    sRB[i].rb = 0;
+    sRB[i].nDrop = 0;
+    sRB[i].nSkip = 0;
+    sRB[i].nMissing = 0;
     // cout <<sRB[i].next<<endl;
   }
 }
 /*! 
- * \fn void sRBcreate(int nServ)
+ * \fn void sRBcreate(int first, int nServ)
  * \brief create RingBuffers
+ * \param first sRBid of the first RingBuffer
  * \param nServ number of Dragons
  */
-void sRBcreate(int nServ)
+void sRBcreate(int first, int nServ)
 {
-  for(int i=0; i<nServ; i++)
+  for(int i=first; i<first+nServ; i++)
   {
     sRB[i].sRBid = i;
     sRB[i].rb = new LSTDAQ::RingBuffer();
+    sRB[i].nDrop = 0;
+    sRB[i].nSkip = 0;
+    sRB[i].nMissing = 0;
     sRB[i].next=&sRB[i+1];
     // cout <<sRB[i].next<<endl;
   }
@@ -353,27 +907,255 @@ void sRBsetaddr(int sRBid, unsigned short shCid, char *szAddr, unsigned short sh
   }
 }
 
+/*! 
+ * \fn void sRBdelete()
+ * \brief delete RingBuffers
+ */
+void sRBdelete()
+{
+  for(int i=0; i<MAX_RINGBUF; i++)
+  {
+    delete sRB[i].rb;
+    sRB[i].rb = 0;
+  }
+}
+
+/********************************/
+// metrics
+/********************************/
+/**
+ Latest measurement of a partition by its ThruPutMes_thread, served by the metrics server (-H). See \ref METRICS.
+ It is kept apart from sPartition and guarded by mutex_metrics, so that the server reads it safely while the
+ partitions are made and deleted by the run control.
+ */
+struct sMetrics{
+  bool valid;                         //!< set while ThruPutMes_thread of the partition runs
+  char name[32];                      //!< name of the partition
+  int nRB;
+  char feb[MAX_CONNECTION][32];       //!< "<address>:<port>" of each FEB
+  unsigned long nw[MAX_CONNECTION];   //!< fragments written to each Ring Buffer
+  unsigned long nr[MAX_CONNECTION];   //!< fragments read by Builder_thread
+  double eventRate[MAX_CONNECTION];   //!< fragments per second from each FEB
+  unsigned long drop[MAX_CONNECTION]; //!< fragments lost on a full Ring Buffer
+  unsigned long skip[MAX_CONNECTION]; //!< fragments thrown away by Builder_thread to catch up the trigger number
+  unsigned long missing[MAX_CONNECTION]; //!< events built without the fragment of the FEB
+  unsigned long long built;           //!< events built over all the runs
+  double buildRate;                   //!< events built per second
+  unsigned long long wrLag;           //!< bytes not yet flushed by EventWriter
+  unsigned long long wrStall;         //!< stall of Builder_thread on EventWriter in the run [usec]
+  unsigned int run;                   //!< run number under run control
+  //percentiles of the current run by DAQtimer : p50, p99, p99.9, max
+  unsigned long long intervalNs[4];   //!< build interval [nsec]
+  unsigned long long latencyNs[4];    //!< event latency [nsec]
+  unsigned long long intervalCount;
+  unsigned long long intervalSumNs;
+  unsigned long long latencyCount;
+  unsigned long long latencySumNs;
+};
+sMetrics metrics[MAX_PARTITION];
+
+/**
+ Thread whose CPU time is served by the metrics server
+ */
+struct sThreadCpu{
+  pid_t tid;            //!< 0 for a free entry
+  char partition[32];   //!< name of the partition
+  char name[32];        //!< role of the thread, e.g. "collector0"
+};
+sThreadCpu threadCpu[MAX_CONNECTION+2*MAX_PARTITION];
+//! guards metrics[] and threadCpu[]
+pthread_mutex_t mutex_metrics=PTHREAD_MUTEX_INITIALIZER;
+
 /*!
- * \fn int getMaxCid()
- * \brief return max collector id
-*/
-int getMaxCid()
+ * \fn void addThreadCpu(sPartition *part, const char *name)
+ * \brief called by a thread at its start so that its CPU time is served by the metrics server
+ */
+void addThreadCpu(sPartition *part, const char *name)
 {
-  int maxCid=0;
-  for(int i=0;i<MAX_RINGBUF;i++)
+  if(metricsPort==0)return;
+  pthread_mutex_lock(&mutex_metrics);
+  for(int i=0;i<MAX_CONNECTION+2*MAX_PARTITION;i++)
   {
-    if(maxCid<sRB[i].Cid)maxCid=sRB[i].Cid;
+    if(threadCpu[i].tid!=0)continue;
+    threadCpu[i].tid=syscall(SYS_gettid);
+    snprintf(threadCpu[i].partition,sizeof(threadCpu[i].partition),"%s",part->name.c_str());
+    snprintf(threadCpu[i].name,sizeof(threadCpu[i].name),"%s",name);
+    break;
   }
-  return maxCid;
-  
+  pthread_mutex_unlock(&mutex_metrics);
+}
+
+/*!
+ * \fn void removeThreadCpu()
+ * \brief called by a thread added by addThreadCpu() at its end
+ */
+void removeThreadCpu()
+{
+  if(metricsPort==0)return;
+  pid_t tid=syscall(SYS_gettid);
+  pthread_mutex_lock(&mutex_metrics);
+  for(int i=0;i<MAX_CONNECTION+2*MAX_PARTITION;i++)
+    if(threadCpu[i].tid==tid)threadCpu[i].tid=0;
+  pthread_mutex_unlock(&mutex_metrics);
 }
 
-void sRBdelete(int nServ)
+/*!
+ * \fn void metricHeader(std::string &text, const char *name, const char *type, const char *help)
+ * \brief "# HELP" and "# TYPE" lines of a metric
+ */
+void metricHeader(std::string &text, const char *name, const char *type, const char *help)
+{
+  char line[256];
+  snprintf(line,sizeof(line),"# HELP %s %s\n# TYPE %s %s\n",name,help,name,type);
+  text+=line;
+}
+
+/*!
+ * \fn void metricValue(std::string &text, const char *name, const char *labels, double value)
+ * \brief one sample of a metric
+ */
+void metricValue(std::string &text, const char *name, const char *labels, double value)
+{
+  char line[256];
+  snprintf(line,sizeof(line),"%s{%s} %.15g\n",name,labels,value);
+  text+=line;
+}
+
+/*!
+ * \fn void writeMetrics(std::string &text)
+ * \brief makes the reply of the metrics server (LSTDAQ::MetricsServer) from metrics[] and threadCpu[]. See \ref METRICS.
+ */
+void writeMetrics(std::string &text)
 {
-  for(int i=0; i<nServ; i++)
+  //****** per FEB ******
+  static const char *febName[]={
+    "lstdaq_feb_bytes_total","lstdaq_feb_bytes_per_second","lstdaq_feb_events_total","lstdaq_feb_events_per_second",
+    "lstdaq_ring_occupancy","lstdaq_ring_fill_ratio","lstdaq_ring_drops_total","lstdaq_trigger_skips_total",
+    "lstdaq_fragments_missing_total"};
+  static const char *febType[]={
+    "counter","gauge","counter","gauge","gauge","gauge","counter","counter","counter"};
+  static const char *febHelp[]={
+    "Bytes received from the FEB.","Bytes per second received from the FEB.",
+    "Fragments received from the FEB.","Fragments per second received from the FEB.",
+    "Fragments in the Ring Buffer not yet read by the builder.","Fraction of the Ring Buffer in use.",
+    "Fragments lost because the Ring Buffer was full.","Fragments thrown away by the builder to catch up the trigger number.",
+    "Events built without the fragment of the FEB."};
+  char labels[160];
+  pthread_mutex_lock(&mutex_metrics);
+  for(int f=0;f<9;f++)
   {
-    delete sRB[i].rb;
+    metricHeader(text,febName[f],febType[f],febHelp[f]);
+    for(int p=0;p<MAX_PARTITION;p++)
+    {
+      sMetrics *m=&metrics[p];
+      if(!m->valid)continue;
+      for(int i=0;i<m->nRB;i++)
+      {
+	snprintf(labels,sizeof(labels),"partition=\"%s\",rb=\"%d\",feb=\"%s\"",m->name,i,m->feb[i]);
+	double value=0;
+	switch(f)
+	{
+	case 0: value=(double)m->nw[i]*EVENTSIZE; break;
+	case 1: value=m->eventRate[i]*EVENTSIZE; break;
+	case 2: value=m->nw[i]; break;
+	case 3: value=m->eventRate[i]; break;
+	case 4: value=(m->nw[i]>m->nr[i] ? m->nw[i]-m->nr[i] : 0); break;
+	case 5: value=(m->nw[i]>m->nr[i] ? (double)(m->nw[i]-m->nr[i])/RINGBUFSIZE : 0.); break;
+	case 6: value=m->drop[i]; break;
+	case 7: value=m->skip[i]; break;
+	case 8: value=m->missing[i]; break;
+	}
+	metricValue(text,febName[f],labels,value);
+      }
+    }
+  }
+
+  //****** per partition ******
+  static const char *partName[]={
+    "lstdaq_events_built_total","lstdaq_events_built_per_second","lstdaq_writer_lag_bytes",
+    "lstdaq_writer_stall_seconds","lstdaq_run"};
+  static const char *partType[]={"counter","gauge","gauge","gauge","gauge"};
+  static const char *partHelp[]={
+    "Events built.","Events built per second.","Bytes not yet flushed to the output files.",
+    "Time the builder waited for the writer in the current run.","Current run number under run control."};
+  for(int f=0;f<5;f++)
+  {
+    metricHeader(text,partName[f],partType[f],partHelp[f]);
+    for(int p=0;p<MAX_PARTITION;p++)
+    {
+      sMetrics *m=&metrics[p];
+      if(!m->valid)continue;
+      snprintf(labels,sizeof(labels),"partition=\"%s\"",m->name);
+      double value=0;
+      switch(f)
+      {
+      case 0: value=m->built; break;
+      case 1: value=m->buildRate; break;
+      case 2: value=m->wrLag; break;
+      case 3: value=m->wrStall*1e-6; break;
+      case 4: value=m->run; break;
+      }
+      metricValue(text,partName[f],labels,value);
+    }
+  }
+
+  //****** build interval and event latency of the current run ******
+  static const char *histoName[]={"lstdaq_build_interval_seconds","lstdaq_event_latency_seconds"};
+  static const char *histoHelp[]={
+    "Time between two events built.","Time from the first fragment of an event read to the event built."};
+  static const char *quantile[]={"0.5","0.99","0.999"};
+  for(int f=0;f<2;f++)
+  {
+    char name[64];
+    metricHeader(text,histoName[f],"summary",histoHelp[f]);
+    for(int p=0;p<MAX_PARTITION;p++)
+    {
+      sMetrics *m=&metrics[p];
+      if(!m->valid)continue;
+      unsigned long long *ns=(f==0 ? m->intervalNs : m->latencyNs);
+      for(int q=0;q<3;q++)
+      {
+	snprintf(labels,sizeof(labels),"partition=\"%s\",quantile=\"%s\"",m->name,quantile[q]);
+	metricValue(text,histoName[f],labels,ns[q]*1e-9);
+      }
+      snprintf(labels,sizeof(labels),"partition=\"%s\"",m->name);
+      snprintf(name,sizeof(name),"%s_sum",histoName[f]);
+      metricValue(text,name,labels,(f==0 ? m->intervalSumNs : m->latencySumNs)*1e-9);
+      snprintf(name,sizeof(name),"%s_count",histoName[f]);
+      metricValue(text,name,labels,(f==0 ? m->intervalCount : m->latencyCount));
+    }
+    snprintf(name,sizeof(name),"%s_max",histoName[f]);
+    metricHeader(text,name,"gauge","Largest value in the current run.");
+    for(int p=0;p<MAX_PARTITION;p++)
+    {
+      sMetrics *m=&metrics[p];
+      if(!m->valid)continue;
+      snprintf(labels,sizeof(labels),"partition=\"%s\"",m->name);
+      metricValue(text,name,labels,(f==0 ? m->intervalNs[3] : m->latencyNs[3])*1e-9);
+    }
+  }
+
+  //****** CPU time of the threads ******
+  metricHeader(text,"lstdaq_thread_cpu_seconds_total","counter","CPU time used by the thread.");
+  double tick=sysconf(_SC_CLK_TCK);
+  for(int i=0;i<MAX_CONNECTION+2*MAX_PARTITION;i++)
+  {
+    if(threadCpu[i].tid==0)continue;
+    char path[64];
+    char stat[512];
+    sprintf(path,"/proc/self/task/%d/stat",(int)threadCpu[i].tid);
+    FILE *fp=fopen(path,"r");
+    if(fp==NULL)continue;
+    bool ok=(fgets(stat,sizeof(stat),fp)!=NULL);
+    fclose(fp);
+    //utime and stime are the 12th and 13th fields after the command name in parentheses
+    char *p=(ok ? strrchr(stat,')') : NULL);
+    unsigned long utime,stime;
+    if(p==NULL || sscanf(p+1," %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",&utime,&stime)!=2)continue;
+    snprintf(labels,sizeof(labels),"partition=\"%s\",thread=\"%s\"",threadCpu[i].partition,threadCpu[i].name);
+    metricValue(text,"lstdaq_thread_cpu_seconds_total",labels,(utime+stime)/tick);
   }
+  pthread_mutex_unlock(&mutex_metrics);
 }
 
 /********************************/
@@ -385,8 +1167,13 @@ void sRBdelete(int nServ)
    *************************
    \section THRU_OPROC Procedures
    *************************
-   -# create file 
+   -# create file (with -l)
    -# initialize timer
+   -# samples Nw and Nr of the Ring Buffers at each tick of the timer and writes them to the file as they come
+   -# every METRICS_INTERVAL_MSEC, updates the metrics of the partition (sMetrics). See \ref METRICS.
+
+   It runs with -l or -H until the Builder_thread of the partition ends (or until reset under run control),
+   with the same memory however long the run is.
  */
 
 
@@ -395,16 +1182,10 @@ void *ThruPutMes_thread(void *arg)
   //basic preparation
   sRingBuffer *srb[MAX_CONNECTION];
   srb[0]= (sRingBuffer*)arg;
-//  double readfreqC[MAX_CONNECTION];//Collector
-//  double readrateC[MAX_CONNECTION];//Collector
-//  double readfreqB[MAX_CONNECTION];//Builder
-//  double readrateB[MAX_CONNECTION];//Builder
-  
-//  unsigned long Nw[MAX_CONNECTION]={0};
-  unsigned long Nr[MAX_NWMES][MAX_CONNECTION]={0};
-//  unsigned long prevNw[MAX_CONNECTION]={0};
-//  unsigned long prevNr[MAX_CONNECTION]={0};
-  unsigned long Nw[MAX_NWMES][MAX_CONNECTION]={0};
+  unsigned long Nr[MAX_CONNECTION]={0};
+  unsigned long Nw[MAX_CONNECTION]={0};
+  unsigned long long WrLag=0;  //bytes not yet flushed by EventWriter
+  unsigned long long WrStall=0;//total stall of Builder on EventWriter [usec]
 
   
   
@@ -418,60 +1199,56 @@ void *ThruPutMes_thread(void *arg)
     nRB++;
   }
   
-  int nColl = 1+ getMaxCid();
+  sPartition *part=srb[0]->part;
+  int nColl = part->nColl;
   
   //*********** CPU Specification    *************//
   int cpuid;
-  cpuid = (nColl+1)%Ncpu;
+  cpuid = part->thruPutCpu;
 #ifdef __CPU_ZERO
   cpu_set_t mask;
   __CPU_ZERO(&mask);
-  __CPU_SET(Ncpu-1,&mask);
+  __CPU_SET(cpuid,&mask);
   if(sched_setaffinity(0,sizeof(mask), &mask) == -1)
     printf("WARNING: failed to set CPU affinity... (cpuid=%d)\n",cpuid);
 #endif
+  addThreadCpu(part,"thruput");
   
   //*********** Output File Creation *************//
 
   //! \param fp_ms ring buffer log file discripter 
-  FILE *fp_ms;
+  FILE *fp_ms=NULL;
   char buf[128];
-  // sprintf(buf,"ThruPutMes_infreq%d_%dto%02d.dat"
-  //         ,infreq
-  //         ,nColl
-  //         ,nRB);
-  // FILE *fp_ms;
-  // fp_ms = fopen(buf,"w");
-  // fprintf(fp_ms,"InFreq=%d\n",infreq);
-  // fprintf(fp_ms,"readrate by Coll[Mbps], readrate by Bld[Mbps]\n");
-  sprintf(buf,"%s/RingBufMes_infreq%d_%dto%02d.dat"
-	  ,LOGPATH ,infreq ,nColl ,nRB);
-
-  fp_ms = fopen(buf,"w");
-  fprintf(fp_ms,"InFreq=%d\n",infreq);
-  fprintf(fp_ms,"Nw in RingBuffer　　　　　　Nr in RingBuffer\n");
+  if(logcreate)
+  {
+    sprintf(buf,"%s/RingBufMes%s_infreq%d_%dto%02d.dat"
+	    ,LOGPATH ,partitionSuffix(part).c_str() ,infreq ,nColl ,nRB);
+    fp_ms = fopen(buf,"w");
+  }
+  if(fp_ms!=NULL)
+  {
+    fprintf(fp_ms,"InFreq=%d\n",infreq);
+    fprintf(fp_ms,"Nw in RingBuffer　　　　　　Nr in RingBuffer\n");
   
-  fprintf(fp_ms, "count");
-  for(int i =0;i<nRB;i++)
-    {
-      fprintf(fp_ms, "   RB%02d   ",i);
-    }
-  for(int i =0;i<nRB;i++)
-    {
-      fprintf(fp_ms, "   RB%02d   ",i);
-    }
-  // for(int i =0;i<nRB;i++)
-  // {
-  //   fprintf(fp_ms, "  RB%02d_B[Mbps]  ",i);
-  // }
-  fprintf(fp_ms,"\n");
+    fprintf(fp_ms, "count");
+    for(int i =0;i<nRB;i++)
+      {
+	fprintf(fp_ms, "   RB%02d   ",i);
+      }
+    for(int i =0;i<nRB;i++)
+      {
+	fprintf(fp_ms, "   RB%02d   ",i);
+      }
+    fprintf(fp_ms, " WrLag[B]  WrStall[us]");
+    fprintf(fp_ms,"\n");
+  }
+  else if(logcreate)
+    printf("WARNING: failed to open %s\n",buf);
 
   //*********** Timer Initialization *************//
-  int interval;
   struct itimerspec its;
   int timerfd;
   int ret;
-  // interval = THRUPUTMES_INTERVAL;
   
   //time to begin;
   its.it_value.tv_sec = THRUPUTMES_STARTSEC;
@@ -485,94 +1262,121 @@ void *ThruPutMes_thread(void *arg)
   ret = timerfd_settime(timerfd, TFD_TIMER_ABSTIME, &its, NULL);
 
   //*********** Start Synchronization *************//
-  while(initEnd<nColl);
+  allowStart(part);
   // cout<<"Bld Confirmed all"<<endl;
   cout<<"*** ThruPutMes_thread initend ***"<<endl;
-  pthread_mutex_lock(&mutex_initLock);
-  pthread_cond_broadcast(&cond_allend);
-  pthread_mutex_unlock(&mutex_initLock);
 
+  //*********** Metrics of the partition *************//
+  sMetrics *m=&metrics[part-partition];
+  unsigned long ticksPerMetrics=METRICS_INTERVAL_MSEC*1000000ULL
+    /(THRUPUTMES_INTERVALSEC*1000000000ULL+THRUPUTMES_INTERVALNSEC);
+  if(ticksPerMetrics==0)ticksPerMetrics=1;
+  unsigned long prevNw[MAX_CONNECTION]={0};
+  unsigned long prevBuilt=0;
+  struct timespec tsPrev,tsNow;
+  clock_gettime(CLOCK_MONOTONIC,&tsPrev);
+  pthread_mutex_lock(&mutex_metrics);
+  *m=sMetrics();
+  m->valid=true;
+  snprintf(m->name,sizeof(m->name),"%s",part->name.c_str());
+  m->nRB=nRB;
+  for(int i=0;i<nRB;i++)
+    snprintf(m->feb[i],sizeof(m->feb[i]),"%s:%u",srb[i]->szAddr,srb[i]->shPort);
+  pthread_mutex_unlock(&mutex_metrics);
   
   //*********** RingBuffer Measuremet *************//
-//  fprintf(stderr, "  Throughput in Mbps   \n");
- // for(int i =0;i<nRB;i++)
- // {
- //   fprintf(stderr, "   RB%02d    ",i);
- // }
- //  fprintf(stderr, "\n");
-
   unsigned long Nread=0;
-  int ReadEnd=0;
-  bool bReadEnd[MAX_CONNECTION]={false};
   while (1)
   {
     uint64_t v;
     ret = read(timerfd, &v, sizeof(v));
     assert(ret == sizeof(v));
-    //    if (v > 1) {
-    //      fputc('o', stderr);
-    //    } else if (!quite) {
-    //      fputc('.', stderr);
-    //    }
     
+    //Nr first : a fragment read after Nw is sampled would make Nr > Nw
     for(int i =0;i<nRB;i++)
     {
-      Nw[Nread][i]=srb[i]->rb->getNw();
-      Nr[Nread][i]=srb[i]->rb->getNr();
+      Nr[i]=srb[i]->rb->getNr();
+      Nw[i]=srb[i]->rb->getNw();
     }
-    for(int i =0;i<nRB;i++)
+    //****** Builder_thread deletes the output at the end of each run ******
+    pthread_mutex_lock(&mutex_metrics);
+    if(part->evOutput!=NULL)
     {
-//      readfreqC[i]=(double)(Nw[i]-prevNw[i])/(double)interval;
-//      readrateC[i]=readfreqC[i]*(double)EVENTSIZE*8./1000./1000.;
-//      prevNw[i]=Nw[i];
-//      readfreqB[i]=(double)(Nr[i]-prevNr[i])/(double)interval;
-//      readrateB[i]=readfreqB[i]*(double)EVENTSIZE*8./1000./1000.;
-//      prevNr[i]=Nr[i];
-      
-      if(Nr[Nread][i]>=Ndaq && !bReadEnd[i])
-      {
-        ReadEnd++;
-        bReadEnd[i]=true;
-      }
+      WrLag=part->evOutput->getLagBytes();
+      WrStall=part->evOutput->getStallUsec();
     }
-//    for(int i =0;i<nRB;i++)
-//    {
-//      fprintf(stderr, "%8.3f  ",readrateC[i]);
-//    }
-//    fprintf(stderr, "\n");
-
-//    for(int i =0;i<nRB;i++)
-//    {
-//      fprintf(fp_ms,"%8.3f  ",readrateC[i]);
-//    }
-    // for(int i =0;i<nRB;i++)
-    // {
-    //   fprintf(fp_ms,"%8.3f  ",readrateB[i]);
-    // }
-//    fprintf(fp_ms, "\n");
-    Nread++;
-    if (Nread==MAX_NWMES)break;
-    // if (ReadEnd==nRB)break;
-    if (ReadEnd>0)break;
-  }
-
-  
-  for(int i=0; i<Nread;i++)
-  {
-    fprintf(fp_ms,"%5d ",i);
-    for(int j=0; j<nRB; j++)
+    pthread_mutex_unlock(&mutex_metrics);
+    if(fp_ms!=NULL)
     {
-      fprintf(fp_ms,"%9d ",Nw[i][j]);
+      fprintf(fp_ms,"%5lu ",Nread);
+      for(int j=0; j<nRB; j++)
+	{
+	  fprintf(fp_ms,"%9lu ",Nw[j]);
+	}
+      for(int j=0; j<nRB; j++)
+	{
+	  fprintf(fp_ms,"%9lu ",Nr[j]);
+	}
+      fprintf(fp_ms,"%9llu %11llu ",WrLag,WrStall);
+      fprintf(fp_ms, "\n");
     }
-    for(int j=0; j<nRB; j++)
+    Nread++;
+
+    if(Nread%ticksPerMetrics==0)
     {
-      fprintf(fp_ms,"%9d ",Nr[i][j]);
+      clock_gettime(CLOCK_MONOTONIC,&tsNow);
+      double sec=(tsNow.tv_sec-tsPrev.tv_sec)+(tsNow.tv_nsec-tsPrev.tv_nsec)*1e-9;
+      unsigned long built=part->nBuiltAll;
+      unsigned long newBuilt=built-prevBuilt;
+      pthread_mutex_lock(&mutex_metrics);
+      for(int i=0;i<nRB;i++)
+      {
+	m->nw[i]=Nw[i];
+	m->nr[i]=Nr[i];
+	m->eventRate[i]=(Nw[i]-prevNw[i])/sec;
+	m->drop[i]=srb[i]->nDrop;
+	m->skip[i]=srb[i]->nSkip;
+	m->missing[i]=srb[i]->nMissing;
+	prevNw[i]=Nw[i];
+      }
+      m->built+=newBuilt;
+      m->buildRate=newBuilt/sec;
+      m->wrLag=WrLag;
+      m->wrStall=WrStall;
+      m->run=part->stats.run;
+      //the percentiles are kept after the run until the next one starts
+      if(part->timer!=NULL)
+      {
+	LSTDAQ::LatencyHistogram *histo[2]={part->timer->getInterval(),part->timer->getLatency()};
+	for(int h=0;h<2;h++)
+	{
+	  unsigned long long *ns=(h==0 ? m->intervalNs : m->latencyNs);
+	  ns[0]=histo[h]->getPercentile(0.5);
+	  ns[1]=histo[h]->getPercentile(0.99);
+	  ns[2]=histo[h]->getPercentile(0.999);
+	  ns[3]=histo[h]->getMax();
+	}
+	m->intervalCount=histo[0]->getTotal();
+	m->intervalSumNs=histo[0]->getSum();
+	m->latencyCount=histo[1]->getTotal();
+	m->latencySumNs=histo[1]->getSum();
+      }
+      pthread_mutex_unlock(&mutex_metrics);
+      prevBuilt=built;
+      tsPrev=tsNow;
     }
-    
-    fprintf(fp_ms, "\n");
+    //under run control, the measurement goes on over runs until reset
+    if (stopRequested || part->closing || part->ended)break;
   }
-  fclose(fp_ms);
+
+  pthread_mutex_lock(&mutex_metrics);
+  m->valid=false;
+  pthread_mutex_unlock(&mutex_metrics);
+  removeThreadCpu();
+  if(fp_ms!=NULL)fclose(fp_ms);
+  close(timerfd);
   
+  return NULL;
 }
 
 
@@ -664,8 +1468,9 @@ void *Collector_thread(void *arg)
   /******************************************/
   //  CPU Specification
   /******************************************/
+  sPartition *part=srb[0]->part;
   int cpuid;
-  cpuid = Cid%Ncpu;
+  cpuid = part->collCpu[Cid];
 #ifdef __CPU_ZERO
   cpu_set_t mask;
   __CPU_ZERO(&mask);
@@ -673,6 +1478,11 @@ void *Collector_thread(void *arg)
   if(sched_setaffinity(0,sizeof(mask), &mask) == -1)
     printf("WARNING: failed to set CPU affinity... (cpuid=%d)\n",cpuid);
 #endif
+  char role[32];
+  sprintf(role,"Collector %d",Cid);
+  setRealtime(RT_PRIO_COLLECTOR,role);
+  sprintf(role,"collector%d",Cid);
+  addThreadCpu(part,role);
   
   
   /******************************************/
@@ -701,6 +1511,13 @@ void *Collector_thread(void *arg)
     srb_temp=srb_temp->next;
     //cout<<"srb["<<nServ<<"]->next :"<<srb_temp->next<<endl;
   }
+  //****** the rings are written here : on the NUMA node of this CPU (pages locked by -t are moved) ******
+  if(topology.getNnode()>1)
+  {
+    for(int i=0;i<nServ;i++)
+      if(!srb[i]->rb->setNode(topology.getNode(cpuid)))
+        printf("WARNING: failed to place RB%d on NUMA node %d\n",srb[i]->sRBid,topology.getNode(cpuid));
+  }
   // cout<< "*** RingBufferList owned by Collector"<<srb[0]->Cid<<endl;
   // for(int i=0;i<nServ;i++)
   // {
@@ -721,17 +1538,35 @@ void *Collector_thread(void *arg)
   unsigned long lConnected = 0;
   LSTDAQ::LIB::TCPClientSocket *tcps[MAX_CONNECTION];
   int sock[MAX_CONNECTION];
-  for(int i=0;i<nServ;i++)
+  int nConnected=0;
+  for(int i=0;i<nServ && !part->closing;i++)
   {
     tcps[i] = new LSTDAQ::LIB::TCPClientSocket();
-    if((tcps[i]->connectTcp(srb[i]->szAddr,
-                            srb[i]->shPort,
-                            lConnected)
-        )<0)
+    //connectTcp() returns the error code of the library, i.e. true on failure
+    if(tcps[i]->connectTcp(srb[i]->szAddr,
+                           srb[i]->shPort,
+                           lConnected))
     {
-      exit(1);
+      delete tcps[i];
+      printf("Collector %d : cannot connect %s:%u\n",Cid,srb[i]->szAddr,srb[i]->shPort);
+      if(runControl==NULL)exit(1);
+      break;
     }
     sock[i] = tcps[i]->getSock();
+    nConnected++;
+  }
+  if(nConnected<nServ)
+  {
+    //****** under run control, configure fails and the DAQ stays IDLE ******
+    failStart(part);
+    for(int i=0;i<nConnected;i++)
+    {
+      tcps[i]->closeSock();
+      delete tcps[i];
+    }
+    removeThreadCpu();
+    cout << "Coll"<<srb[0]->Cid <<" thread end"<<endl;
+    return NULL;
   }
   int maxfd=sock[0];
   fd_set fds, readfds;
@@ -742,17 +1577,22 @@ void *Collector_thread(void *arg)
     if(sock[i]>maxfd)maxfd=sock[i];
   }
   struct timeval tv;
-  tv.tv_sec = 0;
-  tv.tv_usec = 10000;
   
   /******************************************/
   //  Start Synchronization
   /******************************************/
   cout<<"*** CollInit end ***"<<endl;
-  initEnd++;
-  pthread_mutex_lock(&mutex_initLock);
-  pthread_cond_wait(&cond_allend,&mutex_initLock);
-  pthread_mutex_unlock(&mutex_initLock);
+  if(!waitStart(part))
+  {
+    for(int i=0;i<nServ;i++)
+    {
+      tcps[i]->closeSock();
+      delete tcps[i];
+    }
+    removeThreadCpu();
+    cout << "Coll"<<srb[0]->Cid <<" thread end"<<endl;
+    return NULL;
+  }
   
   /******************************************/
   //  Read From sock
@@ -769,6 +1609,9 @@ void *Collector_thread(void *arg)
   for(;;)
   {
     memcpy(&fds,&readfds,sizeof(fd_set));
+    //select() leaves the remaining time in tv : without a reset, it would poll without waiting
+    tv.tv_sec = 0;
+    tv.tv_usec = 10000;
     select(maxfd+1, &fds, NULL, NULL,&tv);
     for(int i=0;i<nServ;i++)
     {
@@ -778,7 +1621,13 @@ void *Collector_thread(void *arg)
 	reqsize=EVENTSIZE;
 	while(1)
 	{
-	  nRdBytes+=(tcps[i]->readSock(&tempbuf[nRdBytes],reqsize));
+	  ssize_t n=tcps[i]->readSock(&tempbuf[nRdBytes],reqsize);
+	  if(n<=0)
+	  {
+	    if(n<0 && errno==EINTR)continue;
+	    break;
+	  }
+	  nRdBytes+=n;
 	  if(nRdBytes==EVENTSIZE)
 	  {
 	    // cout<<"Y"<<nRdBytes<<endl;
@@ -794,14 +1643,29 @@ void *Collector_thread(void *arg)
 	  }
 	  // cout<<"N"<<nRdBytes<<endl;
 	}
+        //****** the FEB has closed the connection : no more data from it ******
+        if(nRdBytes<EVENTSIZE)
+        {
+          cout<<"RB"<<srb[i]->sRBid<<": connection closed by "<<srb[i]->szAddr<<":"<<srb[i]->shPort<<endl;
+          FD_CLR(sock[i],&readfds);
+          if(!bReadEnd[i])
+          {
+            ReadEnd++;
+            bReadEnd[i]=true;
+          }
+          continue;
+        }
         //if(nRdBytes != EVENTSIZE) is usual
         // cout<<"RB"<<srb[i]->sRBid<<"read"<<nRdBytes<<endl;
         // cout<<i<<"  "<<nRdBytes<<"  "<<llReadBytes[i]<<endl;
         // // cout<<tempbuf<<endl;
         
+        //****** under run control, data between runs is discarded ******
+        if(runControl!=NULL && !part->running)continue;
         if((srb[i]->rb->write(tempbuf,nRdBytes))==-1)
         {
           cout<<"RB"<<srb[i]->sRBid<<":W wait exceeded"<<endl;
+          srb[i]->nDrop++;
 	  //exit(1);
         }
 	else
@@ -809,7 +1673,7 @@ void *Collector_thread(void *arg)
 	  llReadBytes[i]+=nRdBytes;
 	}
         //cout<<"connection"<<i<<bReadEnd[i]<<endl;
-        if(llReadBytes[i]>=daqsize && !bReadEnd[i])
+        if(!continuous && runControl==NULL && llReadBytes[i]>=daqsize && !bReadEnd[i])
         {
           ReadEnd++;
           bReadEnd[i]=true;
@@ -820,9 +1684,153 @@ void *Collector_thread(void *arg)
       //cout << "Coll"<<srb[j]->sRBid <<" wrote :"<< tempbuf <<endl;
     }
     if (ReadEnd==nServ)break;
+    if (stopRequested || part->closing)break;
   }
   //sleep(3);
+  for(int i=0;i<nServ;i++)
+  {
+    tcps[i]->closeSock();
+    delete tcps[i];
+  }
+  removeThreadCpu();
   cout << "Coll"<<srb[0]->Cid <<" thread end"<<endl;
+  return NULL;
+}
+
+/*!
+ * \fn void makeMissingFragment(char *frag, unsigned long long trigger)
+ * \brief makes the fragment of EVENTSIZE bytes of a module without data for the trigger (see FRAGMENT_MISSING_MARK)
+ */
+void makeMissingFragment(char *frag, unsigned long long trigger)
+{
+  memset(frag,0,EVENTSIZE);
+  memcpy(frag,FRAGMENT_MISSING_MARK,AAAALEN+PPSLEN);
+  unsigned int raw=(unsigned int)trigger;
+  inverseByteOrder((char *)&raw,sizeof(unsigned int));
+  memcpy(&frag[POSTRGNO],&raw,TRGNOLEN);
+}
+
+/*!
+ * \fn bool isMissingFragment(const char *frag)
+ * \brief true if the fragment was made by makeMissingFragment()
+ */
+bool isMissingFragment(const char *frag)
+{
+  return memcmp(frag,FRAGMENT_MISSING_MARK,AAAALEN+PPSLEN)==0;
+}
+
+/********************************/
+// Node thread
+/********************************/
+/**
+   \func Node_thread
+   Collector_thread of the builder node in the two-tier event building.
+   Reads the sub-events of one collector node (LSTDAQ::SubEventReceiver) instead of FEBs, and writes
+   the fragment of each module of the sub-event to the module's RingBuffer, so that Builder_thread merges
+   the sub-events of all nodes by trigger number as it builds events from FEBs.
+   For a module flagged missing in the sub-event, a fragment marked with FRAGMENT_MISSING_MARK and the trigger
+   number of the sub-event is written instead, so that Builder_thread flags the module missing in the event
+   instead of resynchronizing on it (which would drop the event).
+   When the node closes the link, its RingBuffers are marked closed and the run of the partition ends once
+   they are read out, since no complete event can be built any more.
+ */
+void *Node_thread(void *arg)
+{
+  sRingBuffer *srb[MAX_CONNECTION];
+  srb[0]= (sRingBuffer*)arg;
+  //the node index is the collector ID
+  int node=srb[0]->Cid;
+
+  /******************************************/
+  //  CPU Specification
+  /******************************************/
+  char role[32];
+  sprintf(role,"Node %d",node);
+  setAffinity(&srb[0]->part->collCpu[node],1,role);
+  setRealtime(RT_PRIO_COLLECTOR,role);
+  sprintf(role,"node%d",node);
+  addThreadCpu(srb[0]->part,role);
+
+  /******************************************/
+  //  Search RBs
+  /******************************************/
+  sRingBuffer *srb_temp=srb[0]->next;
+  int nServ=1;
+  while(1)
+  {
+    if(srb_temp->sRBid==-1)break;
+    if(srb_temp->Cid == node)
+    {
+      srb[nServ]=srb_temp;
+      nServ++;
+    }
+    srb_temp=srb_temp->next;
+  }
+  unsigned char *buf=new unsigned char[EVENTSIZE*nServ];
+  LSTDAQ::EventHeader h;
+
+  /******************************************/
+  //  Start Synchronization
+  /******************************************/
+  cout<<"*** Node"<<node<<" init end ***"<<endl;
+  waitStart(srb[0]->part);
+
+  /******************************************/
+  //  Read sub-events
+  //         and Write fragments on RB
+  /******************************************/
+  unsigned long long nSubEvent=0;
+  for(;;)
+  {
+    int ret=nodeReceiver->read(node,&h,buf,NODE_POLL_MSEC);
+    if(ret<0)break;
+    if(ret>0)
+    {
+      for(int i=0;i<nServ;i++)
+      {
+        if(i<64 && (h.missing>>i&1))makeMissingFragment((char *)&buf[i*EVENTSIZE],h.trigger);
+        if((srb[i]->rb->write((char *)&buf[i*EVENTSIZE],EVENTSIZE))==-1)
+        {
+          cout<<"RB"<<srb[i]->sRBid<<":W wait exceeded"<<endl;
+          srb[i]->nDrop++;
+        }
+      }
+      nSubEvent++;
+      if(!continuous && nSubEvent>=Ndaq)break;
+    }
+    if (stopRequested)break;
+  }
+  for(int i=0;i<nServ;i++)srb[i]->closed=true;
+  delete[] buf;
+  removeThreadCpu();
+  cout << "Node"<<node<<" thread end : "<<nSubEvent<<" sub-events"<<endl;
+  return NULL;
+}
+
+/*!
+ * \fn bool readFragment(sRingBuffer *srb, char *buf, bool *ended)
+ * \brief waits for one fragment in the Ring Buffer and reads it
+ * \param ended set to true if no more data comes to the Ring Buffer (the run of the partition ends)
+ * \return false if DAQ or the run is stopped while waiting, or the Ring Buffer is closed and empty
+ *
+ * In real-time mode, the builder runs SCHED_FIFO : it sleeps while waiting, so that the SCHED_OTHER threads
+ * sharing its CPU (writer, workers) can run.
+ */
+bool readFragment(sRingBuffer *srb, char *buf, bool *ended)
+{
+  while(srb->rb->read(buf)==-1)
+  {
+    //****** closed : the last fragments may have come after the first read ******
+    if(srb->closed)
+    {
+      if(srb->rb->read(buf)!=-1)return true;
+      *ended=true;
+      return false;
+    }
+    if(stopRequested || runStopRequested)return false;
+    if(realtime)usleep(RT_IDLE_USEC);
+  }
+  return true;
 }
 
 /********************************/
@@ -864,6 +1872,55 @@ void *Collector_thread(void *arg)
   \subsection BLD_OUTFILE_OPEN Output File Creation
   ************************************************
   Prepares the outputfile.
+  When data is saved (-s), the file is handled by LSTDAQ::EventWriter. Builder_thread only copies
+  each built event into the current memory block of EventWriter, and the blocks are flushed to disk
+  from the writer thread, so that a stall of the disk does not stop event building directly.
+  The size and the number of the blocks are set by -b and -B options.
+  The file is written by the output engine selected with -e option: "buffered" writes through the page cache,
+  "direct" writes with O_DIRECT keeping -q blocks in flight by native AIO (see LSTDAQ::OutputFile).
+  With -d dir1,dir2,... the events are striped over the directories with one writer thread each,
+  and a stripe index locating each trigger number is written (see LSTDAQ::EventOutput).
+  With -R sec and/or -G GB, the output is switched to a new file (suffix _fNNNN) every given time or size.
+  Files are reserved with fallocate() by the size given by -G.
+  Each event starts with LSTDAQ::EventHeader, which holds the trigger number unwrapped to 64 bits.
+  An event index <file>.idx is written alongside each .dat file (see LSTDAQ::EventReader).
+  The fragments are assembled directly into buffers of LSTDAQ::EventBufferPool, and the built event is passed
+  by pointer to the next stage, which releases the buffer when done. When all the buffers are in use,
+  Builder_thread waits for one to be released, and the Ring Buffers absorb the backlog meanwhile.
+  When some processing of events is enabled (e.g. -z), the events are passed to LSTDAQ::WorkerPool instead,
+  which runs the stages (LSTDAQ::EventProcessor) on -w worker threads and writes the events in order.
+  -z compresses the waveforms (LSTDAQ::WaveformCodec). -p packs them to 12 bit samples (LSTDAQ::Pack12),
+  which is faster but saves less; -z is used if both are given.
+  -g thr keeps one gain per channel (LSTDAQ::GainSelector) before them.
+  -P file subtracts the DRS4 pedestals of the file (LSTDAQ::PedestalSubtractor) first of all.
+  With several partitions, each one reads file_<name>, as written by the pedestal run -T file.
+  -Z peak[,charge] then keeps only the channels with signal and their neighbours (LSTDAQ::ZeroSuppressor)
+  in a sparse layout, which is not encoded further by -z/-p.
+  -D window extracts charge and peak time of each channel (LSTDAQ::ChargeExtractor) before -Z and writes them
+  to a separate stream <file>_dl1, or instead of the waveforms with -X.
+  -F mult:thr:n / topo:thr:n (repeatable) writes only the events accepted by one of the filters on the pixel charges
+  (LSTDAQ::SoftwareTrigger), plus 1 of -K rejected events. DL1 records are written for all events.
+  -A stores the samples as [gain][pixel][sample] arrays with a separate table of module headers
+  (LSTDAQ::SoaTransposer) instead of -Z, -z and -p.
+  With -M N, the events are also published to LSTDAQ::EventDispatcher, which hands them to consumers
+  (LSTDAQ::EventConsumer) on their own threads. The online monitor (LSTDAQ::EventMonitor) sees 1 of N events
+  and skips events while it is behind, so it never slows down the output.
+  With -m name, the events are also copied to the POSIX shared memory ring /dev/shm/name (LSTDAQ::ShmPublisher),
+  where any number of local programs can follow them with LSTDAQ::ShmReader (see tools/ShmRead.cpp).
+  With -E unix:path or -E tcp:port, clients on localhost (e.g. event display) get the events over a socket
+  with their own prescale and trigger type selection (LSTDAQ::StreamServer).
+  With -U host:port,node, this LSTDAQ is collector node "node" of a two-tier event building : the events built
+  from the FEBs of its Connection.conf are sent as sub-events to the builder node (LSTDAQ::SubEventSender)
+  instead of being processed here. The builder node, started with -N port,nNode, waits for nNode collector nodes
+  (LSTDAQ::SubEventReceiver) and uses one Node_thread per node instead of Collector_threads.
+  The modules are numbered by node, and the sub-events are merged by trigger number in the same way as
+  fragments from FEBs, so that all the options above apply to the events of the whole camera.
+  Each collector node has its own configuration file (-f) to run several of them on one host.
+  With -T file (pedestal run), no event is written. The workers accumulate the statistics of every DRS4 cell
+  (LSTDAQ::PedestalAccumulator) and only the pedestal file for -P is written at the end.
+  Under run control (-Q), the steps from Output File Creation are done for each run by Builder_run(), and the
+  output files get the suffix _runNNNNN. The Ring Buffers, the event buffers and the consumers of -M/-m/-E are
+  kept over runs. See \ref RUN_CONTROL.
 
   ************************************************
   \subsection BLD_STARTSYNC Synchronizes threads before starting DAQ.
@@ -903,7 +1960,8 @@ void *Collector_thread(void *arg)
   ************************************************ 
   \subsection BLD_SUBMITSUMMARY Submit summary of DAQ
   ************************************************
-  Tell LSTDAQ::DAQtimer object to make summary of DAQ measurement.
+  Tell LSTDAQ::DAQtimer object to make summary of DAQ measurement, with the percentiles of the build interval and
+  of the event latency over the whole run.
   
   ************************************************ 
   \subsection BLD_RB_DATAUNLOAD Unload remaining data from RingBuffer
@@ -915,77 +1973,148 @@ void *Collector_thread(void *arg)
   ************************************************
  
  */
-void *Builder_thread(void *arg)
+/*!
+ * \fn unsigned long Builder_run(sPartition *part, sRingBuffer **srb, int nRB, LSTDAQ::EventDispatcher *dispatcher, LSTDAQ::EventBufferPool *&bufPool)
+ * \brief one run of Builder_thread : opens the outputs, builds events until Ndaq events or stop, and writes the summary
+ * \param bufPool made at the first run and kept for the next runs
+ * \return number of events built
+ */
+unsigned long Builder_run(sPartition *part, sRingBuffer **srb, int nRB,
+			  LSTDAQ::EventDispatcher *dispatcher, LSTDAQ::EventBufferPool *&bufPool)
 {
-  /******************************************/
-  //     basic preparation
-  /******************************************/
-  sRingBuffer *srb[MAX_CONNECTION];
   int offset;
-  srb[0]= (sRingBuffer*)arg;
-  char tempbuf[EVENTSIZE*MAX_CONNECTION];
-  unsigned char *p;
-  unsigned char headerbuf[16];
-  p=headerbuf;
-  
-  memcpy(p,"EHDR99999999",12);
-  p+=12;
-  
-  
+  int nColl = part->nColl;
+  LSTDAQ::EventHeader evh;
+  LSTDAQ::initEventHeader(&evh);
 
-  cout<<"*** Builder_thread initialization ***"<<endl;
-  int nRB =0;
-  while(1)
-  {
-    if(srb[nRB]->next==0||nRB==MAX_RINGBUF)break;
-    //    cout<<"srb["<<nRB<<"] :"<<srb[nRB]->sRBid<<endl;
-    srb[nRB+1]=srb[nRB]->next;
-    nRB++;
-  }
-  
-  int nColl = 1+ getMaxCid();
-  
-  /******************************************/
-  //  CPU Specification
-  /******************************************/
-  int cpuid;
-  cpuid = nColl%Ncpu;
-#ifdef __CPU_ZERO
-  cpu_set_t mask;
-  __CPU_ZERO(&mask);
-  __CPU_SET(Ncpu,&mask);
-  if(sched_setaffinity(0,sizeof(mask), &mask) == -1)
-    printf("WARNING: failed to set CPU affinity... (cpuid=%d)\n",cpuid);
-#endif
-  
   /******************************************/
   //    Output File Creation
   /******************************************/
+  //the writer and worker threads made here do not inherit the CPU of the builder
+  setAffinity(part->helperCpu,part->nHelperCpu,"Builder");
   char buf[128];
   // sprintf(buf,"/media/RAID0_Intel/150224/infreq%d_nColl%d_nRB%d.dat"
-  sprintf(buf,"%s_infreq%d_nColl%d_nRB%d.dat"
+  sprintf(buf,"%s%s%s_infreq%d_nColl%d_nRB%d"
 	  ,fileNameHeader.c_str()
+	  ,partitionSuffix(part).c_str()
+	  ,runSuffix().c_str()
           ,infreq
           ,nColl
           ,nRB);
-  FILE *fp_data;
-  if((fp_data = fopen(buf,"w"))==NULL){
-    cout<<"output file open error!!"<<endl;
-    exit(1);
+  LSTDAQ::EventOutput *output=NULL;
+  if(datacreate==true)
+  {
+    output=new LSTDAQ::EventOutput(writeBlockSizeMB*1024*1024,writeNblock,outputEngine,outputQdepth);
+    output->setDirectories(outputDirs.c_str(),stripeChunkMB);
+    output->setRotation(rotateSec,rotateGB);
+    if(!output->open(buf)){
+      cout<<"output file open error!!"<<endl;
+      exit(1);
+    }
+    pthread_mutex_lock(&mutex_metrics);
+    part->evOutput=output;
+    pthread_mutex_unlock(&mutex_metrics);
+  }
+  LSTDAQ::EventOutput *dl1Output=NULL;
+  if(datacreate==true && dl1Window>0 && !dl1Only)
+  {
+    char dl1buf[160];
+    sprintf(dl1buf,"%s_dl1",buf);
+    dl1Output=new LSTDAQ::EventOutput(writeBlockSizeMB*1024*1024,writeNblock,outputEngine,outputQdepth);
+    dl1Output->setRotation(rotateSec,rotateGB);
+    if(!dl1Output->open(dl1buf)){
+      cout<<"DL1 output file open error!!"<<endl;
+      exit(1);
+    }
+  }
+  //****** collector node : sub-events go to the builder node ******
+  LSTDAQ::SubEventSender *uplink=NULL;
+  if(uplinkAddress.length()>0)
+  {
+    uplink=new LSTDAQ::SubEventSender();
+    if(!uplink->connect(uplinkAddress.c_str(),nodeId,nRB))
+    {
+      cout<<"uplink connection error!!"<<endl;
+      exit(1);
+    }
+  }
+  LSTDAQ::WorkerPool *pool=NULL;
+  if(pedestalRunFile.length()>0)
+  {
+    pool=new LSTDAQ::WorkerPool(nWorker,nWorker*WORKER_NSLOT,EVENTSIZE*nRB);
+    pool->addProcessor(new LSTDAQ::PedestalAccumulator(nRB,(pedestalRunFile+partitionSuffix(part)+runSuffix()).c_str()));
+    pool->setDispatcher(dispatcher);
+    pool->start(NULL);
+  }
+  else if(datacreate==true && nWorker>0)
+  {
+    pool=new LSTDAQ::WorkerPool(nWorker,nWorker*WORKER_NSLOT,EVENTSIZE*nRB);
+    if(part->pedestal!=NULL)pool->addProcessor(new LSTDAQ::PedestalSubtractor(part->pedestal));
+    if(gainselThreshold>0)pool->addProcessor(new LSTDAQ::GainSelector(gainselThreshold));
+    if(dl1Window>0)pool->addProcessor(new LSTDAQ::ChargeExtractor(dl1Window,dl1Only));
+    if(nFilter>0)
+    {
+      LSTDAQ::SoftwareTrigger *trigger=new LSTDAQ::SoftwareTrigger(prescale,dl1Window>0 ? dl1Window : DL1_WINDOW);
+      for(int i=0;i<nFilter;i++)trigger->addFilter(LSTDAQ::EventFilter::create(filterSpec[i].c_str()));
+      pool->addProcessor(trigger);
+    }
+    if(zsPeak>0 || zsCharge>0)pool->addProcessor(new LSTDAQ::ZeroSuppressor(zsPeak,zsCharge));
+    else if(soa)pool->addProcessor(new LSTDAQ::SoaTransposer());
+    pool->setSideOutput(dl1Output);
+    pool->setDispatcher(dispatcher);
+    if(compress)pool->addProcessor(new LSTDAQ::WaveformCodec());
+    else if(pack12)pool->addProcessor(new LSTDAQ::Pack12());
+    pool->start(output);
   }
+  setAffinity(&part->builderCpu,1,"Builder");
   
+  //****** events are built directly into pooled buffers, passed on without copy ******
+  int nBuffer=EVENTPOOL_NSPARE;
+  unsigned int bufSize=EVENTSIZE*nRB;
+  if(pool!=NULL)
+  {
+    nBuffer+=pool->getNslot();
+    bufSize=pool->getBufferSize();
+  }
+  if(dispatcher!=NULL)nBuffer+=dispatcher->getNbufferHeld();
+  //the pool is kept over runs : the sizes are the same for every run
+  if(bufPool==NULL)bufPool=new LSTDAQ::EventBufferPool(nBuffer,bufSize);
+  //the buffers of the run
+  lockMemory(false);
+  LSTDAQ::EventBuffer *ev=bufPool->acquire();
+  char *tempbuf=(char *)ev->data;
+
   int dataLength = EVENTSIZE*nRB;
+  evh.nModule=nRB;
+  evh.size=dataLength;
   
   /******************************************/
   //    Start Synchronization
   /******************************************/
-  while(initEnd<nColl);
+  if(runControl!=NULL)
+  {
+    //****** fragments left from before the run ******
+    for(int i=0;i<nRB;i++)
+      while(srb[i]->rb->read(tempbuf)!=-1)continue;
+  }
+  part->nBuilt=0;
+  part->running=true;
+  //****** the writer and worker threads started above stay SCHED_OTHER ******
+  //a polling SCHED_FIFO builder would starve any other thread on its CPU
+  const char *sharedWith=NULL;
+  for(int c=0;c<nColl;c++)
+    if(part->collCpu[c]==part->builderCpu)sharedWith="a collector";
+  for(int k=0;k<part->nHelperCpu && sharedWith==NULL && hasHelperThreads();k++)
+    if(part->helperCpu[k]==part->builderCpu)sharedWith="the writer and worker threads";
+  if(sharedWith==NULL && (logcreate || metricsPort>0) && part->thruPutCpu==part->builderCpu)sharedWith="ThruPutMes";
+  bool ownCpu=(sharedWith==NULL);
+  if(realtime && !ownCpu)
+    printf("WARNING: Builder : stays SCHED_OTHER on cpu %d shared with %s\n",part->builderCpu,sharedWith);
+  setRealtime(ownCpu ? RT_PRIO_BUILDER : 0,"Builder");
+  allowStart(part);
   // cout<<"Bld Confirmed all"<<endl;
   cout<<"*** Builder_thread starts to read ***"<<endl;
   cout<<Ndaq <<" events from "<<nRB<<"RBs "<<endl;
-  pthread_mutex_lock(&mutex_initLock);
-  pthread_cond_broadcast(&cond_allend);
-  pthread_mutex_unlock(&mutex_initLock);
   
 //  *********** Read Data From RingBuffer without build *************//
 //  bool bReadEnd[MAX_CONNECTION]={false};
@@ -1073,12 +2202,24 @@ void *Builder_thread(void *arg)
   unsigned long rNtrg;  //read Ntrg. first set to rNtrg=cNtrg, when larger Ntrg is come, stored.
   unsigned int *p_Ntrg[MAX_CONNECTION];
   unsigned int *p_Nevt[MAX_CONNECTION];
-  unsigned long Ntrg[MAX_CONNECTION]={0};
-  unsigned long Nevt[MAX_CONNECTION]={0}; 
+  unsigned int rawNtrg,rawNevt;   //32 bit counters in the fragment
+  unsigned long Ntrg[MAX_CONNECTION]={0};//unwrapped to 64 bits
+  unsigned long Nevt[MAX_CONNECTION]={0};
+  unsigned long long missing;     //modules without data in the current event
+  bool bMissing[MAX_CONNECTION]={false};//the fragment read last is a missing mark of the builder node
+  struct timespec tsBuild;        //build time recorded in the event index
   LSTDAQ::DAQtimer *dt=new LSTDAQ::DAQtimer(nRB);
   dt->DAQstart();
+  pthread_mutex_lock(&mutex_metrics);
+  part->timer=dt;
+  pthread_mutex_unlock(&mutex_metrics);
+  bool evBegun=false;             //the first fragment of the event is read
+  bool dataEnded=false;           //a closed Ring Buffer is read out : the run ends
+  struct timespec tsRunStart;
+  clock_gettime(CLOCK_MONOTONIC,&tsRunStart);
   
   cNtrg=0;
+  rNtrg=0;
   int SkipRB=-1;
   unsigned int *id;
 
@@ -1087,17 +2228,24 @@ void *Builder_thread(void *arg)
   {
     unsigned int idfake=0;
     offset=0;
+    missing=0;
     for(unsigned int i=0;i<nRB;i++)
       {
       // cout<<"SkipRB"<<SkipRB<<endl;
       if(i==SkipRB||bReadEnd[i])
 	{
+	  if((i!=SkipRB || bMissing[i]) && i<64)missing|=1ULL<<i;
 	  offset+=EVENTSIZE;
 	}
       else
 	{
 	  // cout<<i<<" "<<SkipRB<<endl;
-	  while(srb[i]->rb->read(&tempbuf[offset])==-1)continue;
+	  if(!readFragment(srb[i],&tempbuf[offset],&dataEnded))break;
+	  if(!evBegun)
+	    {
+	      dt->readbegin();
+	      evBegun=true;
+	    }
 	  //	  memcpy(&tempbuf[offset+1],&i,sizeof(unsigned int));
 	  //	  memcpy(&tempbuf[offset+POSCLK+CLKLEN],&i,sizeof(i));
 	  //	  memcpy(&tempbuf[offset+POSCLK+CLKLEN],"ID==",4);
@@ -1109,10 +2257,13 @@ void *Builder_thread(void *arg)
 	  // if(!bReadStart)bReadStart=true;
 	  p_Nevt[i]=(unsigned int*)&tempbuf[offset+POSEVTNO];
 	  p_Ntrg[i]=(unsigned int*)&tempbuf[offset+POSTRGNO];
-	  Nevt[i]=(unsigned int)*p_Nevt[i];
-	  Ntrg[i]=(unsigned int)*p_Ntrg[i];
-	  inverseByteOrder((char *)&Nevt[i],sizeof(unsigned int));
-	  inverseByteOrder((char *)&Ntrg[i],sizeof(unsigned int));
+	  rawNevt=*p_Nevt[i];
+	  rawNtrg=*p_Ntrg[i];
+	  inverseByteOrder((char *)&rawNevt,sizeof(unsigned int));
+	  inverseByteOrder((char *)&rawNtrg,sizeof(unsigned int));
+	  bMissing[i]=isMissingFragment(&tempbuf[offset]);
+	  if(!bMissing[i])Nevt[i]=unwrapCounter(rawNevt,Nevt[i]);
+	  Ntrg[i]=unwrapCounter(rawNtrg,Ntrg[i]);
 	  //	  cout<<"i="<<i<<" offset="<<offset<<endl;
 	  // if(i==0)
 	  // cout<<"-- sRBid="<<srb[i]->szAddr<<" i="<<i<<" Nevt="<<Nevt[i]<<" Ntrg="<<Ntrg[i]<<
@@ -1127,13 +2278,15 @@ void *Builder_thread(void *arg)
 	  
 	  if(Ntrg[i]==cNtrg)
 	    {
+	      if(bMissing[i] && i<64)missing|=1ULL<<i;
 	      offset+=EVENTSIZE;
 	    }
 	  else if(Ntrg[i]<cNtrg)
 	    {
 	      while(1)
 		{
-		  while(srb[i]->rb->read(&tempbuf[offset])==-1)continue;
+		  srb[i]->nSkip++;//the fragment read last is overwritten
+		  if(!readFragment(srb[i],&tempbuf[offset],&dataEnded))break;
 		  //		  memcpy(&tempbuf[offset+POSCLK+CLKLEN],"ID==",4);
 		  //	  cout<<"i="<<i<<endl;
 		  //		  idfake=i+265;
@@ -1143,16 +2296,20 @@ void *Builder_thread(void *arg)
 		  
 		  p_Nevt[i]=(unsigned int*)&tempbuf[offset+POSEVTNO];
 		  p_Ntrg[i]=(unsigned int*)&tempbuf[offset+POSTRGNO];
-		  Nevt[i]=(unsigned int)*p_Nevt[i];
-		  Ntrg[i]=(unsigned int)*p_Ntrg[i];
-		  inverseByteOrder((char *)&Nevt[i],sizeof(unsigned int));
-		  inverseByteOrder((char *)&Ntrg[i],sizeof(unsigned int));
+		  rawNevt=*p_Nevt[i];
+		  rawNtrg=*p_Ntrg[i];
+		  inverseByteOrder((char *)&rawNevt,sizeof(unsigned int));
+		  inverseByteOrder((char *)&rawNtrg,sizeof(unsigned int));
+		  bMissing[i]=isMissingFragment(&tempbuf[offset]);
+		  if(!bMissing[i])Nevt[i]=unwrapCounter(rawNevt,Nevt[i]);
+		  Ntrg[i]=unwrapCounter(rawNtrg,Ntrg[i]);
 		  //	    cout<<"sRBid = "<<srb[i]->szAddr<<" "<<i<<" nevt="<<Nevt[i]<<endl;
 		  // cout<<"sRBid="<<srb[i]->szAddr<<" "<<i<<" Nevt="<<Nevt[i]<<" Ntrg="<<Ntrg[i]<<
 		  //   " offset="<<offset<<" POSEVTNO="<<POSEVTNO<<"POSTRGNO "<<POSTRGNO<<endl;
 		  Nread[i]++;
 
-		  if(Nevt[i]>=Ndaq)
+		  //events of the run, as the event number of the FEB goes on over runs
+		  if(Nread[i]>=Ndaq)
 		    {
 		      //	       TERM_COLOR_RED;printf("Builder : RB%d end\n",i); TERM_COLOR_RESET;
 		      TERM_COLOR_RED;printf("Builder : RB%d end : %d >= %d\n",i, Nread[i],Ndaq); TERM_COLOR_RESET;
@@ -1162,6 +2319,7 @@ void *Builder_thread(void *arg)
 		    }
 		  if(Ntrg[i]==cNtrg)
 		    {
+		      if(bMissing[i] && i<64)missing|=1ULL<<i;
 		      offset+=EVENTSIZE;
 		      break;
 		    }
@@ -1177,6 +2335,7 @@ void *Builder_thread(void *arg)
 		      break;
 		    }
 		}//while(1)
+	      if(stopRequested || runStopRequested || dataEnded)break;
 	    }//if(skip or end)
 	  else //if(Ntrg[i]>cNtrg)
 	    {
@@ -1196,26 +2355,48 @@ void *Builder_thread(void *arg)
       if(cNtrg==rNtrg && i==(nRB-1))
 	{
 	  dt->readend();
-	  memcpy(headerbuf+12,&cNtrg,sizeof(unsigned long));
-	  //*(unsigned long *)p = cNtrg;
-	  // p+=sizeof(unsigned long);
+	  evBegun=false;
+	  evh.trigger=cNtrg;
+	  evh.missing=missing;
+	  if(missing!=0)
+	    for(int j=0;j<nRB;j++)
+	      if(j<64 && (missing>>j&1))srb[j]->nMissing++;
+	  //fwrite;
+	  if(pool!=NULL || datacreate==true || dispatcher!=NULL || uplink!=NULL)
+	    {
+	      clock_gettime(CLOCK_REALTIME,&tsBuild);
+	      memcpy(&ev->header,&evh,sizeof(evh));
+	      ev->timeNs=(unsigned long long)tsBuild.tv_sec*1000000000ULL+tsBuild.tv_nsec;
+	      if(pool!=NULL)
+		pool->submit(ev);//the pool releases it after writing
+	      else
+		{
+		  if(output!=NULL)output->write(&ev->header,ev->data,ev->timeNs);
+		  if(uplink!=NULL && !uplink->send(&ev->header,ev->data))
+		    {
+		      cout<<"uplink to the builder node is broken"<<endl;
+		      stopRequested=1;
+		    }
+		  if(dispatcher!=NULL)dispatcher->publish(ev);
+		  LSTDAQ::EventBufferPool::release(ev);
+		}
+	      //waits here if all the buffers are still in the pipeline (NULL on stop)
+	      ev=bufPool->acquire(isStopRequested);
+	      if(ev!=NULL)tempbuf=(char *)ev->data;
+	    }
 	  NreadAll++;
+	  part->nBuilt=NreadAll;
+	  part->nBuiltAll++;
 	  cNtrg++;
 	  rNtrg++;
 	  SkipRB=-1;
-	  //fwrite;
-	  if(datacreate==true)
-	    {
-	      fwrite(headerbuf,16,1,fp_data);
-	      fwrite(&tempbuf,dataLength,1,fp_data);
-	    }
 	}
       
     }
     //    cout<<"Read End"<<ReadEnd<<endl;
     // if (ReadEnd==nRB)break;
     //    if (ReadEnd>0)
-    if(NreadAll==Ndaq)
+    if(NreadAll==Ndaq || stopRequested || runStopRequested || dataEnded || ev==NULL)
       {
 	cout<<"Read End"<<ReadEnd<<" NreadAll="<<NreadAll<<endl;
 	break;
@@ -1223,83 +2404,777 @@ void *Builder_thread(void *arg)
   }
   
   dt->DAQend();
+  setRealtime(0,"Builder");
+  part->running=false;
+  struct timespec tsRunEnd;
+  clock_gettime(CLOCK_MONOTONIC,&tsRunEnd);
+  part->stats.nEvent=NreadAll;
+  part->stats.sec=(tsRunEnd.tv_sec-tsRunStart.tv_sec)+(tsRunEnd.tv_nsec-tsRunStart.tv_nsec)*1e-9;
+  part->stats.bytesIn=(unsigned long long)NreadAll*dataLength;
+  part->stats.bytesOut=(pool!=NULL ? pool->getBytesOut() : part->stats.bytesIn);
+  part->stats.file=(output!=NULL ? buf : "");
+  pthread_mutex_lock(&mutex_summary);
+  if(nPartition>1)cout<<"****** partition "<<part->name<<" ******"<<endl;
   dt->DAQsummary(infreq,NreadAll,nRB,nColl,Ntrg,Nevt);
-  fclose(fp_data);
+  if(pool!=NULL)
+  {
+    pool->close();
+    pool->printSummary();
+  }
+  if(output!=NULL)
+  {
+    output->close();
+    output->printSummary();
+  }
+  if(dl1Output!=NULL)
+  {
+    dl1Output->close();
+    dl1Output->printSummary();
+  }
+  if(uplink!=NULL)
+  {
+    uplink->close();
+    uplink->printSummary();
+    delete uplink;
+  }
+  if(nodeReceiver!=NULL)nodeReceiver->printSummary();
+  char drainbuf[EVENTSIZE];
   for(int i=0;i<nRB;i++)
   {
-    while(srb[i]->rb->read(&tempbuf[offset])!=-1)continue;
+    while(srb[i]->rb->read(drainbuf)!=-1)continue;
   }
-  cout << "Builder thread end."<< NreadAll<<"data was read."<<endl;
-  //sleep(1);
+  if(ev!=NULL)LSTDAQ::EventBufferPool::release(ev);
+  if(runControl!=NULL)
+  {
+    //****** the next run opens its own outputs ******
+    pthread_mutex_lock(&mutex_metrics);
+    part->evOutput=NULL;
+    pthread_mutex_unlock(&mutex_metrics);
+    delete pool;
+    delete output;
+    delete dl1Output;
+    cout<<"Run "<<part->stats.run<<" end. "<<NreadAll<<"data was read."<<endl;
+  }
+  pthread_mutex_unlock(&mutex_summary);
+  pthread_mutex_lock(&mutex_metrics);
+  part->timer=NULL;
+  pthread_mutex_unlock(&mutex_metrics);
+  delete dt;
+  return NreadAll;
 }
 
+void *Builder_thread(void *arg)
+{
+  /******************************************/
+  //     basic preparation
+  /******************************************/
+  sRingBuffer *srb[MAX_CONNECTION];
+  srb[0]= (sRingBuffer*)arg;
 
-/****************************/
-// main
-/****************************/
-/** 
- \func main
- \param infreq
- \brief Input frequency.
-  This is used only for making report.
- \param Ndaq
- \brief The number of events to acquire.\n
- default 100000
- \param datacreate
- \brief Whether data will be saved.
- 
+  cout<<"*** Builder_thread initialization ***"<<endl;
+  int nRB =0;
+  while(1)
+  {
+    if(srb[nRB]->next==0||nRB==MAX_RINGBUF)break;
+    //    cout<<"srb["<<nRB<<"] :"<<srb[nRB]->sRBid<<endl;
+    srb[nRB+1]=srb[nRB]->next;
+    nRB++;
+  }
+  
+  sPartition *part=srb[0]->part;
+  
+  /******************************************/
+  //  CPU Specification
+  /******************************************/
+  //the consumer threads made here do not inherit the CPU of the builder
+  setAffinity(part->helperCpu,part->nHelperCpu,"Builder");
+  addThreadCpu(part,"builder");
+  
+  //****** consumers of the built events besides the output ******
+  LSTDAQ::EventDispatcher *dispatcher=NULL;
+  if(monitorPrescale>0 || shmName.length()>0 || streamAddress.length()>0)
+  {
+    dispatcher=new LSTDAQ::EventDispatcher();
+    if(monitorPrescale>0)
+      dispatcher->addConsumer(new LSTDAQ::EventMonitor(),DISPATCH_DROP,monitorPrescale,DISPATCH_QDEPTH);
+    if(shmName.length()>0)
+    {
+      LSTDAQ::ShmPublisher *shm=new LSTDAQ::ShmPublisher((shmName+partitionSuffix(part)).c_str(),(unsigned long long)shmSizeMB*1024*1024);
+      if(!shm->open())
+      {
+        cout<<"shared memory open error!!"<<endl;
+        exit(1);
+      }
+      dispatcher->addConsumer(shm,DISPATCH_DROP,1,DISPATCH_QDEPTH);
+    }
+    if(streamAddress.length()>0)
+    {
+      //each partition has its own socket : the next ports for TCP
+      std::string address=streamAddress;
+      if(nPartition>1 && address.compare(0,4,"tcp:")==0)
+      {
+        char port[16];
+        sprintf(port,"tcp:%d",atoi(address.c_str()+4)+(int)(part-partition));
+        address=port;
+      }
+      else
+        address+=partitionSuffix(part);
+      LSTDAQ::StreamServer *server=new LSTDAQ::StreamServer(address.c_str());
+      if(!server->open())
+      {
+        cout<<"stream server open error!!"<<endl;
+        exit(1);
+      }
+      dispatcher->addConsumer(server,DISPATCH_DROP,1,DISPATCH_QDEPTH);
+    }
+    dispatcher->start();
+  }
+  setAffinity(&part->builderCpu,1,"Builder");
 
- *********************************************************************
- \section MAIN_PROC The procedures
- *********************************************************************
-  -# Set parameters from args
-  -# Inspect # of CPUs
-  -# Read configuration file and check its validity.
-  -# Set configurations for thread and connection in sRIngBuffer structs.
-  -# submit Multi-threaded processes
-  -# wait all the Multi-threaded processes to finish
+  /******************************************/
+  //    Runs
+  /******************************************/
+  LSTDAQ::EventBufferPool *bufPool=NULL;
+  unsigned long nBuilt=0;
+  if(runControl==NULL)
+    nBuilt=Builder_run(part,srb,nRB,dispatcher,bufPool);
+  else
+  {
+    //****** the collectors read (and discard) data from Configure on ******
+    allowStart(part);
+    while(waitRun(part))
+    {
+      nBuilt+=Builder_run(part,srb,nRB,dispatcher,bufPool);
+      endRun(part);
+    }
+  }
 
- ************************************************
- \subsection MAIN_SET_PARAM Set parameters from args
- ************************************************
- At submission, main function can receive 1 to 3 arguments.
- The arg[] are set as follows.\n
- Ndaq = arg[1]\n
- infreq = arg[2]\n
- datacreate = arg[3]\n
- 
- ************************************************
- \subsection MAIN_INS_CPU Inspect # of CPUs
- ************************************************
- Ncpu is set from sysconf().
- see \ref CPU_ID . 
- 
+  pthread_mutex_lock(&mutex_summary);
+  if(dispatcher!=NULL)
+  {
+    dispatcher->close();
+    dispatcher->printSummary();
+  }
+  if(bufPool!=NULL)bufPool->printSummary();
+  delete dispatcher;
+  delete bufPool;
+  cout << "Builder thread end."<< nBuilt<<"data was read."<<endl;
+  pthread_mutex_unlock(&mutex_summary);
+  removeThreadCpu();
+  part->ended=true;
+  //sleep(1);
+  return NULL;
+}
 
- ************************************************
- \subsection MAIN_READCONF Read configuration file and check its validity.
- ************************************************
- Read "Connection.conf" in which empty lines and lines start with "#" are neglected.
- - Parameters to be set\n
-     - Below are used to store the values read from "Connection.conf" temporally .
-         - shCid  : Collector id. 
-         - szAddr : IP address of FEB.
-         - shPort : Port number of FEB.
-     - Below are set from the values above.
-         - maxCid : The maximum value of Collector ID.
-         - firstRB: The first connection ID for each collector thread.
-     
- - Restrictions\n
- There is a rule below for writing configuration files. If the values above violates it, the program exits. 
-     - Limit of # of connections\n
-     If more connections than MAX_CONNECTION are written in "Connection.conf", program exits.
-     - No skip of Cid\n
-     If there is interval in Cid specification, program exits.
- 
- ************************************************
- \subsection MAIN_SETSRB Set configurations for thread and connection in sRIngBuffer structs.
- ************************************************
 
- - After validation,
+/*!
+ * \fn bool addPartition(const char *name, const char *cpuSpec)
+ * \brief starts a new partition in the configuration
+ * \param name    name of the partition
+ * \param cpuSpec CPU set like "0-3,8". All CPUs if empty.
+ * \return false if the partition cannot be added
+ */
+bool addPartition(const char *name, const char *cpuSpec)
+{
+  if(nPartition==MAX_PARTITION || strlen(name)==0)
+  {
+    printf("partition needs a name (up to %d partitions)\n",MAX_PARTITION);
+    return false;
+  }
+  for(int i=0;i<nPartition;i++)
+  {
+    if(partition[i].name==name)
+    {
+      printf("partition %s is declared twice\n",name);
+      return false;
+    }
+  }
+  sPartition *part=&partition[nPartition];
+  part->name=name;
+  part->cpuSpec=cpuSpec;
+  part->nCpu=0;
+  if(strlen(cpuSpec)==0)
+  {
+    for(int i=0;i<Ncpu && i<MAX_PARTITION_CPU;i++)part->cpu[part->nCpu++]=i;
+  }
+  else
+  {
+    part->nCpu=LSTDAQ::CpuTopology::parseCpuList(cpuSpec,part->cpu,MAX_PARTITION_CPU);
+    for(int i=0;i<part->nCpu;i++)
+      if(part->cpu[i]>=Ncpu)part->nCpu=0;
+    if(part->nCpu<=0)
+    {
+      printf("partition %s : bad CPU set %s (this machine has CPU 0-%d)\n",name,cpuSpec,Ncpu-1);
+      return false;
+    }
+  }
+  part->first=0;
+  part->nRB=0;
+  part->nColl=0;
+  for(int i=0;i<MAX_CONNECTION;i++)
+  {
+    part->collCpu[i]=-1;
+    part->collPinned[i]=false;
+  }
+  part->builderCpu=-1;
+  part->thruPutCpu=-1;
+  part->builderPinned=false;
+  part->thruPutPinned=false;
+  part->nHelperCpu=0;
+  pthread_mutex_init(&part->mutex_initLock,NULL);
+  pthread_cond_init(&part->cond_allend,NULL);
+  part->initEnd=0;
+  part->started=false;
+  part->evOutput=NULL;
+  part->pedestal=NULL;
+  pthread_mutex_init(&part->mutex_run,NULL);
+  pthread_cond_init(&part->cond_run,NULL);
+  part->runRequested=0;
+  part->runDone=0;
+  part->closing=false;
+  part->ended=false;
+  part->failed=false;
+  part->timer=NULL;
+  part->running=false;
+  part->nBuilt=0;
+  part->nBuiltAll=0;
+  part->stats=sRunStats();
+  nPartition++;
+  return true;
+}
+
+
+/*!
+ * \fn void planPlacement(sPartition *part)
+ * \brief chooses the CPUs of the threads of the partition in its CPU set and prints the plan. See \ref CPU_ID.
+ *
+ * CPUs pinned in Connection.conf are kept. Each other Collector_thread gets a free CPU, preferring the NUMA node
+ * of the NIC of its first FEB, then a physical core without another collector. Builder_thread (and the writer and
+ * worker threads it starts, which inherit its CPU) gets a free CPU which is not an SMT sibling of a collector,
+ * preferring the node of the collectors. When the CPUs run out, the threads share them as cpu[k%nCpu].
+ * In real-time mode (-t), the CPUs isolated by isolcpus= or nohz_full= come first for the collectors and the
+ * builder, and ThruPutMes_thread is kept off them. See \ref REALTIME.
+ */
+void planPlacement(sPartition *part)
+{
+  bool used[MAX_PARTITION_CPU]={false};
+  int nicNode[MAX_CONNECTION];
+  std::string nicName[MAX_CONNECTION];
+  for(int k=0;k<part->nCpu;k++)
+  {
+    for(int c=0;c<part->nColl;c++)
+      if(part->collPinned[c] && part->collCpu[c]==part->cpu[k])used[k]=true;
+    if(part->builderPinned && part->builderCpu==part->cpu[k])used[k]=true;
+  }
+
+  //****** collectors : close to the NIC ******
+  for(int c=0;c<part->nColl;c++)
+  {
+    nicNode[c]=-1;
+    for(int i=part->first;i<part->first+part->nRB;i++)
+    {
+      if(sRB[i].Cid!=c)continue;
+      nicNode[c]=LSTDAQ::CpuTopology::nicNode(sRB[i].szAddr,nicName[c]);
+      break;
+    }
+    if(part->collPinned[c])continue;
+    int best=-1;
+    int bestScore=-1;
+    for(int k=0;k<part->nCpu;k++)
+    {
+      if(used[k])continue;
+      int score=0;
+      if(realtime && topology.isIsolated(part->cpu[k]))score+=4;
+      if(nicNode[c]<0 || topology.getNode(part->cpu[k])==nicNode[c])score+=2;
+      bool shared=false;
+      for(int d=0;d<part->nColl;d++)
+        if(d!=c && (d<c || part->collPinned[d]) && topology.isSibling(part->cpu[k],part->collCpu[d]))shared=true;
+      if(!shared)score+=1;
+      if(score>bestScore)
+      {
+        best=k;
+        bestScore=score;
+      }
+    }
+    if(best>=0)
+    {
+      used[best]=true;
+      part->collCpu[c]=part->cpu[best];
+    }
+    else
+      part->collCpu[c]=partitionCpu(part,c);
+  }
+
+  //****** builder : off the cores of the collectors ******
+  if(!part->builderPinned)
+  {
+    int best=-1;
+    int bestScore=-1;
+    for(int k=0;k<part->nCpu;k++)
+    {
+      if(used[k])continue;
+      int score=0;
+      if(realtime && topology.isIsolated(part->cpu[k]))score+=4;
+      bool shared=false;
+      for(int c=0;c<part->nColl;c++)
+        if(topology.isSibling(part->cpu[k],part->collCpu[c]))shared=true;
+      if(!shared)score+=2;
+      if(topology.getNode(part->cpu[k])==topology.getNode(part->collCpu[0]))score+=1;
+      if(score>bestScore)
+      {
+        best=k;
+        bestScore=score;
+      }
+    }
+    part->builderCpu=(best>=0 ? part->cpu[best] : partitionCpu(part,part->nColl));
+  }
+  if(!part->thruPutPinned)
+  {
+    part->thruPutCpu=partitionCpu(part,part->nCpu-1);
+    //****** the isolated CPUs are left to the threads on the data path ******
+    for(int k=part->nCpu-1;realtime && k>=0;k--)
+      if(!topology.isIsolated(part->cpu[k]))
+      {
+        part->thruPutCpu=part->cpu[k];
+        break;
+      }
+  }
+
+  //****** writer, worker and dispatcher threads : the CPUs left by the collectors and the builder ******
+  //if none, those of the builder as well, and then all the CPUs of the partition
+  bool helperShared=false;
+  for(int pass=0;pass<4 && part->nHelperCpu==0;pass++)
+    for(int k=0;k<part->nCpu;k++)
+    {
+      bool free=true;
+      for(int c=0;c<part->nColl && pass<3;c++)
+        if(part->collCpu[c]==part->cpu[k])free=false;
+      if(pass<2 && part->cpu[k]==part->builderCpu)free=false;
+      if(pass==0 && topology.isSibling(part->cpu[k],part->builderCpu))free=false;
+      if(!free)continue;
+      part->helperCpu[part->nHelperCpu++]=part->cpu[k];
+      if(part->cpu[k]==part->builderCpu)helperShared=true;
+    }
+
+  //****** plan ******
+  printf("placement%s%s : %d NUMA node(s)\n",
+         nPartition>1 ? " of partition " : "",nPartition>1 ? part->name.c_str() : "",topology.getNnode());
+  for(int c=0;c<part->nColl;c++)
+  {
+    printf("  Collector %-3d : cpu %3d (node %d, core %d)",c,part->collCpu[c],
+           topology.getNode(part->collCpu[c]),topology.getCore(part->collCpu[c]));
+    if(nicName[c].length()>0)printf(", NIC %s (node %d)",nicName[c].c_str(),nicNode[c]);
+    printf("%s%s\n",topology.isIsolated(part->collCpu[c]) ? ", isolated" : "",part->collPinned[c] ? ", pinned" : "");
+  }
+  printf("  Builder       : cpu %3d (node %d, core %d)%s%s\n",part->builderCpu,
+         topology.getNode(part->builderCpu),topology.getCore(part->builderCpu),
+         topology.isIsolated(part->builderCpu) ? ", isolated" : "",part->builderPinned ? ", pinned" : "");
+  if(hasHelperThreads())
+  {
+    printf("  Writer/Worker : cpu");
+    for(int k=0;k<part->nHelperCpu;k++)printf("%s%d",k==0 ? " " : ",",part->helperCpu[k]);
+    printf("%s\n",helperShared ? ", shared with the builder" : "");
+  }
+  if(logcreate || metricsPort>0)
+    printf("  ThruPutMes    : cpu %3d (node %d, core %d)%s\n",part->thruPutCpu,
+           topology.getNode(part->thruPutCpu),topology.getCore(part->thruPutCpu),part->thruPutPinned ? ", pinned" : "");
+}
+
+/*!
+ * \fn bool addPin(const std::string &line)
+ * \brief reads a line "pin collector <Cid> <cpu>", "pin builder <cpu>" or "pin thruput <cpu>" of Connection.conf
+ * \return false if the line is not valid
+ */
+bool addPin(const std::string &line)
+{
+  if(nPartition==0)addPartition("0","");
+  sPartition *part=&partition[nPartition-1];
+  std::istringstream iss(line);
+  std::string word,role;
+  int Cid=0;
+  int cpu=-1;
+  iss >> word >> role;
+  if(role=="collector")iss >> Cid;
+  iss >> cpu;
+  if(iss.fail() || cpu<0 || cpu>=Ncpu || Cid<0 || Cid>=MAX_CONNECTION)
+  {
+    printf("bad pin line (CPU 0-%d) : %s\n",Ncpu-1,line.c_str());
+    return false;
+  }
+  if(role=="collector")
+  {
+    part->collCpu[Cid]=cpu;
+    part->collPinned[Cid]=true;
+  }
+  else if(role=="builder")
+  {
+    part->builderCpu=cpu;
+    part->builderPinned=true;
+  }
+  else if(role=="thruput")
+  {
+    part->thruPutCpu=cpu;
+    part->thruPutPinned=true;
+  }
+  else
+  {
+    printf("pin needs collector, builder or thruput : %s\n",line.c_str());
+    return false;
+  }
+  return true;
+}
+
+
+/*!
+ * \fn bool configure()
+ * \brief reads the connection configuration, makes the Ring Buffers and creates the threads. See \ref MAIN_READCONF.
+ * \return false if the configuration is not valid. teardown() cleans up what is made.
+ */
+bool configure()
+{
+  /******************************************/
+  //   Read Connection Configuration and
+  //     prepare the assignment
+  /******************************************/
+  unsigned short shCid[MAX_CONNECTION]={0};
+  char szAddr[MAX_CONNECTION][16];
+  unsigned short shPort[MAX_CONNECTION]={0};
+  int shPart[MAX_CONNECTION]={0};
+  const char *ConfFile = configFile.c_str();
+  int nServ=0;
+  if(nodePort>0)
+  {
+    //****** builder node : one collector per node, modules numbered by node ******
+    nodeReceiver=new LSTDAQ::SubEventReceiver();
+    if(!nodeReceiver->listen(nodePort) || !nodeReceiver->acceptNodes(nNode,&stopRequested))return false;
+    addPartition("0","");
+    for(int i=0;i<nNode;i++)
+    {
+      if(nServ+nodeReceiver->getNmodule(i)>MAX_CONNECTION){
+        printf("The number of connections excessed limit.");
+        return false;
+      }
+      for(int j=0;j<nodeReceiver->getNmodule(i);j++)
+      {
+        shCid[nServ]=i;
+        sprintf(szAddr[nServ],"node%d",i);
+        shPort[nServ]=nodePort;
+        nServ++;
+      }
+    }
+  }
+  else
+  {
+    std::ifstream ifs(ConfFile);
+    std::string str;
+    if(!ifs)
+    {
+      printf("cannot open %s\n",ConfFile);
+      return false;
+    }
+    while (std::getline(ifs,str)){
+      if(str[0]== '#' || str.length()==0)continue;
+      std::istringstream iss(str);
+      if(str.compare(0,9,"partition")==0)
+      {
+        std::string word,name,cpus;
+        iss >> word >> name >> cpus;
+        if(!addPartition(name.c_str(),cpus.c_str()))return false;
+        continue;
+      }
+      if(str.compare(0,3,"pin")==0)
+      {
+        if(!addPin(str))return false;
+        continue;
+      }
+      if(nServ==MAX_CONNECTION){
+        printf("The number of connections excessed limit.");
+        return false;
+      }
+      if(nPartition==0)addPartition("0","");
+      iss >> shCid[nServ]>> szAddr[nServ] >> shPort[nServ];
+      shPart[nServ]=nPartition-1;
+      nServ++;
+    }
+  }
+  if(nPartition>1 && (uplinkAddress.length()>0 || nodePort>0))
+  {
+    printf("-U and -N need a configuration of one partition\n");
+    return false;
+  }
+
+  /******************************************/
+  //   per partition : Cid validation and
+  //     Ring Buffers followed by a terminator
+  /******************************************/
+  sRBinit();
+  int nCollAll=0;
+  int firstRB[MAX_CONNECTION];
+  int iRB=0;
+  for(int p=0;p<nPartition;p++)
+  {
+    sPartition *part=&partition[p];
+    part->first=iRB;
+    int maxCid=0;
+    for(int i=0;i<nServ;i++)
+    {
+      if(shPart[i]!=p)continue;
+      part->nRB++;
+      if(maxCid<shCid[i])maxCid=shCid[i];
+    }
+    if(part->nRB==0)
+    {
+      cout<<"error: partition "<<part->name<<" has no connection."<<endl;
+      return false;
+    }
+    if(part->nRB>64)
+    {
+      cout<<"error: partition "<<part->name<<" has more than 64 modules, which EventHeader::missing cannot flag."<<endl;
+      return false;
+    }
+    for(int i=0;i<maxCid;i++)
+    {
+      bool Cid_exist=false;
+      for(int j=0;j<nServ;j++)
+      {
+        if(shPart[j]==p && shCid[j]==i)
+        {
+          Cid_exist=true;
+          break;
+        }
+      }
+      if(!Cid_exist)
+      {
+        cout<<"error: Cid "<<i<<"is skipped in partition "<<part->name<<"."<<endl;
+        return false;
+      }
+    }
+    part->nColl=maxCid+1;
+    for(int i=part->nColl;i<MAX_CONNECTION;i++)
+    {
+      if(part->collPinned[i])
+      {
+        cout<<"error: pinned collector "<<i<<" does not exist in partition "<<part->name<<"."<<endl;
+        return false;
+      }
+    }
+    sRBcreate(part->first,part->nRB);
+    for(int i=0;i<nServ;i++)
+    {
+      if(shPart[i]!=p)continue;
+      sRBsetaddr(iRB,shCid[i],szAddr[i],shPort[i]);
+      sRB[iRB].part=part;
+      iRB++;
+    }
+    iRB++;//terminator
+    //substitute the first connection(sRBid) of each collector
+    for(int i=0;i<part->nColl;i++)
+    {
+      for(int j=part->first;j<part->first+part->nRB;j++)
+      {
+        if(sRB[j].Cid==i)//if given CollID matches Cid
+        {
+          firstRB[nCollAll+i]=j;//Coll starts to seek from it
+          break;
+        }
+      }
+    }
+    nCollAll+=part->nColl;
+  }
+  if(pedestalFile.length()>0)
+  {
+    //****** one file per partition, named as the pedestal run (-T) writes them ******
+    for(int p=0;p<nPartition;p++)
+    {
+      std::string file=pedestalFile+partitionSuffix(&partition[p]);
+      partition[p].pedestal=LSTDAQ::PedestalTable::load(file.c_str());
+      if(partition[p].pedestal==NULL)return false;
+      if(partition[p].pedestal->getNmodule()<partition[p].nRB)
+      {
+        cout<<"error: "<<file<<" has pedestals of "<<partition[p].pedestal->getNmodule()<<" modules for "<<partition[p].nRB<<" connections."<<endl;
+        return false;
+      }
+    }
+  }
+  printf("\n");
+  printf("****** Configuration of RinbBuffers are set ******\n");
+  TERM_COLOR_RED;  printf(" %d ",nCollAll);  TERM_COLOR_RESET;
+  printf("Collectors will be created for");
+  TERM_COLOR_RED;  printf(" %d ",nServ);  TERM_COLOR_RESET;
+  printf("connections");
+  if(nPartition>1)
+  {
+    printf(" in");
+    TERM_COLOR_RED;  printf(" %d ",nPartition);  TERM_COLOR_RESET;
+    printf("partitions");
+  }
+  printf("\n");
+  printf("\n");
+
+  for(int p=0;p<nPartition;p++)
+  {
+    sPartition *part=&partition[p];
+    if(nPartition>1 || part->cpuSpec.length()>0)
+      cout<<"partition "<<part->name<<" : cpus "<<(part->cpuSpec.length()>0 ? part->cpuSpec : "all")<<endl;
+    cout<<setw(48)<<setfill('=')<<""<<endl;
+    cout<<"RingBuff id | "<<"Cpu id |"<<"     IP address     |"<<" port "<<endl;
+    for(int i=part->first;i<part->first+part->nRB;i++)
+      cout<<setw(7) << setfill(' ')<<i<<setw(6)<<setfill(' ')<<"|"<<
+        setw(5) << setfill(' ')<<sRB[i].Cid<<setw(4)<<setfill(' ')<<"|"<<
+        "   "<<left<<setw(13)<< setfill(' ')<<sRB[i].szAddr<<right<<setw(5)<<setfill(' ')<<"|"<<
+        setw(5) << setfill(' ')<<sRB[i].shPort<<endl;
+    cout<<setw(48)<<setfill('=')<<""<<endl;
+    planPlacement(part);
+    printf("\n");
+  }
+
+  /******************************************/
+  //    submit Multi-threaded processes
+  /******************************************/
+  // cout << "***  Thread create  ***"<<endl;
+  nThread=nCollAll+nPartition;
+
+
+  TERM_COLOR_BLUE;
+  //  cout << "***LSTDAQ starts***" <<endl;
+  printf("*********************************************\n");
+  printf("*********************************************\n");
+  printf("**                LSTDAQ                   **\n");
+  printf("**                                         **\n");
+  printf("**                ready                    **\n");
+  printf("**                                         **\n");
+  printf("*********************************************\n");
+  printf("*********************************************\n");
+  TERM_COLOR_RESET;
+
+
+  pthread_t *handle=threadHandle;
+  for(int i=0;i<nCollAll;i++)
+  {
+    pthread_create(&handle[i],
+                   NULL,
+                   nodeReceiver!=NULL ? &Node_thread : &Collector_thread,
+                   &sRB[firstRB[i]]);
+    // sleep(1);
+  }
+  for(int p=0;p<nPartition;p++)
+  {
+    pthread_create(&handle[nCollAll+p],
+                   NULL,
+                   &Builder_thread,
+                   &sRB[partition[p].first]);
+    if(logcreate || metricsPort>0)
+      {
+        pthread_create(&handle[nThread++],
+                       NULL,
+                       &ThruPutMes_thread,
+                       &sRB[partition[p].first]);
+      }
+  }
+  return true;
+}
+
+/*!
+ * \fn void teardown()
+ * \brief ends the threads of all the partitions and deletes the Ring Buffers, undoing configure()
+ */
+void teardown()
+{
+  for(int p=0;p<nPartition;p++)
+  {
+    pthread_mutex_lock(&partition[p].mutex_run);
+    partition[p].closing=true;
+    pthread_cond_broadcast(&partition[p].cond_run);
+    pthread_mutex_unlock(&partition[p].mutex_run);
+    //****** threads still waiting for the start of the partition ******
+    pthread_mutex_lock(&partition[p].mutex_initLock);
+    pthread_cond_broadcast(&partition[p].cond_allend);
+    pthread_mutex_unlock(&partition[p].mutex_initLock);
+  }
+  for(int i=0;i<nThread;i++)
+    pthread_join(threadHandle[i],NULL);
+  nThread=0;
+  sRBdelete();
+  for(int p=0;p<nPartition;p++)
+  {
+    pthread_mutex_destroy(&partition[p].mutex_initLock);
+    pthread_cond_destroy(&partition[p].cond_allend);
+    pthread_mutex_destroy(&partition[p].mutex_run);
+    pthread_cond_destroy(&partition[p].cond_run);
+    delete partition[p].pedestal;
+    partition[p].pedestal=NULL;
+  }
+  nPartition=0;
+}
+
+/****************************/
+// main
+/****************************/
+/** 
+ \func main
+ \param infreq
+ \brief Input frequency.
+  This is used only for making report.
+ \param Ndaq
+ \brief The number of events to acquire.\n
+ default 100000
+ \param datacreate
+ \brief Whether data will be saved.
+ 
+
+ *********************************************************************
+ \section MAIN_PROC The procedures
+ *********************************************************************
+  -# Set parameters from args
+  -# Inspect # of CPUs
+  -# Read configuration file and check its validity.
+  -# Set configurations for thread and connection in sRIngBuffer structs.
+  -# submit Multi-threaded processes
+  -# wait all the Multi-threaded processes to finish
+
+ ************************************************
+ \subsection MAIN_SET_PARAM Set parameters from args
+ ************************************************
+ At submission, main function can receive 1 to 3 arguments.
+ The arg[] are set as follows.\n
+ Ndaq = arg[1]\n
+ infreq = arg[2]\n
+ datacreate = arg[3]\n
+ 
+ ************************************************
+ \subsection MAIN_INS_CPU Inspect # of CPUs
+ ************************************************
+ Ncpu is set from sysconf().
+ see \ref CPU_ID . 
+ 
+
+ ************************************************
+ \subsection MAIN_READCONF Read configuration file and check its validity.
+ ************************************************
+ Read "Connection.conf" (or the file given by -f) in which empty lines and lines start with "#" are neglected.
+ A line "partition <name> [<cpus>]" starts a new partition (see sPartition), and the restrictions below
+ apply to each partition.
+ - Parameters to be set\n
+     - Below are used to store the values read from "Connection.conf" temporally .
+         - shCid  : Collector id. 
+         - szAddr : IP address of FEB.
+         - shPort : Port number of FEB.
+     - Below are set from the values above.
+         - maxCid : The maximum value of Collector ID.
+         - firstRB: The first connection ID for each collector thread.
+     
+ - Restrictions\n
+ There is a rule below for writing configuration files. If the values above violates it, the program exits. 
+     - Limit of # of connections\n
+     If more connections than MAX_CONNECTION are written in "Connection.conf", program exits.
+     - No skip of Cid\n
+     If there is interval in Cid specification, program exits.
+ 
+ ************************************************
+ \subsection MAIN_SETSRB Set configurations for thread and connection in sRIngBuffer structs.
+ ************************************************
+
+ - After validation,
  The parameters below are set to sRingBuffer structs from the parameters above.
      - sRB.Cid
      - sRB.szAddr
@@ -1309,8 +3184,8 @@ void *Builder_thread(void *arg)
  ************************************************
  \subsection MAIN_SUBMIT  Submit Multi-threaded processes
  ************************************************
- By pthread_create() function, threads are created. 
- handle[]  is an array of pthread_t type variable, which is used to handle threads.
+ By pthread_create() function, threads are created in configure(). 
+ threadHandle[]  is an array of pthread_t type variable, which is used to handle threads.
  By their numbers the array, threads are numbered as these.\n
 
  Thread name     | Number of threads |  handle[]
@@ -1342,6 +3217,40 @@ int main(int argc, char** argv)
   datacreate=false;
   logcreate=false;
   fileNameHeader="test";
+  writeBlockSizeMB=WRITER_BLOCKSIZE_MB;
+  writeNblock=WRITER_NBLOCK;
+  outputEngine=OUTPUT_ENGINE_BUFFERED;
+  outputQdepth=OUTPUT_QDEPTH;
+  outputDirs="";
+  stripeChunkMB=0;
+  continuous=false;
+  rotateSec=0;
+  rotateGB=0;
+  nWorker=0;
+  compress=false;
+  pack12=false;
+  gainselThreshold=0;
+  pedestalFile="";
+  pedestalRunFile="";
+  zsPeak=0;
+  zsCharge=0;
+  dl1Window=0;
+  dl1Only=false;
+  nFilter=0;
+  prescale=0;
+  soa=false;
+  monitorPrescale=0;
+  shmName="";
+  shmSizeMB=SHM_RINGSIZE_MB;
+  streamAddress="";
+  configFile="Connection.conf";
+  uplinkAddress="";
+  nodeId=0;
+  nodePort=0;
+  nNode=0;
+  controlAddress="";
+  realtime=false;
+  metricsPort=0;
   // if(argc<2)
   //   {
   //     usage(argv);
@@ -1372,7 +3281,7 @@ int main(int argc, char** argv)
 
   int opt;
   int index;
-  while((opt=getopt_long(argc,argv,"hi:n:o:r:sv:cf:l",options,&index)) !=-1)
+  while((opt=getopt_long(argc,argv,"hi:n:o:r:sv:cf:lb:B:e:q:d:S:CR:G:w:zpg:P:T:Z:D:XF:K:AM:m:E:U:N:Q:tH:",options,&index)) !=-1)
     {
       //      printf("index = %d %s %s \n",optind,options[optind].name,optarg);
     switch(opt)
@@ -1402,13 +3311,157 @@ int main(int argc, char** argv)
       // case 'c':
       // 	closeinspect=true;
       // 	break;
-      // case 'f' :
-      // 	configfile=optarg;
-      // 	break;
+      case 'f' :
+	configFile=optarg;
+	break;
       case 'l':
 	printf("Log file will be stored\n");
 	logcreate=true;
 	break;
+      case 'b':
+	if(atoi(optarg)<1)
+	  {
+	    printf("-b needs a block size of at least 1 MB\n");
+	    exit(1);
+	  }
+	writeBlockSizeMB=(unsigned long)atoi(optarg);
+	break;
+      case 'B':
+	writeNblock=atoi(optarg);
+	if(writeNblock<2)
+	  {
+	    printf("-B needs at least 2 blocks\n");
+	    exit(1);
+	  }
+	break;
+      case 'e':
+	if(strcmp(optarg,"direct")==0)
+	  outputEngine=OUTPUT_ENGINE_DIRECT;
+	else if(strcmp(optarg,"buffered")==0)
+	  outputEngine=OUTPUT_ENGINE_BUFFERED;
+	else
+	  usage(argv);
+	break;
+      case 'q':
+	outputQdepth=atoi(optarg);
+	break;
+      case 'd':
+	outputDirs=optarg;
+	break;
+      case 'S':
+	stripeChunkMB=(unsigned long)atoi(optarg);
+	break;
+      case 'C':
+	continuous=true;
+	break;
+      case 'R':
+	rotateSec=atof(optarg);
+	break;
+      case 'G':
+	rotateGB=atof(optarg);
+	break;
+      case 'w':
+	nWorker=atoi(optarg);
+	break;
+      case 'z':
+	compress=true;
+	break;
+      case 'p':
+	pack12=true;
+	break;
+      case 'g':
+	gainselThreshold=atoi(optarg);
+	break;
+      case 'P':
+	pedestalFile=optarg;
+	break;
+      case 'T':
+	pedestalRunFile=optarg;
+	break;
+      case 'D':
+	dl1Window=atoi(optarg);
+	break;
+      case 'X':
+	dl1Only=true;
+	break;
+      case 'F':
+	{
+	  LSTDAQ::EventFilter *f=LSTDAQ::EventFilter::create(optarg);
+	  if(f==NULL || nFilter==MAX_FILTER)
+	    {
+	      printf("-F needs mult:<threshold>:<n> or topo:<threshold>:<n> (up to %d filters)\n",MAX_FILTER);
+	      exit(1);
+	    }
+	  delete f;
+	  filterSpec[nFilter++]=optarg;
+	}
+	break;
+      case 'K':
+	prescale=(unsigned int)atoi(optarg);
+	break;
+      case 'A':
+	soa=true;
+	break;
+      case 'M':
+	monitorPrescale=atoi(optarg);
+	break;
+      case 'E':
+	streamAddress=optarg;
+	break;
+      case 'U':
+	{
+	  std::string arg=optarg;
+	  size_t comma=arg.find(',');
+	  uplinkAddress=arg.substr(0,comma);
+	  if(comma!=std::string::npos)nodeId=atoi(arg.c_str()+comma+1);
+	  if(uplinkAddress.find(':')==std::string::npos || nodeId<0 || nodeId>=MAX_NODE)
+	    {
+	      printf("-U needs <host>:<port>[,<node>] (node < %d)\n",MAX_NODE);
+	      exit(1);
+	    }
+	}
+	break;
+      case 'N':
+	if(sscanf(optarg,"%d,%d",&nodePort,&nNode)<2 || nodePort<=0 || nNode<1 || nNode>MAX_NODE)
+	  {
+	    printf("-N needs <port>,<#of nodes> (up to %d nodes)\n",MAX_NODE);
+	    exit(1);
+	  }
+	break;
+      case 'Q':
+	controlAddress=optarg;
+	break;
+      case 't':
+	realtime=true;
+	break;
+      case 'H':
+	metricsPort=atoi(optarg);
+	if(metricsPort<=0 || metricsPort>65535)
+	  {
+	    printf("-H needs a TCP port\n");
+	    exit(1);
+	  }
+	break;
+      case 'm':
+	{
+	  std::string arg=optarg;
+	  size_t comma=arg.find(',');
+	  shmName=arg.substr(0,comma);
+	  if(comma!=std::string::npos)shmSizeMB=atoi(arg.c_str()+comma+1);
+	  if(shmName.length()==0 || shmSizeMB<=0)
+	    {
+	      printf("-m needs <name>[,<MB>]\n");
+	      exit(1);
+	    }
+	}
+	break;
+      case 'Z':
+	if(sscanf(optarg,"%d,%d",&zsPeak,&zsCharge)<1)
+	  {
+	    printf("-Z needs <peak>[,<charge>]\n");
+	    exit(1);
+	  }
+	break;
       case '?':
 	printf("Unknown options\n");
 	printf("%s -h for usage\n",argv[0]);
@@ -1421,6 +3474,58 @@ int main(int argc, char** argv)
       } 
     }
 
+  if(pedestalRunFile.length()>0)
+  {
+    printf("Pedestal run : only %s is written\n",pedestalRunFile.c_str());
+    datacreate=false;
+    pedestalFile="";
+  }
+  if(dl1Only && dl1Window==0)dl1Window=DL1_WINDOW;
+  if((zsPeak>0 || zsCharge>0 || nFilter>0) && pedestalFile.length()==0 && pedestalRunFile.length()==0)
+  {
+    printf("Zero suppression and filters need pedestals : give -P <file>\n");
+    exit(1);
+  }
+  //processing stages need the worker pool
+  if((compress || pack12 || gainselThreshold>0 || pedestalFile.length()>0 || pedestalRunFile.length()>0 || zsPeak>0 || zsCharge>0 || dl1Window>0 || nFilter>0 || soa) && nWorker==0)nWorker=1;
+  if(nWorker>MAX_WORKER)nWorker=MAX_WORKER;
+  if(soa && (zsPeak>0 || zsCharge>0))
+  {
+    printf("-A and -Z cannot be given together : the sparse payload of zero suppression has no SoA layout\n");
+    exit(1);
+  }
+  if(uplinkAddress.length()>0 && nWorker>0)
+  {
+    printf("-U sends raw sub-events : give the processing options to the builder node (-N)\n");
+    exit(1);
+  }
+  if(uplinkAddress.length()>0 && nodePort>0)
+  {
+    printf("-U and -N cannot be given together\n");
+    exit(1);
+  }
+  if(controlAddress.length()>0 && (uplinkAddress.length()>0 || nodePort>0))
+  {
+    printf("-Q controls a standalone LSTDAQ : it cannot be given with -U or -N\n");
+    exit(1);
+  }
+
+  if(continuous)
+  {
+    printf("Continuous mode : DAQ runs until SIGINT/SIGTERM\n");
+    Ndaq=ULONG_MAX;
+  }
+  //a run of -n events is aborted by SIGINT/SIGTERM as before
+  if(continuous || controlAddress.length()>0)
+  {
+    signal(SIGINT,requestStop);
+    signal(SIGTERM,requestStop);
+  }
+
+  //writes in flight need their own blocks plus one to be filled
+  if(outputEngine==OUTPUT_ENGINE_DIRECT && writeNblock<outputQdepth+1)
+    writeNblock=outputQdepth+1;
+
   /******************************************/
   //  Inspect # of CPUs
   /******************************************/
@@ -1428,143 +3533,184 @@ int main(int argc, char** argv)
   printf("This machine has ");
   TERM_COLOR_RED;  printf("%d",Ncpu);  TERM_COLOR_RESET;
   printf(" cpus\n");
+  topology.load(Ncpu);
+
   /******************************************/
-  //   Read Connection Configuration and
-  //     prepare the assignment
+  //  Real-time mode
   /******************************************/
-  unsigned short shCid[MAX_CONNECTION]={0};
-  char szAddr[MAX_CONNECTION][16];
-  unsigned short shPort[MAX_CONNECTION]={0};
-  unsigned long lConnected=0;
-  const char *ConfFile = "Connection.conf";
-  std::ifstream ifs(ConfFile);
-  std::string str;
-  int nServ=0;
-  while (std::getline(ifs,str)){
-    if(str[0]== '#' || str.length()==0)continue;
-    std::istringstream iss(str);
-    iss >> shCid[nServ]>> szAddr[nServ] >> shPort[nServ];
-    nServ++;
-  }
-  if(nServ>MAX_CONNECTION){
-    printf("The number of connections excessed limit.");
-    exit(1);
+  if(realtime)
+  {
+    //****** the memory is locked after configure(), see lockMemory() ******
+    printf("real-time mode : isolated CPUs '%s', nohz_full CPUs '%s'\n",
+           topology.getIsolatedList(),topology.getNohzList());
   }
-  
-  //Cid validation
-  int maxCid=0;
-  for(int i=0;i<nServ;i++)
+
+  if(metricsPort>0)
+  {
+    metricsServer=new LSTDAQ::MetricsServer(metricsPort,&writeMetrics);
+    if(!metricsServer->open())exit(1);
+  }
+
+  if(controlAddress.length()==0)
   {
-    if(maxCid<shCid[i])maxCid=shCid[i];
+    /******************************************/
+    //   single run
+    /******************************************/
+    if(!configure())exit(1);
+    lockMemory(true);
+    // cout <<"Threads created. "<<
+    // Ndaq << "events will be transferred each"<<endl;
+    /******************************************/
+    //    wait all the Multi-threaded processes to finish
+    /******************************************/
+    for(int i=0;i<nThread;i++)
+      pthread_join(threadHandle[i],NULL);
+    delete nodeReceiver;
+    if(metricsServer!=NULL)
+    {
+      metricsServer->close();
+      metricsServer->printSummary();
+      delete metricsServer;
+    }
+  
+    cout << "LSTDAQ end" <<endl;
+    return 0;
   }
-  for(int i=0;i<maxCid;i++)
+
+  /******************************************/
+  //   run control
+  /******************************************/
+  runControl=new LSTDAQ::RunControl(controlAddress.c_str());
+  if(!runControl->open())exit(1);
+  unsigned long defaultNdaq=Ndaq;
+  std::string arg;
+  char line[256];
+  while(1)
   {
-    bool Cid_exist=false;
-    for(int j=0;j<nServ;j++)
+    int cmd=runControl->next(arg,RC_POLL_MSEC);
+    if(stopRequested)cmd=RC_CMD_QUIT;
+    //****** the run has ended by itself after Ndaq events ******
+    if(runControl->getState()==RC_STATE_RUNNING)
     {
-      if(shCid[j]==i)
+      bool done=true;
+      for(int p=0;p<nPartition;p++)done=done && isRunDone(&partition[p],false);
+      if(done)
       {
-        Cid_exist=true;
-        break;
+        runControl->setState(RC_STATE_CONFIGURED);
+        cout<<"Run "<<runNumber<<" has ended."<<endl;
       }
     }
-    if(!Cid_exist)
+    if(cmd==RC_CMD_NONE)continue;
+    if(cmd==RC_CMD_UNKNOWN)
     {
-      cout<<"error: Cid "<<i<<"is skipped."<<endl;
-      exit(1);
+      runControl->error("unknown command (configure, start [N], stop, reset, status, quit)");
+      continue;
     }
-  }
-  int nColl=maxCid+1;
-  int firstRB[MAX_CONNECTION];
-  //substitute the first connection(sRBid)
-  for(int i=0;i<nColl;i++)
-  {
-    for(int j=0;j<nServ;j++)
+    if(!runControl->isAllowed(cmd))
+    {
+      snprintf(line,sizeof(line),"not allowed in state %s",LSTDAQ::RunControl::stateName(runControl->getState()));
+      runControl->error(line);
+      continue;
+    }
+    //****** the run is stopped before stop, reset and quit ******
+    if((cmd==RC_CMD_STOP || cmd==RC_CMD_RESET || cmd==RC_CMD_QUIT) && runControl->getState()==RC_STATE_RUNNING)
     {
-      if(shCid[j]==i)//if given CollID matches Cid
+      runStopRequested=1;
+      for(int p=0;p<nPartition;p++)isRunDone(&partition[p],true);
+      runControl->setState(RC_STATE_CONFIGURED);
+    }
+    switch(cmd)
+    {
+    case RC_CMD_CONFIGURE:
+      runStopRequested=0;
+      if(!configure())
+      {
+        teardown();
+        runControl->error("configuration failed");
+        break;
+      }
+      //****** all the FEBs are connected ******
+      {
+        struct timespec tsLimit;
+        clock_gettime(CLOCK_MONOTONIC,&tsLimit);
+        tsLimit.tv_sec+=RC_CONFIGURE_SEC;
+        bool configured=true;
+        for(int p=0;p<nPartition && configured;p++)configured=waitConfigured(&partition[p],&tsLimit);
+        if(!configured)
+        {
+          teardown();
+          runControl->error(stopRequested ? "configuration stopped" : "FEBs not connected (see the log)");
+          break;
+        }
+      }
+      lockMemory(true);
+      runControl->setState(RC_STATE_CONFIGURED);
+      runControl->ok();
+      break;
+    case RC_CMD_START:
+      Ndaq=defaultNdaq;
+      if(arg.length()>0)Ndaq=strtoul(arg.c_str(),NULL,10);
+      if(Ndaq==0)
       {
-        firstRB[i]=j;//Coll starts to seek from it
+        runControl->error("start needs a positive number of events");
         break;
       }
+      runStopRequested=0;
+      runNumber++;
+      for(int p=0;p<nPartition;p++)requestRun(&partition[p],runNumber);
+      runControl->setState(RC_STATE_RUNNING);
+      snprintf(line,sizeof(line),"run %u",runNumber);
+      runControl->reply(line);
+      runControl->ok();
+      break;
+    case RC_CMD_STOP:
+      for(int p=0;p<nPartition;p++)
+      {
+        sRunStats *st=&partition[p].stats;
+        snprintf(line,sizeof(line),"partition %s run %u : %lu events in %.3f sec (%.1f Hz), %.3f MB in, %.3f MB out",
+                partition[p].name.c_str(),st->run,st->nEvent,st->sec,st->sec>0 ? st->nEvent/st->sec : 0.,
+                st->bytesIn/1e6,st->bytesOut/1e6);
+        runControl->reply(line);
+        if(st->file.length()>0)
+        {
+          snprintf(line,sizeof(line),"partition %s run %u : file %s",partition[p].name.c_str(),st->run,st->file.c_str());
+          runControl->reply(line);
+        }
+      }
+      runControl->ok();
+      break;
+    case RC_CMD_STATUS:
+      snprintf(line,sizeof(line),"state %s, run %u",LSTDAQ::RunControl::stateName(runControl->getState()),runNumber);
+      runControl->reply(line);
+      for(int p=0;p<nPartition;p++)
+      {
+        snprintf(line,sizeof(line),"partition %s : %d connections, %lu events built",
+                partition[p].name.c_str(),partition[p].nRB,partition[p].nBuilt);
+        runControl->reply(line);
+      }
+      runControl->ok();
+      break;
+    case RC_CMD_RESET:
+    case RC_CMD_QUIT:
+      if(runControl->getState()!=RC_STATE_IDLE)teardown();
+      runControl->setState(RC_STATE_IDLE);
+      runControl->ok();
+      break;
     }
+    if(cmd==RC_CMD_QUIT)break;
   }
-  sRBinit();
-  sRBcreate(nServ);
-  for(int i=0;i<nServ;i++)
-    sRBsetaddr(i,shCid[i],szAddr[i],shPort[i]);
-  printf("\n");
-  printf("****** Configuration of RinbBuffers are set ******\n");
-  TERM_COLOR_RED;  printf(" %d ",nColl);  TERM_COLOR_RESET;
-  printf("Collectors will be created for");
-  TERM_COLOR_RED;  printf(" %d ",nServ);  TERM_COLOR_RESET;
-  printf("connections\n");
-  printf("\n");
-
-  cout<<setw(48)<<setfill('=')<<""<<endl;
-  cout<<"RingBuff id | "<<"Cpu id |"<<"     IP address     |"<<" port "<<endl;
-  for(int i=0;i<nServ;i++)
-    cout<<setw(7) << setfill(' ')<<i<<setw(6)<<setfill(' ')<<"|"<<
-      setw(5) << setfill(' ')<<sRB[i].Cid<<setw(4)<<setfill(' ')<<"|"<<
-      "   "<<left<<setw(13)<< setfill(' ')<<sRB[i].szAddr<<right<<setw(5)<<setfill(' ')<<"|"<<
-      setw(5) << setfill(' ')<<sRB[i].shPort<<endl;
-  cout<<setw(48)<<setfill('=')<<""<<endl;
-  printf("\n");
-
-  /******************************************/
-  //    submit Multi-threaded processes
-  /******************************************/
-  // cout << "***  Thread create  ***"<<endl;
-  int NumberOfThread=nColl;
-  if(logcreate)
-    NumberOfThread=nColl+2;
-  else
-    NumberOfThread=nColl+1;
-
-
-  TERM_COLOR_BLUE;
-  //  cout << "***LSTDAQ starts***" <<endl;
-  printf("*********************************************\n");
-  printf("*********************************************\n");
-  printf("**                LSTDAQ                   **\n");
-  printf("**                                         **\n");
-  printf("**                ready                    **\n");
-  printf("**                                         **\n");
-  printf("*********************************************\n");
-  printf("*********************************************\n");
-  TERM_COLOR_RESET;
-
-
-  pthread_t handle[nColl+2];
-  for(int i=0;i<nColl;i++)
+  runControl->close();
+  delete runControl;
+  if(metricsServer!=NULL)
   {
-    pthread_create(&handle[i],
-                   NULL,
-                   &Collector_thread,
-                   &sRB[firstRB[i]]);
-    // sleep(1);
-  }
-  pthread_create(&handle[nColl],
-                 NULL,
-                 &Builder_thread,
-                 &sRB[0]);
-  if(logcreate)
-    {
-      pthread_create(&handle[nColl+1],
-		     NULL,
-		     &ThruPutMes_thread,
-		     &sRB[0]);
-    }
-  // cout <<"Threads created. "<<
-  // Ndaq << "events will be transferred each"<<endl;
-    /******************************************/
-    //    wait all the Multi-threaded processes to finish
-    /******************************************/
-    for(int i=0;i<NumberOfThread;i++)
-    pthread_join(handle[i],NULL);
-  
-    cout << "LSTDAQ end" <<endl;
-    return 0;
+    metricsServer->close();
+    metricsServer->printSummary();
+    delete metricsServer;
   }
+  cout << "LSTDAQ end" <<endl;
+  return 0;
+}
+
 
 
 
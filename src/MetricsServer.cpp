@@ -0,0 +1,156 @@
+#include "MetricsServer.hpp"
+#include <iostream>
+#include <stdio.h>     //perror
+#include <string.h>    //memset
+#include <errno.h>
+#include <unistd.h>    //close
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+namespace LSTDAQ{
+  MetricsServer::MetricsServer(int port, Writer writer) throw()
+  {
+    m_port=port;
+    m_writer=writer;
+    m_listenFd=-1;
+    m_closing=false;
+    m_running=false;
+    m_nRequest=0;
+  }
+  MetricsServer::~MetricsServer() throw()
+  {
+    close();
+  }
+
+  bool MetricsServer::open()
+  {
+    //****** localhost only ******
+    struct sockaddr_in addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sin_family=AF_INET;
+    addr.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+    addr.sin_port=htons(m_port);
+    m_listenFd=socket(AF_INET,SOCK_STREAM,0);
+    int on=1;
+    if(m_listenFd>=0)setsockopt(m_listenFd,SOL_SOCKET,SO_REUSEADDR,&on,sizeof(on));
+    if(m_listenFd<0 || bind(m_listenFd,(struct sockaddr *)&addr,sizeof(addr))!=0)
+    {
+      perror("MetricsServer::bind()");
+      return false;
+    }
+    if(listen(m_listenFd,4)!=0)
+    {
+      perror("MetricsServer::listen()");
+      return false;
+    }
+    m_closing=false;
+    m_running=true;
+    pthread_create(&m_thread,NULL,&MetricsServer::server_thread,this);
+    std::cout<<"MetricsServer: http://localhost:"<<m_port<<"/metrics"<<std::endl;
+    return true;
+  }
+
+  void *MetricsServer::server_thread(void *arg)
+  {
+    ((MetricsServer *)arg)->run();
+    return NULL;
+  }
+
+  void MetricsServer::run()
+  {
+    while(!m_closing)
+    {
+      struct pollfd pfd;
+      pfd.fd=m_listenFd;
+      pfd.events=POLLIN;
+      if(poll(&pfd,1,METRICS_POLL_MSEC)<=0)continue;
+      int fd=accept(m_listenFd,NULL,NULL);
+      if(fd<0)continue;
+      serve(fd);
+      ::close(fd);
+    }
+  }
+
+  void MetricsServer::serve(int fd)
+  {
+    //****** request header, up to the empty line ******
+    char req[1024];
+    int len=0;
+    struct pollfd pfd;
+    pfd.fd=fd;
+    pfd.events=POLLIN;
+    while(len<(int)sizeof(req)-1 && poll(&pfd,1,METRICS_REQUEST_MSEC)>0)
+    {
+      ssize_t n=recv(fd,req+len,sizeof(req)-1-len,0);
+      if(n<0 && errno==EINTR)continue;
+      if(n<=0)break;
+      len+=n;
+      req[len]='\0';
+      if(strstr(req,"\r\n\r\n")!=NULL || strstr(req,"\n\n")!=NULL)break;
+    }
+    req[len]='\0';
+
+    char method[16];
+    char path[256];
+    std::string body;
+    const char *status="200 OK";
+    if(sscanf(req,"%15s %255s",method,path)!=2)
+    {
+      status="400 Bad Request";
+      body="bad request\n";
+    }
+    else if(strcmp(method,"GET")!=0)
+    {
+      status="405 Method Not Allowed";
+      body="only GET\n";
+    }
+    else if(strcmp(path,"/metrics")!=0 && strcmp(path,"/")!=0)
+    {
+      status="404 Not Found";
+      body="see /metrics\n";
+    }
+    else
+      m_writer(body);
+    m_nRequest++;
+
+    char head[256];
+    snprintf(head,sizeof(head),"HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\n"
+             "Content-Length: %lu\r\nConnection: close\r\n\r\n",status,(unsigned long)body.length());
+    std::string reply=head;
+    reply+=body;
+
+    //****** a client which does not read is given up ******
+    struct timeval tv;
+    tv.tv_sec=1;
+    tv.tv_usec=0;
+    setsockopt(fd,SOL_SOCKET,SO_SNDTIMEO,&tv,sizeof(tv));
+    const char *p=reply.c_str();
+    size_t rest=reply.length();
+    while(rest>0)
+    {
+      ssize_t n=send(fd,p,rest,MSG_NOSIGNAL);
+      if(n<0 && errno==EINTR)continue;
+      if(n<=0)break;
+      p+=n;
+      rest-=n;
+    }
+  }
+
+  void MetricsServer::close()
+  {
+    if(m_running)
+    {
+      m_closing=true;
+      pthread_join(m_thread,NULL);
+      m_running=false;
+    }
+    if(m_listenFd>=0)::close(m_listenFd);
+    m_listenFd=-1;
+  }
+
+  void MetricsServer::printSummary()
+  {
+    std::cout<<"metrics server      :port "<<m_port<<", "<<m_nRequest<<" requests"<<std::endl;
+  }
+}
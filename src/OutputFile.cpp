@@ -0,0 +1,224 @@
+#include "OutputFile.hpp"
+#include <iostream>
+#include <stdio.h>       //perror
+#include <string.h>      //memset
+#include <errno.h>
+#include <fcntl.h>       //open, O_DIRECT
+#include <unistd.h>      //write, ftruncate
+#include <sys/syscall.h> //AIO system calls
+#include <time.h>
+
+//****************************************************
+// Linux native AIO
+//   called through syscall() so that libaio is not needed.
+//****************************************************
+static int io_setup(unsigned nr, aio_context_t *ctxp)
+{
+  return syscall(__NR_io_setup, nr, ctxp);
+}
+static int io_destroy(aio_context_t ctx)
+{
+  return syscall(__NR_io_destroy, ctx);
+}
+static int io_submit(aio_context_t ctx, long nr, struct iocb **iocbpp)
+{
+  return syscall(__NR_io_submit, ctx, nr, iocbpp);
+}
+static int io_getevents(aio_context_t ctx, long min_nr, long max_nr,
+                        struct io_event *events, struct timespec *timeout)
+{
+  return syscall(__NR_io_getevents, ctx, min_nr, max_nr, events, timeout);
+}
+
+//****************************************************
+// reserve space for the file so that it is not fragmented
+//****************************************************
+static bool preallocate(int fd, unsigned long long bytes)
+{
+  if(bytes==0)return false;
+  if(fallocate(fd,FALLOC_FL_KEEP_SIZE,0,(off_t)bytes)!=0)
+  {
+    perror("fallocate()");
+    return false;
+  }
+  return true;
+}
+
+namespace LSTDAQ{
+  //****************************************************
+  // OutputFile
+  //****************************************************
+  OutputFile::OutputFile() throw()
+  {
+  }
+  OutputFile::~OutputFile() throw()
+  {
+  }
+  OutputFile *OutputFile::create(int engine, int qdepth)
+  {
+    if(engine==OUTPUT_ENGINE_DIRECT)
+      return new DirectOutputFile(qdepth);
+    return new BufferedOutputFile();
+  }
+
+  //****************************************************
+  // BufferedOutputFile
+  //****************************************************
+  BufferedOutputFile::BufferedOutputFile() throw():m_fd(-1),m_nDone(0),m_size(0),m_prealloc(false)
+  {
+  }
+  BufferedOutputFile::~BufferedOutputFile() throw()
+  {
+    if(m_fd>=0)::close(m_fd);
+  }
+  bool BufferedOutputFile::open(const char *fileName, unsigned long long prealloc)
+  {
+    m_fd=::open(fileName,O_WRONLY|O_CREAT|O_TRUNC,0644);
+    m_nDone=0;
+    m_size=0;
+    if(m_fd<0)return false;
+    m_prealloc=preallocate(m_fd,prealloc);
+    return true;
+  }
+  int BufferedOutputFile::submit(const void *buf, unsigned long len, int tag)
+  {
+    const char *p=(const char *)buf;
+    while(len>0)
+    {
+      ssize_t n=::write(m_fd,p,len);
+      if(n<0)
+      {
+        if(errno==EINTR)continue;
+        perror("BufferedOutputFile::write()");
+        return -1;
+      }
+      p+=n;
+      len-=n;
+      m_size+=n;
+    }
+    m_tag[m_nDone++]=tag;
+    return 0;
+  }
+  int BufferedOutputFile::reap(int *tags, int maxtag, int timeoutUsec)
+  {
+    int n=m_nDone<maxtag ? m_nDone : maxtag;
+    for(int i=0;i<n;i++)tags[i]=m_tag[i];
+    for(int i=n;i<m_nDone;i++)m_tag[i-n]=m_tag[i];
+    m_nDone-=n;
+    return n;
+  }
+  bool BufferedOutputFile::close()
+  {
+    //****** release the reserved space not used ******
+    if(m_prealloc)ftruncate(m_fd,m_size);
+    int ret=::close(m_fd);
+    m_fd=-1;
+    return ret==0;
+  }
+  const char *BufferedOutputFile::getName()
+  {
+    return "buffered";
+  }
+
+  //****************************************************
+  // DirectOutputFile
+  //****************************************************
+  DirectOutputFile::DirectOutputFile(int qdepth) throw():m_fd(-1),m_ctx(0),m_nInflight(0),m_offset(0),m_size(0)
+  {
+    if(qdepth<1)qdepth=1;
+    if(qdepth>WRITER_MAX_NBLOCK)qdepth=WRITER_MAX_NBLOCK;
+    m_qdepth=qdepth;
+  }
+  DirectOutputFile::~DirectOutputFile() throw()
+  {
+    if(m_fd>=0)close();
+  }
+  bool DirectOutputFile::open(const char *fileName, unsigned long long prealloc)
+  {
+    m_fd=::open(fileName,O_WRONLY|O_CREAT|O_TRUNC|O_DIRECT,0644);
+    if(m_fd<0)
+    {
+      perror("DirectOutputFile::open()");
+      return false;
+    }
+    m_ctx=0;
+    if(io_setup(m_qdepth,&m_ctx)<0)
+    {
+      perror("DirectOutputFile::io_setup()");
+      ::close(m_fd);
+      m_fd=-1;
+      return false;
+    }
+    m_nInflight=0;
+    m_offset=0;
+    m_size=0;
+    preallocate(m_fd,prealloc);
+    return true;
+  }
+  int DirectOutputFile::submit(const void *buf, unsigned long len, int tag)
+  {
+    //****** O_DIRECT needs aligned length : pad the last block ******
+    unsigned long alen=(len+WRITER_ALIGN-1)/WRITER_ALIGN*WRITER_ALIGN;
+    struct iocb *cb=&m_iocb[tag];
+    memset(cb,0,sizeof(struct iocb));
+    cb->aio_lio_opcode=IOCB_CMD_PWRITE;
+    cb->aio_fildes=m_fd;
+    cb->aio_buf=(unsigned long long)(unsigned long)buf;
+    cb->aio_nbytes=alen;
+    cb->aio_offset=m_offset;
+    cb->aio_data=(unsigned long long)tag;
+    if(io_submit(m_ctx,1,&cb)!=1)
+    {
+      perror("DirectOutputFile::io_submit()");
+      return -1;
+    }
+    m_nInflight++;
+    m_offset+=alen;
+    m_size+=len;
+    return 0;
+  }
+  int DirectOutputFile::reap(int *tags, int maxtag, int timeoutUsec)
+  {
+    struct io_event ev[WRITER_MAX_NBLOCK];
+    if(maxtag>WRITER_MAX_NBLOCK)maxtag=WRITER_MAX_NBLOCK;
+    if(m_nInflight==0)return 0;
+    struct timespec ts;
+    ts.tv_sec=timeoutUsec/1000000;
+    ts.tv_nsec=(timeoutUsec%1000000)*1000;
+    int n=io_getevents(m_ctx,timeoutUsec>0 ? 1 : 0,maxtag,ev,&ts);
+    if(n<0)
+    {
+      if(errno==EINTR)return 0;
+      perror("DirectOutputFile::io_getevents()");
+      return -1;
+    }
+    for(int i=0;i<n;i++)
+    {
+      struct iocb *cb=(struct iocb *)(unsigned long)ev[i].obj;
+      if(ev[i].res!=(long long)cb->aio_nbytes)
+      {
+        std::cout<<"DirectOutputFile: write error ("<<ev[i].res<<")"<<std::endl;
+        return -1;
+      }
+      tags[i]=(int)ev[i].data;
+    }
+    m_nInflight-=n;
+    return n;
+  }
+  bool DirectOutputFile::close()
+  {
+    int tags[WRITER_MAX_NBLOCK];
+    while(m_nInflight>0)
+      if(reap(tags,WRITER_MAX_NBLOCK,100000)<0)break;
+    io_destroy(m_ctx);
+    //****** cut the padding of the last block ******
+    bool ret=(ftruncate(m_fd,m_size)==0);
+    ::close(m_fd);
+    m_fd=-1;
+    return ret;
+  }
+  const char *DirectOutputFile::getName()
+  {
+    return "direct";
+  }
+}
@@ -0,0 +1,220 @@
+#include "Pack12.hpp"
+#include "Simd.hpp"
+#include <string.h>//memcpy
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PACK12_X86
+#endif
+
+//****************************************************
+// scalar kernels
+//****************************************************
+static void pack12_scalar(const unsigned char *in, unsigned char *out, int nLine)
+{
+  for(int l=0;l<nLine;l++)
+  {
+    for(int k=0;k<NCHANNEL/2;k++)
+    {
+      unsigned int a=(in[4*k]<<8|in[4*k+1])&0xFFF;
+      unsigned int b=(in[4*k+2]<<8|in[4*k+3])&0xFFF;
+      out[3*k]=(unsigned char)(a>>4);
+      out[3*k+1]=(unsigned char)((a<<4)|(b>>8));
+      out[3*k+2]=(unsigned char)b;
+    }
+    in+=LINESIZE;
+    out+=PACK12_LINESIZE;
+  }
+}
+
+static void unpack12_scalar(const unsigned char *in, unsigned char *out, int nLine)
+{
+  for(int l=0;l<nLine;l++)
+  {
+    for(int k=0;k<NCHANNEL/2;k++)
+    {
+      unsigned int a=(in[3*k]<<4)|(in[3*k+1]>>4);
+      unsigned int b=((in[3*k+1]&0xF)<<8)|in[3*k+2];
+      out[4*k]=(unsigned char)(a>>8);
+      out[4*k+1]=(unsigned char)a;
+      out[4*k+2]=(unsigned char)(b>>8);
+      out[4*k+3]=(unsigned char)b;
+    }
+    in+=PACK12_LINESIZE;
+    out+=LINESIZE;
+  }
+}
+
+#ifdef PACK12_X86
+//****************************************************
+// SSSE3 kernels : one line (8 samples) per step
+//   pack   : byte swap to little endian u16 -> pmaddwd a*4096+b -> pick 3 bytes of each u32
+//   unpack : pick byte pairs for a and b -> shift/mask -> byte swap to big endian
+// The 16 byte stores/loads run 4 bytes past the line, so the last line is left to the scalar kernel.
+//****************************************************
+__attribute__((target("ssse3")))
+static void pack12_ssse3(const unsigned char *in, unsigned char *out, int nLine)
+{
+  const __m128i swap=_mm_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+  const __m128i mask=_mm_set1_epi16(0x0FFF);
+  const __m128i mul=_mm_set1_epi32(0x00011000);
+  const __m128i pick=_mm_setr_epi8(2,1,0,6,5,4,10,9,8,14,13,12,-1,-1,-1,-1);
+  int l=0;
+  for(;l+1<nLine;l++)
+  {
+    __m128i x=_mm_loadu_si128((const __m128i *)in);
+    x=_mm_and_si128(_mm_shuffle_epi8(x,swap),mask);
+    x=_mm_madd_epi16(x,mul);
+    _mm_storeu_si128((__m128i *)out,_mm_shuffle_epi8(x,pick));
+    in+=LINESIZE;
+    out+=PACK12_LINESIZE;
+  }
+  pack12_scalar(in,out,nLine-l);
+}
+
+__attribute__((target("ssse3")))
+static void unpack12_ssse3(const unsigned char *in, unsigned char *out, int nLine)
+{
+  const __m128i pick=_mm_setr_epi8(1,0,2,1,4,3,5,4,7,6,8,7,10,9,11,10);
+  const __m128i maskA=_mm_set1_epi32(0x00000FFF);
+  const __m128i maskB=_mm_set1_epi32(0x0FFF0000);
+  const __m128i swap=_mm_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+  int l=0;
+  for(;l+1<nLine;l++)
+  {
+    __m128i x=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)in),pick);
+    x=_mm_or_si128(_mm_and_si128(_mm_srli_epi16(x,4),maskA),_mm_and_si128(x,maskB));
+    _mm_storeu_si128((__m128i *)out,_mm_shuffle_epi8(x,swap));
+    in+=PACK12_LINESIZE;
+    out+=LINESIZE;
+  }
+  unpack12_scalar(in,out,nLine-l);
+}
+
+//****************************************************
+// AVX2 kernels : two lines per step, one in each 128 bit lane
+//   vpermd moves the 12 bytes of each lane together (pack) or apart (unpack).
+//   The 32 byte stores/loads run 8 bytes past the two lines.
+//****************************************************
+__attribute__((target("avx2")))
+static void pack12_avx2(const unsigned char *in, unsigned char *out, int nLine)
+{
+  const __m256i swap=_mm256_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14,
+                                      1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+  const __m256i mask=_mm256_set1_epi16(0x0FFF);
+  const __m256i mul=_mm256_set1_epi32(0x00011000);
+  const __m256i pick=_mm256_setr_epi8(2,1,0,6,5,4,10,9,8,14,13,12,-1,-1,-1,-1,
+                                      2,1,0,6,5,4,10,9,8,14,13,12,-1,-1,-1,-1);
+  const __m256i compact=_mm256_setr_epi32(0,1,2,4,5,6,7,7);
+  int l=0;
+  for(;l+2<nLine;l+=2)
+  {
+    __m256i x=_mm256_loadu_si256((const __m256i *)in);
+    x=_mm256_and_si256(_mm256_shuffle_epi8(x,swap),mask);
+    x=_mm256_shuffle_epi8(_mm256_madd_epi16(x,mul),pick);
+    _mm256_storeu_si256((__m256i *)out,_mm256_permutevar8x32_epi32(x,compact));
+    in+=2*LINESIZE;
+    out+=2*PACK12_LINESIZE;
+  }
+  _mm256_zeroupper();  //the tail call is not given vzeroupper by the compiler
+  pack12_ssse3(in,out,nLine-l);
+}
+
+__attribute__((target("avx2")))
+static void unpack12_avx2(const unsigned char *in, unsigned char *out, int nLine)
+{
+  const __m256i pick=_mm256_setr_epi8(1,0,2,1,4,3,5,4,7,6,8,7,10,9,11,10,
+                                      1,0,2,1,4,3,5,4,7,6,8,7,10,9,11,10);
+  const __m256i expand=_mm256_setr_epi32(0,1,2,3,3,4,5,6);
+  const __m256i maskA=_mm256_set1_epi32(0x00000FFF);
+  const __m256i maskB=_mm256_set1_epi32(0x0FFF0000);
+  const __m256i swap=_mm256_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14,
+                                      1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+  int l=0;
+  for(;l+2<nLine;l+=2)
+  {
+    __m256i x=_mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)in),expand);
+    x=_mm256_shuffle_epi8(x,pick);
+    x=_mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(x,4),maskA),_mm256_and_si256(x,maskB));
+    _mm256_storeu_si256((__m256i *)out,_mm256_shuffle_epi8(x,swap));
+    in+=2*PACK12_LINESIZE;
+    out+=2*LINESIZE;
+  }
+  _mm256_zeroupper();
+  unpack12_ssse3(in,out,nLine-l);
+}
+#endif
+
+namespace LSTDAQ{
+  Pack12::Pack12() throw()
+  {
+  }
+  Pack12::~Pack12() throw()
+  {
+  }
+  const char *Pack12::getName()
+  {
+    return "pack12";
+  }
+
+  bool Pack12::process(EventHeader *header, unsigned char **data, unsigned char **spare, int worker)
+  {
+    if(header->flags&(EVFMT_ENCODED|EVFMT_ZS|EVFMT_DL1|EVFMT_SOA))return true;
+    unsigned int prefix=getPrefixSize(header->flags,header->nModule);
+    memcpy(*spare,*data,prefix);
+    header->size=prefix+encode(*data+prefix,header->nModule,getNgainStored(header->flags),*spare+prefix);
+    header->flags|=EVFMT_PACK12;
+    unsigned char *p=*data;
+    *data=*spare;
+    *spare=p;
+    return true;
+  }
+
+  void Pack12::pack(const unsigned char *in, unsigned char *out, int nLine)
+  {
+#ifdef PACK12_X86
+    switch(getSimdLevel())
+    {
+    case SIMD_AVX2:pack12_avx2(in,out,nLine);return;
+    case SIMD_SSSE3:pack12_ssse3(in,out,nLine);return;
+    }
+#endif
+    pack12_scalar(in,out,nLine);
+  }
+
+  void Pack12::unpack(const unsigned char *in, unsigned char *out, int nLine)
+  {
+#ifdef PACK12_X86
+    switch(getSimdLevel())
+    {
+    case SIMD_AVX2:unpack12_avx2(in,out,nLine);return;
+    case SIMD_SSSE3:unpack12_ssse3(in,out,nLine);return;
+    }
+#endif
+    unpack12_scalar(in,out,nLine);
+  }
+
+  unsigned int Pack12::encode(const unsigned char *in, unsigned int nModule, int nGain, unsigned char *out)
+  {
+    for(unsigned int m=0;m<nModule;m++)
+    {
+      memcpy(out,in,LINE_WAVEFORM*LINESIZE);
+      pack(in+LINE_WAVEFORM*LINESIZE,out+LINE_WAVEFORM*LINESIZE,READDEPTH*nGain);
+      in+=(LINE_WAVEFORM+READDEPTH*nGain)*LINESIZE;
+      out+=PACK12_MODULESIZE(nGain);
+    }
+    return nModule*PACK12_MODULESIZE(nGain);
+  }
+
+  int Pack12::decode(const unsigned char *in, unsigned int size, unsigned int nModule, int nGain, unsigned char *out)
+  {
+    if(size!=nModule*PACK12_MODULESIZE(nGain))return -1;
+    for(unsigned int m=0;m<nModule;m++)
+    {
+      memcpy(out,in,LINE_WAVEFORM*LINESIZE);
+      unpack(in+LINE_WAVEFORM*LINESIZE,out+LINE_WAVEFORM*LINESIZE,READDEPTH*nGain);
+      in+=PACK12_MODULESIZE(nGain);
+      out+=(LINE_WAVEFORM+READDEPTH*nGain)*LINESIZE;
+    }
+    return (int)(nModule*(LINE_WAVEFORM+READDEPTH*nGain)*LINESIZE);
+  }
+}
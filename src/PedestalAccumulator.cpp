@@ -0,0 +1,177 @@
+#include "PedestalAccumulator.hpp"
+#include <iostream>
+#include <stdio.h> //printf
+#include <math.h>  //sqrt
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PEDACC_X86
+#endif
+
+//****************************************************
+// Welford update of len contiguous cells
+//   n+=1, d=x-mean, mean+=d/n, m2+=d*(x-mean)
+//****************************************************
+static void update(float *n, float *mean, float *m2, const float *x, int len)
+{
+  int i=0;
+#ifdef PEDACC_X86
+  const __m128 one=_mm_set1_ps(1.0f);
+  for(;i+4<=len;i+=4)
+  {
+    __m128 vn=_mm_add_ps(_mm_loadu_ps(n+i),one);
+    __m128 vx=_mm_loadu_ps(x+i);
+    __m128 vm=_mm_loadu_ps(mean+i);
+    __m128 d=_mm_sub_ps(vx,vm);
+    vm=_mm_add_ps(vm,_mm_div_ps(d,vn));
+    __m128 v2=_mm_add_ps(_mm_loadu_ps(m2+i),_mm_mul_ps(d,_mm_sub_ps(vx,vm)));
+    _mm_storeu_ps(n+i,vn);
+    _mm_storeu_ps(mean+i,vm);
+    _mm_storeu_ps(m2+i,v2);
+  }
+#endif
+  for(;i<len;i++)
+  {
+    n[i]+=1.0f;
+    float d=x[i]-mean[i];
+    mean[i]+=d/n[i];
+    m2[i]+=d*(x[i]-mean[i]);
+  }
+}
+
+namespace LSTDAQ{
+  PedestalAccumulator::PedestalAccumulator(int nModule, const char *fileName) throw()
+    :m_nModule(nModule),m_fileName(fileName),m_nWorker(0),m_table(NULL),m_saved(false)
+  {
+  }
+  PedestalAccumulator::~PedestalAccumulator() throw()
+  {
+    for(int w=0;w<m_nWorker;w++)
+    {
+      delete[] m_shard[w].n;
+      delete[] m_shard[w].mean;
+      delete[] m_shard[w].m2;
+    }
+    delete m_table;
+  }
+  const char *PedestalAccumulator::getName()
+  {
+    return "pedrun";
+  }
+
+  void PedestalAccumulator::init(int nWorker)
+  {
+    unsigned long size=(unsigned long)m_nModule*NGAIN*NCHANNEL*DRS4_NCELL;
+    m_nWorker=nWorker;
+    for(int w=0;w<nWorker;w++)
+    {
+      m_shard[w].n=new float[size];
+      m_shard[w].mean=new float[size];
+      m_shard[w].m2=new float[size];
+      for(unsigned long i=0;i<size;i++)
+      {
+        m_shard[w].n[i]=0;
+        m_shard[w].mean[i]=0;
+        m_shard[w].m2[i]=0;
+      }
+      m_shard[w].nEvent=0;
+    }
+  }
+
+  bool PedestalAccumulator::process(EventHeader *header, unsigned char **data, unsigned char **spare, int worker)
+  {
+    if(header->flags!=0)return false;  //raw fragments only
+    int n=header->nModule<m_nModule ? header->nModule : m_nModule;
+    for(int m=0;m<n;m++)
+    {
+      if(m<64 && (header->missing>>m&1))continue;
+      accumulateModule(&m_shard[worker],*data+(unsigned long)m*EVENTSIZE,m);
+    }
+    m_shard[worker].nEvent++;
+    return false;  //only the statistics are kept
+  }
+
+  void PedestalAccumulator::accumulateModule(Shard *shard, const unsigned char *frag, int module)
+  {
+    float x[READDEPTH];
+    const unsigned char *stopline=frag+LINE_STOPCELL*LINESIZE;
+    for(int c=0;c<NCHANNEL;c++)
+    {
+      int stop=(stopline[2*c]<<8|stopline[2*c+1])&(DRS4_NCELL-1);
+      //****** cells stop.. up to the end of the ring, then from cell 0 ******
+      int len=DRS4_NCELL-stop;
+      if(len>READDEPTH)len=READDEPTH;
+      for(int g=0;g<NGAIN;g++)
+      {
+        const unsigned char *p=frag+(LINE_WAVEFORM+g)*LINESIZE+2*c;
+        for(int s=0;s<READDEPTH;s++)
+        {
+          x[s]=(float)(p[0]<<8|p[1]);
+          p+=NGAIN*LINESIZE;
+        }
+        unsigned long row=(((unsigned long)module*NGAIN+g)*NCHANNEL+c)*DRS4_NCELL;
+        update(shard->n+row+stop,shard->mean+row+stop,shard->m2+row+stop,x,len);
+        if(len<READDEPTH)
+          update(shard->n+row,shard->mean+row,shard->m2+row,x+len,READDEPTH-len);
+      }
+    }
+  }
+
+  void PedestalAccumulator::finish()
+  {
+    if(m_table!=NULL)return;
+    m_table=new PedestalTable(m_nModule);
+    unsigned long long nEvent=0;
+    for(int w=0;w<m_nWorker;w++)nEvent+=m_shard[w].nEvent;
+    m_table->setNevent(nEvent);
+    unsigned long i=0;
+    for(int m=0;m<m_nModule;m++)
+      for(int g=0;g<NGAIN;g++)
+        for(int c=0;c<NCHANNEL;c++)
+          for(int cell=0;cell<DRS4_NCELL;cell++,i++)
+          {
+            //****** merge the shards ******
+            double n=0,mean=0,m2=0;
+            for(int w=0;w<m_nWorker;w++)
+            {
+              double nb=m_shard[w].n[i];
+              if(nb==0)continue;
+              double d=m_shard[w].mean[i]-mean;
+              double nt=n+nb;
+              mean+=d*nb/nt;
+              m2+=m_shard[w].m2[i]+d*d*n*nb/nt;
+              n=nt;
+            }
+            m_table->set(m,g,c,cell,(float)mean,n>1 ? (float)sqrt(m2/(n-1)) : 0.0f);
+          }
+    m_saved=m_table->save(m_fileName.c_str());
+    if(!m_saved)
+      std::cout<<"PedestalAccumulator: pedestal file write error!! : "<<m_fileName<<std::endl;
+  }
+
+  PedestalTable *PedestalAccumulator::getTable()
+  {
+    return m_table;
+  }
+
+  void PedestalAccumulator::printSummary()
+  {
+    if(m_table==NULL)return;
+    //****** cells never read out are excluded from the averages ******
+    double sumMean=0,sumRms=0;
+    unsigned long nCell=0;
+    for(int m=0;m<m_nModule;m++)
+      for(int g=0;g<NGAIN;g++)
+        for(int c=0;c<NCHANNEL;c++)
+          for(int cell=0;cell<DRS4_NCELL;cell++)
+          {
+            float rms=m_table->getRms(m,g,c,cell);
+            if(rms==0)continue;
+            sumMean+=m_table->getMean(m,g,c,cell);
+            sumRms+=rms;
+            nCell++;
+          }
+    printf("  %llu events, %lu cells filled, mean pedestal %.1f, mean rms %.2f -> %s%s\n",
+           m_table->getNevent(),nCell,nCell>0 ? sumMean/nCell : 0.0,nCell>0 ? sumRms/nCell : 0.0,
+           m_fileName.c_str(),m_saved ? "" : " (write error)");
+  }
+}
@@ -0,0 +1,150 @@
+#include "PedestalSubtractor.hpp"
+#include "Simd.hpp"
+#include <stdio.h> //printf
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PEDSUB_X86
+#endif
+
+//****************************************************
+// stop cells of the 8 channels
+//****************************************************
+static void getStopCell(const unsigned char *frag, int *stop)
+{
+  const unsigned char *p=frag+LINE_STOPCELL*LINESIZE;
+  for(int c=0;c<NCHANNEL;c++)
+    stop[c]=(p[2*c]<<8|p[2*c+1])&(DRS4_NCELL-1);
+}
+
+//****************************************************
+// scalar kernel : samples from..READDEPTH-1 of one gain
+//****************************************************
+static void subtract_scalar(unsigned char *frag, const unsigned short **row, int gain, int from)
+{
+  for(int s=from;s<READDEPTH;s++)
+  {
+    unsigned char *p=frag+(LINE_WAVEFORM+NGAIN*s+gain)*LINESIZE;
+    for(int c=0;c<NCHANNEL;c++)
+    {
+      int v=(p[2*c]<<8|p[2*c+1])-row[c][s]+PEDESTAL_OFFSET;
+      if(v<0)v=0;
+      if(v>4095)v=4095;
+      p[2*c]=v>>8;
+      p[2*c+1]=v&0xff;
+    }
+  }
+}
+
+#ifdef PEDSUB_X86
+//****************************************************
+// SSSE3 kernel
+//   rows of the 8 channels -> 8x8 transpose -> 8 lines of one gain
+//   The samples are unsigned : sample+offset and -pedestal saturate at 0xffff and 0
+//   (pedestals are 12 bit), then min(x,4095)=x-subs(x,4095), as the scalar kernel.
+//****************************************************
+__attribute__((target("ssse3")))
+static void subtract_ssse3(unsigned char *frag, const unsigned short **row, int gain)
+{
+  const __m128i swap=_mm_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+  const __m128i offset=_mm_set1_epi16(PEDESTAL_OFFSET);
+  const __m128i max=_mm_set1_epi16(4095);
+  int s0;
+  for(s0=0;s0+8<=READDEPTH;s0+=8)
+  {
+    __m128i v[8],t[8];
+    for(int c=0;c<8;c++)v[c]=_mm_loadu_si128((const __m128i *)(row[c]+s0));
+    //****** transpose : t[k] = pedestals of sample s0+k for channels 0..7 ******
+    __m128i a0=_mm_unpacklo_epi16(v[0],v[1]);
+    __m128i a1=_mm_unpackhi_epi16(v[0],v[1]);
+    __m128i a2=_mm_unpacklo_epi16(v[2],v[3]);
+    __m128i a3=_mm_unpackhi_epi16(v[2],v[3]);
+    __m128i a4=_mm_unpacklo_epi16(v[4],v[5]);
+    __m128i a5=_mm_unpackhi_epi16(v[4],v[5]);
+    __m128i a6=_mm_unpacklo_epi16(v[6],v[7]);
+    __m128i a7=_mm_unpackhi_epi16(v[6],v[7]);
+    __m128i b0=_mm_unpacklo_epi32(a0,a2);
+    __m128i b1=_mm_unpackhi_epi32(a0,a2);
+    __m128i b2=_mm_unpacklo_epi32(a1,a3);
+    __m128i b3=_mm_unpackhi_epi32(a1,a3);
+    __m128i b4=_mm_unpacklo_epi32(a4,a6);
+    __m128i b5=_mm_unpackhi_epi32(a4,a6);
+    __m128i b6=_mm_unpacklo_epi32(a5,a7);
+    __m128i b7=_mm_unpackhi_epi32(a5,a7);
+    t[0]=_mm_unpacklo_epi64(b0,b4);
+    t[1]=_mm_unpackhi_epi64(b0,b4);
+    t[2]=_mm_unpacklo_epi64(b1,b5);
+    t[3]=_mm_unpackhi_epi64(b1,b5);
+    t[4]=_mm_unpacklo_epi64(b2,b6);
+    t[5]=_mm_unpackhi_epi64(b2,b6);
+    t[6]=_mm_unpacklo_epi64(b3,b7);
+    t[7]=_mm_unpackhi_epi64(b3,b7);
+
+    unsigned char *p=frag+(LINE_WAVEFORM+NGAIN*s0+gain)*LINESIZE;
+    for(int k=0;k<8;k++)
+    {
+      __m128i x=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p),swap);
+      x=_mm_subs_epu16(_mm_adds_epu16(x,offset),t[k]);
+      x=_mm_sub_epi16(x,_mm_subs_epu16(x,max));
+      _mm_storeu_si128((__m128i *)p,_mm_shuffle_epi8(x,swap));
+      p+=NGAIN*LINESIZE;
+    }
+  }
+  if(s0<READDEPTH)subtract_scalar(frag,row,gain,s0);
+}
+#endif
+
+namespace LSTDAQ{
+  PedestalSubtractor::PedestalSubtractor(PedestalTable *table) throw():m_table(table)
+  {
+    for(int i=0;i<MAX_WORKER;i++)m_count[i].nModule=0;
+  }
+  PedestalSubtractor::~PedestalSubtractor() throw()
+  {
+  }
+  const char *PedestalSubtractor::getName()
+  {
+    return "pedsub";
+  }
+
+  bool PedestalSubtractor::process(EventHeader *header, unsigned char **data, unsigned char **spare, int worker)
+  {
+    if(header->flags!=0)return true;  //raw fragments only
+    int n=header->nModule;
+    if(n>m_table->getNmodule())n=m_table->getNmodule();
+    for(int m=0;m<n;m++)
+    {
+      if(m<64 && (header->missing>>m&1))continue;
+      subtractModule(*data+(unsigned long)m*EVENTSIZE,m_table,m);
+      m_count[worker].nModule++;
+    }
+    header->flags|=EVFMT_PEDSUB;
+    return true;
+  }
+
+  void PedestalSubtractor::subtractModule(unsigned char *frag, PedestalTable *table, int module)
+  {
+    int stop[NCHANNEL];
+    const unsigned short *row[NCHANNEL];
+    getStopCell(frag,stop);
+    for(int g=0;g<NGAIN;g++)
+    {
+      for(int c=0;c<NCHANNEL;c++)row[c]=table->getRow(module,g,c)+stop[c];
+#ifdef PEDSUB_X86
+      if(getSimdLevel()>=SIMD_SSSE3)
+      {
+        subtract_ssse3(frag,row,g);
+        continue;
+      }
+#endif
+      subtract_scalar(frag,row,g,0);
+    }
+  }
+
+  void PedestalSubtractor::printSummary()
+  {
+    unsigned long long n=0;
+    for(int i=0;i<MAX_WORKER;i++)n+=m_count[i].nModule;
+    printf("  %d modules in the table (%llu events), %llu module fragments subtracted\n",
+           m_table->getNmodule(),m_table->getNevent(),n);
+  }
+}
@@ -0,0 +1,125 @@
+#include "PedestalTable.hpp"
+#include <iostream>
+#include <stdio.h> //fopen
+#include <string.h>//memcpy
+
+namespace LSTDAQ{
+  PedestalTable::PedestalTable(int nModule) throw():m_nModule(nModule),m_nEvent(0)
+  {
+    unsigned long n=(unsigned long)nModule*NGAIN*NCHANNEL*DRS4_NCELL;
+    m_mean=new float[n];
+    m_rms=new float[n];
+    m_row=new unsigned short[(unsigned long)nModule*NGAIN*NCHANNEL*(DRS4_NCELL+PEDESTAL_PAD)];
+    for(unsigned long i=0;i<n;i++)
+    {
+      m_mean[i]=0;
+      m_rms[i]=0;
+    }
+    memset(m_row,0,sizeof(unsigned short)*nModule*NGAIN*NCHANNEL*(DRS4_NCELL+PEDESTAL_PAD));
+  }
+  PedestalTable::~PedestalTable() throw()
+  {
+    delete[] m_mean;
+    delete[] m_rms;
+    delete[] m_row;
+  }
+
+  void PedestalTable::set(int module, int gain, int channel, int cell, float mean, float rms)
+  {
+    m_mean[index(module,gain,channel,cell)]=mean;
+    m_rms[index(module,gain,channel,cell)]=rms;
+    unsigned short *row=(unsigned short *)getRow(module,gain,channel);
+    unsigned short v= mean<0 ? 0 : (unsigned short)(mean+0.5);
+    row[cell]=v;
+    if(cell<PEDESTAL_PAD)row[DRS4_NCELL+cell]=v;
+  }
+  float PedestalTable::getMean(int module, int gain, int channel, int cell)
+  {
+    return m_mean[index(module,gain,channel,cell)];
+  }
+  float PedestalTable::getRms(int module, int gain, int channel, int cell)
+  {
+    return m_rms[index(module,gain,channel,cell)];
+  }
+  int PedestalTable::getNmodule() throw()
+  {
+    return m_nModule;
+  }
+  void PedestalTable::setNevent(unsigned long long nEvent)
+  {
+    m_nEvent=nEvent;
+  }
+  unsigned long long PedestalTable::getNevent() throw()
+  {
+    return m_nEvent;
+  }
+
+  PedestalTable *PedestalTable::load(const char *fileName)
+  {
+    FILE *fp=fopen(fileName,"rb");
+    if(fp==NULL)
+    {
+      std::cout<<"pedestal file open error!! : "<<fileName<<std::endl;
+      return NULL;
+    }
+    PedestalFileHeader h;
+    if(fread(&h,sizeof(h),1,fp)!=1 || memcmp(h.magic,PEDESTAL_MAGIC,4)!=0 || h.version!=PEDESTAL_VERSION
+       || h.nGain!=NGAIN || h.nChannel!=NCHANNEL || h.nCell!=DRS4_NCELL)
+    {
+      std::cout<<"not a pedestal file for this configuration : "<<fileName<<std::endl;
+      fclose(fp);
+      return NULL;
+    }
+    PedestalTable *t=new PedestalTable(h.nModule);
+    unsigned long n=(unsigned long)h.nModule*NGAIN*NCHANNEL*DRS4_NCELL;
+    float *mean=new float[n];
+    float *rms=new float[n];
+    bool ok=(fread(mean,sizeof(float),n,fp)==n && fread(rms,sizeof(float),n,fp)==n);
+    fclose(fp);
+    if(ok)
+    {
+      for(int m=0;m<h.nModule;m++)
+        for(int g=0;g<NGAIN;g++)
+          for(int c=0;c<NCHANNEL;c++)
+            for(int cell=0;cell<DRS4_NCELL;cell++)
+            {
+              unsigned long i=t->index(m,g,c,cell);
+              t->set(m,g,c,cell,mean[i],rms[i]);
+            }
+      t->setNevent(h.nEvent);
+    }
+    else
+    {
+      std::cout<<"pedestal file is truncated : "<<fileName<<std::endl;
+      delete t;
+      t=NULL;
+    }
+    delete[] mean;
+    delete[] rms;
+    return t;
+  }
+
+  bool PedestalTable::save(const char *fileName)
+  {
+    FILE *fp=fopen(fileName,"wb");
+    if(fp==NULL)
+    {
+      std::cout<<"pedestal file open error!! : "<<fileName<<std::endl;
+      return false;
+    }
+    PedestalFileHeader h;
+    memcpy(h.magic,PEDESTAL_MAGIC,4);
+    h.version=PEDESTAL_VERSION;
+    h.nModule=m_nModule;
+    h.nGain=NGAIN;
+    h.nChannel=NCHANNEL;
+    h.nCell=DRS4_NCELL;
+    h.reserved=0;
+    h.nEvent=m_nEvent;
+    unsigned long n=(unsigned long)m_nModule*NGAIN*NCHANNEL*DRS4_NCELL;
+    bool ok=(fwrite(&h,sizeof(h),1,fp)==1 && fwrite(m_mean,sizeof(float),n,fp)==n
+             && fwrite(m_rms,sizeof(float),n,fp)==n);
+    if(fclose(fp)!=0)ok=false;
+    return ok;
+  }
+}
@@ -6,6 +6,14 @@
 #include <stdlib.h> //exit(1)
 #include <sys/time.h>//timespec in cond_timedwait
 #include <errno.h>//ETIMEDOUT is defined here
+#include <sys/syscall.h>//mbind
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE (1<<1)
+#endif
 
 //EVENTSIZE should be variable
 // for multiple connection.
@@ -45,9 +53,25 @@ namespace LSTDAQ{
   }
   bool RingBuffer::open()
   {
+    return true;
   }
   bool RingBuffer::init()
   {
+    return true;
+  }
+  bool RingBuffer::setNode(int node)
+  {
+#ifdef SYS_mbind
+    if(node<0 || node>=(int)sizeof(unsigned long)*8)return false;
+    unsigned long mask=1UL<<node;
+    //****** whole pages inside the buffer ******
+    unsigned long page=sysconf(_SC_PAGESIZE);
+    unsigned long start=((unsigned long)m_buffer+page-1)&~(page-1);
+    unsigned long end=((unsigned long)m_buffer+sizeof(m_buffer))&~(page-1);
+    return syscall(SYS_mbind,start,end-start,MPOL_PREFERRED,&mask,sizeof(mask)*8+1,MPOL_MF_MOVE)==0;
+#else
+    return false;
+#endif
   }
   int RingBuffer::write( char *buf,unsigned int wbytes)
   {
@@ -0,0 +1,228 @@
+#include "RunControl.hpp"
+#include <iostream>
+#include <stdio.h>     //perror
+#include <stdlib.h>    //atoi
+#include <string.h>    //strcpy
+#include <errno.h>
+#include <unistd.h>    //close, unlink
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>    //sockaddr_un
+#include <sys/stat.h>  //lstat
+#include <netinet/in.h>
+
+namespace LSTDAQ{
+  RunControl::RunControl(const char *address) throw()
+  {
+    m_address=address;
+    m_listenFd=-1;
+    m_clientFd=-1;
+    m_state=RC_STATE_IDLE;
+  }
+  RunControl::~RunControl() throw()
+  {
+    close();
+  }
+
+  bool RunControl::open()
+  {
+    if(m_address.compare(0,5,"unix:")==0)
+    {
+      struct sockaddr_un addr;
+      m_unixPath=m_address.substr(5);
+      if(m_unixPath.length()==0 || m_unixPath.length()>=sizeof(addr.sun_path))
+      {
+        std::cout<<"RunControl: bad socket path "<<m_unixPath<<std::endl;
+        return false;
+      }
+      memset(&addr,0,sizeof(addr));
+      addr.sun_family=AF_UNIX;
+      strcpy(addr.sun_path,m_unixPath.c_str());
+      //****** only a socket left by a previous process is replaced ******
+      struct stat st;
+      if(lstat(m_unixPath.c_str(),&st)==0)
+      {
+        if(!S_ISSOCK(st.st_mode))
+        {
+          std::cout<<"RunControl: "<<m_unixPath<<" exists and is not a socket"<<std::endl;
+          return false;
+        }
+        unlink(m_unixPath.c_str());
+      }
+      m_listenFd=socket(AF_UNIX,SOCK_STREAM,0);
+      if(m_listenFd<0 || bind(m_listenFd,(struct sockaddr *)&addr,sizeof(addr))!=0)
+      {
+        perror("RunControl::bind()");
+        return false;
+      }
+    }
+    else if(m_address.compare(0,4,"tcp:")==0)
+    {
+      //****** localhost only ******
+      struct sockaddr_in addr;
+      memset(&addr,0,sizeof(addr));
+      addr.sin_family=AF_INET;
+      addr.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+      addr.sin_port=htons(atoi(m_address.c_str()+4));
+      m_listenFd=socket(AF_INET,SOCK_STREAM,0);
+      int on=1;
+      if(m_listenFd>=0)setsockopt(m_listenFd,SOL_SOCKET,SO_REUSEADDR,&on,sizeof(on));
+      if(m_listenFd<0 || bind(m_listenFd,(struct sockaddr *)&addr,sizeof(addr))!=0)
+      {
+        perror("RunControl::bind()");
+        return false;
+      }
+    }
+    else
+    {
+      std::cout<<"RunControl: address must be unix:<path> or tcp:<port> : "<<m_address<<std::endl;
+      return false;
+    }
+    if(listen(m_listenFd,1)!=0)
+    {
+      perror("RunControl::listen()");
+      return false;
+    }
+    std::cout<<"RunControl: waiting for commands on "<<m_address<<std::endl;
+    return true;
+  }
+
+  int RunControl::next(std::string &arg, int timeoutMsec)
+  {
+    arg="";
+    //****** a command may be left from the last read ******
+    size_t eol=m_line.find('\n');
+    if(eol==std::string::npos)
+    {
+      struct pollfd pfd;
+      pfd.fd=(m_clientFd>=0 ? m_clientFd : m_listenFd);
+      pfd.events=POLLIN;
+      if(poll(&pfd,1,timeoutMsec)<=0)return RC_CMD_NONE;
+      if(m_clientFd<0)
+      {
+        m_clientFd=accept(m_listenFd,NULL,NULL);
+        if(m_clientFd>=0)std::cout<<"RunControl: client connected"<<std::endl;
+        m_line="";
+        return RC_CMD_NONE;
+      }
+      char buf[256];
+      ssize_t n=recv(m_clientFd,buf,sizeof(buf),0);
+      if(n<0 && errno==EINTR)return RC_CMD_NONE;
+      if(n<=0)
+      {
+        std::cout<<"RunControl: client disconnected"<<std::endl;
+        ::close(m_clientFd);
+        m_clientFd=-1;
+        return RC_CMD_NONE;
+      }
+      m_line.append(buf,n);
+      eol=m_line.find('\n');
+      if(eol==std::string::npos)
+      {
+        //****** a line longer than any command is thrown away ******
+        if(m_line.length()>sizeof(buf))m_line="";
+        return RC_CMD_NONE;
+      }
+    }
+    std::string line=m_line.substr(0,eol);
+    m_line.erase(0,eol+1);
+    if(line.length()>0 && line[line.length()-1]=='\r')line.erase(line.length()-1);
+    if(line.length()==0)return RC_CMD_NONE;
+    return parse(line.c_str(),arg);
+  }
+
+  int RunControl::parse(const char *line, std::string &arg)
+  {
+    char cmd[32];
+    char word[64];
+    word[0]='\0';
+    if(sscanf(line,"%31s %63s",cmd,word)<1)return RC_CMD_UNKNOWN;
+    arg=word;
+    if(strcmp(cmd,"configure")==0)return RC_CMD_CONFIGURE;
+    if(strcmp(cmd,"start")==0)return RC_CMD_START;
+    if(strcmp(cmd,"stop")==0)return RC_CMD_STOP;
+    if(strcmp(cmd,"reset")==0)return RC_CMD_RESET;
+    if(strcmp(cmd,"status")==0)return RC_CMD_STATUS;
+    if(strcmp(cmd,"quit")==0)return RC_CMD_QUIT;
+    return RC_CMD_UNKNOWN;
+  }
+
+  void RunControl::reply(const char *line)
+  {
+    if(m_clientFd<0)return;
+    std::string s=line;
+    s+="\n";
+    //****** a client which does not read its replies is dropped ******
+    if(send(m_clientFd,s.c_str(),s.length(),MSG_NOSIGNAL|MSG_DONTWAIT)!=(ssize_t)s.length())
+    {
+      std::cout<<"RunControl: client dropped"<<std::endl;
+      ::close(m_clientFd);
+      m_clientFd=-1;
+    }
+  }
+
+  void RunControl::ok()
+  {
+    std::string s="OK ";
+    s+=stateName(m_state);
+    reply(s.c_str());
+  }
+
+  void RunControl::error(const char *reason)
+  {
+    std::string s="ERROR ";
+    s+=reason;
+    reply(s.c_str());
+  }
+
+  bool RunControl::isAllowed(int cmd) throw()
+  {
+    switch(cmd)
+    {
+    case RC_CMD_CONFIGURE:
+      return m_state==RC_STATE_IDLE;
+    case RC_CMD_START:
+      return m_state==RC_STATE_CONFIGURED;
+    case RC_CMD_STOP:
+      //also after a run which ended by itself, to get its statistics
+      return m_state!=RC_STATE_IDLE;
+    case RC_CMD_RESET:
+    case RC_CMD_STATUS:
+    case RC_CMD_QUIT:
+      return true;
+    }
+    return false;
+  }
+
+  void RunControl::close()
+  {
+    if(m_clientFd>=0)::close(m_clientFd);
+    m_clientFd=-1;
+    if(m_listenFd>=0)
+    {
+      ::close(m_listenFd);
+      if(m_unixPath.length()>0)unlink(m_unixPath.c_str());
+    }
+    m_listenFd=-1;
+  }
+
+  const char *RunControl::stateName(int state)
+  {
+    switch(state)
+    {
+    case RC_STATE_IDLE:       return "IDLE";
+    case RC_STATE_CONFIGURED: return "CONFIGURED";
+    case RC_STATE_RUNNING:    return "RUNNING";
+    }
+    return "UNKNOWN";
+  }
+
+  int RunControl::getState() throw()
+  {
+    return m_state;
+  }
+  void RunControl::setState(int state) throw()
+  {
+    m_state=state;
+  }
+}
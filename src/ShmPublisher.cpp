@@ -0,0 +1,151 @@
+#include "ShmPublisher.hpp"
+#include <iostream>
+#include <stdio.h>    //perror
+#include <string.h>   //memcpy
+#include <fcntl.h>    //O_CREAT
+#include <unistd.h>   //ftruncate
+#include <sys/mman.h> //shm_open, mmap
+
+namespace LSTDAQ{
+  ShmPublisher::ShmPublisher(const char *name, unsigned long long dataSize) throw()
+  {
+    m_name=name;
+    if(m_name.length()==0 || m_name[0]!='/')m_name="/"+m_name;
+    m_dataSize=(dataSize+SHM_ALIGN-1)/SHM_ALIGN*SHM_ALIGN;
+    m_fd=-1;
+    m_map=NULL;
+    m_mapSize=0;
+    m_header=NULL;
+    m_data=NULL;
+    m_nEvent=0;
+    m_nTooLarge=0;
+    m_bytes=0;
+  }
+  ShmPublisher::~ShmPublisher() throw()
+  {
+    finish();
+  }
+
+  bool ShmPublisher::open()
+  {
+    m_fd=shm_open(m_name.c_str(),O_RDWR|O_CREAT|O_TRUNC,0644);
+    if(m_fd<0)
+    {
+      perror("ShmPublisher::shm_open()");
+      return false;
+    }
+    m_mapSize=getShmHeaderSize()+m_dataSize;
+    if(ftruncate(m_fd,m_mapSize)!=0)
+    {
+      perror("ShmPublisher::ftruncate()");
+      ::close(m_fd);
+      m_fd=-1;
+      shm_unlink(m_name.c_str());
+      return false;
+    }
+    void *p=mmap(NULL,m_mapSize,PROT_READ|PROT_WRITE,MAP_SHARED,m_fd,0);
+    if(p==MAP_FAILED)
+    {
+      perror("ShmPublisher::mmap()");
+      ::close(m_fd);
+      m_fd=-1;
+      shm_unlink(m_name.c_str());
+      return false;
+    }
+    m_map=(unsigned char *)p;
+    m_header=(ShmRingHeader *)m_map;
+    m_data=m_map+getShmHeaderSize();
+    memset(m_header,0,sizeof(ShmRingHeader));
+    m_header->version=SHM_VERSION;
+    m_header->dataSize=m_dataSize;
+    m_header->state=SHM_STATE_RUNNING;
+    //****** readers check the magic last ******
+    __sync_synchronize();
+    memcpy(m_header->magic,SHM_MAGIC,4);
+    return true;
+  }
+
+  const char *ShmPublisher::getName()
+  {
+    return "shm";
+  }
+
+  //****** move oldest over the records overwritten by len bytes at writeOffset ******
+  void ShmPublisher::makeRoom(unsigned int len)
+  {
+    unsigned long long oldest=m_header->oldest;
+    unsigned long long end=m_header->writeOffset+len;
+    while(end-oldest>m_dataSize)
+      oldest+=((ShmRecordHeader *)(m_data+oldest%m_dataSize))->size;
+    m_header->oldest=oldest;
+    __sync_synchronize();
+  }
+
+  void ShmPublisher::put(const ShmRecordHeader *record, const EventHeader *header, const unsigned char *data)
+  {
+    makeRoom(record->size);
+    unsigned char *p=m_data+m_header->writeOffset%m_dataSize;
+    memcpy(p,record,sizeof(ShmRecordHeader));
+    if(header!=NULL)
+    {
+      memcpy(p+sizeof(ShmRecordHeader),header,sizeof(EventHeader));
+      memcpy(p+sizeof(ShmRecordHeader)+sizeof(EventHeader),data,header->size);
+    }
+    __sync_synchronize();
+    if(header!=NULL)m_header->writeSeq++;
+    m_header->writeOffset+=record->size;
+  }
+
+  void ShmPublisher::consume(const EventBuffer *buf)
+  {
+    if(m_header==NULL)return;
+    ShmRecordHeader record;
+    memset(&record,0,sizeof(record));
+    record.seq=m_header->writeSeq;
+    record.timeNs=buf->timeNs;
+    record.size=getShmRecordSize(buf->header.size);
+    if(record.size>m_dataSize/2)
+    {
+      //****** skipped : readers see a gap of seq ******
+      m_header->writeSeq++;
+      m_nTooLarge++;
+      return;
+    }
+    //****** a record is not split at the end of the ring ******
+    unsigned long long rest=m_dataSize-m_header->writeOffset%m_dataSize;
+    if(record.size>rest)
+    {
+      ShmRecordHeader pad;
+      memset(&pad,0,sizeof(pad));
+      pad.seq=record.seq;
+      pad.size=rest;
+      pad.flags=SHM_RECORD_PAD;
+      put(&pad,NULL,NULL);
+    }
+    put(&record,&buf->header,buf->data);
+    m_nEvent++;
+    m_bytes+=record.size;
+  }
+
+  void ShmPublisher::finish()
+  {
+    if(m_map==NULL)return;
+    __sync_synchronize();
+    m_header->state=SHM_STATE_CLOSED;
+    munmap(m_map,m_mapSize);
+    ::close(m_fd);
+    shm_unlink(m_name.c_str());
+    m_map=NULL;
+    m_header=NULL;
+    m_data=NULL;
+    m_fd=-1;
+  }
+
+  void ShmPublisher::printSummary()
+  {
+    std::cout<<"shared memory       :"<<m_name<<" ("<<m_dataSize/1024/1024<<"MB)"<<std::endl;
+    std::cout<<"published           :"<<m_nEvent<<" events, "<<m_bytes<<" bytes";
+    if(m_nTooLarge>0)std::cout<<" ("<<m_nTooLarge<<" too large)";
+    std::cout<<std::endl;
+  }
+}
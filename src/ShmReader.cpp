@@ -0,0 +1,187 @@
+#include "ShmReader.hpp"
+#include <iostream>
+#include <string>
+#include <string.h>   //memcpy
+#include <fcntl.h>    //O_RDONLY
+#include <unistd.h>   //close, usleep
+#include <sys/mman.h> //shm_open, mmap
+#include <sys/stat.h> //fstat
+#include <time.h>
+
+/** @def SHM_POLL_USEC
+ * @brief Interval to check the ring again when no new event is there [usec]
+ */
+#define SHM_POLL_USEC 100
+
+//****************************************************
+// time calc
+//****************************************************
+static unsigned long long usecSince(const struct timespec *pFrom)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC,&now);
+  return ((unsigned long long)(now.tv_sec - pFrom->tv_sec)*1000000ULL
+          + (unsigned long long)now.tv_nsec/1000ULL) - (unsigned long long)pFrom->tv_nsec/1000ULL;
+}
+
+namespace LSTDAQ{
+  ShmReader::ShmReader() throw()
+  {
+    m_map=NULL;
+    m_mapSize=0;
+    m_header=NULL;
+    m_data=NULL;
+    m_dataSize=0;
+    m_pos=0;
+    m_cur=0;
+    m_seq=0;
+    m_record=NULL;
+    m_timeNs=0;
+    m_nRead=0;
+    m_nSkipped=0;
+    m_nTorn=0;
+  }
+  ShmReader::~ShmReader() throw()
+  {
+    close();
+  }
+
+  bool ShmReader::open(const char *name)
+  {
+    close();
+    std::string path=name;
+    if(path.length()==0 || path[0]!='/')path="/"+path;
+    int fd=shm_open(path.c_str(),O_RDONLY,0);
+    if(fd<0)return false;
+    struct stat st;
+    if(fstat(fd,&st)!=0 || (size_t)st.st_size<getShmHeaderSize())
+    {
+      ::close(fd);
+      return false;
+    }
+    void *p=mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+    ::close(fd);
+    if(p==MAP_FAILED)return false;
+    m_map=(unsigned char *)p;
+    m_mapSize=st.st_size;
+    m_header=(const ShmRingHeader *)m_map;
+    if(memcmp(m_header->magic,SHM_MAGIC,4)!=0 || m_header->version!=SHM_VERSION
+       || getShmHeaderSize()+m_header->dataSize>m_mapSize)
+    {
+      std::cout<<"ShmReader: "<<path<<" is not a ring of version "<<SHM_VERSION<<std::endl;
+      close();
+      return false;
+    }
+    __sync_synchronize();
+    m_data=m_map+getShmHeaderSize();
+    m_dataSize=m_header->dataSize;
+    //****** start from the next event ******
+    m_pos=m_header->writeOffset;
+    __sync_synchronize();
+    m_seq=m_header->writeSeq;
+    m_record=NULL;
+    m_nRead=0;
+    m_nSkipped=0;
+    m_nTorn=0;
+    return true;
+  }
+
+  void ShmReader::close()
+  {
+    if(m_map==NULL)return;
+    munmap(m_map,m_mapSize);
+    m_map=NULL;
+    m_header=NULL;
+    m_data=NULL;
+    m_record=NULL;
+  }
+
+  int ShmReader::next(const EventHeader **header, const unsigned char **data, int timeoutUsec)
+  {
+    if(m_map==NULL)return -1;
+    struct timespec tsStart;
+    clock_gettime(CLOCK_MONOTONIC,&tsStart);
+    while(1)
+    {
+      //****** fell behind : jump to the oldest record ******
+      unsigned long long oldest=m_header->oldest;
+      if(m_pos<oldest)m_pos=oldest;
+      bool closed=(m_header->state==SHM_STATE_CLOSED);
+      __sync_synchronize();
+      if(m_pos>=m_header->writeOffset)
+      {
+        if(closed)return -1;
+        if(usecSince(&tsStart)>=(unsigned long long)timeoutUsec)return 0;
+        usleep(SHM_POLL_USEC);
+        continue;
+      }
+      const ShmRecordHeader *r=(const ShmRecordHeader *)(m_data+m_pos%m_dataSize);
+      ShmRecordHeader rec;
+      memcpy(&rec,r,sizeof(rec));
+      __sync_synchronize();
+      if(m_header->oldest>m_pos)continue;//overwritten while reading
+      if(rec.size<SHM_ALIGN || rec.size>m_dataSize-m_pos%m_dataSize)
+      {
+        m_pos=m_header->oldest;
+        continue;
+      }
+      m_cur=m_pos;
+      m_pos+=rec.size;
+      if(rec.flags&SHM_RECORD_PAD)continue;
+      if(rec.seq>m_seq)m_nSkipped+=rec.seq-m_seq;
+      m_seq=rec.seq+1;
+      m_record=r;
+      m_timeNs=rec.timeNs;
+      m_nRead++;
+      *header=(const EventHeader *)(r+1);
+      *data=(const unsigned char *)(r+1)+sizeof(EventHeader);
+      return 1;
+    }
+  }
+
+  bool ShmReader::isValid()
+  {
+    if(m_record==NULL)return false;
+    __sync_synchronize();
+    if(m_header->oldest<=m_cur)return true;
+    m_nTorn++;
+    m_record=NULL;
+    return false;
+  }
+
+  bool ShmReader::copy(EventHeader *header, unsigned char *buf)
+  {
+    if(m_record==NULL)return false;
+    const EventHeader *h=(const EventHeader *)(m_record+1);
+    memcpy(header,h,sizeof(EventHeader));
+    //****** a size beyond the ring is read only from a record being overwritten ******
+    if(sizeof(ShmRecordHeader)+sizeof(EventHeader)+header->size>m_dataSize-m_cur%m_dataSize)
+    {
+      isValid();
+      return false;
+    }
+    memcpy(buf,(const unsigned char *)(h+1),header->size);
+    return isValid();
+  }
+
+  unsigned long long ShmReader::getSeq() throw()
+  {
+    return m_seq-1;
+  }
+  unsigned long long ShmReader::getTimeNs() throw()
+  {
+    return m_timeNs;
+  }
+  unsigned long long ShmReader::getNread() throw()
+  {
+    return m_nRead;
+  }
+  unsigned long long ShmReader::getNskipped() throw()
+  {
+    return m_nSkipped;
+  }
+  unsigned long long ShmReader::getNtorn() throw()
+  {
+    return m_nTorn;
+  }
+}
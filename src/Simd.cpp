@@ -0,0 +1,38 @@
+#include "Simd.hpp"
+
+//****************************************************
+// detect the instruction set of the CPU
+//****************************************************
+static int detectSimdLevel()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2"))return SIMD_AVX2;
+  if(__builtin_cpu_supports("ssse3"))return SIMD_SSSE3;
+#endif
+  return SIMD_SCALAR;
+}
+
+static int s_simdLevel=-1;
+
+namespace LSTDAQ{
+  int getSimdLevel()
+  {
+    if(s_simdLevel<0)s_simdLevel=detectSimdLevel();
+    return s_simdLevel;
+  }
+  void setSimdLevel(int level)
+  {
+    int max=detectSimdLevel();
+    s_simdLevel= level>max ? max : level;
+  }
+  const char *getSimdName(int level)
+  {
+    switch(level)
+    {
+    case SIMD_AVX2:return "avx2";
+    case SIMD_SSSE3:return "ssse3";
+    default:return "scalar";
+    }
+  }
+}
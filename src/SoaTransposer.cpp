@@ -0,0 +1,144 @@
+#include "SoaTransposer.hpp"
+#include "Simd.hpp"
+#include <string.h>//memcpy
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SOA_X86
+#endif
+
+//****************************************************
+// scalar kernel : samples from..READDEPTH-1
+//****************************************************
+static void transpose_scalar(const unsigned char *module, int nGain, int gain, unsigned short *out, int stride, int from)
+{
+  for(int s=from;s<READDEPTH;s++)
+  {
+    const unsigned char *p=module+(LINE_WAVEFORM+nGain*s+gain)*LINESIZE;
+    for(int c=0;c<NCHANNEL;c++)
+      out[c*stride+s]=p[2*c]<<8|p[2*c+1];
+  }
+}
+
+#ifdef SOA_X86
+//****************************************************
+// SSSE3 kernel : 8 lines (samples) x 8 channels per block
+//****************************************************
+__attribute__((target("ssse3")))
+static void transpose_ssse3(const unsigned char *module, int nGain, int gain, unsigned short *out, int stride)
+{
+  const __m128i swap=_mm_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+  int s0;
+  for(s0=0;s0+8<=READDEPTH;s0+=8)
+  {
+    const unsigned char *p=module+(LINE_WAVEFORM+nGain*s0+gain)*LINESIZE;
+    __m128i v[8];
+    for(int k=0;k<8;k++)
+      v[k]=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p+k*nGain*LINESIZE)),swap);
+    __m128i a0=_mm_unpacklo_epi16(v[0],v[1]);
+    __m128i a1=_mm_unpackhi_epi16(v[0],v[1]);
+    __m128i a2=_mm_unpacklo_epi16(v[2],v[3]);
+    __m128i a3=_mm_unpackhi_epi16(v[2],v[3]);
+    __m128i a4=_mm_unpacklo_epi16(v[4],v[5]);
+    __m128i a5=_mm_unpackhi_epi16(v[4],v[5]);
+    __m128i a6=_mm_unpacklo_epi16(v[6],v[7]);
+    __m128i a7=_mm_unpackhi_epi16(v[6],v[7]);
+    __m128i b0=_mm_unpacklo_epi32(a0,a2);
+    __m128i b1=_mm_unpackhi_epi32(a0,a2);
+    __m128i b2=_mm_unpacklo_epi32(a1,a3);
+    __m128i b3=_mm_unpackhi_epi32(a1,a3);
+    __m128i b4=_mm_unpacklo_epi32(a4,a6);
+    __m128i b5=_mm_unpackhi_epi32(a4,a6);
+    __m128i b6=_mm_unpacklo_epi32(a5,a7);
+    __m128i b7=_mm_unpackhi_epi32(a5,a7);
+    unsigned short *q=out+s0;
+    _mm_storeu_si128((__m128i *)(q+0*stride),_mm_unpacklo_epi64(b0,b4));
+    _mm_storeu_si128((__m128i *)(q+1*stride),_mm_unpackhi_epi64(b0,b4));
+    _mm_storeu_si128((__m128i *)(q+2*stride),_mm_unpacklo_epi64(b1,b5));
+    _mm_storeu_si128((__m128i *)(q+3*stride),_mm_unpackhi_epi64(b1,b5));
+    _mm_storeu_si128((__m128i *)(q+4*stride),_mm_unpacklo_epi64(b2,b6));
+    _mm_storeu_si128((__m128i *)(q+5*stride),_mm_unpackhi_epi64(b2,b6));
+    _mm_storeu_si128((__m128i *)(q+6*stride),_mm_unpacklo_epi64(b3,b7));
+    _mm_storeu_si128((__m128i *)(q+7*stride),_mm_unpackhi_epi64(b3,b7));
+  }
+  if(s0<READDEPTH)transpose_scalar(module,nGain,gain,out,stride,s0);
+}
+#endif
+
+namespace LSTDAQ{
+  SoaTransposer::SoaTransposer() throw()
+  {
+  }
+  SoaTransposer::~SoaTransposer() throw()
+  {
+  }
+  const char *SoaTransposer::getName()
+  {
+    return "soa";
+  }
+
+  void SoaTransposer::transposeModule(const unsigned char *module, int nGain, int gain, unsigned short *out, int stride)
+  {
+#ifdef SOA_X86
+    if(getSimdLevel()>=SIMD_SSSE3)
+    {
+      transpose_ssse3(module,nGain,gain,out,stride);
+      return;
+    }
+#endif
+    transpose_scalar(module,nGain,gain,out,stride,0);
+  }
+
+  bool SoaTransposer::process(EventHeader *header, unsigned char **data, unsigned char **spare, int worker)
+  {
+    if(header->flags&(EVFMT_ENCODED|EVFMT_ZS|EVFMT_DL1|EVFMT_SOA))return true;  //dense layouts only
+    int nGain=getNgainStored(header->flags);
+    unsigned int prefix=getPrefixSize(header->flags,header->nModule);
+    unsigned int moduleSize=getModuleSize(header->flags);
+    unsigned int nModule=header->nModule;
+    memcpy(*spare,*data,prefix);
+    unsigned char *table=*spare+prefix;
+    unsigned short *samples=(unsigned short *)(table+nModule*SOA_HEADERSIZE);
+    //****** module by module : the fragment stays in cache while its rows are written ******
+    for(unsigned int m=0;m<nModule;m++)
+    {
+      const unsigned char *in=*data+prefix+(unsigned long)m*moduleSize;
+      memcpy(table+m*SOA_HEADERSIZE,in,SOA_HEADERSIZE);
+      for(int g=0;g<nGain;g++)
+        transposeModule(in,nGain,g,samples+((unsigned long)g*nModule*NCHANNEL+m*NCHANNEL)*READDEPTH,READDEPTH);
+    }
+    header->flags|=EVFMT_SOA;
+    unsigned char *p=*data;
+    *data=*spare;
+    *spare=p;
+    return true;
+  }
+
+  int SoaTransposer::restore(const EventHeader *header, const unsigned char *payload, unsigned char *out)
+  {
+    unsigned short flags=header->flags&~EVFMT_SOA;
+    int nGain=getNgainStored(flags);
+    unsigned int prefix=getPrefixSize(flags,header->nModule);
+    unsigned int moduleSize=getModuleSize(flags);
+    unsigned int nModule=header->nModule;
+    const unsigned char *table=payload+prefix;
+    const unsigned short *samples=(const unsigned short *)(table+nModule*SOA_HEADERSIZE);
+    memcpy(out,payload,prefix);
+    for(unsigned int m=0;m<nModule;m++)
+    {
+      unsigned char *module=out+prefix+(unsigned long)m*moduleSize;
+      memcpy(module,table+m*SOA_HEADERSIZE,SOA_HEADERSIZE);
+      for(int g=0;g<nGain;g++)
+        for(int c=0;c<NCHANNEL;c++)
+        {
+          const unsigned short *row=samples+((unsigned long)g*nModule*NCHANNEL+m*NCHANNEL+c)*READDEPTH;
+          for(int s=0;s<READDEPTH;s++)
+          {
+            unsigned char *p=module+(LINE_WAVEFORM+nGain*s+g)*LINESIZE+2*c;
+            p[0]=row[s]>>8;
+            p[1]=row[s]&0xff;
+          }
+        }
+    }
+    return prefix+nModule*moduleSize;
+  }
+}
@@ -0,0 +1,128 @@
+#include "SoftwareTrigger.hpp"
+#include "ChargeExtractor.hpp"
+#include "PedestalSubtractor.hpp"
+#include <iostream>
+#include <stdio.h> //printf
+#include <stdlib.h>//exit(1)
+#include <string.h>//memset
+#include <time.h>
+
+//****************************************************
+// time calc
+//****************************************************
+static unsigned long long nsecSince(const struct timespec *pFrom)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC,&now);
+  return (unsigned long long)(now.tv_sec - pFrom->tv_sec)*1000000000ULL + now.tv_nsec - pFrom->tv_nsec;
+}
+
+namespace LSTDAQ{
+  SoftwareTrigger::SoftwareTrigger(unsigned int prescale, int window) throw():m_prescale(prescale),m_nFilter(0)
+  {
+    if(window<1)window=1;
+    if(window>READDEPTH)window=READDEPTH;
+    m_window=window;
+    memset(m_count,0,sizeof(m_count));
+  }
+  SoftwareTrigger::~SoftwareTrigger() throw()
+  {
+    for(int i=0;i<m_nFilter;i++)delete m_filter[i];
+  }
+  void SoftwareTrigger::addFilter(EventFilter *filter)
+  {
+    if(m_nFilter==MAX_FILTER)
+    {
+      std::cout<<"The number of filters excessed limit."<<std::endl;
+      exit(1);
+    }
+    m_filter[m_nFilter++]=filter;
+  }
+  int SoftwareTrigger::getNfilter() throw()
+  {
+    return m_nFilter;
+  }
+  const char *SoftwareTrigger::getName()
+  {
+    return "trigger";
+  }
+
+  bool SoftwareTrigger::getCharge(const EventHeader *header, const unsigned char *data, int *charge)
+  {
+    unsigned int prefix=getPrefixSize(header->flags,header->nModule);
+    int nGain=getNgainStored(header->flags);
+    if(header->flags&EVFMT_DL1)
+    {
+      //****** the first int[NCHANNEL] of each module record ******
+      for(unsigned int m=0;m<header->nModule;m++)
+        memcpy(charge+m*NCHANNEL,data+prefix+m*DL1_MODULESIZE(nGain),NCHANNEL*sizeof(int));
+      return true;
+    }
+    if(header->flags&(EVFMT_ENCODED|EVFMT_ZS|EVFMT_SOA))return false;
+    int baseline=(header->flags&EVFMT_PEDSUB) ? PEDESTAL_OFFSET : 0;
+    unsigned int moduleSize=getModuleSize(header->flags);
+    unsigned short peak[NCHANNEL];
+    for(unsigned int m=0;m<header->nModule;m++)
+    {
+      //****** a missing module holds an older event : skipped by the filters ******
+      if(m<64 && (header->missing>>m&1))continue;
+      ChargeExtractor::extractGain(data+prefix+(unsigned long)m*moduleSize,nGain,0,m_window,baseline,
+                                   charge+m*NCHANNEL,peak);
+    }
+    return true;
+  }
+
+  bool SoftwareTrigger::process(EventHeader *header, unsigned char **data, unsigned char **spare, int worker)
+  {
+    Count &count=m_count[worker];
+    int charge[MAX_CONNECTION*NCHANNEL];
+    if(header->nModule>MAX_CONNECTION || !getCharge(header,*data,charge))return true;
+    bool keep=false;
+    for(int i=0;i<m_nFilter;i++)
+    {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC,&ts);
+      bool ok=m_filter[i]->accept(charge,header->nModule,header->missing);
+      count.filterNsec[i]+=nsecSince(&ts);
+      if(ok)
+      {
+        count.nAccept[i]++;
+        header->trigType|=TRIGTYPE_FILTER(i);
+        keep=true;
+      }
+    }
+    count.nTest++;
+    if(!keep && m_prescale>0 && header->trigger%m_prescale==0)
+    {
+      count.nPrescaled++;
+      header->trigType|=TRIGTYPE_PRESCALED;
+      keep=true;
+    }
+    if(keep)count.nKeep++;
+    return keep;
+  }
+
+  void SoftwareTrigger::printSummary()
+  {
+    unsigned long long nTest=0,nKeep=0,nPrescaled=0;
+    for(int w=0;w<MAX_WORKER;w++)
+    {
+      nTest+=m_count[w].nTest;
+      nKeep+=m_count[w].nKeep;
+      nPrescaled+=m_count[w].nPrescaled;
+    }
+    for(int i=0;i<m_nFilter;i++)
+    {
+      unsigned long long nAccept=0,nsec=0;
+      for(int w=0;w<MAX_WORKER;w++)
+      {
+        nAccept+=m_count[w].nAccept[i];
+        nsec+=m_count[w].filterNsec[i];
+      }
+      printf("  %-16s: accept %llu/%llu (%.2f%%), %.3fusec/event\n",m_filter[i]->getName(),nAccept,nTest,
+             nTest>0 ? 100.0*nAccept/nTest : 0.0,nTest>0 ? (double)nsec/nTest/1000. : 0.);
+    }
+    printf("  kept %llu/%llu (%.2f%%) including %llu prescaled 1/%u\n",nKeep,nTest,
+           nTest>0 ? 100.0*nKeep/nTest : 0.0,nPrescaled,m_prescale);
+  }
+}
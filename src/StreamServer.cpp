@@ -0,0 +1,342 @@
+#include "StreamServer.hpp"
+#include <iostream>
+#include <stdio.h>     //perror, snprintf
+#include <stdlib.h>    //malloc, strtoul
+#include <string.h>    //memcpy, strstr
+#include <errno.h>
+#include <unistd.h>    //close, unlink
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>    //sockaddr_un
+#include <sys/stat.h>  //lstat
+#include <netinet/in.h>
+#include <arpa/inet.h> //inet_ntoa
+
+namespace LSTDAQ{
+  StreamServer::StreamServer(const char *address) throw()
+  {
+    m_address=address;
+    m_listenFd=-1;
+    m_closing=false;
+    m_running=false;
+    pthread_mutex_init(&m_mutex,NULL);
+    for(int i=0;i<MAX_STREAM_CLIENT;i++)m_client[i]=NULL;
+    m_nClient=0;
+    m_nQueued=0;
+    m_nDrop=0;
+    m_bytesSent=0;
+  }
+  StreamServer::~StreamServer() throw()
+  {
+    finish();
+    pthread_mutex_destroy(&m_mutex);
+  }
+
+  bool StreamServer::open()
+  {
+    if(m_address.compare(0,5,"unix:")==0)
+    {
+      struct sockaddr_un addr;
+      m_unixPath=m_address.substr(5);
+      if(m_unixPath.length()==0 || m_unixPath.length()>=sizeof(addr.sun_path))
+      {
+        std::cout<<"StreamServer: bad socket path "<<m_unixPath<<std::endl;
+        return false;
+      }
+      memset(&addr,0,sizeof(addr));
+      addr.sun_family=AF_UNIX;
+      strcpy(addr.sun_path,m_unixPath.c_str());
+      //****** a socket left by a previous process is replaced, any other file is kept ******
+      struct stat st;
+      if(lstat(m_unixPath.c_str(),&st)==0)
+      {
+        if(!S_ISSOCK(st.st_mode))
+        {
+          std::cout<<"StreamServer: "<<m_unixPath<<" exists and is not a socket"<<std::endl;
+          return false;
+        }
+        unlink(m_unixPath.c_str());
+      }
+      m_listenFd=socket(AF_UNIX,SOCK_STREAM,0);
+      if(m_listenFd<0 || bind(m_listenFd,(struct sockaddr *)&addr,sizeof(addr))!=0)
+      {
+        perror("StreamServer::bind()");
+        return false;
+      }
+    }
+    else if(m_address.compare(0,4,"tcp:")==0)
+    {
+      //****** localhost only ******
+      struct sockaddr_in addr;
+      memset(&addr,0,sizeof(addr));
+      addr.sin_family=AF_INET;
+      addr.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+      addr.sin_port=htons(atoi(m_address.c_str()+4));
+      m_listenFd=socket(AF_INET,SOCK_STREAM,0);
+      int on=1;
+      if(m_listenFd>=0)setsockopt(m_listenFd,SOL_SOCKET,SO_REUSEADDR,&on,sizeof(on));
+      if(m_listenFd<0 || bind(m_listenFd,(struct sockaddr *)&addr,sizeof(addr))!=0)
+      {
+        perror("StreamServer::bind()");
+        return false;
+      }
+    }
+    else
+    {
+      std::cout<<"StreamServer: address must be unix:<path> or tcp:<port> : "<<m_address<<std::endl;
+      return false;
+    }
+    if(listen(m_listenFd,MAX_STREAM_CLIENT)!=0)
+    {
+      perror("StreamServer::listen()");
+      return false;
+    }
+    m_closing=false;
+    m_running=true;
+    pthread_create(&m_acceptThread,NULL,&StreamServer::accept_thread,this);
+    return true;
+  }
+
+  const char *StreamServer::getName()
+  {
+    return "stream";
+  }
+
+  void *StreamServer::accept_thread(void *arg)
+  {
+    ((StreamServer *)arg)->runAccept();
+    return NULL;
+  }
+
+  void StreamServer::runAccept()
+  {
+    while(!m_closing)
+    {
+      struct pollfd pfd;
+      pfd.fd=m_listenFd;
+      pfd.events=POLLIN;
+      int n=poll(&pfd,1,STREAM_POLL_MSEC);
+      //****** clean up disconnected clients ******
+      for(int i=0;i<MAX_STREAM_CLIENT;i++)
+        if(m_client[i]!=NULL && m_client[i]->dead)removeClient(i);
+      if(n<=0)continue;
+
+      struct sockaddr_storage addr;
+      socklen_t len=sizeof(addr);
+      int fd=accept(m_listenFd,(struct sockaddr *)&addr,&len);
+      if(fd<0)continue;
+      char name[64];
+      if(addr.ss_family==AF_INET)
+      {
+        struct sockaddr_in *in=(struct sockaddr_in *)&addr;
+        snprintf(name,sizeof(name),"%s:%d",inet_ntoa(in->sin_addr),ntohs(in->sin_port));
+      }
+      else
+        snprintf(name,sizeof(name),"unix#%llu",m_nClient);
+      addClient(fd,name);
+    }
+  }
+
+  void StreamServer::addClient(int fd, const char *name)
+  {
+    //****** optional request line ******
+    char req[256];
+    int len=0;
+    struct pollfd pfd;
+    pfd.fd=fd;
+    pfd.events=POLLIN;
+    while(len<(int)sizeof(req)-1 && poll(&pfd,1,STREAM_REQUEST_MSEC)>0)
+    {
+      ssize_t n=recv(fd,req+len,sizeof(req)-1-len,0);
+      if(n<=0)break;
+      len+=n;
+      req[len]='\0';
+      if(strchr(req,'\n')!=NULL)break;
+    }
+    req[len]='\0';
+    unsigned int prescale=1;
+    unsigned int typeMask=0;
+    const char *p;
+    if((p=strstr(req,"prescale="))!=NULL)prescale=strtoul(p+9,NULL,0);
+    if((p=strstr(req,"types="))!=NULL)typeMask=strtoul(p+6,NULL,0);
+    if(prescale<1)prescale=1;
+
+    //****** a stalled client must not keep the sender thread forever ******
+    struct timeval tv;
+    tv.tv_sec=STREAM_SENDTIMEOUT_SEC;
+    tv.tv_usec=0;
+    setsockopt(fd,SOL_SOCKET,SO_SNDTIMEO,&tv,sizeof(tv));
+
+    pthread_mutex_lock(&m_mutex);
+    int slot=-1;
+    for(int i=0;i<MAX_STREAM_CLIENT && slot<0;i++)
+      if(m_client[i]==NULL)slot=i;
+    pthread_mutex_unlock(&m_mutex);
+    if(slot<0)
+    {
+      std::cout<<"StreamServer: too many clients. "<<name<<" is refused."<<std::endl;
+      ::close(fd);
+      return;
+    }
+
+    unsigned long size=(unsigned long)STREAM_QUEUE_MB*1024*1024;
+    unsigned char *ring=(unsigned char *)malloc(size);
+    if(ring==NULL)
+    {
+      std::cout<<"StreamServer: no memory for the queue. "<<name<<" is refused."<<std::endl;
+      ::close(fd);
+      return;
+    }
+
+    Client *c=new Client;
+    c->owner=this;
+    c->fd=fd;
+    c->name=name;
+    pthread_mutex_init(&c->mutex,NULL);
+    pthread_cond_init(&c->cond,NULL);
+    c->size=size;
+    c->ring=ring;
+    c->head=0;
+    c->tail=0;
+    c->holdUntil=0;
+    c->closing=false;
+    c->dead=false;
+    c->prescale=prescale;
+    c->curPrescale=prescale;
+    c->typeMask=typeMask;
+    c->nOffer=0;
+    c->nQueued=0;
+    c->nDrop=0;
+    pthread_create(&c->thread,NULL,&StreamServer::sender_thread,c);
+    m_nClient++;
+    std::cout<<"StreamServer: client "<<name<<" connected (prescale "<<prescale
+             <<", types 0x"<<std::hex<<typeMask<<std::dec<<")"<<std::endl;
+
+    pthread_mutex_lock(&m_mutex);
+    m_client[slot]=c;
+    pthread_mutex_unlock(&m_mutex);
+  }
+
+  //****** called from the accept thread (or finish() after it stopped) ******
+  void StreamServer::removeClient(int i)
+  {
+    pthread_mutex_lock(&m_mutex);
+    Client *c=m_client[i];
+    m_client[i]=NULL;
+    pthread_mutex_unlock(&m_mutex);
+
+    pthread_mutex_lock(&c->mutex);
+    c->closing=true;
+    pthread_cond_signal(&c->cond);
+    pthread_mutex_unlock(&c->mutex);
+    pthread_join(c->thread,NULL);
+    ::close(c->fd);
+    std::cout<<"StreamServer: client "<<c->name<<" disconnected : "<<c->nQueued<<" events queued, "
+             <<c->nDrop<<" dropped (prescale "<<c->curPrescale<<")"<<std::endl;
+    m_nQueued+=c->nQueued;
+    m_nDrop+=c->nDrop;
+    m_bytesSent+=c->tail;
+    free(c->ring);
+    pthread_cond_destroy(&c->cond);
+    pthread_mutex_destroy(&c->mutex);
+    delete c;
+  }
+
+  void *StreamServer::sender_thread(void *arg)
+  {
+    Client *c=(Client *)arg;
+    c->owner->runSender(c);
+    return NULL;
+  }
+
+  void StreamServer::runSender(Client *c)
+  {
+    pthread_mutex_lock(&c->mutex);
+    while(1)
+    {
+      while(c->head==c->tail && !c->closing)
+        pthread_cond_wait(&c->cond,&c->mutex);
+      if(c->head==c->tail)break;//closing and flushed
+      unsigned long off=c->tail%c->size;
+      unsigned long len=c->head-c->tail;
+      if(len>c->size-off)len=c->size-off;
+      pthread_mutex_unlock(&c->mutex);
+
+      ssize_t n=send(c->fd,c->ring+off,len,MSG_NOSIGNAL);
+
+      pthread_mutex_lock(&c->mutex);
+      if(n<0 && (errno==EINTR || ((errno==EAGAIN || errno==EWOULDBLOCK) && !c->closing)))continue;
+      if(n<=0)break;
+      c->tail+=n;
+      //****** the client keeps up : give it more events ******
+      if(c->head-c->tail<c->size/4 && c->tail>=c->holdUntil && c->curPrescale>c->prescale)c->curPrescale--;
+    }
+    c->dead=true;
+    pthread_mutex_unlock(&c->mutex);
+  }
+
+  //****** called with c->mutex locked and enough room in the queue ******
+  void StreamServer::put(Client *c, const void *p, unsigned long len)
+  {
+    unsigned long off=c->head%c->size;
+    unsigned long n=c->size-off;
+    if(n>len)n=len;
+    memcpy(c->ring+off,p,n);
+    memcpy(c->ring,(const unsigned char *)p+n,len-n);
+    c->head+=len;
+  }
+
+  void StreamServer::consume(const EventBuffer *buf)
+  {
+    const EventHeader *h=&buf->header;
+    unsigned long len=sizeof(EventHeader)+h->size;
+    pthread_mutex_lock(&m_mutex);
+    for(int i=0;i<MAX_STREAM_CLIENT;i++)
+    {
+      Client *c=m_client[i];
+      if(c==NULL || c->dead)continue;
+      if(c->typeMask!=0 && (h->trigType&c->typeMask)==0)continue;
+      pthread_mutex_lock(&c->mutex);
+      //****** the client is behind : send it fewer events ******
+      if(c->head-c->tail>c->size/2 && c->tail>=c->holdUntil && c->curPrescale<STREAM_MAX_PRESCALE)
+      {
+        c->curPrescale*=2;
+        if(c->curPrescale>STREAM_MAX_PRESCALE)c->curPrescale=STREAM_MAX_PRESCALE;
+        c->holdUntil=c->tail+c->size/8;
+      }
+      if(c->nOffer++%c->curPrescale==0)
+      {
+        if(c->size-(c->head-c->tail)<len)
+          c->nDrop++;
+        else
+        {
+          put(c,h,sizeof(EventHeader));
+          put(c,buf->data,h->size);
+          c->nQueued++;
+          pthread_cond_signal(&c->cond);
+        }
+      }
+      pthread_mutex_unlock(&c->mutex);
+    }
+    pthread_mutex_unlock(&m_mutex);
+  }
+
+  void StreamServer::finish()
+  {
+    if(!m_running)return;
+    m_closing=true;
+    pthread_join(m_acceptThread,NULL);
+    m_running=false;
+    ::close(m_listenFd);
+    m_listenFd=-1;
+    if(m_unixPath.length()>0)unlink(m_unixPath.c_str());
+    for(int i=0;i<MAX_STREAM_CLIENT;i++)
+      if(m_client[i]!=NULL)removeClient(i);
+  }
+
+  void StreamServer::printSummary()
+  {
+    std::cout<<"stream server       :"<<m_address<<", "<<m_nClient<<" clients"<<std::endl;
+    std::cout<<"streamed            :"<<m_nQueued<<" events, "<<m_bytesSent<<" bytes ("<<m_nDrop<<" dropped)"<<std::endl;
+  }
+}
@@ -0,0 +1,186 @@
+#include "SubEventReceiver.hpp"
+#include <iostream>
+#include <stdio.h>     //perror
+#include <string.h>    //memcmp
+#include <errno.h>
+#include <unistd.h>    //close
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h> //inet_ntoa
+
+//****************************************************
+// reads len bytes, waiting as long as needed
+//****************************************************
+static bool recvAll(int fd, void *p, unsigned long len)
+{
+  unsigned char *c=(unsigned char *)p;
+  while(len>0)
+  {
+    ssize_t n=recv(fd,c,len,MSG_WAITALL);
+    if(n<0 && errno==EINTR)continue;
+    if(n<=0)return false;
+    c+=n;
+    len-=n;
+  }
+  return true;
+}
+
+namespace LSTDAQ{
+  SubEventReceiver::SubEventReceiver() throw()
+  {
+    m_listenFd=-1;
+    m_nNode=0;
+    for(int i=0;i<MAX_NODE;i++)
+    {
+      m_fd[i]=-1;
+      m_nModule[i]=0;
+      m_nEvent[i]=0;
+      m_bytes[i]=0;
+    }
+  }
+  SubEventReceiver::~SubEventReceiver() throw()
+  {
+    close();
+  }
+
+  bool SubEventReceiver::listen(int port)
+  {
+    struct sockaddr_in addr;
+    memset(&addr,0,sizeof(addr));
+    addr.sin_family=AF_INET;
+    addr.sin_addr.s_addr=htonl(INADDR_ANY);
+    addr.sin_port=htons(port);
+    m_listenFd=socket(AF_INET,SOCK_STREAM,0);
+    int on=1;
+    if(m_listenFd>=0)setsockopt(m_listenFd,SOL_SOCKET,SO_REUSEADDR,&on,sizeof(on));
+    if(m_listenFd<0 || bind(m_listenFd,(struct sockaddr *)&addr,sizeof(addr))!=0)
+    {
+      perror("SubEventReceiver::bind()");
+      return false;
+    }
+    if(::listen(m_listenFd,MAX_NODE)!=0)
+    {
+      perror("SubEventReceiver::listen()");
+      return false;
+    }
+    std::cout<<"SubEventReceiver: waiting for collector nodes on port "<<port<<std::endl;
+    return true;
+  }
+
+  bool SubEventReceiver::acceptNodes(int nNode, const volatile sig_atomic_t *stop)
+  {
+    if(nNode<1 || nNode>MAX_NODE)
+    {
+      std::cout<<"SubEventReceiver: number of nodes must be 1 - "<<MAX_NODE<<std::endl;
+      return false;
+    }
+    int nConnected=0;
+    while(nConnected<nNode)
+    {
+      if(*stop)return false;
+      struct pollfd pfd;
+      pfd.fd=m_listenFd;
+      pfd.events=POLLIN;
+      if(poll(&pfd,1,NODE_POLL_MSEC)<=0)continue;
+      struct sockaddr_in addr;
+      socklen_t len=sizeof(addr);
+      int fd=accept(m_listenFd,(struct sockaddr *)&addr,&len);
+      if(fd<0)continue;
+
+      //****** the node introduces itself first ******
+      struct timeval tv;
+      tv.tv_sec=1;
+      tv.tv_usec=0;
+      setsockopt(fd,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));
+      SubEventHello hello;
+      if(!recvAll(fd,&hello,sizeof(hello)) || memcmp(hello.magic,SUBEVENT_MAGIC,4)!=0
+         || hello.version!=SUBEVENT_VERSION)
+      {
+        std::cout<<"SubEventReceiver: "<<inet_ntoa(addr.sin_addr)<<" is not a collector node of version "
+                 <<SUBEVENT_VERSION<<std::endl;
+        ::close(fd);
+        continue;
+      }
+      if(hello.nodeId>=(unsigned int)nNode || m_fd[hello.nodeId]>=0 || hello.nModule<1
+         || hello.fragmentSize!=EVENTSIZE)
+      {
+        std::cout<<"SubEventReceiver: node "<<hello.nodeId<<" from "<<inet_ntoa(addr.sin_addr)
+                 <<" is refused ("<<hello.nModule<<" modules of "<<hello.fragmentSize<<" bytes)"<<std::endl;
+        ::close(fd);
+        continue;
+      }
+      tv.tv_sec=0;
+      setsockopt(fd,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));
+      int size=NODE_SOCKBUF_MB*1024*1024;
+      setsockopt(fd,SOL_SOCKET,SO_RCVBUF,&size,sizeof(size));
+      m_fd[hello.nodeId]=fd;
+      m_nModule[hello.nodeId]=hello.nModule;
+      nConnected++;
+      std::cout<<"SubEventReceiver: node "<<hello.nodeId<<" connected from "<<inet_ntoa(addr.sin_addr)
+               <<" ("<<hello.nModule<<" modules)"<<std::endl;
+    }
+    m_nNode=nNode;
+    ::close(m_listenFd);
+    m_listenFd=-1;
+    return true;
+  }
+
+  int SubEventReceiver::read(int node, EventHeader *header, unsigned char *buf, int timeoutMsec)
+  {
+    if(m_fd[node]<0)return -1;
+    struct pollfd pfd;
+    pfd.fd=m_fd[node];
+    pfd.events=POLLIN;
+    int n=poll(&pfd,1,timeoutMsec);
+    if(n==0 || (n<0 && errno==EINTR))return 0;
+    if(!recvAll(m_fd[node],header,sizeof(EventHeader)))
+    {
+      std::cout<<"SubEventReceiver: node "<<node<<" closed"<<std::endl;
+      return -1;
+    }
+    //****** only raw sub-events of the announced modules are merged ******
+    if(memcmp(header->magic,EVENT_MAGIC,4)!=0 || header->flags!=0
+       || header->nModule!=(unsigned int)m_nModule[node] || header->size!=header->nModule*EVENTSIZE)
+    {
+      std::cout<<"SubEventReceiver: bad sub-event from node "<<node<<" (flags 0x"<<std::hex<<header->flags<<std::dec
+               <<", "<<header->nModule<<" modules, "<<header->size<<" bytes)"<<std::endl;
+      return -1;
+    }
+    if(!recvAll(m_fd[node],buf,header->size))
+    {
+      std::cout<<"SubEventReceiver: node "<<node<<" closed in a sub-event"<<std::endl;
+      return -1;
+    }
+    m_nEvent[node]++;
+    m_bytes[node]+=sizeof(EventHeader)+header->size;
+    return 1;
+  }
+
+  void SubEventReceiver::close()
+  {
+    if(m_listenFd>=0)::close(m_listenFd);
+    m_listenFd=-1;
+    for(int i=0;i<MAX_NODE;i++)
+    {
+      if(m_fd[i]>=0)::close(m_fd[i]);
+      m_fd[i]=-1;
+    }
+  }
+
+  void SubEventReceiver::printSummary()
+  {
+    for(int i=0;i<m_nNode;i++)
+      std::cout<<"node "<<i<<"              :"<<m_nModule[i]<<" modules, "<<m_nEvent[i]<<" sub-events, "
+               <<m_bytes[i]<<" bytes"<<std::endl;
+  }
+
+  int SubEventReceiver::getNnode() throw()
+  {
+    return m_nNode;
+  }
+  int SubEventReceiver::getNmodule(int node) throw()
+  {
+    return m_nModule[node];
+  }
+}
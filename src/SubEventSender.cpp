@@ -0,0 +1,132 @@
+#include "SubEventSender.hpp"
+#include <iostream>
+#include <stdio.h>     //perror
+#include <stdlib.h>    //atoi
+#include <string.h>    //memcpy
+#include <errno.h>
+#include <unistd.h>    //close, usleep
+#include <time.h>
+#include <netdb.h>     //getaddrinfo
+#include <sys/socket.h>
+
+//****************************************************
+// time calc
+//****************************************************
+static unsigned long long usecSince(const struct timespec *pFrom)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC,&now);
+  return ((unsigned long long)(now.tv_sec - pFrom->tv_sec)*1000000ULL
+          + (unsigned long long)now.tv_nsec/1000ULL) - (unsigned long long)pFrom->tv_nsec/1000ULL;
+}
+
+namespace LSTDAQ{
+  SubEventSender::SubEventSender() throw()
+  {
+    m_fd=-1;
+    m_nEvent=0;
+    m_bytes=0;
+    m_stallUsec=0;
+  }
+  SubEventSender::~SubEventSender() throw()
+  {
+    close();
+  }
+
+  bool SubEventSender::connect(const char *address, int nodeId, int nModule)
+  {
+    m_address=address;
+    size_t colon=m_address.rfind(':');
+    if(colon==std::string::npos || colon==0)
+    {
+      std::cout<<"SubEventSender: address must be <host>:<port> : "<<m_address<<std::endl;
+      return false;
+    }
+    std::string host=m_address.substr(0,colon);
+    std::string port=m_address.substr(colon+1);
+    struct addrinfo hints,*res;
+    memset(&hints,0,sizeof(hints));
+    hints.ai_family=AF_INET;
+    hints.ai_socktype=SOCK_STREAM;
+    if(getaddrinfo(host.c_str(),port.c_str(),&hints,&res)!=0)
+    {
+      std::cout<<"SubEventSender: host not found : "<<host<<std::endl;
+      return false;
+    }
+
+    //****** the builder node may be started later ******
+    int nTry=0;
+    while(1)
+    {
+      m_fd=socket(AF_INET,SOCK_STREAM,0);
+      if(m_fd<0)break;
+      int size=NODE_SOCKBUF_MB*1024*1024;
+      setsockopt(m_fd,SOL_SOCKET,SO_SNDBUF,&size,sizeof(size));
+      if(::connect(m_fd,res->ai_addr,res->ai_addrlen)==0)break;
+      ::close(m_fd);
+      m_fd=-1;
+      if(++nTry>=NODE_CONNECT_SEC*10)break;
+      usleep(100000);
+    }
+    freeaddrinfo(res);
+    if(m_fd<0)
+    {
+      perror("SubEventSender::connect()");
+      return false;
+    }
+
+    SubEventHello hello;
+    memset(&hello,0,sizeof(hello));
+    memcpy(hello.magic,SUBEVENT_MAGIC,4);
+    hello.version=SUBEVENT_VERSION;
+    hello.nodeId=nodeId;
+    hello.nModule=nModule;
+    hello.fragmentSize=EVENTSIZE;
+    if(!sendAll(&hello,sizeof(hello),0))return false;
+    std::cout<<"SubEventSender: connected to "<<m_address<<" as node "<<nodeId<<" ("<<nModule<<" modules)"<<std::endl;
+    return true;
+  }
+
+  bool SubEventSender::sendAll(const void *p, unsigned long len, int flags)
+  {
+    const unsigned char *c=(const unsigned char *)p;
+    while(len>0)
+    {
+      ssize_t n=::send(m_fd,c,len,flags|MSG_NOSIGNAL);
+      if(n<0 && errno==EINTR)continue;
+      if(n<=0)
+      {
+        perror("SubEventSender::send()");
+        return false;
+      }
+      c+=n;
+      len-=n;
+    }
+    return true;
+  }
+
+  bool SubEventSender::send(const EventHeader *header, const unsigned char *data)
+  {
+    if(m_fd<0)return false;
+    struct timespec tsStart;
+    clock_gettime(CLOCK_MONOTONIC,&tsStart);
+    if(!sendAll(header,sizeof(EventHeader),MSG_MORE) || !sendAll(data,header->size,0))return false;
+    m_stallUsec+=usecSince(&tsStart);
+    m_nEvent++;
+    m_bytes+=sizeof(EventHeader)+header->size;
+    return true;
+  }
+
+  void SubEventSender::close()
+  {
+    if(m_fd<0)return;
+    ::close(m_fd);
+    m_fd=-1;
+  }
+
+  void SubEventSender::printSummary()
+  {
+    std::cout<<"uplink              :"<<m_address<<", "<<m_nEvent<<" sub-events, "<<m_bytes<<" bytes"<<std::endl;
+    printf("uplink stall        :%.3f sec\n",m_stallUsec*1e-6);
+  }
+}
@@ -64,6 +64,11 @@ namespace LSTDAQ{
         perror("socket() error");
         return -1;
       }
+      //****** an unreachable FEB fails in FEB_CONNECT_SEC, not in the timeout of the kernel ******
+      struct timeval tv;
+      tv.tv_sec = FEB_CONNECT_SEC;
+      tv.tv_usec = 0;
+      setsockopt(m_sockTcp, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
       m_addrTcp.sin_family = AF_INET;
       m_addrTcp.sin_port = htons(shPort);
       m_addrTcp.sin_addr.s_addr = inet_addr(pszHost);
@@ -117,8 +122,8 @@ namespace LSTDAQ{
             perror("ConnectTCP()::connect(2)");
             printf("ERROR:ConnectTCP:: can't connect not found (%d) to %08X %s:%u\n",
                    m_addrTcp.sin_addr.s_addr,m_sockTcp,pszHost,shPort);
-            m_sockTcp = -1;
             close(m_sockTcp);
+            m_sockTcp = -1;
             return -4;
         }
         else
@@ -127,6 +132,8 @@ namespace LSTDAQ{
           printf("ConnectTCP::Connected1(%d) %s:%d\n",m_sockTcp,pszHost,shPort);
         }
       }
+      tv.tv_sec = 0;
+      setsockopt(m_sockTcp, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
           return 0;      //return( sockTcp );
     }
     ssize_t TCPClientSocket::readSock(void *buffer, size_t nbytes) throw()
@@ -0,0 +1,148 @@
+#include "WaveformCodec.hpp"
+#include <string.h>//memcpy
+
+//****************************************************
+// bit packing of one block
+//****************************************************
+static unsigned char *packBlock(const unsigned short *v, int n, unsigned char *out)
+{
+  unsigned int m=0;
+  for(int i=0;i<n;i++)m|=v[i];
+  int b= m==0 ? 0 : 32-__builtin_clz(m);
+  *out++=(unsigned char)b;
+  unsigned long long acc=0;
+  int nbit=0;
+  for(int i=0;i<n;i++)
+  {
+    acc|=(unsigned long long)v[i]<<nbit;
+    nbit+=b;
+    while(nbit>=8)
+    {
+      *out++=(unsigned char)acc;
+      acc>>=8;
+      nbit-=8;
+    }
+  }
+  if(nbit>0)*out++=(unsigned char)acc;
+  return out;
+}
+
+static const unsigned char *unpackBlock(const unsigned char *in, const unsigned char *end,
+                                        unsigned short *v, int n)
+{
+  if(in>=end)return NULL;
+  int b=*in++;
+  if(b>16 || in+(n*b+7)/8>end)return NULL;
+  unsigned long long acc=0;
+  int nbit=0;
+  unsigned int mask=(1u<<b)-1;
+  for(int i=0;i<n;i++)
+  {
+    while(nbit<b)
+    {
+      acc|=(unsigned long long)(*in++)<<nbit;
+      nbit+=8;
+    }
+    v[i]=(unsigned short)(acc&mask);
+    acc>>=b;
+    nbit-=b;
+  }
+  return in;
+}
+
+namespace LSTDAQ{
+  WaveformCodec::WaveformCodec() throw()
+  {
+  }
+  WaveformCodec::~WaveformCodec() throw()
+  {
+  }
+  const char *WaveformCodec::getName()
+  {
+    return "compress";
+  }
+  unsigned int WaveformCodec::getMaxSize(unsigned int inSize)
+  {
+    //****** incompressible data : one width byte per block more than raw ******
+    return inSize+inSize/(CODEC_BLOCK*2)+EVENTSIZE;
+  }
+
+  bool WaveformCodec::process(EventHeader *header, unsigned char **data, unsigned char **spare, int worker)
+  {
+    if(header->flags&(EVFMT_ENCODED|EVFMT_ZS|EVFMT_DL1|EVFMT_SOA))return true;
+    unsigned int prefix=getPrefixSize(header->flags,header->nModule);
+    memcpy(*spare,*data,prefix);
+    header->size=prefix+encode(*data+prefix,header->nModule,getNgainStored(header->flags),*spare+prefix);
+    header->flags|=EVFMT_DELTA;
+    unsigned char *p=*data;
+    *data=*spare;
+    *spare=p;
+    return true;
+  }
+
+  unsigned int WaveformCodec::encode(const unsigned char *in, unsigned int nModule, int nGain, unsigned char *out)
+  {
+    unsigned char *p=out;
+    unsigned short z[READDEPTH];
+    unsigned long moduleSize=(LINE_WAVEFORM+READDEPTH*nGain)*LINESIZE;
+    for(unsigned int m=0;m<nModule;m++)
+    {
+      const unsigned char *frag=in+m*moduleSize;
+      memcpy(p,frag,LINE_WAVEFORM*LINESIZE);
+      p+=LINE_WAVEFORM*LINESIZE;
+      for(int g=0;g<nGain;g++)
+        for(int c=0;c<NCHANNEL;c++)
+        {
+          const unsigned char *q=frag+(LINE_WAVEFORM+g)*LINESIZE+2*c;
+          unsigned short prev=0;
+          for(int s=0;s<READDEPTH;s++)
+          {
+            unsigned short v=(unsigned short)(q[0]<<8|q[1]);
+            short d=(short)(v-prev);
+            z[s]=(unsigned short)(((unsigned)d<<1)^(d>>15));//no left shift of a negative value
+            prev=v;
+            q+=nGain*LINESIZE;
+          }
+          for(int s=0;s<READDEPTH;s+=CODEC_BLOCK)
+            p=packBlock(&z[s],READDEPTH-s<CODEC_BLOCK ? READDEPTH-s : CODEC_BLOCK,p);
+        }
+    }
+    return (unsigned int)(p-out);
+  }
+
+  int WaveformCodec::decode(const unsigned char *in, unsigned int size, unsigned int nModule, int nGain, unsigned char *out)
+  {
+    const unsigned char *p=in;
+    const unsigned char *end=in+size;
+    unsigned short z[READDEPTH];
+    unsigned long moduleSize=(LINE_WAVEFORM+READDEPTH*nGain)*LINESIZE;
+    for(unsigned int m=0;m<nModule;m++)
+    {
+      unsigned char *frag=out+m*moduleSize;
+      if(p+LINE_WAVEFORM*LINESIZE>end)return -1;
+      memcpy(frag,p,LINE_WAVEFORM*LINESIZE);
+      p+=LINE_WAVEFORM*LINESIZE;
+      for(int g=0;g<nGain;g++)
+        for(int c=0;c<NCHANNEL;c++)
+        {
+          for(int s=0;s<READDEPTH;s+=CODEC_BLOCK)
+          {
+            p=unpackBlock(p,end,&z[s],READDEPTH-s<CODEC_BLOCK ? READDEPTH-s : CODEC_BLOCK);
+            if(p==NULL)return -1;
+          }
+          unsigned char *q=frag+(LINE_WAVEFORM+g)*LINESIZE+2*c;
+          unsigned short prev=0;
+          for(int s=0;s<READDEPTH;s++)
+          {
+            unsigned short v=(unsigned short)(prev+(unsigned short)((z[s]>>1)^(-(z[s]&1))));
+            q[0]=(unsigned char)(v>>8);
+            q[1]=(unsigned char)v;
+            prev=v;
+            q+=nGain*LINESIZE;
+          }
+        }
+    }
+    if(p!=end)return -1;
+    return (int)(nModule*moduleSize);
+  }
+}
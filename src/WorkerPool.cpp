@@ -0,0 +1,322 @@
+#include "WorkerPool.hpp"
+#include <iostream>
+#include <stdio.h> //printf
+#include <string.h>//memset
+#include <stdlib.h>//exit(1)
+#include <time.h>
+
+//****************************************************
+// time calc
+//****************************************************
+static unsigned long long nsecSince(const struct timespec *pFrom)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC,&now);
+  return (unsigned long long)(now.tv_sec - pFrom->tv_sec)*1000000000ULL + now.tv_nsec - pFrom->tv_nsec;
+}
+
+namespace LSTDAQ{
+  WorkerPool::WorkerPool(int nWorker, int nSlot, unsigned int maxSize) throw()
+  {
+    pthread_mutex_init(&m_mutex,NULL);
+    pthread_cond_init(&m_condWork,NULL);
+    pthread_cond_init(&m_condDone,NULL);
+    pthread_cond_init(&m_condFree,NULL);
+    m_running=false;
+    m_closing=false;
+    m_nextWorker=0;
+    m_output=NULL;
+    m_sideOutput=NULL;
+    m_dispatcher=NULL;
+    m_nProc=0;
+
+    if(nWorker<1)nWorker=1;
+    if(nWorker>MAX_WORKER)nWorker=MAX_WORKER;
+    m_nWorker=nWorker;
+    if(nSlot<nWorker+1)nSlot=nWorker+1;
+    m_nSlot=nSlot;
+    m_maxSize=maxSize;
+    m_bufSize=0;
+    m_slot=new Slot[m_nSlot];
+    for(int i=0;i<m_nSlot;i++)
+    {
+      m_slot[i].buf=NULL;
+      m_slot[i].done=false;
+      m_slot[i].keep=true;
+      m_slot[i].side=NULL;
+      m_slot[i].hasSide=false;
+    }
+    m_nSubmit=0;
+    m_nTaken=0;
+    m_nDrained=0;
+
+    m_bytesIn=0;
+    m_bytesOut=0;
+    m_nDrop=0;
+    m_sideBytes=0;
+    m_nStall=0;
+    m_stallUsec=0;
+    memset(m_procStat,0,sizeof(m_procStat));
+  }
+  WorkerPool::~WorkerPool() throw()
+  {
+    close();
+    for(int i=0;i<m_nSlot;i++)
+      delete[] m_slot[i].side;
+    delete[] m_slot;
+    for(int i=0;i<m_nProc;i++)delete m_proc[i];
+    pthread_cond_destroy(&m_condFree);
+    pthread_cond_destroy(&m_condDone);
+    pthread_cond_destroy(&m_condWork);
+    pthread_mutex_destroy(&m_mutex);
+  }
+
+  void WorkerPool::addProcessor(EventProcessor *proc)
+  {
+    if(m_nProc==MAX_PROCESSOR)
+    {
+      std::cout<<"The number of processing stages excessed limit."<<std::endl;
+      exit(1);
+    }
+    m_proc[m_nProc++]=proc;
+  }
+  int WorkerPool::getNprocessor() throw()
+  {
+    return m_nProc;
+  }
+
+  unsigned int WorkerPool::getBufferSize()
+  {
+    //****** large enough for the output of every stage ******
+    unsigned int size=m_maxSize;
+    m_bufSize=m_maxSize;
+    for(int i=0;i<m_nProc;i++)
+    {
+      size=m_proc[i]->getMaxSize(size);
+      if(size>m_bufSize)m_bufSize=size;
+    }
+    return m_bufSize;
+  }
+  int WorkerPool::getNslot() throw()
+  {
+    return m_nSlot;
+  }
+
+  bool WorkerPool::start(EventOutput *output)
+  {
+    m_output=output;
+    //****** side records are small and stay in the slots ******
+    unsigned int size=m_maxSize;
+    unsigned int sideSize=0;
+    for(int i=0;i<m_nProc;i++)
+    {
+      unsigned int n=m_proc[i]->getSideSize(size);
+      m_makeSide[i]=(n>0);
+      if(n>sideSize)sideSize=n;
+      size=m_proc[i]->getMaxSize(size);
+    }
+    if(sideSize>0)
+      for(int i=0;i<m_nSlot;i++)m_slot[i].side=new unsigned char[sideSize];
+    for(int i=0;i<m_nProc;i++)m_proc[i]->init(m_nWorker);
+
+    m_closing=false;
+    m_running=true;
+    m_nextWorker=0;
+    for(int i=0;i<m_nWorker;i++)
+      pthread_create(&m_worker[i],NULL,&WorkerPool::worker_thread,this);
+    pthread_create(&m_drain,NULL,&WorkerPool::drain_thread,this);
+    return true;
+  }
+
+  void WorkerPool::setSideOutput(EventOutput *side)
+  {
+    m_sideOutput=side;
+  }
+  void WorkerPool::setDispatcher(EventDispatcher *dispatcher)
+  {
+    m_dispatcher=dispatcher;
+  }
+
+  int WorkerPool::submit(EventBuffer *buf)
+  {
+    pthread_mutex_lock(&m_mutex);
+    if(m_nSubmit-m_nDrained==(unsigned long long)m_nSlot)
+    {
+      //****** all slots in use : builder stalls ******
+      struct timespec tsWait;
+      clock_gettime(CLOCK_MONOTONIC,&tsWait);
+      while(m_nSubmit-m_nDrained==(unsigned long long)m_nSlot)
+        pthread_cond_wait(&m_condFree,&m_mutex);
+      m_nStall++;
+      m_stallUsec+=nsecSince(&tsWait)/1000;
+    }
+    pthread_mutex_unlock(&m_mutex);
+
+    //****** the slot belongs to the builder until m_nSubmit is incremented ******
+    Slot &s=m_slot[m_nSubmit%m_nSlot];
+    s.buf=buf;
+    s.done=false;
+    s.keep=true;
+    s.hasSide=false;
+    m_bytesIn+=buf->header.size;
+
+    pthread_mutex_lock(&m_mutex);
+    m_nSubmit++;
+    pthread_cond_signal(&m_condWork);
+    pthread_mutex_unlock(&m_mutex);
+    return 0;
+  }
+
+  void WorkerPool::close()
+  {
+    if(!m_running)return;
+    pthread_mutex_lock(&m_mutex);
+    m_closing=true;
+    pthread_cond_broadcast(&m_condWork);
+    pthread_cond_broadcast(&m_condDone);
+    pthread_mutex_unlock(&m_mutex);
+    for(int i=0;i<m_nWorker;i++)pthread_join(m_worker[i],NULL);
+    pthread_join(m_drain,NULL);
+    m_running=false;
+    for(int i=0;i<m_nProc;i++)m_proc[i]->finish();
+  }
+
+  void *WorkerPool::worker_thread(void *arg)
+  {
+    WorkerPool *pool=(WorkerPool *)arg;
+    pthread_mutex_lock(&pool->m_mutex);
+    int worker=pool->m_nextWorker++;
+    pthread_mutex_unlock(&pool->m_mutex);
+    pool->runWorker(worker);
+    return NULL;
+  }
+
+  void WorkerPool::runWorker(int worker)
+  {
+    while(1)
+    {
+      pthread_mutex_lock(&m_mutex);
+      while(m_nTaken==m_nSubmit && !m_closing)
+        pthread_cond_wait(&m_condWork,&m_mutex);
+      if(m_nTaken==m_nSubmit)
+      {
+        pthread_mutex_unlock(&m_mutex);
+        break;
+      }
+      Slot &s=m_slot[m_nTaken%m_nSlot];
+      m_nTaken++;
+      pthread_mutex_unlock(&m_mutex);
+
+      //****** run the chain ******
+      EventBuffer *b=s.buf;
+      for(int i=0;i<m_nProc;i++)
+      {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC,&ts);
+        if(m_makeSide[i] && !s.hasSide)
+          s.hasSide=m_proc[i]->makeSide(&b->header,b->data,&s.sideHeader,s.side,worker);
+        s.keep=m_proc[i]->process(&b->header,&b->data,&b->spare,worker);
+        m_procStat[worker].nsec[i]+=nsecSince(&ts);
+        m_procStat[worker].count[i]++;
+        if(!s.keep)break;
+      }
+
+      pthread_mutex_lock(&m_mutex);
+      s.done=true;
+      pthread_cond_signal(&m_condDone);
+      pthread_mutex_unlock(&m_mutex);
+    }
+  }
+
+  void *WorkerPool::drain_thread(void *arg)
+  {
+    ((WorkerPool *)arg)->runDrain();
+    return NULL;
+  }
+
+  void WorkerPool::runDrain()
+  {
+    while(1)
+    {
+      pthread_mutex_lock(&m_mutex);
+      while(!(m_nDrained<m_nSubmit && m_slot[m_nDrained%m_nSlot].done))
+      {
+        if(m_closing && m_nDrained==m_nSubmit)break;
+        pthread_cond_wait(&m_condDone,&m_mutex);
+      }
+      if(m_nDrained==m_nSubmit)
+      {
+        pthread_mutex_unlock(&m_mutex);
+        break;
+      }
+      Slot &s=m_slot[m_nDrained%m_nSlot];
+      pthread_mutex_unlock(&m_mutex);
+
+      //****** write in the order of building ******
+      EventBuffer *b=s.buf;
+      if(s.hasSide)
+      {
+        if(m_sideOutput!=NULL)m_sideOutput->write(&s.sideHeader,s.side,b->timeNs);
+        m_sideBytes+=s.sideHeader.size;
+      }
+      if(s.keep)
+      {
+        if(m_output!=NULL)m_output->write(&b->header,b->data,b->timeNs);
+        if(m_dispatcher!=NULL)m_dispatcher->publish(b);
+        m_bytesOut+=b->header.size;
+      }
+      else
+        m_nDrop++;
+      s.buf=NULL;
+      EventBufferPool::release(b);
+
+      pthread_mutex_lock(&m_mutex);
+      s.done=false;
+      m_nDrained++;
+      pthread_cond_signal(&m_condFree);
+      pthread_mutex_unlock(&m_mutex);
+    }
+  }
+
+  unsigned long long WorkerPool::getBytesIn() throw()
+  {
+    return m_bytesIn;
+  }
+  unsigned long long WorkerPool::getBytesOut() throw()
+  {
+    return m_bytesOut;
+  }
+  unsigned long WorkerPool::getNstall() throw()
+  {
+    return m_nStall;
+  }
+  unsigned long long WorkerPool::getStallUsec() throw()
+  {
+    return m_stallUsec;
+  }
+
+  void WorkerPool::printSummary()
+  {
+    std::cout<<" Worker Pool Summary "<<std::endl;
+    std::cout<<"workers             :"<<m_nWorker<<" ("<<m_nSlot<<" slots)"<<std::endl;
+    std::cout<<"events              :"<<m_nDrained<<" ("<<m_nDrop<<" dropped)"<<std::endl;
+    std::cout<<"bytes in/out        :"<<m_bytesIn<<" / "<<m_bytesOut<<std::endl;
+    if(m_bytesOut>0)
+      printf("ratio               :%.3f\n",(double)m_bytesIn/(double)m_bytesOut);
+    if(m_sideBytes>0)
+      std::cout<<"side records        :"<<m_sideBytes<<" bytes"<<std::endl;
+    std::cout<<"builder stall       :"<<m_nStall<<" times, "<<m_stallUsec<<"usec"<<std::endl;
+    for(int i=0;i<m_nProc;i++)
+    {
+      unsigned long long nsec=0,count=0;
+      for(int w=0;w<m_nWorker;w++)
+      {
+        nsec+=m_procStat[w].nsec[i];
+        count+=m_procStat[w].count[i];
+      }
+      printf("stage %-14s:%llu events, %.2fusec/event\n",m_proc[i]->getName(),count,
+             count>0 ? (double)nsec/count/1000. : 0.);
+      m_proc[i]->printSummary();
+    }
+  }
+}
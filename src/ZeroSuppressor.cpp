@@ -0,0 +1,211 @@
+#include "ZeroSuppressor.hpp"
+#include "PedestalSubtractor.hpp"
+#include "Simd.hpp"
+#include <string.h>//memcpy
+#include <stdio.h> //printf
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ZS_X86
+#endif
+
+//****************************************************
+// scalar kernel
+//****************************************************
+static unsigned char scan_scalar(const unsigned char *module, int nGain, int peakThreshold, int chargeThreshold)
+{
+  int peak[NCHANNEL]={0};
+  int sum[NCHANNEL]={0};
+  const unsigned char *p=module+LINE_WAVEFORM*LINESIZE;
+  for(int s=0;s<READDEPTH;s++)
+  {
+    for(int c=0;c<NCHANNEL;c++)
+    {
+      int v=p[2*c]<<8|p[2*c+1];
+      if(v>peak[c])peak[c]=v;
+      sum[c]+=v;
+    }
+    p+=nGain*LINESIZE;
+  }
+  unsigned char mask=0;
+  for(int c=0;c<NCHANNEL;c++)
+  {
+    if(peakThreshold>0 && peak[c]-PEDESTAL_OFFSET>=peakThreshold)mask|=1<<c;
+    if(chargeThreshold>0 && sum[c]-READDEPTH*PEDESTAL_OFFSET>=chargeThreshold)mask|=1<<c;
+  }
+  return mask;
+}
+
+#ifdef ZS_X86
+//****************************************************
+// SSSE3 kernel
+//   one line holds a sample of the 8 channels : max in 16 bits, sums in 32 bits.
+//   The samples are unsigned : the max and the compare run on samples biased by 0x8000.
+//****************************************************
+__attribute__((target("ssse3")))
+static unsigned char scan_ssse3(const unsigned char *module, int nGain, int peakThreshold, int chargeThreshold)
+{
+  const __m128i swap=_mm_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+  const __m128i zero=_mm_setzero_si128();
+  const __m128i bias=_mm_set1_epi16((short)0x8000);
+  __m128i peak=bias,sumlo=zero,sumhi=zero;
+  const unsigned char *p=module+LINE_WAVEFORM*LINESIZE;
+  for(int s=0;s<READDEPTH;s++)
+  {
+    __m128i x=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p),swap);
+    peak=_mm_max_epi16(peak,_mm_xor_si128(x,bias));
+    sumlo=_mm_add_epi32(sumlo,_mm_unpacklo_epi16(x,zero));
+    sumhi=_mm_add_epi32(sumhi,_mm_unpackhi_epi16(x,zero));
+    p+=nGain*LINESIZE;
+  }
+  __m128i keep=zero;
+  //****** thresholds above any sample or sum keep nothing ******
+  long long peakMin=(long long)PEDESTAL_OFFSET+peakThreshold;
+  if(peakThreshold>0 && peakMin<=0xffff)
+    keep=_mm_cmpgt_epi16(peak,_mm_set1_epi16((short)((peakMin-1)^0x8000)));
+  long long chargeMin=(long long)READDEPTH*PEDESTAL_OFFSET+chargeThreshold;
+  if(chargeThreshold>0 && chargeMin<=0x7fffffff)
+  {
+    __m128i thr=_mm_set1_epi32((int)(chargeMin-1));
+    keep=_mm_or_si128(keep,_mm_packs_epi32(_mm_cmpgt_epi32(sumlo,thr),_mm_cmpgt_epi32(sumhi,thr)));
+  }
+  return (unsigned char)_mm_movemask_epi8(_mm_packs_epi16(keep,zero));
+}
+#endif
+
+namespace LSTDAQ{
+  ZeroSuppressor::ZeroSuppressor(int peakThreshold, int chargeThreshold) throw()
+    :m_peakThreshold(peakThreshold),m_chargeThreshold(chargeThreshold)
+  {
+    for(int i=0;i<MAX_WORKER;i++)
+    {
+      m_count[i].nChannel=0;
+      m_count[i].nKept=0;
+    }
+  }
+  ZeroSuppressor::~ZeroSuppressor() throw()
+  {
+  }
+  const char *ZeroSuppressor::getName()
+  {
+    return "zs";
+  }
+  unsigned int ZeroSuppressor::getMaxSize(unsigned int inSize)
+  {
+    //****** all channels kept : the channel bitmap only is added ******
+    return inSize+ZS_BITMAPSIZE(MAX_CONNECTION);
+  }
+
+  unsigned char ZeroSuppressor::scanModule(const unsigned char *module, int nGain, int peakThreshold, int chargeThreshold)
+  {
+#ifdef ZS_X86
+    if(getSimdLevel()>=SIMD_SSSE3)
+      return scan_ssse3(module,nGain,peakThreshold,chargeThreshold);
+#endif
+    return scan_scalar(module,nGain,peakThreshold,chargeThreshold);
+  }
+
+  bool ZeroSuppressor::process(EventHeader *header, unsigned char **data, unsigned char **spare, int worker)
+  {
+    //****** pedestal subtracted dense layouts only ******
+    if(!(header->flags&EVFMT_PEDSUB) || (header->flags&(EVFMT_ENCODED|EVFMT_ZS|EVFMT_DL1|EVFMT_SOA)))return true;
+    int nGain=getNgainStored(header->flags);
+    unsigned int prefix=getPrefixSize(header->flags,header->nModule);
+    unsigned int moduleSize=getModuleSize(header->flags);
+    unsigned char *bitmap=*spare+prefix;
+    memcpy(*spare,*data,prefix);
+    memset(bitmap,0,ZS_BITMAPSIZE(header->nModule));
+    unsigned char *out=bitmap+ZS_BITMAPSIZE(header->nModule);
+    for(unsigned int m=0;m<header->nModule;m++)
+    {
+      const unsigned char *in=*data+prefix+(unsigned long)m*moduleSize;
+      unsigned char mask=scanModule(in,nGain,m_peakThreshold,m_chargeThreshold);
+      mask|=(unsigned char)(mask<<1)|(mask>>1);
+      bitmap[m]=mask;
+      m_count[worker].nKept+=__builtin_popcount(mask);
+      memcpy(out,in,LINE_WAVEFORM*LINESIZE);
+      out+=LINE_WAVEFORM*LINESIZE;
+      //****** kept channels : one waveform per gain ******
+      for(int c=0;c<NCHANNEL;c++)
+      {
+        if(!(mask>>c&1))continue;
+        for(int g=0;g<nGain;g++)
+        {
+          const unsigned char *p=in+(LINE_WAVEFORM+g)*LINESIZE+2*c;
+          for(int s=0;s<READDEPTH;s++)
+          {
+            out[0]=p[0];
+            out[1]=p[1];
+            out+=2;
+            p+=nGain*LINESIZE;
+          }
+        }
+      }
+    }
+    m_count[worker].nChannel+=header->nModule*NCHANNEL;
+    header->size=out-*spare;
+    header->flags|=EVFMT_ZS;
+    unsigned char *p=*data;
+    *data=*spare;
+    *spare=p;
+    return true;
+  }
+
+  unsigned char ZeroSuppressor::getChannelMask(const EventHeader *header, const unsigned char *payload, int m)
+  {
+    return payload[getPrefixSize(header->flags&~EVFMT_ZS,header->nModule)+m];
+  }
+
+  int ZeroSuppressor::expand(const EventHeader *header, const unsigned char *payload, unsigned char *out)
+  {
+    unsigned short flags=header->flags&~EVFMT_ZS;
+    int nGain=getNgainStored(flags);
+    unsigned int prefix=getPrefixSize(flags,header->nModule);
+    unsigned int moduleSize=getModuleSize(flags);
+    const unsigned char *bitmap=payload+prefix;
+    const unsigned char *in=bitmap+ZS_BITMAPSIZE(header->nModule);
+    const unsigned char *end=payload+header->size;
+    if(header->size<prefix+ZS_BITMAPSIZE(header->nModule))return -1;
+    memcpy(out,payload,prefix);
+    for(unsigned int m=0;m<header->nModule;m++)
+    {
+      unsigned char *module=out+prefix+(unsigned long)m*moduleSize;
+      unsigned char mask=bitmap[m];
+      if(in+LINE_WAVEFORM*LINESIZE+__builtin_popcount(mask)*nGain*READDEPTH*2>end)return -1;
+      memcpy(module,in,LINE_WAVEFORM*LINESIZE);
+      in+=LINE_WAVEFORM*LINESIZE;
+      for(int c=0;c<NCHANNEL;c++)
+        for(int g=0;g<nGain;g++)
+        {
+          unsigned char *p=module+(LINE_WAVEFORM+g)*LINESIZE+2*c;
+          for(int s=0;s<READDEPTH;s++)
+          {
+            if(mask>>c&1)
+            {
+              p[0]=in[0];
+              p[1]=in[1];
+              in+=2;
+            }
+            else
+            {
+              p[0]=PEDESTAL_OFFSET>>8;
+              p[1]=PEDESTAL_OFFSET&0xff;
+            }
+            p+=nGain*LINESIZE;
+          }
+        }
+    }
+    return prefix+header->nModule*moduleSize;
+  }
+
+  void ZeroSuppressor::printSummary()
+  {
+    unsigned long long n=0,k=0;
+    for(int i=0;i<MAX_WORKER;i++)
+    {
+      n+=m_count[i].nChannel;
+      k+=m_count[i].nKept;
+    }
+    printf("  peak >= %d or charge >= %d, %llu of %llu channels kept (%.1f%%)\n",
+           m_peakThreshold,m_chargeThreshold,k,n,n>0 ? 100.0*k/n : 0.0);
+  }
+}
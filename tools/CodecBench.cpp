@@ -0,0 +1,118 @@
+//
+//! \file  CodecBench.cpp
+//  Benchmark of WaveformCodec : compression ratio and speed on simulated events or on an output file.
+//
+//  Usage : codecbench [-m nModule] [-n nEvent] [-s noise] [-p pulseFraction] [-f file.dat]
+//
+
+#include <iostream>
+#include <iomanip>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "Config.hpp"
+#include "EventReader.hpp"
+#include "WaveformCodec.hpp"
+#include "SimEvent.hpp"
+
+using namespace std;
+
+static double secSince(const struct timespec *pFrom)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC,&now);
+  return (now.tv_sec-pFrom->tv_sec)+(now.tv_nsec-pFrom->tv_nsec)*1e-9;
+}
+
+int main(int argc, char **argv)
+{
+  int nModule=16;
+  int nEvent=2000;
+  double noise=5.;
+  double pulseFrac=0.1;
+  const char *fileName=NULL;
+  int opt;
+  while((opt=getopt(argc,argv,"m:n:s:p:f:"))!=-1)
+  {
+    switch(opt)
+    {
+    case 'm':nModule=atoi(optarg);break;
+    case 'n':nEvent=atoi(optarg);break;
+    case 's':noise=atof(optarg);break;
+    case 'p':pulseFrac=atof(optarg);break;
+    case 'f':fileName=optarg;break;
+    default:
+      printf("usage : %s [-m nModule] [-n nEvent] [-s noise] [-p pulseFraction] [-f file.dat]\n",argv[0]);
+      exit(1);
+    }
+  }
+
+  //****** input events ******
+  unsigned char *raw;
+  if(fileName!=NULL)
+  {
+    LSTDAQ::EventReader reader;
+    if(!reader.open(fileName))exit(1);
+    const LSTDAQ::EventHeader *h=reader.getEvent(0);
+    if(h==NULL)exit(1);
+    nModule=h->nModule;
+    if((unsigned long long)nEvent>reader.getNevent())nEvent=reader.getNevent();
+    raw=new unsigned char[(unsigned long)nEvent*nModule*EVENTSIZE];
+    LSTDAQ::EventHeader eh;
+    for(int i=0;i<nEvent;i++)
+      if(reader.readEvent(i,&eh,raw+(unsigned long)i*nModule*EVENTSIZE)!=nModule*EVENTSIZE)
+      {
+        cout<<"event "<<i<<" has a different number of modules"<<endl;
+        exit(1);
+      }
+  }
+  else
+  {
+    LSTDAQ::SimEvent sim(nModule,noise,pulseFrac);
+    raw=new unsigned char[(unsigned long)nEvent*nModule*EVENTSIZE];
+    for(int i=0;i<nEvent;i++)sim.fill(raw+(unsigned long)i*nModule*EVENTSIZE);
+  }
+
+  unsigned long rawSize=(unsigned long)nModule*EVENTSIZE;
+  LSTDAQ::WaveformCodec codec;
+  unsigned char *enc=new unsigned char[(unsigned long)nEvent*codec.getMaxSize(rawSize)];
+  unsigned int *encSize=new unsigned int[nEvent];
+  unsigned char *dec=new unsigned char[rawSize];
+
+  //****** encode ******
+  struct timespec ts;
+  unsigned long long total=0;
+  unsigned char *p=enc;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  for(int i=0;i<nEvent;i++)
+  {
+    encSize[i]=LSTDAQ::WaveformCodec::encode(raw+(unsigned long)i*rawSize,nModule,NGAIN,p);
+    p+=encSize[i];
+    total+=encSize[i];
+  }
+  double tEnc=secSince(&ts);
+
+  //****** decode and check ******
+  int nBad=0;
+  p=enc;
+  double tDec=0;
+  for(int i=0;i<nEvent;i++)
+  {
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    int n=LSTDAQ::WaveformCodec::decode(p,encSize[i],nModule,NGAIN,dec);
+    tDec+=secSince(&ts);
+    if(n!=(int)rawSize || memcmp(dec,raw+(unsigned long)i*rawSize,rawSize)!=0)nBad++;
+    p+=encSize[i];
+  }
+
+  double mb=(double)rawSize*nEvent/1e6;
+  cout<<"input               :"<<(fileName!=NULL ? fileName : "simulation")<<endl;
+  cout<<"events              :"<<nEvent<<" x "<<nModule<<" modules ("<<rawSize<<" bytes)"<<endl;
+  cout<<"ratio               :"<<fixed<<setprecision(3)<<(double)rawSize*nEvent/total<<endl;
+  cout<<"encode              :"<<setprecision(1)<<mb/tEnc<<" MB/s"<<endl;
+  cout<<"decode              :"<<mb/tDec<<" MB/s"<<endl;
+  cout<<"round trip          :"<<(nBad==0 ? "OK" : "FAILED")<<" ("<<nBad<<" bad events)"<<endl;
+  return nBad==0 ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+//
+//! \file  PackBench.cpp
+//  Benchmark of the 12 bit packing kernels (Pack12) for each instruction set.
+//
+//  Usage : packbench [-m nModule] [-n nEvent]
+//
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "Config.hpp"
+#include "Simd.hpp"
+#include "Pack12.hpp"
+#include "SimEvent.hpp"
+
+using namespace std;
+
+static double secSince(const struct timespec *pFrom)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC,&now);
+  return (now.tv_sec-pFrom->tv_sec)+(now.tv_nsec-pFrom->tv_nsec)*1e-9;
+}
+
+int main(int argc, char **argv)
+{
+  int nModule=16;
+  int nEvent=200;
+  int nLoop=20;
+  int opt;
+  while((opt=getopt(argc,argv,"m:n:l:"))!=-1)
+  {
+    switch(opt)
+    {
+    case 'm':nModule=atoi(optarg);break;
+    case 'n':nEvent=atoi(optarg);break;
+    case 'l':nLoop=atoi(optarg);break;
+    default:
+      printf("usage : %s [-m nModule] [-n nEvent] [-l nLoop]\n",argv[0]);
+      exit(1);
+    }
+  }
+
+  unsigned long rawSize=(unsigned long)nModule*EVENTSIZE;
+  unsigned long packSize=(unsigned long)nModule*PACK12_MODULESIZE(NGAIN);
+  unsigned char *raw=new unsigned char[rawSize*nEvent];
+  unsigned char *packed=new unsigned char[packSize*nEvent];
+  unsigned char *ref=new unsigned char[packSize*nEvent];
+  unsigned char *dec=new unsigned char[rawSize*nEvent];
+  LSTDAQ::SimEvent sim(nModule,5.,0.1);
+  for(int i=0;i<nEvent;i++)sim.fill(raw+i*rawSize);
+
+  int maxLevel=LSTDAQ::getSimdLevel();
+  cout<<"events              :"<<nEvent<<" x "<<nModule<<" modules, "<<nLoop<<" loops"<<endl;
+  for(int level=SIMD_SCALAR;level<=maxLevel;level++)
+  {
+    LSTDAQ::setSimdLevel(level);
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    for(int k=0;k<nLoop;k++)
+      for(int i=0;i<nEvent;i++)LSTDAQ::Pack12::encode(raw+i*rawSize,nModule,NGAIN,packed+i*packSize);
+    double tPack=secSince(&ts);
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    for(int k=0;k<nLoop;k++)
+      for(int i=0;i<nEvent;i++)LSTDAQ::Pack12::decode(packed+i*packSize,packSize,nModule,NGAIN,dec+i*rawSize);
+    double tUnpack=secSince(&ts);
+
+    if(level==SIMD_SCALAR)memcpy(ref,packed,packSize*nEvent);
+    bool ok=(memcmp(ref,packed,packSize*nEvent)==0 && memcmp(raw,dec,rawSize*nEvent)==0);
+    double gb=(double)rawSize*nEvent*nLoop/1e9;
+    printf("%-8s pack %6.2f GB/s  unpack %6.2f GB/s  %s\n",LSTDAQ::getSimdName(level),
+           gb/tPack,gb/tUnpack,ok ? "OK" : "MISMATCH");
+  }
+  printf("size                : %lu -> %lu bytes (%.1f%%)\n",rawSize,packSize,100.*packSize/rawSize);
+  return 0;
+}
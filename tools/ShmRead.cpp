@@ -0,0 +1,114 @@
+//
+//! \file  ShmRead.cpp
+//  Example reader of the shared memory ring published by LSTDAQ -m <name>.
+//  Follows the events and prints every second how many were read, skipped and overwritten while read,
+//  with the delay from building to reading.
+//
+//  Usage : shmreader [-n nEvent] [-c] <name>
+//    -c : copy each event out of the ring (otherwise the events are used in place)
+//
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "Config.hpp"
+#include "EventFormat.hpp"
+#include "ShmReader.hpp"
+
+using namespace std;
+
+static double secSince(const struct timespec *pFrom)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC,&now);
+  return (now.tv_sec-pFrom->tv_sec)+(now.tv_nsec-pFrom->tv_nsec)*1e-9;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long long nEvent=0;
+  bool copy=false;
+  int opt;
+  while((opt=getopt(argc,argv,"n:c"))!=-1)
+  {
+    switch(opt)
+    {
+    case 'n':nEvent=strtoull(optarg,NULL,10);break;
+    case 'c':copy=true;break;
+    default:
+      printf("usage : %s [-n nEvent] [-c] <name>\n",argv[0]);
+      exit(1);
+    }
+  }
+  if(optind>=argc)
+  {
+    printf("usage : %s [-n nEvent] [-c] <name>\n",argv[0]);
+    exit(1);
+  }
+
+  //****** wait up to 10 sec for LSTDAQ to create the ring ******
+  LSTDAQ::ShmReader reader;
+  int nTry=0;
+  while(!reader.open(argv[optind]) && ++nTry<100)usleep(100000);
+  if(nTry==100)
+  {
+    printf("cannot open shared memory %s\n",argv[optind]);
+    exit(1);
+  }
+  unsigned char *buf=new unsigned char[EVENTSIZE*MAX_CONNECTION*2];
+  LSTDAQ::EventHeader copied;
+
+  struct timespec tsStart,tsPrint;
+  clock_gettime(CLOCK_MONOTONIC,&tsStart);
+  tsPrint=tsStart;
+  unsigned long long nGood=0,nBad=0,lastPrinted=0;
+  unsigned long long firstTrigger=0,lastTrigger=0;
+  double delaySum=0;
+  while(nEvent==0 || nGood<nEvent)
+  {
+    const LSTDAQ::EventHeader *h;
+    const unsigned char *data;
+    int ret=reader.next(&h,&data,200000);
+    if(ret<0)break;
+    if(ret>0)
+    {
+      unsigned long long trigger=h->trigger;
+      bool ok=(memcmp(h->magic,EVENT_MAGIC,4)==0);
+      if(copy)
+        ok=reader.copy(&copied,buf) && ok;
+      else
+        ok=reader.isValid() && ok;
+      if(ok)
+      {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME,&now);
+        delaySum+=((unsigned long long)now.tv_sec*1000000000ULL+now.tv_nsec-reader.getTimeNs())*1e-6;
+        if(nGood==0)firstTrigger=trigger;
+        lastTrigger=trigger;
+        nGood++;
+      }
+      else
+        nBad++;
+    }
+    if(secSince(&tsPrint)>=1.)
+    {
+      double sec=secSince(&tsPrint);
+      clock_gettime(CLOCK_MONOTONIC,&tsPrint);
+      printf("read %llu (%.1f events/s), skipped %llu, overwritten %llu, delay %.3f msec\n",
+             nGood,(nGood-lastPrinted)/sec,reader.getNskipped(),nBad,
+             nGood>0 ? delaySum/nGood : 0.);
+      lastPrinted=nGood;
+    }
+  }
+  double sec=secSince(&tsStart);
+  cout<<"events read         :"<<nGood<<" (trigger "<<firstTrigger<<" - "<<lastTrigger<<")"<<endl;
+  cout<<"events skipped      :"<<reader.getNskipped()<<endl;
+  cout<<"events overwritten  :"<<nBad<<endl;
+  printf("rate                :%.1f events/s\n",nGood/sec);
+  printf("mean delay          :%.3f msec\n",nGood>0 ? delaySum/nGood : 0.);
+  delete[] buf;
+  return 0;
+}
@@ -0,0 +1,109 @@
+//
+//! \file  SimEvent.hpp
+//  Simple simulator of module fragments for the benchmarks in tools/.
+//
+
+#ifndef __SIMEVENT_H
+#define __SIMEVENT_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "Config.hpp"
+
+namespace LSTDAQ{
+
+  /**
+   * Makes fragments which look like DRS4 data.
+   *
+   * Each channel has a fixed pedestal per cell (around 400 counts), gaussian noise is added and
+   * the samples are read from the stop cell on with wraparound. A fraction of the channels gets
+   * a pulse, 10 times smaller in the low gain. Samples are 12 bits, big endian.
+   */
+  class SimEvent
+  {
+  public:
+    /**
+     * @param nModule   number of modules
+     * @param noise     sigma of the noise [counts]
+     * @param pulseFrac fraction of channels with a pulse
+     */
+    SimEvent(int nModule, double noise, double pulseFrac)
+      :m_nModule(nModule),m_noise(noise),m_pulseFrac(pulseFrac),m_seed(1),m_trigger(0)
+    {
+      m_ped=new unsigned short[(unsigned long)nModule*NGAIN*NCHANNEL*DRS4_NCELL];
+      for(unsigned long i=0;i<(unsigned long)nModule*NGAIN*NCHANNEL*DRS4_NCELL;i++)
+        m_ped[i]=(unsigned short)(380+rand_r(&m_seed)%40);
+    }
+    ~SimEvent()
+    {
+      delete[] m_ped;
+    }
+    /**
+     * @return pedestal of the cell
+     */
+    unsigned short getPedestal(int module, int gain, int channel, int cell)
+    {
+      return m_ped[(((unsigned long)module*NGAIN+gain)*NCHANNEL+channel)*DRS4_NCELL+cell];
+    }
+    /**
+     * Fills nModule fragments of the next event.
+     */
+    void fill(unsigned char *buf)
+    {
+      for(int m=0;m<m_nModule;m++)
+      {
+        unsigned char *frag=buf+(unsigned long)m*EVENTSIZE;
+        memset(frag,0,LINE_WAVEFORM*LINESIZE);
+        frag[0]=0xAA;
+        frag[1]=0xAA;
+        for(int i=0;i<4;i++)
+        {
+          frag[POSEVTNO+i]=(unsigned char)(m_trigger>>(24-8*i));
+          frag[POSTRGNO+i]=(unsigned char)(m_trigger>>(24-8*i));
+        }
+        int stop[NCHANNEL];
+        for(int c=0;c<NCHANNEL;c++)
+        {
+          stop[c]=rand_r(&m_seed)%DRS4_NCELL;
+          frag[LINE_STOPCELL*LINESIZE+2*c]=(unsigned char)(stop[c]>>8);
+          frag[LINE_STOPCELL*LINESIZE+2*c+1]=(unsigned char)stop[c];
+        }
+        for(int c=0;c<NCHANNEL;c++)
+        {
+          double amp=0;
+          if(rand_r(&m_seed)<m_pulseFrac*RAND_MAX)amp=50+rand_r(&m_seed)%2000;
+          for(int g=0;g<NGAIN;g++)
+            for(int s=0;s<READDEPTH;s++)
+            {
+              double t=s-READDEPTH/2;
+              double v=getPedestal(m,g,c,(stop[c]+s)%DRS4_NCELL)+gauss()*m_noise;
+              if(amp>0 && t>-3)v+=(g==0 ? amp : amp/10)*exp(-t*t/8.);
+              if(v<0)v=0;
+              if(v>4095)v=4095;
+              unsigned short u=(unsigned short)v;
+              unsigned char *q=frag+(LINE_WAVEFORM+2*s+g)*LINESIZE+2*c;
+              q[0]=(unsigned char)(u>>8);
+              q[1]=(unsigned char)u;
+            }
+        }
+      }
+      m_trigger++;
+    }
+  private:
+    double gauss()
+    {
+      double u1=(rand_r(&m_seed)+1.)/(RAND_MAX+2.);
+      double u2=(rand_r(&m_seed)+1.)/(RAND_MAX+2.);
+      return sqrt(-2.*log(u1))*cos(2.*M_PI*u2);
+    }
+    int m_nModule;
+    double m_noise;
+    double m_pulseFrac;
+    unsigned int m_seed;
+    unsigned int m_trigger;
+    unsigned short *m_ped;
+  };
+}
+
+#endif